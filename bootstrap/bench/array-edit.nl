@@ -0,0 +1,30 @@
+#!/usr/bin/neul
+
+//array edits: adding, replacing, and removing elements one at a time
+(let fill (sub (i a)
+	(if (< $i 2000)
+		(recur (+ $i 1) (ar-extend $a $i))
+	else
+		$a
+	)
+))
+(let double (sub (i a)
+	(if (< $i (ar-sz $a))
+		(recur (+ $i 1) (ar-replace $a $i (* (ar-idx $a $i) 2)))
+	else
+		$a
+	)
+))
+(let drop (sub (i a)
+	(if (< $i 500)
+		(recur (+ $i 1) (ar-omit $a 0))
+	else
+		$a
+	)
+))
+
+(let a ($drop 0 ($double 0 ($fill 0 (array)))))
+(outexp (ar-sz $a))
+(outs " ")
+(outexp (ar-idx $a 0))
+(outs $newl)
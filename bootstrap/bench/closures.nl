@@ -0,0 +1,17 @@
+#!/usr/bin/neul
+
+//closure creation: making (and calling) a new closure on every iteration
+(let make-adder (sub (n)
+	(sub (x) (+ $x $n))
+))
+
+(let sum (sub (i total)
+	(if (< $i 60000)
+		(recur (+ $i 1) (($make-adder $i) $total))
+	else
+		$total
+	)
+))
+
+(outexp ($sum 0 0))
+(outs $newl)
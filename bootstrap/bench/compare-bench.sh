@@ -0,0 +1,36 @@
+#!/bin/bash
+
+#compares two sets of benchmark results (from run-bench.sh), giving the change in each number as a percentage of the old one
+#usage: compare-bench.sh <old results> <new results>
+
+if [ "$#" -ne 2 ]
+then
+	echo "Usage: $0 <old results> <new results>" 1>&2
+	exit 1
+fi
+
+#every benchmark line looks like "name": {"median_ms": 1.234, "peak_rss_kb": 5678, "allocs": 91011}
+awk '
+function change(old_val,new_val){
+	if((old_val=="null") || (new_val=="null") || (old_val==0)){
+		return "     n/a"
+	}
+	return sprintf("%+7.1f%%",((new_val-old_val)*100)/old_val)
+}
+/"median_ms"/ {
+	line=$0
+	gsub(/[",{}:]/," ",line)
+	split(line,f," ")
+	if(FNR==NR){
+		old_ms[f[1]]=f[3]
+		old_rss[f[1]]=f[5]
+		old_allocs[f[1]]=f[7]
+		next
+	}
+	if(!(f[1] in old_ms)){
+		printf("%-16s (new)\n",f[1])
+		next
+	}
+	printf("%-16s %10s ms -> %10s ms %s   %8s kb -> %8s kb %s   %10s -> %10s allocs %s\n",f[1],old_ms[f[1]],f[3],change(old_ms[f[1]],f[3]),old_rss[f[1]],f[5],change(old_rss[f[1]],f[5]),old_allocs[f[1]],f[7],change(old_allocs[f[1]],f[7]))
+}
+' "$1" "$2"
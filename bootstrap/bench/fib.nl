@@ -0,0 +1,13 @@
+#!/usr/bin/neul
+
+//recursion: naive fibonacci, which is nothing but subroutine calls and arithmetic
+(let fib (sub (n)
+	(if (< $n 2)
+		$n
+	else
+		(+ ($fib (- $n 1)) ($fib (- $n 2)))
+	)
+))
+
+(outexp ($fib 21))
+(outs $newl)
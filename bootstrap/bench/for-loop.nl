@@ -0,0 +1,11 @@
+#!/usr/bin/neul
+
+//tight loops: nested for loops doing a little arithmetic on every iteration
+(outexp (for i 0 (< $i 300) (+ $i 1)
+	(for j 0 (< $j 300) (+ $j 1)
+		(+ (* $i $j) 1)
+	)
+after
+	$i
+))
+(outs $newl)
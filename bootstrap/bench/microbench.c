@@ -0,0 +1,226 @@
+//micro-benchmarks of the interpreter's core data structures, run in isolation from the evaluator
+//this is built with the interpreter's own sources, minus its main (see the microbench target in the Makefile)
+//every benchmark is run a few times and the fastest run is reported, in cycles (the timestamp counter), ns, and operations per second
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "nl_structures.h"
+
+//how many times each benchmark is run (the fastest counts), and how many distinct names and elements they work on
+#define NL_MB_ROUNDS 7
+#define NL_MB_NAMES 4096
+#define NL_MB_ELEMENTS 65536
+#define NL_MB_DEPTH 64
+
+//BEGIN MICRO-BENCHMARK HARNESS -----------------------------------------------------------------------------------
+
+//the names every trie benchmark uses ("name-0" through "name-4095")
+char *nl_mb_names[NL_MB_NAMES];
+unsigned int nl_mb_name_lens[NL_MB_NAMES];
+
+//the trie the match benchmark reads
+nl_trie_node *nl_mb_trie=NULL;
+
+//a deep structure (nested lists of numbers, strings, and symbols) for the copy and compare benchmarks, and a copy of it
+nl_val *nl_mb_deep=NULL;
+nl_val *nl_mb_deep_cp=NULL;
+
+//the source text the parse benchmark reads
+nl_val *nl_mb_src=NULL;
+
+//read the timestamp counter (cycles at a constant rate on any recent x86 processor), or nanoseconds where there isn't one
+unsigned long long nl_mb_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+	unsigned long long ret=__rdtsc();
+	_mm_lfence();
+	return ret;
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (((unsigned long long)(t.tv_sec))*1000000000ULL)+t.tv_nsec;
+#endif
+}
+
+//the monotonic clock, in nanoseconds
+unsigned long long nl_mb_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (((unsigned long long)(t.tv_sec))*1000000000ULL)+t.tv_nsec;
+}
+
+//run a benchmark (which does ops operations each time it's called) and write out how fast it went
+void nl_mb_run(const char *name, void (*bench)(unsigned int ops), unsigned int ops){
+	//the first call warms up caches and the allocator, and isn't counted
+	bench(ops);
+	
+	unsigned long long best_cycles=0;
+	unsigned long long best_ns=0;
+	unsigned int round;
+	for(round=0;round<NL_MB_ROUNDS;round++){
+		unsigned long long start_ns=nl_mb_ns();
+		unsigned long long start_cycles=nl_mb_cycles();
+		bench(ops);
+		unsigned long long cycles=nl_mb_cycles()-start_cycles;
+		unsigned long long ns=nl_mb_ns()-start_ns;
+		if((round==0) || (cycles<best_cycles)){
+			best_cycles=cycles;
+			best_ns=ns;
+		}
+	}
+	
+	double ns_per_op=((double)(best_ns))/ops;
+	printf("%-24s %10u %12.1f %12.1f %14.0f\n",name,ops,((double)(best_cycles))/ops,ns_per_op,(ns_per_op>0)?(1000000000.0/ns_per_op):0.0);
+}
+
+//END MICRO-BENCHMARK HARNESS -------------------------------------------------------------------------------------
+
+//BEGIN MICRO-BENCHMARKS ------------------------------------------------------------------------------------------
+
+//add every name to a new trie (ops is the number of names), then free it
+void nl_mb_trie_add(unsigned int ops){
+	nl_trie_node *trie=nl_trie_malloc();
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		nl_trie_add_node(trie,nl_mb_names[n%NL_MB_NAMES],0,nl_mb_name_lens[n%NL_MB_NAMES],nl_null,FALSE,FALSE);
+	}
+	nl_trie_free(trie);
+}
+
+//look up names in a trie that has all of them, the way the environment does (reordering what's found)
+void nl_mb_trie_match(unsigned int ops){
+	char success;
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		//(a stride that isn't a factor of the name count, so lookups jump around the trie)
+		unsigned int idx=(n*7919)%NL_MB_NAMES;
+		nl_trie_match(nl_mb_trie,nl_mb_names[idx],0,nl_mb_name_lens[idx],&success,TRUE);
+	}
+}
+
+//push numbers onto a new array one at a time, then free it
+void nl_mb_array_push(unsigned int ops){
+	nl_val *a=nl_val_malloc(ARRAY);
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		nl_val *v=nl_val_malloc(NUM);
+		v->d.num.n=n;
+		v->d.num.d=1;
+		nl_array_push(a,v);
+	}
+	nl_val_free(a);
+}
+
+//copy the deep structure and free the copy
+void nl_mb_val_cp_free(unsigned int ops){
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		nl_val_free(nl_val_cp(nl_mb_deep));
+	}
+}
+
+//reduce fractions with a range of common factors
+void nl_mb_gcd_reduce(unsigned int ops){
+	nl_val v;
+	v.t=NUM;
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		v.d.num.n=((long long int)(n+1))*6006;
+		v.d.num.d=((long long int)((n%97)+1))*4290;
+		nl_gcd_reduce(&v);
+	}
+}
+
+//compare the deep structure with an equal copy of it (which has to look at everything)
+void nl_mb_val_cmp(unsigned int ops){
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		if(nl_val_cmp(nl_mb_deep,nl_mb_deep_cp)!=0){
+			fprintf(stderr,"Err: a copy compared as different from the original\n");
+			exit(1);
+		}
+	}
+}
+
+//parse the source text to an expression and free it
+void nl_mb_str_read_exp(unsigned int ops){
+	unsigned int n;
+	for(n=0;n<ops;n++){
+		unsigned int pos=0;
+		nl_val_free(nl_str_read_exp(nl_mb_src,&pos));
+	}
+}
+
+//END MICRO-BENCHMARKS --------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[]){
+	//the runtime needs an interpreter to allocate values in, just like a program does
+	nl_packed_byte_vals_init();
+	nl_vm_enter(nl_vm_malloc());
+	
+	unsigned int n;
+	nl_mb_trie=nl_trie_malloc();
+	for(n=0;n<NL_MB_NAMES;n++){
+		char name[32];
+		snprintf(name,sizeof(name),"name-%u",n);
+		nl_mb_names[n]=strdup(name);
+		nl_mb_name_lens[n]=strlen(name);
+		if(nl_mb_names[n]==NULL){
+			fprintf(stderr,"Err: could not malloc a name (out of memory?)\n");
+			return 1;
+		}
+		nl_trie_add_node(nl_mb_trie,nl_mb_names[n],0,nl_mb_name_lens[n],nl_null,FALSE,FALSE);
+	}
+	
+	//the deep structure is NL_MB_DEPTH levels of (level "text" (a b c) (next level...))
+	//and the parse benchmark reads that same text
+	size_t src_size=(NL_MB_DEPTH*64)+64;
+	char *src=(char*)(malloc(src_size));
+	if(src==NULL){
+		fprintf(stderr,"Err: could not malloc the source text (out of memory?)\n");
+		return 1;
+	}
+	src[0]='\0';
+	for(n=0;n<NL_MB_DEPTH;n++){
+		char level[64];
+		snprintf(level,sizeof(level),"(%u/3 \"level text\" (1 2 3) sym-%u ",n,n);
+		strcat(src,level);
+	}
+	for(n=0;n<NL_MB_DEPTH;n++){
+		strcat(src,")");
+	}
+	nl_mb_src=nl_str_from_c_str(src);
+	unsigned int pos=0;
+	nl_mb_deep=nl_str_read_exp(nl_mb_src,&pos);
+	nl_mb_deep_cp=nl_val_cp(nl_mb_deep);
+	free(src);
+	
+	printf("%-24s %10s %12s %12s %14s\n","benchmark","ops","cycles/op","ns/op","ops/sec");
+	nl_mb_run("nl_trie_add_node",nl_mb_trie_add,NL_MB_NAMES);
+	nl_mb_run("nl_trie_match",nl_mb_trie_match,NL_MB_ELEMENTS);
+	nl_mb_run("nl_array_push",nl_mb_array_push,NL_MB_ELEMENTS);
+	nl_mb_run("nl_val_cp+nl_val_free",nl_mb_val_cp_free,256);
+	nl_mb_run("nl_gcd_reduce",nl_mb_gcd_reduce,NL_MB_ELEMENTS);
+	nl_mb_run("nl_val_cmp",nl_mb_val_cmp,256);
+	nl_mb_run("nl_str_read_exp",nl_mb_str_read_exp,256);
+	
+	nl_val_free(nl_mb_deep);
+	nl_val_free(nl_mb_deep_cp);
+	nl_val_free(nl_mb_src);
+	nl_trie_free(nl_mb_trie);
+	for(n=0;n<NL_MB_NAMES;n++){
+		free(nl_mb_names[n]);
+	}
+	return 0;
+}
+
@@ -0,0 +1,19 @@
+#!/usr/bin/neul
+
+//parsing: write out a large source file, then read and evaluate it
+//(run with --no-cache so that the file is parsed every time rather than loaded from its cache)
+//the source is built by doubling one line (8192 lines in 13 steps), so building it takes next to nothing next to parsing it;
+//time writes how long source itself took to stderr
+(let src-file "/tmp/neulang-bench-parse.nl")
+(let line (, "(lit (entry 12/5 -3 " $dquo "some text" $dquo " 'c' (nested (list of) symbols) (1 2 3)))" $newl))
+(let double (sub (n src)
+	(if (= $n 0)
+		$src
+	else
+		(recur (- $n 1) (, $src $src))
+	)
+))
+(ar->file $src-file ($double 13 $line))
+
+(outexp (time (source $src-file)))
+(outs $newl)
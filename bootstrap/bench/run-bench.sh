@@ -0,0 +1,49 @@
+#!/bin/bash
+
+#runs every benchmark here (bench/*.nl) several times, and writes the results to stdout as JSON
+#each benchmark gets one line, so two sets of results can be compared with diff (or compare-bench.sh, which gives the changes)
+#for each one this gives the median wall time over the runs in milliseconds, and from the interpreter's --stats output
+#the peak resident memory in kilobytes and the number of values allocated
+#usage: run-bench.sh [runs] [interpreter]
+
+runs=${1:-5}
+neul=${2:-./bootstrap-neul}
+bench_dir=$(dirname "$0")
+
+#--no-cache makes sure every run parses its source, rather than the first run parsing it and the rest loading a cache
+echo "{"
+echo "\"runs\": ${runs},"
+echo "\"benchmarks\": {"
+sep=""
+for file in "${bench_dir}"/*.nl
+do
+	name=$(basename "${file}" .nl)
+	times=""
+	stats=""
+	for run in $(seq 1 "${runs}")
+	do
+		start=$(date +%s%N)
+		stats=$("${neul}" --no-cache --stats "${file}" 2>&1 >/dev/null | tail -n 1)
+		status=$?
+		end=$(date +%s%N)
+		times="${times}$(( (end-start)/1000 ))"$'\n'
+	done
+	
+	#the middle run, once they're sorted (for an even number of runs, the faster of the two middle ones)
+	median_us=$(echo -n "${times}" | sort -n | sed -n "$(( (runs+1)/2 ))p")
+	allocs=$(echo "${stats}" | sed -n 's/.*"allocs": \([0-9]*\).*/\1/p')
+	peak_rss_kb=$(echo "${stats}" | sed -n 's/.*"peak_rss_kb": \([0-9]*\).*/\1/p')
+	if [ -z "${allocs}" ] || [ -z "${peak_rss_kb}" ]
+	then
+		echo "${name} failed: ${stats}" 1>&2
+		allocs=null
+		peak_rss_kb=null
+	fi
+	
+	echo -n "${sep}"
+	printf '\t"%s": {"median_ms": %d.%03d, "peak_rss_kb": %s, "allocs": %s}' "${name}" $(( median_us/1000 )) $(( median_us%1000 )) "${peak_rss_kb}" "${allocs}"
+	sep=$',\n'
+done
+echo ""
+echo "}"
+echo "}"
@@ -0,0 +1,13 @@
+#!/usr/bin/neul
+
+//string building: appending to a string one piece at a time with ,
+(let build (sub (i text)
+	(if (< $i 20000)
+		(recur (+ $i 1) (, $text "line " (val->memstr $i) $newl))
+	else
+		$text
+	)
+))
+
+(outexp (ar-sz ($build 0 "")))
+(outs $newl)
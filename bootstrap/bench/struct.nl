@@ -0,0 +1,19 @@
+#!/usr/bin/neul
+
+//structs: reading and replacing fields over and over
+(let step (sub (i p)
+	(if (< $i 20000)
+		(recur (+ $i 1) (struct-replace (struct-replace (struct-replace $p
+				x (+ (struct-get $p x) $i))
+				y (- (struct-get $p y) 1))
+				hits (+ (struct-get $p hits) 1)))
+	else
+		$p
+	)
+))
+
+(let p ($step 0 (struct (x 0) (y 0) (name "point") (hits 0))))
+(outexp (struct-get $p x))
+(outs " ")
+(outexp (struct-get $p hits))
+(outs $newl)
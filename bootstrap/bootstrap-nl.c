@@ -4,6 +4,12 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
 
 //BEGIN DATA STRUCTURES -------------------------------------------------------------------------------------------
 //NOTE: this also includes forward declarations for all functions (including standard library ones) and global constants
@@ -12,61 +18,40 @@
 
 //BEGIN GLOBAL DATA -----------------------------------------------------------------------------------------------
 
-//keywords
-nl_val *true_keyword;
-nl_val *false_keyword;
-nl_val *null_keyword;
-//nl_val *line_num_keyword;
-
-nl_val *pair_keyword;
-nl_val *f_keyword;
-nl_val *r_keyword;
-nl_val *if_keyword;
-nl_val *else_keyword;
-nl_val *and_keyword;
-nl_val *or_keyword;
-nl_val *not_keyword;
-nl_val *xor_keyword;
-nl_val *exit_keyword;
-nl_val *lit_keyword;
-nl_val *let_keyword;
-nl_val *sub_keyword;
-nl_val *begin_keyword;
-nl_val *recur_keyword;
-nl_val *return_keyword;
-nl_val *with_keyword;
-nl_val *while_keyword;
-nl_val *for_keyword;
-nl_val *after_keyword;
-nl_val *array_keyword;
-nl_val *list_keyword;
-nl_val *struct_keyword;
-nl_val *type_keyword;
-
-nl_val *byte_t_keyword;
-nl_val *num_t_keyword;
-nl_val *pair_t_keyword;
-nl_val *array_t_keyword;
-nl_val *pri_t_keyword;
-nl_val *sub_t_keyword;
-nl_val *struct_t_keyword;
-nl_val *symbol_t_keyword;
-nl_val *evaluation_t_keyword;
-nl_val *bind_t_keyword;
-nl_val *null_t_keyword;
+//the interpreter this thread is running (declared in nl_structures.h)
+__thread nl_vm *nl_vm_cur=NULL;
+
+//source files are parsed once and the parse cached next to them (see nl_source_read), unless this is turned off
+//this is a process-wide option, set before any interpreter starts
+char nl_source_cache=TRUE;
+
+//global null
+//NULL is never reference counted or changed, so one value is shared by every interpreter in the process
+nl_val nl_null_val={NL_NULL,NL_VAL_FROZEN,0,1};
+nl_val *nl_null=&nl_null_val;
+
+//parallel work (see nl_array_pmap); the thread count is a process-wide option, set before any interpreter starts
+unsigned int nl_par_threads=0;
+int nl_par_active=0;
 
 //END GLOBAL DATA -------------------------------------------------------------------------------------------------
 
 //error message function
 void nl_err(const nl_val *v, const char *msg, char output){
+	nl_par_impure();
+	nl_vm_cur->err_cnt++;
+	
+	//stdout may be fully buffered, so flush it first to keep output and errors in order
+	fflush(stdout);
+	
 	if(v!=nl_null){
 		if(output){
-			fprintf(stderr,"Err [line %u]: %s ",v->line,msg);
+			fprintf(stderr,"Err [line %u]: %s ",nl_val_line(v),msg);
 			fprintf(stderr,"(relevant value might be ");
 			nl_out(stderr,v);
 			fprintf(stderr,")\n");
 		}else{
-			fprintf(stderr,"Err [line %u]: %s\n",v->line,msg);
+			fprintf(stderr,"Err [line %u]: %s\n",nl_val_line(v),msg);
 		}
 	}else{
 		//this output case will always list NULL as the value
@@ -74,12 +59,12 @@ void nl_err(const nl_val *v, const char *msg, char output){
 		//note the line number is global, rather that the value's line number (since nl_null is only allocated once)
 		// ^ that is the key difference and the reason for two cases in this function
 		if(output){
-			fprintf(stderr,"Err [line %u]: %s ",line_number,msg);
+			fprintf(stderr,"Err [line %u]: %s ",nl_vm_cur->line_number,msg);
 			fprintf(stderr,"(relevant value might be ");
 			nl_out(stderr,v);
 			fprintf(stderr,")\n");
 		}else{
-			fprintf(stderr,"Err [line %u]: %s\n",line_number,msg);
+			fprintf(stderr,"Err [line %u]: %s\n",nl_vm_cur->line_number,msg);
 		}
 	}
 }
@@ -108,6 +93,9 @@ const char *nl_type_name(nl_type t){
 		case STRUCT:
 			return "STRUCT";
 			break;
+		case HANDLE:
+			return "HANDLE";
+			break;
 		case SYMBOL:
 			return "SYMBOL";
 			break;
@@ -120,6 +108,12 @@ const char *nl_type_name(nl_type t){
 		case NL_NULL:
 			return "NL_NULL";
 			break;
+		case FUTURE:
+			return "FUTURE";
+			break;
+		case CHANNEL:
+			return "CHANNEL";
+			break;
 		default:
 			break;
 	}
@@ -133,28 +127,34 @@ const nl_type nl_type_from_sym(nl_val *sym){
 		return NL_NULL;
 	}
 	
-	if(nl_val_cmp(sym,byte_t_keyword)==0){
+	if(nl_val_cmp(sym,nl_vm_cur->byte_t_keyword)==0){
 		return BYTE;
-	}else if(nl_val_cmp(sym,num_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->num_t_keyword)==0){
 		return NUM;
-	}else if(nl_val_cmp(sym,pair_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->pair_t_keyword)==0){
 		return PAIR;
-	}else if(nl_val_cmp(sym,array_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->array_t_keyword)==0){
 		return ARRAY;
-	}else if(nl_val_cmp(sym,pri_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->pri_t_keyword)==0){
 		return PRI;
-	}else if(nl_val_cmp(sym,sub_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->sub_t_keyword)==0){
 		return SUB;
-	}else if(nl_val_cmp(sym,struct_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->struct_t_keyword)==0){
 		return STRUCT;
-	}else if(nl_val_cmp(sym,symbol_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->handle_t_keyword)==0){
+		return HANDLE;
+	}else if(nl_val_cmp(sym,nl_vm_cur->symbol_t_keyword)==0){
 		return SYMBOL;
-	}else if(nl_val_cmp(sym,evaluation_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->evaluation_t_keyword)==0){
 		return EVALUATION;
-	}else if(nl_val_cmp(sym,bind_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->bind_t_keyword)==0){
 		return BIND;
-	}else if(nl_val_cmp(sym,null_t_keyword)==0){
+	}else if(nl_val_cmp(sym,nl_vm_cur->null_t_keyword)==0){
 		return NL_NULL;
+	}else if(nl_val_cmp(sym,nl_vm_cur->future_t_keyword)==0){
+		return FUTURE;
+	}else if(nl_val_cmp(sym,nl_vm_cur->channel_t_keyword)==0){
+		return CHANNEL;
 	}
 	
 	ERR_EXIT(sym,"symbol doesn't correspond to a type name",TRUE);
@@ -165,8 +165,92 @@ const nl_type nl_type_from_sym(nl_val *sym){
 
 //fuck it, just reference count the damn thing; I don't even care anymore
 
+//add the given slot to the line table's hash index
+void nl_line_index_add(nl_vm *vm, unsigned short slot){
+	unsigned int mask=(vm->line_table_size*2)-1;
+	unsigned int h=(vm->line_table[slot]*2654435761U)&mask;
+	while(vm->line_index[h]!=0){
+		h=(h+1)&mask;
+	}
+	vm->line_index[h]=slot;
+}
+
+//get the line side table slot for the given source line (allocating a new slot if needed)
+//returns 0 (no line) if the table is full
+unsigned short nl_line_slot(unsigned int line){
+	nl_vm *vm=nl_vm_cur;
+	
+	//the common case; this line was the last one the reader tagged
+	if(vm->line_table_cnt>1 && vm->line_table[vm->line_table_cnt-1]==line){
+		return (unsigned short)(vm->line_table_cnt-1);
+	}
+	
+	//a line that's been read before (source in a loop, inexp, the repl) gets the slot it had
+	unsigned int mask=(vm->line_table_size*2)-1;
+	unsigned int h=(line*2654435761U)&mask;
+	while(vm->line_index[h]!=0){
+		if(vm->line_table[vm->line_index[h]]==line){
+			return vm->line_index[h];
+		}
+		h=(h+1)&mask;
+	}
+	
+	//a parallel map chunk might be using another interpreter's table, so it never adds to it
+	if(vm->par_task){
+		return 0;
+	}
+	
+	if(vm->line_table_cnt>=vm->line_table_size){
+		//out of slots; errors for these values will just report the current line
+		if(vm->line_table_size>=NL_LINE_SLOTS){
+			if(!(vm->line_table_full)){
+				fprintf(stderr,"Warn [line %u]: more than %u distinct source lines have been read; errors in code read from now on will report the current line instead\n",vm->line_number,NL_LINE_SLOTS-1);
+				vm->line_table_full=TRUE;
+			}
+			return 0;
+		}
+		
+		//grow the table and rebuild its index
+		unsigned int new_size=vm->line_table_size*2;
+		unsigned int *new_table=(unsigned int*)(realloc(vm->line_table,new_size*sizeof(unsigned int)));
+		unsigned short *new_index=(unsigned short*)(calloc(new_size*2,sizeof(unsigned short)));
+		if((new_table==NULL) || (new_index==NULL)){
+			fprintf(stderr,"Err: could not grow the line table (out of memory?)\n");
+			exit(1);
+		}
+		free(vm->line_index);
+		vm->line_table=new_table;
+		vm->line_index=new_index;
+		vm->line_table_size=new_size;
+		unsigned int n;
+		for(n=1;n<vm->line_table_cnt;n++){
+			nl_line_index_add(vm,(unsigned short)(n));
+		}
+	}
+	
+	vm->line_table[vm->line_table_cnt]=line;
+	nl_line_index_add(vm,(unsigned short)(vm->line_table_cnt));
+	vm->line_table_cnt++;
+	return (unsigned short)(vm->line_table_cnt-1);
+}
+
+//record the current line number on a value the reader just created
+void nl_line_set(nl_val *v){
+	if(v!=nl_null && v!=NULL){
+		v->line_slot=nl_line_slot(nl_vm_cur->line_number);
+	}
+}
+
+//returns the source line a value was read on, or the current line number for values that weren't created by the reader
+unsigned int nl_val_line(const nl_val *v){
+	if(v->line_slot>0){
+		return nl_vm_cur->line_table[v->line_slot];
+	}
+	return nl_vm_cur->line_number;
+}
+
 //allocate a value, and initialize it so that we're not doing anything too crazy
-nl_val *nl_val_malloc(nl_type t){
+nl_val *(nl_val_malloc)(nl_type t){
 	nl_val *ret=(nl_val*)(malloc(sizeof(nl_val)));
 	if(ret==NULL){
 		ERR_EXIT(nl_null,"could not malloc a value (out of memory?)",FALSE);
@@ -176,8 +260,18 @@ nl_val *nl_val_malloc(nl_type t){
 	}
 	
 	ret->t=t;
+	ret->flags=0;
+	ret->line_slot=0;
 	ret->ref=1;
-	ret->line=line_number;
+	
+	//(the command-line arguments are allocated before there's an interpreter)
+	nl_vm *vm=nl_vm_cur;
+	NL_STATS_COUNT(vm,allocs,1);
+	NL_STATS_MEM(vm,live[t],1,sizeof(nl_val));
+#ifdef _LEAKCHECK
+	nl_leak_link(ret);
+#endif
+	
 	switch(ret->t){
 		case BYTE:
 			ret->d.byte.v=0;
@@ -198,13 +292,47 @@ nl_val *nl_val_malloc(nl_type t){
 			break;
 		case PRI:
 			ret->d.pri.function=NULL;
+			ret->d.pri.prof_id=0;
 			break;
 		case SUB:
-//			ret->d.sub.t=NUM;
-			ret->d.sub.args=nl_null;
-			ret->d.sub.dflt_args=nl_null;
-			ret->d.sub.body=nl_null;
-			ret->d.sub.env=NULL;
+			ret->d.sub=(nl_sub_data*)(malloc(sizeof(nl_sub_data)));
+			if(ret->d.sub==NULL){
+				ERR_EXIT(nl_null,"could not malloc a subroutine (out of memory?)",FALSE);
+				exit(1);
+			}
+//			ret->d.sub->t=NUM;
+			ret->d.sub->args=nl_null;
+			ret->d.sub->dflt_args=nl_null;
+			ret->d.sub->body=nl_null;
+			ret->d.sub->env=NULL;
+			ret->d.sub->line=0;
+			ret->d.sub->prof_name=0;
+			ret->d.sub->prof_id=0;
+			break;
+		case HANDLE:
+			ret->d.handle=(nl_handle*)(malloc(sizeof(nl_handle)));
+			if(ret->d.handle==NULL){
+				ERR_EXIT(nl_null,"could not malloc a handle (out of memory?)",FALSE);
+				exit(1);
+			}
+			ret->d.handle->fd=-1;
+			ret->d.handle->is_std=FALSE;
+			ret->d.handle->r=NULL;
+			ret->d.handle->line_bufs[0]=NULL;
+			ret->d.handle->line_bufs[1]=NULL;
+			ret->d.handle->next_line_buf=0;
+			ret->d.handle->wbuf=NULL;
+			ret->d.handle->wlen=0;
+			ret->d.handle->sync=NL_SYNC_NONE;
+			ret->d.handle->unsynced=FALSE;
+			break;
+		//the task is made by whatever makes the future (see nl_eval_future)
+		case FUTURE:
+			ret->d.future=NULL;
+			break;
+		//and the channel by nl_chan_new
+		case CHANNEL:
+			ret->d.chan=NULL;
 			break;
 		case STRUCT:
 //			ret->d.nl_struct.env=NULL;
@@ -239,12 +367,14 @@ char nl_val_free(nl_val *exp){
 		return TRUE;
 	}else if(exp==nl_null){
 		return TRUE;
+	//pinned values are free'd with their interpreter, and frozen values are never free'd
+	}else if(exp->flags & (NL_VAL_PINNED|NL_VAL_FROZEN)){
+		return FALSE;
 	}
 	
 	//decrease references on this object
-	exp->ref--;
 	//if there are still references left then don't free it quite yet
-	if(exp->ref>0){
+	if(NL_REF_DEC(exp->ref)>0){
 /*
 #ifdef _DEBUG
 		printf("nl_val_free debug 0, NOT freeing ");
@@ -275,13 +405,18 @@ char nl_val_free(nl_val *exp){
 			break;
 		//arrays need each element free'd
 		case ARRAY:
-			if(exp->d.array.v!=NULL){
+			//packed arrays just let go of their shared storage
+			if(exp->flags & NL_VAL_PACKED){
+				nl_bytes_release(exp->d.array.bytes);
+			}else if(exp->d.array.v!=NULL){
 				unsigned int n;
 				for(n=0;n<(exp->d.array.size);n++){
 //					nl_val_free(&(exp->d.array.v[n]));
 					nl_val_free(exp->d.array.v[n]);
 				}
 				free(exp->d.array.v);
+				NL_STATS_MEM(nl_vm_cur,array_slots_used,-((long long)(exp->d.array.size)),0);
+				NL_STATS_MEM(nl_vm_cur,array_slots,-((long long)(exp->d.array.stored_size)),sizeof(nl_val*));
 			}
 			break;
 		//primitive procedures are never free'd, they are static memory
@@ -289,14 +424,30 @@ char nl_val_free(nl_val *exp){
 			break;
 		//subroutines need the body an closure environment free'd
 		case SUB:
-			nl_val_free(exp->d.sub.args);
-			nl_val_free(exp->d.sub.dflt_args);
-			nl_val_free(exp->d.sub.body);
+			nl_val_free(exp->d.sub->args);
+			nl_val_free(exp->d.sub->dflt_args);
+			nl_val_free(exp->d.sub->body);
 			//if this was chained in an application environment then it needs another free (had an extra reference)
-//			if(exp->d.sub.env->shared==FALSE){
-//				nl_env_frame_free(exp->d.sub.env);
+//			if(exp->d.sub->env->shared==FALSE){
+//				nl_env_frame_free(exp->d.sub->env);
 //			}
-			nl_env_frame_free(exp->d.sub.env);
+			nl_env_frame_free(exp->d.sub->env);
+			free(exp->d.sub);
+			break;
+		//handles close their file once nothing refers to them
+		case HANDLE:
+			nl_handle_close(exp->d.handle);
+			free(exp->d.handle);
+			break;
+		case FUTURE:
+			if(exp->d.future!=NULL){
+				nl_par_task_release(exp->d.future);
+			}
+			break;
+		case CHANNEL:
+			if(exp->d.chan!=NULL){
+				nl_chan_free(exp->d.chan);
+			}
 			break;
 		case STRUCT:
 			nl_env_frame_free(exp->d.nl_struct.env);
@@ -322,6 +473,12 @@ char nl_val_free(nl_val *exp){
 			break;
 	}
 	
+	nl_vm *vm=nl_vm_cur;
+	NL_STATS_COUNT(vm,frees,1);
+	NL_STATS_MEM(vm,live[exp->t],-1,sizeof(nl_val));
+#ifdef _LEAKCHECK
+	nl_leak_unlink(exp);
+#endif
 	free(exp);
 	return TRUE;
 }
@@ -337,10 +494,10 @@ nl_val *nl_val_cp(nl_val *v){
 	
 	//if we're not doing a data-wise copy don't allocate new memory
 	//(primitive subroutines and closures are copied pointer-wise)
-	if((v->t!=PRI) && (v->t!=SUB)){
+	if((v->t!=PRI) && (v->t!=SUB) && (v->t!=HANDLE) && (v->t!=FUTURE) && (v->t!=CHANNEL)){
 		ret=nl_val_malloc(v->t);
-		//copy the line number too; if we're copying it then the user didn't just enter it
-		ret->line=v->line;
+		//copy the line slot too; if we're copying it then the user didn't just enter it
+		ret->line_slot=v->line_slot;
 	}
 	
 	switch(v->t){
@@ -352,26 +509,39 @@ nl_val *nl_val_cp(nl_val *v){
 			ret->d.num.d=v->d.num.d;
 			break;
 		//recurse to copy list elements
+		//(the elements of a frozen list are shared, but its cells are still copied, so the copy can be changed)
 		case PAIR:
-			ret->d.pair.f=nl_val_cp(v->d.pair.f);
+			ret->d.pair.f=(v->flags & NL_VAL_FROZEN)?v->d.pair.f:nl_val_cp(v->d.pair.f);
 			ret->d.pair.r=nl_val_cp(v->d.pair.r);
 			break;
 		//recurse to copy array elements, pushing each into the new array
 		case ARRAY:
-			{
+			//packed arrays share their storage (it's copied when either array is modified)
+			if(v->flags & NL_VAL_PACKED){
+				ret->flags|=NL_VAL_PACKED;
+				ret->d.array.bytes=v->d.array.bytes;
+				NL_BYTES_REF_INC(ret->d.array.bytes);
+				ret->d.array.offset=v->d.array.offset;
+				ret->d.array.size=v->d.array.size;
+			}else{
 				int n;
 				for(n=0;(n<(v->d.array.size));n++){
 //					nl_array_push(ret,nl_val_cp(&(v->d.array.v[n])));
-					nl_array_push(ret,nl_val_cp(v->d.array.v[n]));
+					//the elements of a frozen array are shared rather than copied
+					nl_array_push(ret,(v->flags & NL_VAL_FROZEN)?nl_array_entry(v,n):nl_val_cp(nl_array_entry(v,n)));
 				}
 			}
 			break;
 		//TODO: should we recurse and copy body and environment for closures? (should environment be constant between copies?)
-		//pointer-wise copies; primitive procedures and closure subroutines
+		//pointer-wise copies; primitive procedures, closure subroutines, file handles, futures, and channels
 		case PRI:
 		case SUB:
+		case HANDLE:
+		case FUTURE:
+		case CHANNEL:
 			//this is a direct pointer copy; we increment the references just to keep track of everything
-			v->ref++;
+			//(except for pinned and frozen values, which aren't reference counted)
+			NL_VAL_REF_INC(v);
 			ret=v;
 			break;
 		//in a struct copy all the bindings
@@ -403,6 +573,7 @@ nl_val *nl_val_cp(nl_val *v){
 //allocate an environment frame
 nl_env_frame *nl_env_frame_malloc(nl_env_frame *up_scope){
 	nl_env_frame *ret=(nl_env_frame*)(malloc(sizeof(nl_env_frame)));
+	NL_STATS_MEM(nl_vm_cur,env_frames,1,sizeof(nl_env_frame));
 	
 	//environments are shared by default
 	ret->shared=TRUE;
@@ -412,6 +583,10 @@ nl_env_frame *nl_env_frame_malloc(nl_env_frame *up_scope){
 	//the environment above this (NULL for global)
 	ret->up_scope=up_scope;
 	
+	//no tasks can see a new frame yet
+	ret->par_visible=FALSE;
+	ret->par_call=FALSE;
+	
 	return ret;
 }
 
@@ -428,6 +603,7 @@ void nl_env_frame_free(nl_env_frame *env){
 	//note that we do NOT free the above environment here; if you want to do that do it elsewhere
 	
 	free(env);
+	NL_STATS_MEM(nl_vm_cur,env_frames,-1,sizeof(nl_env_frame));
 }
 
 //bind the given symbol to the given value in the given environment frame
@@ -486,7 +662,8 @@ char nl_bind(nl_val *symbol, nl_val *value, nl_env_frame *env, const char chk_ty
 	//bind this symbol in the internal trie structure
 	//note that the add_node handles reference counting for value
 //	char ret=nl_trie_add_node(env->trie,symbol_c_str,0,strlen(symbol_c_str),value,chk_type);
-	char ret=nl_trie_add_node(env->trie,symbol_c_str,0,symbol->d.sym.name->d.array.size,value,chk_type);
+	//(if tasks on other threads can see this frame, they could be reading it right now)
+	char ret=nl_trie_add_node(env->trie,symbol_c_str,0,symbol->d.sym.name->d.array.size,value,chk_type,(env->par_visible) && (__atomic_load_n(&nl_par_active,__ATOMIC_RELAXED)>0));
 	
 #ifdef _DEBUG
 //	printf("nl_bind debug 2, returned from nl_trie_add_node with ret %s...\n",ret?"TRUE":"FALSE");
@@ -524,35 +701,45 @@ nl_val *nl_lookup(nl_val *symbol, nl_env_frame *env){
 	
 	char success=FALSE;
 //	nl_val *ret=nl_trie_match(env->trie,symbol_c_str,0,strlen(symbol_c_str),&success,TRUE);
-	nl_val *ret=nl_trie_match(env->trie,symbol_c_str,0,symbol->d.sym.name->d.array.size,&success,TRUE);
-	free(symbol_c_str);
+	//(lookups don't reorder the trie while parallel work is running, since other threads could be looking in it too)
+	nl_val *ret=nl_trie_match(env->trie,symbol_c_str,0,symbol->d.sym.name->d.array.size,&success,(__atomic_load_n(&nl_par_active,__ATOMIC_RELAXED)==0));
 	
 	//if we found it, return!
 	if(success){
+		free(symbol_c_str);
 		return ret;
 	}
 	
+	//a closure called in parallel work that reads a variable from its real environment (rather than one it set during this call)
+	//is reading state an earlier call left there; in order it would see what the call just before it left, which is only known then
+	//(a closure made in parallel work can still be called once that's over, through its frames; that's an ordinary lookup)
+	if((env->par_call) && (nl_vm_cur->par_task) && (env->up_scope!=NULL) && !(env->up_scope->par_call)){
+		nl_trie_match(env->up_scope->trie,symbol_c_str,0,symbol->d.sym.name->d.array.size,&success,FALSE);
+	}
+	free(symbol_c_str);
+	if(success){
+		nl_par_impure();
+	}
+	
 	//if we got here and didn't return, then this symbol wasn't bound in the current environment
 	//so look up (to a higher scope)
 	return nl_lookup(symbol,env->up_scope);
 }
 
-//make a neulang string from a c string
-nl_val *nl_str_from_c_str(const char *c_str){
+//make a neulang string from a buffer of the given length
+nl_val *nl_str_from_buf(const char *buf, unsigned int length){
 	nl_val *ret=nl_val_malloc(ARRAY);
-	
-	int n=0;
-	while(c_str[n]!='\0'){
-		nl_val *character=nl_val_malloc(BYTE);
-		character->d.byte.v=c_str[n];
-		nl_array_push(ret,character);
-		
-		n++;
+	if(length>0){
+		nl_array_push_bytes(ret,buf,length);
 	}
-	
 	return ret;
 }
 
+//make a neulang string from a c string
+nl_val *nl_str_from_c_str(const char *c_str){
+	return nl_str_from_buf(c_str,strlen(c_str));
+}
+
 //make a neulang symbol from a c string
 nl_val *nl_sym_from_c_str(const char *c_str){
 	nl_val *ret=nl_val_malloc(SYMBOL);
@@ -573,10 +760,14 @@ char *c_str_from_nl_str(nl_val *nl_str){
 	bzero(c_str,buf_size);
 	
 	//copy in the neulang string
-	int n;
-	for(n=0;n<(nl_str->d.array.size);n++){
-		if((nl_str->d.array.v[n]!=nl_null) && (nl_str->d.array.v[n]->t==BYTE)){
-			c_str[n]=nl_str->d.array.v[n]->d.byte.v;
+	if(nl_str->flags & NL_VAL_PACKED){
+		memcpy(c_str,nl_array_bytes(nl_str),nl_str->d.array.size);
+	}else{
+		int n;
+		for(n=0;n<(nl_str->d.array.size);n++){
+			if((nl_array_entry(nl_str,n)!=nl_null) && (nl_array_entry(nl_str,n)->t==BYTE)){
+				c_str[n]=nl_array_entry(nl_str,n)->d.byte.v;
+			}
 		}
 	}
 	//always null-terminate just in case
@@ -591,9 +782,23 @@ char *c_str_from_nl_str(nl_val *nl_str){
 }
 
 //make a neulang value out of a primitve function so we can bind it
+//(the value is pinned to the current interpreter; see NL_VAL_PINNED)
 nl_val *nl_primitive_wrap(nl_val *(*function)(nl_val *arglist)){
 	nl_val *ret=nl_val_malloc(PRI);
 	ret->d.pri.function=function;
+	
+	//primitives belong to the interpreter (see NL_VAL_PINNED)
+	if(nl_vm_cur->pinned_cnt>=nl_vm_cur->pinned_size){
+		nl_vm_cur->pinned_size=(nl_vm_cur->pinned_size>0)?(nl_vm_cur->pinned_size*2):256;
+		nl_vm_cur->pinned=(nl_val**)(realloc(nl_vm_cur->pinned,sizeof(nl_val*)*(nl_vm_cur->pinned_size)));
+		if(nl_vm_cur->pinned==NULL){
+			ERR_EXIT(nl_null,"could not malloc a primitive (out of memory?)",FALSE);
+			exit(1);
+		}
+	}
+	ret->flags|=NL_VAL_PINNED;
+	nl_vm_cur->pinned[nl_vm_cur->pinned_cnt]=ret;
+	nl_vm_cur->pinned_cnt++;
 	return ret;
 }
 
@@ -626,7 +831,7 @@ char nl_substitute_elements_skipsub(nl_val *list, nl_val *old_val, nl_val *new_v
 		if((list->t==PAIR) && (list->d.pair.f->t==PAIR)){
 			//if this is not a sub, while, or for statement then recurse
 			nl_val *list_start=list->d.pair.f->d.pair.f;
-			if((list_start->t==SYMBOL) && ((nl_val_cmp(list_start,sub_keyword)==0) || (nl_val_cmp(list_start,while_keyword)==0) || (nl_val_cmp(list_start,for_keyword)==0))){
+			if((list_start->t==SYMBOL) && ((nl_val_cmp(list_start,nl_vm_cur->sub_keyword)==0) || (nl_val_cmp(list_start,nl_vm_cur->while_keyword)==0) || (nl_val_cmp(list_start,nl_vm_cur->for_keyword)==0))){
 				//skip sub, while, and for statements
 			}else{
 				//recurse! recurse!
@@ -685,6 +890,89 @@ int nl_list_occur(nl_val *list, nl_val *value){
 	return ret;
 }
 
+//returns TRUE if the value is or contains a closure (structs are assumed to, rather than searched)
+char nl_val_has_sub(const nl_val *v){
+	while(v->t==PAIR){
+		if(nl_val_has_sub(v->d.pair.f)){
+			return TRUE;
+		}
+		v=v->d.pair.r;
+	}
+	
+	switch(v->t){
+		//(a future's result isn't known until it's finished, so it's assumed to have one too, and so is anything queued in a channel)
+		case SUB:
+		case STRUCT:
+		case FUTURE:
+		case CHANNEL:
+			return TRUE;
+			break;
+		//packed arrays only hold bytes
+		case ARRAY:
+			if(!(v->flags & NL_VAL_PACKED)){
+				unsigned int n;
+				for(n=0;n<v->d.array.size;n++){
+					if(nl_val_has_sub(v->d.array.v[n])){
+						return TRUE;
+					}
+				}
+			}
+			break;
+		case BIND:
+			return nl_val_has_sub(v->d.bind.v);
+			break;
+		default:
+			break;
+	}
+	return FALSE;
+}
+
+//returns TRUE if the value is or contains a closure made in the given frame (or in one below it), which would link up to that frame
+//(like nl_val_has_sub, structs, futures, and channels are assumed to, rather than searched)
+char nl_val_links_env(const nl_val *v, const nl_env_frame *env){
+	while(v->t==PAIR){
+		if(nl_val_links_env(v->d.pair.f,env)){
+			return TRUE;
+		}
+		v=v->d.pair.r;
+	}
+	
+	switch(v->t){
+		case SUB:
+			{
+				const nl_env_frame *frame;
+				for(frame=v->d.sub->env;frame!=NULL;frame=frame->up_scope){
+					if(frame==env){
+						return TRUE;
+					}
+				}
+			}
+			break;
+		case STRUCT:
+		case FUTURE:
+		case CHANNEL:
+			return TRUE;
+			break;
+		//packed arrays only hold bytes
+		case ARRAY:
+			if(!(v->flags & NL_VAL_PACKED)){
+				unsigned int n;
+				for(n=0;n<v->d.array.size;n++){
+					if(nl_val_links_env(v->d.array.v[n],env)){
+						return TRUE;
+					}
+				}
+			}
+			break;
+		case BIND:
+			return nl_val_links_env(v->d.bind.v,env);
+			break;
+		default:
+			break;
+	}
+	return FALSE;
+}
+
 //evaluate all the elements in a list, replacing them with their evaluations
 void nl_eval_elements(nl_val *list, nl_env_frame *env){
 	while(list->t==PAIR){
@@ -717,6 +1005,10 @@ nl_val *nl_eval_sequence(nl_val *body, nl_env_frame *env, char *early_ret){
 	//whether or not this is the last statement in the body
 	char on_last_exp=FALSE;
 	
+	if(nl_vm_cur->prof_ring!=NULL){
+		nl_prof_check(nl_vm_cur);
+	}
+	
 /*
 #ifdef _DEBUG
 	printf("nl_eval sequence debug -1, trying to evaluate ");
@@ -744,12 +1036,12 @@ nl_val *nl_eval_sequence(nl_val *body, nl_env_frame *env, char *early_ret){
 		to_eval=nl_val_cp(body->d.pair.f);
 		//increment the references because this (to_eval) is a new reference and nl_eval will free it before we can if it's self-evaluating
 		if(to_eval!=nl_null){
-			to_eval->ref++;
+			NL_VAL_REF_INC(to_eval);
 		}
 		
 		//note that early_ret handles nested returns (such as a return within an if statement)
 		//if we hit the "return" keyword then go ahead and treat this as the last expression (even if it wasn't properly)
-		if((to_eval->t==PAIR) && (to_eval->d.pair.f->t==SYMBOL) && (nl_val_cmp(return_keyword,to_eval->d.pair.f)==0)){
+		if((to_eval->t==PAIR) && (to_eval->d.pair.f->t==SYMBOL) && (nl_val_cmp(nl_vm_cur->return_keyword,to_eval->d.pair.f)==0)){
 			on_last_exp=TRUE;
 			
 			//returns evaluate pretty much just like begin statements
@@ -965,7 +1257,7 @@ nl_val *nl_apply(nl_val *sub, nl_val *arguments, char *early_ret){
 		if(sub==nl_null){
 			ERR_EXIT(sub,"cannot apply NULL!!!",FALSE);
 		}else{
-//			fprintf(stderr,"Err [line %u]: invalid type given to apply, expected subroutine or primitve procedure, got %i\n",line_number,sub->t);
+//			fprintf(stderr,"Err [line %u]: invalid type given to apply, expected subroutine or primitve procedure, got %i\n",nl_vm_cur->line_number,sub->t);
 			ERR_EXIT(sub,"invalid type given to apply, expected subroutine or primitve procedure",TRUE);
 		}
 #ifdef _STRICT
@@ -976,28 +1268,47 @@ nl_val *nl_apply(nl_val *sub, nl_val *arguments, char *early_ret){
 	
 	//for primitive procedures just call out to the c function
 	if(sub->t==PRI){
-		ret=(*(sub->d.pri.function))(arguments);
+		if(nl_prof_counting){
+			ret=nl_prof_count_pri(sub,arguments);
+		}else{
+			ret=(*(sub->d.pri.function))(arguments);
+		}
 	//bind arguments to internal sub symbols, substitute the body in, and actually do the apply
 	}else if(sub->t==SUB){
+		//the closure environment; arguments are bound here as well as in the apply environment
+		nl_env_frame *closure_env=sub->d.sub->env;
+		
+		//in a parallel map chunk other threads could be calling this same closure, so its environment is left alone
+		//and each call gets a fresh shared frame of its own instead (this is where new vars and returned closures end up)
+		nl_env_frame *call_env=NULL;
+		if(nl_vm_cur->par_task){
+			call_env=nl_env_frame_malloc(closure_env);
+			call_env->par_call=TRUE;
+			closure_env=call_env;
+		}
+		
+		//futures made during the call are finished before it returns, since they can see its frames (see nl_par_sync)
+		nl_par_task *futures=nl_vm_cur->futures;
+		
 		//create an apply environment with an up_scope of the closure environment
 		nl_env_frame *apply_env;
 		
 		//note that apply is never called on a tailcall, so we're always building up stack
-		apply_env=nl_env_frame_malloc(sub->d.sub.env);
+		apply_env=nl_env_frame_malloc(closure_env);
 		
-		nl_val *arg_syms=sub->d.sub.args;
+		nl_val *arg_syms=sub->d.sub->args;
 		nl_val *arg_vals=arguments;
 		
-		if(!nl_bind_dflt(sub->d.sub.dflt_args,apply_env)){
-			ERR_EXIT(sub->d.sub.dflt_args,"could not bind default (named) arguments to application environment (call stack)",TRUE);
+		if(!nl_bind_dflt(sub->d.sub->dflt_args,apply_env)){
+			ERR_EXIT(sub->d.sub->dflt_args,"could not bind default (named) arguments to application environment (call stack)",TRUE);
 		}
-		if(!nl_bind_list(arg_syms,arg_vals,apply_env,TRUE,sub->d.sub.dflt_args,FALSE)){
+		if(!nl_bind_list(arg_syms,arg_vals,apply_env,TRUE,sub->d.sub->dflt_args,FALSE)){
 			ERR_EXIT(arg_vals,"could not bind arguments to application environment (call stack) from apply",TRUE);
 		}
 		
 		//also bind those same arguments to the closure environment
 		//(the body of the closure will always look them up in the apply env, but this keeps any references such as from returned closures safe)
-		if(!nl_bind_list(arg_syms,arg_vals,sub->d.sub.env,TRUE,sub->d.sub.dflt_args,FALSE)){
+		if(!nl_bind_list(arg_syms,arg_vals,closure_env,TRUE,sub->d.sub->dflt_args,FALSE)){
 			//could not bind to closure scope
 		}
 		
@@ -1008,16 +1319,37 @@ nl_val *nl_apply(nl_val *sub, nl_val *arguments, char *early_ret){
 		//and recur are handled in nl_eval_sub (by substituting the closure for all instances of recur in the body)
 		
 		//now evaluate the body in the application env
-//		nl_val *body=sub->d.sub.body;
+//		nl_val *body=sub->d.sub->body;
 //		ret=nl_eval_sequence(nl_val_cp(body),apply_env,early_ret);
 
 		//now evaluate the body in the application env
-		nl_val *body=sub->d.sub.body;
+		nl_val *body=sub->d.sub->body;
+		if(nl_vm_cur->prof_stack!=NULL){
+			nl_prof_push(nl_vm_cur,nl_prof_frame(sub));
+		}
+		if(nl_prof_counting){
+			nl_prof_count_enter(nl_vm_cur,nl_prof_sub_key(sub),FALSE);
+		}
 		ret=nl_eval_sequence(nl_val_cp(body),apply_env,early_ret);
 //		ret=nl_eval_sequence(nl_val_cp(body),apply_env,NULL);
+		if(nl_prof_counting){
+			nl_prof_count_exit(nl_vm_cur);
+		}
+		if(nl_vm_cur->prof_stack!=NULL){
+			nl_prof_pop(nl_vm_cur);
+		}
+		
+		if(nl_vm_cur->futures!=futures){
+			nl_par_sync(futures);
+		}
 		
 		//now clean up the apply environment (call stack); again, tailcalls are handled in eval, this is never called on a tailcall
 		nl_env_frame_free(apply_env);
+		
+		//a per-call frame can go too, unless a closure made during the call (which would link up to it) is being returned
+		if((call_env!=NULL) && (!nl_val_has_sub(ret))){
+			nl_env_frame_free(call_env);
+		}
 
 /*
 #ifdef _DEBUG
@@ -1076,7 +1408,7 @@ nl_val *nl_eval_if(nl_val *arguments, nl_env_frame *env, char last_exp, char *ea
 		nl_val *tmp_args=arguments;
 		while(tmp_args->t==PAIR){
 			//if we hit an else statement then break out (skipping over false case)
-			if((tmp_args->d.pair.r==nl_null) || ((tmp_args->d.pair.r->t==PAIR) && (tmp_args->d.pair.r->d.pair.f!=nl_null) && (tmp_args->d.pair.r->d.pair.f->t==SYMBOL) && (nl_val_cmp(else_keyword,tmp_args->d.pair.r->d.pair.f)==0))){
+			if((tmp_args->d.pair.r==nl_null) || ((tmp_args->d.pair.r->t==PAIR) && (tmp_args->d.pair.r->d.pair.f!=nl_null) && (tmp_args->d.pair.r->d.pair.f->t==SYMBOL) && (nl_val_cmp(nl_vm_cur->else_keyword,tmp_args->d.pair.r->d.pair.f)==0))){
 				nl_val_free(tmp_args->d.pair.r);
 				tmp_args->d.pair.r=nl_null;
 				break;
@@ -1093,7 +1425,7 @@ nl_val *nl_eval_if(nl_val *arguments, nl_env_frame *env, char last_exp, char *ea
 		//skip over true case
 		while(arguments->t==PAIR){
 			//if we hit an else statement then break out
-			if((arguments->d.pair.f->t==SYMBOL) && (nl_val_cmp(arguments->d.pair.f,else_keyword)==0)){
+			if((arguments->d.pair.f->t==SYMBOL) && (nl_val_cmp(arguments->d.pair.f,nl_vm_cur->else_keyword)==0)){
 				break;
 			}
 			
@@ -1103,7 +1435,7 @@ nl_val *nl_eval_if(nl_val *arguments, nl_env_frame *env, char last_exp, char *ea
 		
 		//false eval
 		//if we actually hit an else statement just then (rather than the list end)
-		if((arguments!=nl_null) && (nl_val_cmp(arguments->d.pair.f,else_keyword)==0)){
+		if((arguments!=nl_null) && (nl_val_cmp(arguments->d.pair.f,nl_vm_cur->else_keyword)==0)){
 			//this MUST call out to eval_sequence to handle returns properly
 			//call into eval_sequence
 			nl_val *tmp_args=nl_val_cp(arguments->d.pair.r);
@@ -1160,16 +1492,16 @@ nl_val *nl_eval_sub(nl_val *arguments, nl_env_frame *env){
 			nl_val *n_arg=arg_iter->d.pair.f;
 //			n_arg->d.bind.sym->ref++;
 //			n_arg->d.bind.v->ref++;
-			n_arg->ref++;
+			NL_VAL_REF_INC(n_arg);
 			
 			//if there were no named arguments yet, then make a new named argument list
-			if(ret->d.sub.dflt_args==nl_null){
-				ret->d.sub.dflt_args=nl_val_malloc(PAIR);
-				ret->d.sub.dflt_args->d.pair.f=n_arg;
-				ret->d.sub.dflt_args->d.pair.r=nl_null;
+			if(ret->d.sub->dflt_args==nl_null){
+				ret->d.sub->dflt_args=nl_val_malloc(PAIR);
+				ret->d.sub->dflt_args->d.pair.f=n_arg;
+				ret->d.sub->dflt_args->d.pair.r=nl_null;
 			//if there was already a named argument list, then append to the end
 			}else{
-				nl_val *sub_arg_iter=ret->d.sub.dflt_args;
+				nl_val *sub_arg_iter=ret->d.sub->dflt_args;
 				while(sub_arg_iter->t==PAIR){
 					if(sub_arg_iter->d.pair.r==nl_null){
 						sub_arg_iter->d.pair.r=nl_val_malloc(PAIR);
@@ -1189,7 +1521,7 @@ nl_val *nl_eval_sub(nl_val *arguments, nl_env_frame *env){
 	}
 	//separate named arguments from unnamed arguments
 	nl_val *req_args=arguments->d.pair.f;
-	ret->d.sub.args=req_args;
+	ret->d.sub->args=req_args;
 	if(req_arg_cnt>0){
 		int n;
 		for(n=0;n<(req_arg_cnt-1);n++){
@@ -1198,19 +1530,19 @@ nl_val *nl_eval_sub(nl_val *arguments, nl_env_frame *env){
 		nl_val_free(req_args->d.pair.r);
 		req_args->d.pair.r=nl_null;
 	}
-	ret->d.sub.args->ref++;
+	NL_VAL_REF_INC(ret->d.sub->args);
 	
 	if(req_arg_cnt==0){
-		nl_val_free(ret->d.sub.args);
-		ret->d.sub.args=nl_null;
+		nl_val_free(ret->d.sub->args);
+		ret->d.sub->args=nl_null;
 	}
 	
 #ifdef _DEBUG
-	if(ret->d.sub.dflt_args!=nl_null){
+	if(ret->d.sub->dflt_args!=nl_null){
 		printf("eval_sub debug 0, got sub with %u required arguments ",req_arg_cnt);
-		nl_out(stdout,ret->d.sub.args);
+		nl_out(stdout,ret->d.sub->args);
 		printf(", default (named) arguments ");
-		nl_out(stdout,ret->d.sub.dflt_args);
+		nl_out(stdout,ret->d.sub->dflt_args);
 		printf("\n");
 	}
 #endif
@@ -1219,19 +1551,20 @@ nl_val *nl_eval_sub(nl_val *arguments, nl_env_frame *env){
 	while(env!=NULL && env->shared==FALSE){
 		env=env->up_scope;
 	}
-	ret->d.sub.env=nl_env_frame_malloc(env);
+	ret->d.sub->env=nl_env_frame_malloc(env);
+	ret->d.sub->line=nl_val_line(arguments);
 	
 	//the rest of the arguments are the body
-	ret->d.sub.body=arguments->d.pair.r;
-	if(ret->d.sub.body!=nl_null){
-		ret->d.sub.body->ref++;
+	ret->d.sub->body=arguments->d.pair.r;
+	if(ret->d.sub->body!=nl_null){
+		NL_VAL_REF_INC(ret->d.sub->body);
 		
 		//be sneaky about fixing recursion
 		//check the body for "recur" statements; any time we find one, replace it with a reference to this closure
 		//they'll never know!
 		
 		//if replacements were made
-		if(nl_substitute_elements_skipsub(ret->d.sub.body,recur_keyword,ret)){
+		if(nl_substitute_elements_skipsub(ret->d.sub->body,nl_vm_cur->recur_keyword,ret)){
 		}
 	}
 	
@@ -1250,10 +1583,10 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 	//TODO: refactor this code so that eval_keyword isn't GIANT (move keyword cases to separate functions)
 	
 	//check for if statements
-	if(nl_val_cmp(keyword,if_keyword)==0){
+	if(nl_val_cmp(keyword,nl_vm_cur->if_keyword)==0){
 		//handle memory to allow for TCO
 		if(arguments!=nl_null){
-			arguments->ref++;
+			NL_VAL_REF_INC(arguments);
 		}
 		nl_val_free(keyword_exp);
 		
@@ -1265,24 +1598,27 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 		//handle if statements
 //		ret=nl_eval_if(arguments,env,last_exp);
 	//check for literals (equivilent to scheme quote)
-	}else if(nl_val_cmp(keyword,lit_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->lit_keyword)==0){
 		//if there was only one argument, just return that
 		if((arguments->t==PAIR) && (arguments->d.pair.r==nl_null)){
-			arguments->d.pair.f->ref++;
+			NL_VAL_REF_INC(arguments->d.pair.f);
 			ret=arguments->d.pair.f;
 		//if there was a list of multiple arguments, return all of them
 		}else if(arguments!=nl_null){
-			arguments->ref++;
+			NL_VAL_REF_INC(arguments);
 			ret=arguments;
 		}
 		
 	//check for let statements (assignment operations)
-	}else if(nl_val_cmp(keyword,let_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->let_keyword)==0){
 		//if we got a symbol followed by something else, eval that thing and bind
 		if((arguments->t==PAIR) && (arguments->d.pair.f->t==SYMBOL) && (arguments->d.pair.r->t==PAIR)){
 			//let should never cause an early return to be passed up; (let a (return b)) will NOT return early
 //			nl_val *bound_value=nl_eval(arguments->d.pair.r->d.pair.f,env,last_exp,early_ret);
 			nl_val *bound_value=nl_eval(arguments->d.pair.r->d.pair.f,env,last_exp,NULL);
+			if(nl_prof_on){
+				nl_prof_name_sub(bound_value,arguments->d.pair.f);
+			}
 			if(!nl_bind(arguments->d.pair.f,bound_value,env,TRUE)){
 				ERR_EXIT(arguments->d.pair.f,"let couldn't bind symbol to value",TRUE);
 			}
@@ -1332,7 +1668,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			ERR_EXIT(keyword_exp,"wrong syntax for let statement",TRUE);
 		}
 	//check for type keywords (declarations)
-	}else if(nl_val_cmp(keyword,type_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->type_keyword)==0){
 		if((arguments->t==PAIR) && (arguments->d.pair.f->t==SYMBOL) && (arguments->d.pair.r->t==PAIR)){
 			if(env==NULL){
 				ERR_EXIT(keyword_exp,"NULL environment used with type expression (we fucked up BAD)",TRUE);
@@ -1393,25 +1729,27 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			ERR_EXIT(keyword_exp,"wrong syntax for type statement",TRUE);
 		}
 	//check for subroutine definitions (lambda expressions which are used as closures)
-	}else if(nl_val_cmp(keyword,sub_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->sub_keyword)==0){
 		//handle sub statements
 		ret=nl_eval_sub(arguments,env);
 	//check for begin statements (executed in-order, returning only the last)
-	}else if(nl_val_cmp(keyword,begin_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->begin_keyword)==0){
 		//handle begin statements
 //		ret=nl_eval_sequence(nl_val_cp(arguments),env,early_ret);
 		
 		//NOTE: this is used for tailcalls and depends on C TCO (-O3 or -O2)
 		if(last_exp){
+			//(the arguments are part of keyword_exp, so they're copied before it's free'd)
+			nl_val *body=nl_val_cp(arguments);
 			nl_val_free(keyword_exp);
-			return nl_eval_sequence(nl_val_cp(arguments),env,early_ret);
+			return nl_eval_sequence(body,env,early_ret);
 //			return nl_eval_sequence(nl_val_cp(arguments),env,NULL);
 		}else{
 			ret=nl_eval_sequence(nl_val_cp(arguments),env,early_ret);
 //			ret=nl_eval_sequence(nl_val_cp(arguments),env,NULL);
 		}
 	//check for return statements, they act in a manner similar to a begin tailcall
-	}else if(nl_val_cmp(keyword,return_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->return_keyword)==0){
 /*
 #ifdef _DEBUG
 		printf("nl_eval_keyword debug -1, found a return statement, arguments has %i references\n",(arguments!=NULL)?arguments->ref:0);
@@ -1422,13 +1760,13 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			(*early_ret)=TRUE;
 		}
 		
-		arguments->ref++;
+		NL_VAL_REF_INC(arguments);
 		nl_val_free(keyword_exp);
 		//NOTE: eval sequence frees the associated arguments (which is why we ref++'d a couple lines above this)
 		//NOTE: this is used for tailcalls and depends on C TCO (-O3 or -O2)
 		return nl_eval_sequence(arguments,env,NULL);
 	//check for with statements, which are used when calling with named arguments
-	}else if(nl_val_cmp(keyword,with_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->with_keyword)==0){
 		if(arguments==nl_null){
 			ERR_EXIT(keyword_exp,"no arguments given to with statement",TRUE);
 			return nl_null;
@@ -1446,8 +1784,8 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 				tmp->d.pair.f=arguments->d.pair.f->d.pair.f;
 				tmp->d.pair.r=arguments->d.pair.f->d.pair.r->d.pair.f;
 				
-				tmp->d.pair.f->ref++;
-				tmp->d.pair.r->ref++;
+				NL_VAL_REF_INC(tmp->d.pair.f);
+				NL_VAL_REF_INC(tmp->d.pair.r);
 				
 				nl_val_free(arguments->d.pair.f);
 				arguments->d.pair.f=tmp;
@@ -1458,10 +1796,10 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 		
 		//return a literal (with (sym val) ...), but with values substituted for evaluation results
 		ret=keyword_exp;
-		ret->ref++;
+		NL_VAL_REF_INC(ret);
 		
 	//check for while statements (we'll convert this to tail recursion)
-	}else if(nl_val_cmp(keyword,while_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->while_keyword)==0){
 		if(nl_c_list_size(arguments)<2){
 			ERR_EXIT(keyword_exp,"too few arguments given to while statement",TRUE);
 		}else{
@@ -1474,11 +1812,11 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 				nl_val *next_arg=arguments->d.pair.r;
 				
 				//if we found an "after" then shove everything else in the post-loop and break
-				if((next_arg->t==PAIR) && (next_arg->d.pair.f->t==SYMBOL) && (nl_val_cmp(next_arg->d.pair.f,after_keyword)==0)){
+				if((next_arg->t==PAIR) && (next_arg->d.pair.f->t==SYMBOL) && (nl_val_cmp(next_arg->d.pair.f,nl_vm_cur->after_keyword)==0)){
 					post_loop=next_arg->d.pair.r;
 					
 					//free the after keyword itself (this will not appear in the resulting sub)
-					post_loop->ref++;
+					NL_VAL_REF_INC(post_loop);
 					nl_val_free(next_arg);
 					
 					//separate this list from the body list
@@ -1488,7 +1826,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 				arguments=arguments->d.pair.r;
 			}
 			
-			cond->ref++;
+			NL_VAL_REF_INC(cond);
 //			body->ref++;
 			if(post_loop!=nl_null){
 //				post_loop->ref++;
@@ -1497,7 +1835,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			//build a sub expression to evaluate
 			nl_val *sub_to_eval=nl_val_malloc(PAIR);
 			//keyword
-			sub_to_eval->d.pair.f=nl_val_cp(sub_keyword);
+			sub_to_eval->d.pair.f=nl_val_cp(nl_vm_cur->sub_keyword);
 			sub_to_eval->d.pair.r=nl_val_malloc(PAIR);
 			//no arguments (closures preserve values of new vars between calls)
 			sub_to_eval->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
@@ -1507,7 +1845,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			sub_to_eval->d.pair.r->d.pair.r=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.r=nl_null;
-			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(if_keyword);
+			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(nl_vm_cur->if_keyword);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r->d.pair.f=cond;
 //			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r->d.pair.r=body;
@@ -1518,14 +1856,14 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 					//add in the recursive call that makes it, you know, loop
 					body->d.pair.r=nl_val_malloc(PAIR);
 					body->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
-					body->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(recur_keyword);
+					body->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(nl_vm_cur->recur_keyword);
 					body->d.pair.r->d.pair.f->d.pair.r=nl_null;
 					body->d.pair.r->d.pair.r=nl_null;
 					
 					//if we had a post-loop clause then put it in there
 					if(post_loop!=nl_null){
 						body->d.pair.r->d.pair.r=nl_val_malloc(PAIR);
-						body->d.pair.r->d.pair.r->d.pair.f=nl_val_cp(else_keyword);
+						body->d.pair.r->d.pair.r->d.pair.f=nl_val_cp(nl_vm_cur->else_keyword);
 						body->d.pair.r->d.pair.r->d.pair.r=post_loop;
 					}
 					break;
@@ -1556,7 +1894,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 //			return nl_eval(to_eval,env,last_exp,NULL);
 		}
 	//check for for statements/loops
-	}else if(nl_val_cmp(keyword,for_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->for_keyword)==0){
 		if(nl_c_list_size(arguments)<5){
 			ERR_EXIT(keyword_exp,"too few arguments given to for statement",TRUE);
 		}else{
@@ -1572,11 +1910,11 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 				nl_val *next_arg=arguments->d.pair.r;
 				
 				//if we found an "after" then shove everything else in the post-loop and break
-				if((next_arg->t==PAIR) && (next_arg->d.pair.f->t==SYMBOL) && (nl_val_cmp(next_arg->d.pair.f,after_keyword)==0)){
+				if((next_arg->t==PAIR) && (next_arg->d.pair.f->t==SYMBOL) && (nl_val_cmp(next_arg->d.pair.f,nl_vm_cur->after_keyword)==0)){
 					post_loop=next_arg->d.pair.r;
 					
 					//free the after keyword itself (this will not appear in the resulting sub)
-					post_loop->ref++;
+					NL_VAL_REF_INC(post_loop);
 					nl_val_free(next_arg);
 					
 					//separate this list from the body list
@@ -1586,10 +1924,10 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 				arguments=arguments->d.pair.r;
 			}
 			
-			counter->ref++;
-			init_val->ref++;
-			cond->ref++;
-			update->ref++;
+			NL_VAL_REF_INC(counter);
+			NL_VAL_REF_INC(init_val);
+			NL_VAL_REF_INC(cond);
+			NL_VAL_REF_INC(update);
 //			body->ref++;
 			if(post_loop!=nl_null){
 //				post_loop->ref++;
@@ -1598,7 +1936,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			//build a sub expression to evaluate
 			nl_val *sub_to_eval=nl_val_malloc(PAIR);
 			//keyword
-			sub_to_eval->d.pair.f=nl_val_cp(sub_keyword);
+			sub_to_eval->d.pair.f=nl_val_cp(nl_vm_cur->sub_keyword);
 			sub_to_eval->d.pair.r=nl_val_malloc(PAIR);
 			//one argument (the counter symbol)
 			sub_to_eval->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
@@ -1608,7 +1946,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			sub_to_eval->d.pair.r->d.pair.r=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.r=nl_null;
-			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(if_keyword);
+			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(nl_vm_cur->if_keyword);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r=nl_val_malloc(PAIR);
 			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r->d.pair.f=cond;
 //			sub_to_eval->d.pair.r->d.pair.r->d.pair.f->d.pair.r->d.pair.r=body;
@@ -1619,7 +1957,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 					//add in the recursive call that makes it, you know, loop
 					body->d.pair.r=nl_val_malloc(PAIR);
 					body->d.pair.r->d.pair.f=nl_val_malloc(PAIR);
-					body->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(recur_keyword);
+					body->d.pair.r->d.pair.f->d.pair.f=nl_val_cp(nl_vm_cur->recur_keyword);
 					body->d.pair.r->d.pair.f->d.pair.r=nl_val_malloc(PAIR);
 					//pass in the update expression which will be re-evaluated each iteration
 					body->d.pair.r->d.pair.f->d.pair.r->d.pair.f=update;
@@ -1629,7 +1967,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 					//if we had a post-loop clause then put it in there
 					if(post_loop!=nl_null){
 						body->d.pair.r->d.pair.r=nl_val_malloc(PAIR);
-						body->d.pair.r->d.pair.r->d.pair.f=nl_val_cp(else_keyword);
+						body->d.pair.r->d.pair.r->d.pair.f=nl_val_cp(nl_vm_cur->else_keyword);
 						body->d.pair.r->d.pair.r->d.pair.r=post_loop;
 					}
 					break;
@@ -1663,7 +2001,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 		}
 
 	//check for array statements (turns the evaluated argument list into an array then returns that)
-	}else if(nl_val_cmp(keyword,array_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->array_keyword)==0){
 		//first evaluate arguements
 		nl_eval_elements(arguments,env);
 		
@@ -1675,7 +2013,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for f statements (car)
-	}else if(nl_val_cmp(keyword,f_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->f_keyword)==0){
 		if(arguments->t==PAIR){
 			//evaluate the first argument
 //			nl_val *result=nl_eval(arguments->d.pair.f,env,FALSE,early_ret);
@@ -1687,7 +2025,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			if(arguments->d.pair.f->t==PAIR){
 				ret=arguments->d.pair.f->d.pair.f;
 				if(ret!=nl_null){
-					ret->ref++;
+					NL_VAL_REF_INC(ret);
 				}
 			}else{
 				ERR_EXIT(keyword_exp,"argument given to f statement was not a pair",TRUE);
@@ -1696,7 +2034,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			ERR_EXIT(keyword_exp,"incorrect usage of f statement",TRUE);
 		}
 	//check for r statements (cdr)
-	}else if(nl_val_cmp(keyword,r_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->r_keyword)==0){
 		if(arguments->t==PAIR){
 			//evaluate the first argument
 //			nl_val *result=nl_eval(arguments->d.pair.f,env,FALSE,early_ret);
@@ -1708,7 +2046,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			if(arguments->d.pair.f->t==PAIR){
 				ret=arguments->d.pair.f->d.pair.r;
 				if(ret!=nl_null){
-					ret->ref++;
+					NL_VAL_REF_INC(ret);
 				}
 			}else{
 				ERR_EXIT(keyword_exp,"argument given to r statement was not a pair",TRUE);
@@ -1717,14 +2055,14 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			ERR_EXIT(keyword_exp,"incorrect usage of r statement",TRUE);
 		}
 	//check for list statements (evaluates argument list, returns it)
-	}else if(nl_val_cmp(keyword,list_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->list_keyword)==0){
 		//first evaluate arguements
 		nl_eval_elements(arguments,env);
 		
-		arguments->ref++;
+		NL_VAL_REF_INC(arguments);
 		ret=arguments;
 	//check for boolean operator and
-	}else if(nl_val_cmp(keyword,and_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->and_keyword)==0){
 		ret=nl_val_malloc(BYTE);
 		//true until we find a false value
 		ret->d.byte.v=TRUE;
@@ -1741,7 +2079,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for boolean operator or
-	}else if(nl_val_cmp(keyword,or_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->or_keyword)==0){
 		ret=nl_val_malloc(BYTE);
 		//false until we find a true value
 		ret->d.byte.v=FALSE;
@@ -1758,7 +2096,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for boolean operator not
-	}else if(nl_val_cmp(keyword,not_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->not_keyword)==0){
 		if(nl_c_list_size(arguments)>1){
 			ERR(keyword_exp,"too many arguments given to not, ignoring all but the first...",TRUE);
 		}
@@ -1782,7 +2120,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for boolean operator xor
-	}else if(nl_val_cmp(keyword,xor_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->xor_keyword)==0){
 		ret=nl_val_malloc(BYTE);
 		//false until we find a true value, after which we better not find any more!
 		ret->d.byte.v=FALSE;
@@ -1802,7 +2140,7 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for pair keyword
-	}else if(nl_val_cmp(keyword,pair_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->pair_keyword)==0){
 		if(nl_c_list_size(arguments)!=2){
 			ERR_EXIT(keyword_exp,"wrong number of arguments given to pair",TRUE);
 		}else{
@@ -1812,12 +2150,12 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			//make a pair from the list entries
 			ret=nl_val_malloc(PAIR);
 			ret->d.pair.f=arguments->d.pair.f;
-			ret->d.pair.f->ref++;
+			NL_VAL_REF_INC(ret->d.pair.f);
 			ret->d.pair.r=arguments->d.pair.r->d.pair.f;
-			ret->d.pair.r->ref++;
+			NL_VAL_REF_INC(ret->d.pair.r);
 		}
 	//check for structs
-	}else if(nl_val_cmp(keyword,struct_keyword)==0){
+	}else if(nl_val_cmp(keyword,nl_vm_cur->struct_keyword)==0){
 		//a struct is just a named array, so we re-use the environment frame system to make that simple and painless
 		ret=nl_val_malloc(STRUCT);
 		while(arguments->t==PAIR){
@@ -1853,15 +2191,20 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			arguments=arguments->d.pair.r;
 		}
 	//check for exits
-	}else if(nl_val_cmp(keyword,exit_keyword)==0){
-		end_program=TRUE;
+	}else if(nl_val_cmp(keyword,nl_vm_cur->exit_keyword)==0){
+		nl_par_impure();
+		
+		//futures that are still running can see the environment that's about to go away; they're waited for but not finished
+		nl_par_wait(NULL);
+		
+		nl_vm_cur->end_program=TRUE;
 		ret=nl_null;
 		
 		//if an integer numeric argument was given, then pass that through to the system exit
-		exit_status=0;
+		nl_vm_cur->exit_status=0;
 		if((arguments->t==PAIR) && (arguments->d.pair.f->t==NUM)){
 			if(arguments->d.pair.f->d.num.d==1){
-				exit_status=(int)(arguments->d.pair.f->d.num.n);
+				nl_vm_cur->exit_status=(int)(arguments->d.pair.f->d.num.n);
 			}
 		}
 		
@@ -1872,12 +2215,55 @@ nl_val *nl_eval_keyword(nl_val *keyword_exp, nl_env_frame *env, char last_exp, c
 			//de-allocate the environment
 			nl_env_frame_free(env);
 			
-			//free (de-allocate) keywords
-			nl_keyword_free();
+			//free (de-allocate) the interpreter, keywords and all
+			int status=nl_vm_cur->exit_status;
+			char isolate=nl_isolate_started();
+			if(isolate){
+				nl_isolate_finish(nl_isolate_cur,status);
+			}
+			nl_vm_free(nl_vm_enter(NULL));
 			
 			//an explicit exit call is needed so we don't keep evaluating anything after this
-			exit(exit_status);
+			//(in an isolate that only ends the isolate's own thread; whatever it was still evaluating is left, as it is when the process exits)
+			if(isolate){
+				pthread_exit(NULL);
+			}
+			exit(status);
 		}
+		
+		//coroutines that haven't finished don't get to
+		nl_co_abandon_all();
+	//check for source statements, which evaluate another file's expressions right here (our include/import equivalent)
+	}else if(nl_val_cmp(keyword,nl_vm_cur->source_keyword)==0){
+		if((arguments->t==PAIR) && (arguments->d.pair.r==nl_null)){
+			nl_val *fname=nl_eval(arguments->d.pair.f,env,FALSE,NULL);
+			//null-out the list element we got rid of
+			arguments->d.pair.f=nl_null;
+			
+			if(fname->t==ARRAY){
+				ret=nl_source_eval(fname,env);
+			}else{
+				ERR_EXIT(fname,"wrong type argument given to source, expecting a file name",TRUE);
+			}
+			nl_val_free(fname);
+		}else{
+			ERR_EXIT(keyword_exp,"wrong syntax for source statement (takes exactly one file name)",TRUE);
+		}
+	//check for par statements, which evaluate each of their arguments at once (on the task scheduler) and return an array of the results
+	}else if(nl_val_cmp(keyword,nl_vm_cur->par_keyword)==0){
+		ret=nl_eval_par(arguments,env);
+	//check for futures, which start evaluating their body (on the task scheduler) and return right away; see touch
+	}else if(nl_val_cmp(keyword,nl_vm_cur->future_keyword)==0){
+		ret=nl_eval_future(arguments,env);
+	//check for spawns, which start a coroutine to evaluate their body once this one waits (on a channel, a sleep, or input) or yields
+	}else if(nl_val_cmp(keyword,nl_vm_cur->spawn_keyword)==0){
+		ret=nl_eval_spawn(arguments,env);
+	//check for time statements, which evaluate their body and report how long it took and what it allocated
+	}else if(nl_val_cmp(keyword,nl_vm_cur->time_keyword)==0){
+		ret=nl_eval_time(arguments,env,early_ret);
+	//check for image-save statements, which save the global bindings to an image (like --save-image does when the program ends)
+	}else if(nl_val_cmp(keyword,nl_vm_cur->image_save_keyword)==0){
+		ret=nl_eval_image_save(arguments,env);
 	//TODO: check for all other keywords
 	}else{
 		//in the default case check for subroutines bound to this symbol
@@ -1950,25 +2336,25 @@ tailcall:
 		case SYMBOL:
 			{
 				//TRUE keyword
-				if(nl_val_cmp(exp,true_keyword)==0){
+				if(nl_val_cmp(exp,nl_vm_cur->true_keyword)==0){
 					ret=nl_val_malloc(BYTE);
 					ret->d.byte.v=1;
 				//FALSE keyword
-				}else if(nl_val_cmp(exp,false_keyword)==0){
+				}else if(nl_val_cmp(exp,nl_vm_cur->false_keyword)==0){
 					ret=nl_val_malloc(BYTE);
 					ret->d.byte.v=0;
 				//NULL keyword
-				}else if(nl_val_cmp(exp,null_keyword)==0){
+				}else if(nl_val_cmp(exp,nl_vm_cur->null_keyword)==0){
 					ret=nl_null;
 				//LINE-NUM keyword
 /*
-				}else if(nl_val_cmp(exp,line_num_keyword)==0){
+				}else if(nl_val_cmp(exp,nl_vm_cur->line_num_keyword)==0){
 					ret=nl_val_malloc(NUM);
-					ret->d.num.n=line_number;
+					ret->d.num.n=nl_vm_cur->line_number;
 					ret->d.num.d=1;
 */
 				}else{
-					exp->ref++;
+					NL_VAL_REF_INC(exp);
 					ret=exp;
 				}
 			}
@@ -1985,7 +2371,7 @@ tailcall:
 			//otherwise eagerly evaluate then call out to apply
 			}else if(exp->d.pair.f!=nl_null){
 				//evaluate the first element, the thing we're going to apply to the arguments
-				exp->d.pair.f->ref++;
+				NL_VAL_REF_INC(exp->d.pair.f);
 				nl_val *sub=nl_eval(exp->d.pair.f,env,last_exp,early_ret);
 //				nl_val *sub=nl_eval(exp->d.pair.f,env,last_exp,NULL);
 				
@@ -1995,7 +2381,7 @@ tailcall:
 				//this is to handle anonymous subroutines, which don't have a reference from the environment frame
 				//this also handles anonymous recursion
 				//(it seems like it doesn't, but it does, somehow; honestly I moved this code and am amazed it still works)
-				if(sub->ref==1){
+				if(NL_REF_GET(sub->ref)==1){
 /*
 #ifdef _DEBUG
 					printf("nl_eval debug 0.5, got a sub with one reference, expression was ");
@@ -2003,7 +2389,7 @@ tailcall:
 					printf("\n");
 #endif
 */
-					sub->ref++;
+					NL_VAL_REF_INC(sub);
 					
 					//call out to apply; this will run through the body (in the case of a closure)
 					ret=nl_apply(sub,exp->d.pair.r,early_ret);
@@ -2021,28 +2407,35 @@ tailcall:
 */
 				//if this is the last expression then it doesn't need any environment trickery and we can just execute the body directly
 				}else if((last_exp) && (sub->t==SUB)){
-					if(!nl_bind_dflt(sub->d.sub.dflt_args,env)){
-						ERR_EXIT(sub->d.sub.dflt_args,"could not bind default (named) arguments to application environment (call stack)",TRUE);
+					if(!nl_bind_dflt(sub->d.sub->dflt_args,env)){
+						ERR_EXIT(sub->d.sub->dflt_args,"could not bind default (named) arguments to application environment (call stack)",TRUE);
 					}
-					if(!nl_bind_list(sub->d.sub.args,exp->d.pair.r,env,TRUE,sub->d.sub.dflt_args,FALSE)){
+					if(!nl_bind_list(sub->d.sub->args,exp->d.pair.r,env,TRUE,sub->d.sub->dflt_args,FALSE)){
 						ERR_EXIT(exp->d.pair.r,"could not bind arguments to application environment (call stack) from apply",TRUE);
 					}
 					
 					//also bind those same arguments to the closure environment
 					//(the body of the closure will always look them up in the apply env, but this keeps any references such as from returned closures safe)
-					if(!nl_bind_list(sub->d.sub.args,exp->d.pair.r,sub->d.sub.env,TRUE,sub->d.sub.dflt_args,FALSE)){
+					//(in a parallel map chunk other threads could be using the closure, so this is skipped; see nl_apply)
+					if((!nl_vm_cur->par_task) && (!nl_bind_list(sub->d.sub->args,exp->d.pair.r,sub->d.sub->env,TRUE,sub->d.sub->dflt_args,FALSE))){
 						//could not bind to closure scope
 					}
-
+					
+					if(nl_vm_cur->prof_stack!=NULL){
+						nl_prof_tail(nl_vm_cur,nl_prof_frame(sub));
+					}
+					if(nl_prof_counting){
+						nl_prof_count_tail(nl_vm_cur,nl_prof_sub_key(sub));
+					}
 					
 					nl_val_free(exp);
 					nl_val_free(sub);
 					
 					exp=nl_val_malloc(PAIR);
-					exp->d.pair.f=nl_val_cp(begin_keyword);
-//					exp->d.pair.r=nl_val_cp(sub->d.sub.body);
-					exp->d.pair.r=sub->d.sub.body;
-					exp->d.pair.r->ref++;
+					exp->d.pair.f=nl_val_cp(nl_vm_cur->begin_keyword);
+//					exp->d.pair.r=nl_val_cp(sub->d.sub->body);
+					exp->d.pair.r=sub->d.sub->body;
+					NL_VAL_REF_INC(exp->d.pair.r);
 					
 /*
 #ifdef _DEBUG
@@ -2079,7 +2472,7 @@ tailcall:
 */
 			//null lists are self-evaluating (the empty list)
 			}else{
-				exp->ref++;
+				NL_VAL_REF_INC(exp);
 				ret=exp;
 			}
 			break;
@@ -2097,7 +2490,7 @@ tailcall:
 			break;
 		//default self-evaluating
 		default:
-			exp->ref++;
+			NL_VAL_REF_INC(exp);
 			ret=exp;
 			break;
 	}
@@ -2125,66 +2518,173 @@ char nl_is_whitespace(char c){
 	return (c==' ') || (c=='\t') || (c=='\r') || (c=='\n');
 }
 
+//allocate a source reader for the given file
+nl_reader *nl_reader_malloc(int fd){
+	nl_reader *r=(nl_reader*)(malloc(sizeof(nl_reader)));
+	if(r==NULL){
+		ERR_EXIT(nl_null,"could not malloc a reader (out of memory?)",FALSE);
+		exit(1);
+	}
+	r->fd=fd;
+	r->cap=NL_READ_CHUNK;
+	r->buf=(char*)(malloc(r->cap));
+	r->pos=0;
+	r->len=0;
+	r->eof=FALSE;
+	return r;
+}
+
+//allocate a source reader for bytes already in memory (these are copied, so nothing needs to outlive the reader)
+nl_reader *nl_reader_from_buf(const char *data, unsigned int length){
+	nl_reader *r=nl_reader_malloc(-1);
+	if(length>(r->cap)){
+		r->cap=length;
+		r->buf=(char*)(realloc(r->buf,r->cap));
+	}
+	memcpy(r->buf,data,length);
+	r->len=length;
+	
+	//everything there is to read is already here
+	r->eof=TRUE;
+	return r;
+}
+
+//free a source reader (this does not close the file)
+void nl_reader_free(nl_reader *r){
+	if(r==NULL){
+		return;
+	}
+	free(r->buf);
+	free(r);
+}
+
+//returns the (shared) reader for stdin, allocating it if needed
+nl_reader *nl_reader_stdin(){
+	nl_par_impure();
+	if(nl_vm_cur->stdin_reader==NULL){
+		nl_vm_cur->stdin_reader=nl_reader_malloc(STDIN_FILENO);
+	}
+	return nl_vm_cur->stdin_reader;
+}
+
+//read more data into the reader's buffer, keeping any unread data
+//returns the number of new bytes read (0 at end of file)
+unsigned int nl_reader_fill(nl_reader *r){
+	nl_par_impure();
+	if(r->eof){
+		return 0;
+	}
+	
+	//other coroutines get to run until there's something to read
+	nl_co_wait_fd(r->fd);
+	if(r->eof){
+		return 0;
+	}
+	
+	//move any unread data to the front of the buffer
+	if(r->pos>0){
+		memmove(r->buf,(r->buf)+(r->pos),(r->len)-(r->pos));
+		r->len-=r->pos;
+		r->pos=0;
+	}
+	
+	//if an expression is bigger than the buffer, grow it
+	if(((r->cap)-(r->len))<NL_READ_CHUNK){
+		r->cap=(r->len)+NL_READ_CHUNK;
+		r->buf=(char*)(realloc(r->buf,r->cap));
+	}
+	
+	//anything waiting to go to the terminal (a prompt, for instance) needs to be out before we block on input
+	if(r->fd==STDIN_FILENO){
+		fflush(stdout);
+	}
+	
+	//NOTE: read() returns whatever is available, so on a terminal or pipe this gives us a line at a time and doesn't block waiting for a full chunk
+	ssize_t n;
+	do{
+		n=read(r->fd,(r->buf)+(r->len),(r->cap)-(r->len));
+	}while((n<0) && (errno==EINTR));
+	
+	if(n<=0){
+		r->eof=TRUE;
+		return 0;
+	}
+	r->len+=n;
+	return n;
+}
+
+//look at the byte the given offset past the read position without consuming anything
+//returns EOF if the file ends first
+int nl_reader_peek(nl_reader *r, unsigned int offset){
+	while(((r->pos)+offset)>=(r->len)){
+		if(nl_reader_fill(r)==0){
+			return EOF;
+		}
+	}
+	return (unsigned char)(r->buf[(r->pos)+offset]);
+}
+
+//consume and return the next byte, or EOF
+int nl_reader_getc(nl_reader *r){
+	int c=nl_reader_peek(r,0);
+	if(c!=EOF){
+		r->pos++;
+	}
+	return c;
+}
+
 //TODO: add another argument to read_exp for interactive mode, and in interactive mode use getch to handle arrow keys, etc.
 //TODO: (cont) this interactive mode should also be user-accessable via an argument to inexp
-//read an expression from the given input stream
-nl_val *nl_read_exp(FILE *fp){
-	//read in a string until non-whitespace followed by whitespace is found
+//read an expression from the given reader
+//this finds the extent of the next expression in the reader's buffer and then parses it in place (nothing is copied)
+nl_val *nl_read_exp(nl_reader *r){
+	//read until non-whitespace followed by whitespace is found
 	//also if we're in a list, keep reading until the end of it (and care about comments insomuch as nest level doesn't change within comments)
-	nl_val *input_string=nl_val_malloc(ARRAY);
 	int nest_level=0;
 	char found_exp=FALSE;
 	char in_multiline_comment=FALSE;
 	char in_singleline_comment=FALSE;
 	char in_string=FALSE;
 	
-	//read an input string from a file handle
+	//how many bytes (past the reader position) we've consumed
+	unsigned int consumed=0;
+	//how many bytes make up the expression text; this can be one more than consumed (see the newline handling below)
+	unsigned int extent=0;
+	
+	//scan the buffer (reading more as needed)
 	//stopping once a complete expression is found or end of file is hit
-	while(!feof(fp)){
-		char c=getc(fp);
-		char next_c='\0';
-		
-		if((c!='\r') && (c!='\n')){
-			next_c=getc(fp);
-			ungetc(next_c,fp);
-		}
-/*
-#ifdef _DEBUG
-		printf("read a '%c'; next_c='%c'\n",c,next_c);
-#endif
-*/
+	while(TRUE){
+		int next_byte=nl_reader_peek(r,consumed);
 		
 		//if we hit end of file just give up man
-		if(feof(fp)){
+		if(next_byte==EOF){
 /*
 #ifdef _DEBUG
 			printf("nl_read_exp debug -2, hit EOF\n");
 #endif
 */
-			end_program=TRUE;
+			nl_vm_cur->end_program=TRUE;
 			break;
 		}
 		
-		nl_val *string_char=nl_val_malloc(BYTE);
-		string_char->d.byte.v=c;
-		nl_array_push(input_string,string_char);
-#ifdef _DEBUG
-/*
-		printf("nl_read_exp debug -1, input_string=");
-		nl_out(stdout,input_string);
-		printf("\n");
-*/
-#endif
+		char c=(char)(next_byte);
+		consumed++;
 		
-		//newlines end single-line comments (since these are whitespace this check must go prior to the nl_is_whitespace() check)
-		if(((c=='\r') || (c=='\n')) && (!in_string) && (!in_multiline_comment)){
+		char next_c='\0';
+		if((c!='\r') && (c!='\n')){
+			next_byte=nl_reader_peek(r,consumed);
+			if(next_byte!=EOF){
+				next_c=(char)(next_byte);
+			}
+		}
 /*
 #ifdef _DEBUG
-			printf("nl_read_exp debug 1, ending single-line comment, input_string=");
-			nl_out(stdout,input_string);
-			printf("\n");
+		printf("read a '%c'; next_c='%c'\n",c,next_c);
 #endif
 */
+		
+		//newlines end single-line comments (since these are whitespace this check must go prior to the nl_is_whitespace() check)
+		if(((c=='\r') || (c=='\n')) && (!in_string) && (!in_multiline_comment)){
 			in_singleline_comment=FALSE;
 			if(nest_level<=0){
 /*
@@ -2200,26 +2700,14 @@ nl_val *nl_read_exp(FILE *fp){
 				break;
 			}
 		//comments are // for single-line or /*...*/ for multi-line
-		//note the extra getc so that /*/ is considered an unterminated multi-line comment
+		//note the extra consumed byte so that /*/ is considered an unterminated multi-line comment
 		}else if((c=='/') && !(in_string)){
 			if(next_c=='*'){
-				//make sure next_c makes it into the end string, since we're skipping it here
-				string_char=nl_val_malloc(BYTE);
-				string_char->d.byte.v=next_c;
-				nl_array_push(input_string,string_char);
-				
-				//and don't skip a beat, but do skip the *
-				c=getc(fp);
+				//don't skip a beat, but do skip the *
+				consumed++;
 				in_multiline_comment=TRUE;
 			}else if(next_c=='/'){
 				in_singleline_comment=TRUE;
-/*
-#ifdef _DEBUG
-				printf("nl_read_exp debug 0, starting single-line comment, input_string=");
-				nl_out(stdout,input_string);
-				printf("\n");
-#endif
-*/
 			}
 		//look for end of /*...*/ multi-line comment
 		}else if((c=='*') && (next_c=='/') && !(in_string)){
@@ -2230,165 +2718,318 @@ nl_val *nl_read_exp(FILE *fp){
 		//lists end with ), providing we're not within a comment or string
 		}else if((c==')') && !(in_singleline_comment) && !(in_multiline_comment) && !(in_string)){
 			nest_level--;
-/*
-			if(nest_level<=0){
-				break;
-			}
-*/
 		//strings are double-quote delimited; there is NO ESCAPE
 		}else if((c=='"') && (!in_singleline_comment) && (!in_multiline_comment)){
 			in_string=(!in_string);
 			//strings count as expressions, even empty ones
 			if(!in_string){
 				found_exp=TRUE;
-/*
-				if(nest_level<=0){
-					break;
-				}
-*/
 			}
 		//normal character, just treat it as-is and remember we found something
-		//this was already added to the input string at the top of this loop so no need to here
-//		}else if((!in_multiline_comment) && (!in_singleline_comment)){
 		}else{
 			found_exp=TRUE;
 		}
 		
 		//if the user hit enter and we've read in a parseable expression at this point then go ahead and return up
 		if(((next_c=='\r') || (next_c=='\n')) && (found_exp) && (nest_level<=0) && (!in_string) && (!in_multiline_comment) && (!in_singleline_comment)){
-			//make sure next_c makes it into the end string, since we're skipping it here
-			string_char=nl_val_malloc(BYTE);
-			string_char->d.byte.v=next_c;
-			nl_array_push(input_string,string_char);
+			//make sure next_c makes it into the expression text even though it's left unconsumed
+			extent=consumed+1;
 			
 			//decrement the line number so this newline isn't counted twice
 			if(next_c=='\n'){
-				line_number--;
+				nl_vm_cur->line_number--;
 			}
 			break;
 		}
 	}
+	if(extent<consumed){
+		extent=consumed;
+	}
+	
+	//parse straight out of the reader's buffer
 	unsigned int pos=0;
-	nl_val *exp=nl_str_read_exp(input_string,&pos);
+	nl_val *exp=nl_buf_read_exp((r->buf)+(r->pos),extent,&pos);
 	
 #ifdef _DEBUG
 /*
-	printf("nl_read_exp debug 2, stopped reading (lines %u-%u) at input_string=",old_line_number,line_number);
-	nl_out(stdout,input_string);
-	printf("\n");
+	printf("nl_read_exp debug 2, stopped reading at input=%.*s\n",extent,(r->buf)+(r->pos));
 */
 /*
-	if(pos<input_string->d.array.size){
-		printf("nl_read_exp debug 3, didn't use whole string (pos=%u, string length=%u)\n",pos,input_string->d.array.size);
+	if(pos<extent){
+		printf("nl_read_exp debug 3, didn't use whole string (pos=%u, string length=%u)\n",pos,extent);
 	}
 */
 #endif
 	
-	nl_val_free(input_string);
+	r->pos+=consumed;
 	return exp;
 }
 
+//write raw string bytes to the given file, in as few writes as possible
+//(bytes with values less than 2 are written as numbers, the same way nl_out writes them)
+void nl_out_bytes(FILE *fp, const char *data, unsigned int length){
+	nl_par_impure();
+	
+	unsigned int start=0;
+	unsigned int n;
+	for(n=0;n<length;n++){
+		if(data[n]<2){
+			//everything before this byte is written as-is
+			if(n>start){
+				fwrite(data+start,1,n-start,fp);
+			}
+			fprintf(fp,"%i",data[n]);
+			start=n+1;
+		}
+	}
+	if(length>start){
+		fwrite(data+start,1,length-start,fp);
+	}
+}
+
 //this now outputs a [neulang] string; NOT a c string, so we don't need a length (from a user perspective there's no change, just done in a different function)
 //output a neulang value
 void nl_out(FILE *fp, const nl_val *exp){
+	nl_par_impure();
+	
+	//stdout may be fully buffered, so flush it before anything goes to stderr to keep the two in order
+	if(fp==stderr){
+		fflush(stdout);
+	}
+	
 	nl_val *nl_str=nl_val_to_memstr(exp);
-	int n;
-	for(n=0;n<(nl_str->d.array.size);n++){
-		fprintf(fp,"%c",nl_str->d.array.v[n]->d.byte.v);
+	
+	//the string representation is already rendered, so it goes out in one write
+	if(nl_str->flags & NL_VAL_PACKED){
+		fwrite(nl_array_bytes(nl_str),1,nl_str->d.array.size,fp);
+	}else{
+		unsigned int n;
+		for(n=0;n<(nl_str->d.array.size);n++){
+			fputc(nl_array_entry(nl_str,n)->d.byte.v,fp);
+		}
 	}
 	nl_val_free(nl_str);
 }
 
 //END I/O SUBROUTINES ---------------------------------------------------------------------------------------------
 
-//create global symbol data so it's not constantly being re-allocated (which is slow and unnecessary)
-void nl_keyword_malloc(){
-	true_keyword=nl_sym_from_c_str("TRUE");
-	false_keyword=nl_sym_from_c_str("FALSE");
-	null_keyword=nl_sym_from_c_str("NULL");
-//	line_num_keyword=nl_sym_from_c_str("LINE_NUM");
-	
-	pair_keyword=nl_sym_from_c_str("pair");
-	f_keyword=nl_sym_from_c_str("f");
-	r_keyword=nl_sym_from_c_str("r");
-	if_keyword=nl_sym_from_c_str("if");
-	else_keyword=nl_sym_from_c_str("else");
-	and_keyword=nl_sym_from_c_str("and");
-	or_keyword=nl_sym_from_c_str("or");
-	not_keyword=nl_sym_from_c_str("not");
-	xor_keyword=nl_sym_from_c_str("xor");
-	exit_keyword=nl_sym_from_c_str("exit");
-	lit_keyword=nl_sym_from_c_str("lit");
-	let_keyword=nl_sym_from_c_str("let");
-	sub_keyword=nl_sym_from_c_str("sub");
-	begin_keyword=nl_sym_from_c_str("begin");
-	recur_keyword=nl_sym_from_c_str("recur");
-	return_keyword=nl_sym_from_c_str("return");
-	with_keyword=nl_sym_from_c_str("with");
-	while_keyword=nl_sym_from_c_str("while");
-	for_keyword=nl_sym_from_c_str("for");
-	after_keyword=nl_sym_from_c_str("after");
-	array_keyword=nl_sym_from_c_str("array");
-	list_keyword=nl_sym_from_c_str("list");
-	struct_keyword=nl_sym_from_c_str("struct");
-	type_keyword=nl_sym_from_c_str("type");
-	
-	byte_t_keyword=nl_sym_from_c_str("BYTE_T");
-	num_t_keyword=nl_sym_from_c_str("NUM_T");
-	pair_t_keyword=nl_sym_from_c_str("PAIR_T");
-	array_t_keyword=nl_sym_from_c_str("ARRAY_T");
-	pri_t_keyword=nl_sym_from_c_str("PRI_T");
-	sub_t_keyword=nl_sym_from_c_str("SUB_T");
-	struct_t_keyword=nl_sym_from_c_str("STRUCT_T");
-	symbol_t_keyword=nl_sym_from_c_str("SYMBOL_T");
-	evaluation_t_keyword=nl_sym_from_c_str("EVALUATION_T");
-	bind_t_keyword=nl_sym_from_c_str("BIND_T");
-	null_t_keyword=nl_sym_from_c_str("NULL_T");
+//create an interpreter's symbol data so it's not constantly being re-allocated (which is slow and unnecessary)
+void nl_keyword_malloc(nl_vm *vm){
+	vm->true_keyword=nl_sym_from_c_str("TRUE");
+	vm->false_keyword=nl_sym_from_c_str("FALSE");
+	vm->null_keyword=nl_sym_from_c_str("NULL");
+//	vm->line_num_keyword=nl_sym_from_c_str("LINE_NUM");
+	
+	vm->pair_keyword=nl_sym_from_c_str("pair");
+	vm->f_keyword=nl_sym_from_c_str("f");
+	vm->r_keyword=nl_sym_from_c_str("r");
+	vm->if_keyword=nl_sym_from_c_str("if");
+	vm->else_keyword=nl_sym_from_c_str("else");
+	vm->and_keyword=nl_sym_from_c_str("and");
+	vm->or_keyword=nl_sym_from_c_str("or");
+	vm->not_keyword=nl_sym_from_c_str("not");
+	vm->xor_keyword=nl_sym_from_c_str("xor");
+	vm->exit_keyword=nl_sym_from_c_str("exit");
+	vm->lit_keyword=nl_sym_from_c_str("lit");
+	vm->let_keyword=nl_sym_from_c_str("let");
+	vm->sub_keyword=nl_sym_from_c_str("sub");
+	vm->begin_keyword=nl_sym_from_c_str("begin");
+	vm->recur_keyword=nl_sym_from_c_str("recur");
+	vm->return_keyword=nl_sym_from_c_str("return");
+	vm->with_keyword=nl_sym_from_c_str("with");
+	vm->while_keyword=nl_sym_from_c_str("while");
+	vm->for_keyword=nl_sym_from_c_str("for");
+	vm->after_keyword=nl_sym_from_c_str("after");
+	vm->array_keyword=nl_sym_from_c_str("array");
+	vm->list_keyword=nl_sym_from_c_str("list");
+	vm->struct_keyword=nl_sym_from_c_str("struct");
+	vm->type_keyword=nl_sym_from_c_str("type");
+	vm->source_keyword=nl_sym_from_c_str("source");
+	vm->par_keyword=nl_sym_from_c_str("par");
+	vm->future_keyword=nl_sym_from_c_str("future");
+	vm->spawn_keyword=nl_sym_from_c_str("spawn");
+	vm->time_keyword=nl_sym_from_c_str("time");
+	vm->image_save_keyword=nl_sym_from_c_str("image-save");
+	
+	vm->byte_t_keyword=nl_sym_from_c_str("BYTE_T");
+	vm->num_t_keyword=nl_sym_from_c_str("NUM_T");
+	vm->pair_t_keyword=nl_sym_from_c_str("PAIR_T");
+	vm->array_t_keyword=nl_sym_from_c_str("ARRAY_T");
+	vm->pri_t_keyword=nl_sym_from_c_str("PRI_T");
+	vm->sub_t_keyword=nl_sym_from_c_str("SUB_T");
+	vm->struct_t_keyword=nl_sym_from_c_str("STRUCT_T");
+	vm->handle_t_keyword=nl_sym_from_c_str("HANDLE_T");
+	vm->symbol_t_keyword=nl_sym_from_c_str("SYMBOL_T");
+	vm->evaluation_t_keyword=nl_sym_from_c_str("EVALUATION_T");
+	vm->bind_t_keyword=nl_sym_from_c_str("BIND_T");
+	vm->null_t_keyword=nl_sym_from_c_str("NULL_T");
+	vm->future_t_keyword=nl_sym_from_c_str("FUTURE_T");
+	vm->channel_t_keyword=nl_sym_from_c_str("CHANNEL_T");
+}
+
+//free an interpreter's symbol data for clean exit
+void nl_keyword_free(nl_vm *vm){
+	nl_val_free(vm->true_keyword);
+	nl_val_free(vm->false_keyword);
+	nl_val_free(vm->null_keyword);
+//	nl_val_free(vm->line_num_keyword);
+	
+	nl_val_free(vm->pair_keyword);
+	nl_val_free(vm->f_keyword);
+	nl_val_free(vm->r_keyword);
+	nl_val_free(vm->if_keyword);
+	nl_val_free(vm->else_keyword);
+	nl_val_free(vm->and_keyword);
+	nl_val_free(vm->or_keyword);
+	nl_val_free(vm->not_keyword);
+	nl_val_free(vm->xor_keyword);
+	nl_val_free(vm->exit_keyword);
+	nl_val_free(vm->lit_keyword);
+	nl_val_free(vm->let_keyword);
+	nl_val_free(vm->sub_keyword);
+	nl_val_free(vm->begin_keyword);
+	nl_val_free(vm->recur_keyword);
+	nl_val_free(vm->return_keyword);
+	nl_val_free(vm->with_keyword);
+	nl_val_free(vm->while_keyword);
+	nl_val_free(vm->for_keyword);
+	nl_val_free(vm->after_keyword);
+	nl_val_free(vm->array_keyword);
+	nl_val_free(vm->list_keyword);
+	nl_val_free(vm->struct_keyword);
+	nl_val_free(vm->type_keyword);
+	nl_val_free(vm->source_keyword);
+	nl_val_free(vm->par_keyword);
+	nl_val_free(vm->future_keyword);
+	nl_val_free(vm->spawn_keyword);
+	nl_val_free(vm->time_keyword);
+	nl_val_free(vm->image_save_keyword);
+
+	nl_val_free(vm->byte_t_keyword);
+	nl_val_free(vm->num_t_keyword);
+	nl_val_free(vm->pair_t_keyword);
+	nl_val_free(vm->array_t_keyword);
+	nl_val_free(vm->pri_t_keyword);
+	nl_val_free(vm->sub_t_keyword);
+	nl_val_free(vm->struct_t_keyword);
+	nl_val_free(vm->handle_t_keyword);
+	nl_val_free(vm->symbol_t_keyword);
+	nl_val_free(vm->evaluation_t_keyword);
+	nl_val_free(vm->bind_t_keyword);
+	nl_val_free(vm->null_t_keyword);
+	nl_val_free(vm->future_t_keyword);
+	nl_val_free(vm->channel_t_keyword);
 }
 
-//free global symbol data for clean exit
-void nl_keyword_free(){
-	nl_val_free(true_keyword);
-	nl_val_free(false_keyword);
-	nl_val_free(null_keyword);
-//	nl_val_free(line_num_keyword);
-	
-	nl_val_free(pair_keyword);
-	nl_val_free(f_keyword);
-	nl_val_free(r_keyword);
-	nl_val_free(if_keyword);
-	nl_val_free(else_keyword);
-	nl_val_free(and_keyword);
-	nl_val_free(or_keyword);
-	nl_val_free(not_keyword);
-	nl_val_free(xor_keyword);
-	nl_val_free(exit_keyword);
-	nl_val_free(lit_keyword);
-	nl_val_free(let_keyword);
-	nl_val_free(sub_keyword);
-	nl_val_free(begin_keyword);
-	nl_val_free(recur_keyword);
-	nl_val_free(return_keyword);
-	nl_val_free(with_keyword);
-	nl_val_free(while_keyword);
-	nl_val_free(for_keyword);
-	nl_val_free(after_keyword);
-	nl_val_free(array_keyword);
-	nl_val_free(list_keyword);
-	nl_val_free(struct_keyword);
-	nl_val_free(type_keyword);
-
-	nl_val_free(byte_t_keyword);
-	nl_val_free(num_t_keyword);
-	nl_val_free(pair_t_keyword);
-	nl_val_free(array_t_keyword);
-	nl_val_free(pri_t_keyword);
-	nl_val_free(sub_t_keyword);
-	nl_val_free(struct_t_keyword);
-	nl_val_free(symbol_t_keyword);
-	nl_val_free(evaluation_t_keyword);
-	nl_val_free(bind_t_keyword);
-	nl_val_free(null_t_keyword);
+//allocate the state for one interpreter
+//an interpreter only runs on one thread at a time (see nl_vm_enter), but any number of them can run at once on different threads
+nl_vm *nl_vm_malloc(){
+	nl_vm *vm=(nl_vm*)(malloc(sizeof(nl_vm)));
+	if(vm!=NULL){
+		vm->line_table=(unsigned int*)(malloc(NL_LINE_SLOTS_INIT*sizeof(unsigned int)));
+		vm->line_index=(unsigned short*)(calloc(NL_LINE_SLOTS_INIT*2,sizeof(unsigned short)));
+	}
+	if((vm==NULL) || (vm->line_table==NULL) || (vm->line_index==NULL)){
+		fprintf(stderr,"Err: could not malloc an interpreter (out of memory?)\n");
+		exit(1);
+	}
+	
+	vm->end_program=FALSE;
+	vm->exit_status=0;
+	vm->line_number=1;
+	vm->err_cnt=0;
+	vm->stdin_reader=NULL;
+	
+	//slot 0 is reserved to mean "no line"
+	vm->line_table[0]=0;
+	vm->line_table_cnt=1;
+	vm->line_table_size=NL_LINE_SLOTS_INIT;
+	vm->line_table_full=FALSE;
+	
+	vm->pinned=NULL;
+	vm->pinned_cnt=0;
+	vm->pinned_size=0;
+	
+	vm->par_task=FALSE;
+	vm->par_abort=NULL;
+	vm->par_deque=NULL;
+	vm->par_victim=0;
+	vm->futures=NULL;
+	
+	vm->co_main=NULL;
+	vm->co_cur=NULL;
+	vm->co_ready=NULL;
+	vm->co_ready_last=NULL;
+	vm->co_sleeping=NULL;
+	vm->co_io=NULL;
+	vm->co_all=NULL;
+	vm->co_cnt=0;
+	vm->co_joining=FALSE;
+	vm->co_dead=NULL;
+	
+	//(see nl_prof_vm_init)
+	vm->prof_stack=NULL;
+	vm->prof_depth=0;
+	vm->prof_ring=NULL;
+	vm->prof_root=0;
+	
+	//(see nl_prof_count_vm_init)
+	vm->prof_tally=NULL;
+	vm->prof_calls=NULL;
+	vm->prof_call_depth=0;
+	vm->prof_call_size=0;
+	vm->trace_buf=NULL;
+	
+	nl_stats_vm_init(vm);
+	
+	nl_packed_byte_vals_init();
+	
+	nl_keyword_malloc(vm);
+	return vm;
+}
+
+//free the state for an interpreter (this must not be the current interpreter of any thread that will keep running it)
+void nl_vm_free(nl_vm *vm){
+	if(vm==NULL){
+		return;
+	}
+	nl_keyword_free(vm);
+	nl_reader_free(vm->stdin_reader);
+	nl_par_deque_release(vm);
+	nl_prof_vm_free(vm);
+	nl_prof_count_vm_free(vm);
+	
+	//(coroutines are all finished or abandoned by the end of the program; see nl_co_join)
+	if(vm->co_main!=NULL){
+		free(vm->co_main->prof_stack);
+		free(vm->co_main->prof_calls);
+	}
+	free(vm->co_main);
+	
+	//pinned values only ever hold static data (primitive functions), so there's nothing to free but the values themselves
+	unsigned int n;
+	for(n=0;n<vm->pinned_cnt;n++){
+		NL_COUNT_ADD(vm->stats.frees,1);
+		NL_STATS_MEM(vm,live[vm->pinned[n]->t],-1,sizeof(nl_val));
+#ifdef _LEAKCHECK
+		nl_leak_unlink(vm->pinned[n]);
+#endif
+		free(vm->pinned[n]);
+	}
+	free(vm->pinned);
+	nl_stats_vm_free(vm);
+	
+	free(vm->line_table);
+	free(vm->line_index);
+	free(vm);
+}
+
+//make the given interpreter the one the current thread is running
+//returns the interpreter this thread was running before, so it can be restored (NULL if there wasn't one)
+nl_vm *nl_vm_enter(nl_vm *vm){
+	nl_vm *prev=nl_vm_cur;
+	nl_vm_cur=vm;
+	return prev;
 }
 
 //bind a newly alloc'd value (just removes an reference after bind to keep us memory-safe)
@@ -2434,12 +3075,15 @@ void nl_bind_stdlib(nl_env_frame *env){
 	nl_bind_new(nl_sym_from_c_str("ar-extend"),nl_primitive_wrap(nl_array_extend),env);
 	nl_bind_new(nl_sym_from_c_str("ar-omit"),nl_primitive_wrap(nl_array_omit),env);
 	
-//	nl_bind_new(nl_sym_from_c_str("ar-find"),nl_primitive_wrap(nl_array_find),env);
+	nl_bind_new(nl_sym_from_c_str("ar-find"),nl_primitive_wrap(nl_array_find),env);
 	nl_bind_new(nl_sym_from_c_str("ar-ins"),nl_primitive_wrap(nl_array_insert),env);
 	nl_bind_new(nl_sym_from_c_str("ar-chop"),nl_primitive_wrap(nl_array_chop),env);
 	nl_bind_new(nl_sym_from_c_str("ar-subar"),nl_primitive_wrap(nl_array_subarray),env);
 	nl_bind_new(nl_sym_from_c_str("ar-range"),nl_primitive_wrap(nl_array_range),env);
 	nl_bind_new(nl_sym_from_c_str("ar-map"),nl_primitive_wrap(nl_array_map),env);
+	nl_bind_new(nl_sym_from_c_str("ar-pmap"),nl_primitive_wrap(nl_array_pmap),env);
+	nl_bind_new(nl_sym_from_c_str("ar-fold"),nl_primitive_wrap(nl_array_fold),env);
+	nl_bind_new(nl_sym_from_c_str("ar-reduce"),nl_primitive_wrap(nl_array_reduce),env);
 	//TODO: make and bind additional array subroutines
 	
 	//same as for arrays; size and length mean the same thing, sz is the official/recommended one
@@ -2454,13 +3098,16 @@ void nl_bind_stdlib(nl_env_frame *env){
 	
 	nl_bind_new(nl_sym_from_c_str("outs"),nl_primitive_wrap(nl_outstr),env);
 	nl_bind_new(nl_sym_from_c_str("outexp"),nl_primitive_wrap(nl_outexp),env);
+	nl_bind_new(nl_sym_from_c_str("flush"),nl_primitive_wrap(nl_flush),env);
 	
 	nl_bind_new(nl_sym_from_c_str("inexp"),nl_primitive_wrap(nl_inexp),env);
 	nl_bind_new(nl_sym_from_c_str("inline"),nl_primitive_wrap(nl_inline),env);
 	nl_bind_new(nl_sym_from_c_str("inchar"),nl_primitive_wrap(nl_inchar),env);
 	
-	//read in a file as a byte array (aka a string)
+	//read in a file as a byte array (aka a string), and write one out
 	nl_bind_new(nl_sym_from_c_str("file->ar"),nl_primitive_wrap(nl_str_from_file),env);
+	nl_bind_new(nl_sym_from_c_str("ar->file"),nl_primitive_wrap(nl_str_to_file),env);
+	nl_bind_new(nl_sym_from_c_str("ar->file-append"),nl_primitive_wrap(nl_str_append_file),env);
 	
 	
 	nl_bind_new(nl_sym_from_c_str("num->byte"),nl_primitive_wrap(nl_num_to_byte),env);
@@ -2469,6 +3116,8 @@ void nl_bind_stdlib(nl_env_frame *env){
 	nl_bind_new(nl_sym_from_c_str("list->ar"),nl_primitive_wrap(nl_list_to_array),env);
 	nl_bind_new(nl_sym_from_c_str("struct->list"),nl_primitive_wrap(nl_struct_to_list),env);
 	nl_bind_new(nl_sym_from_c_str("val->memstr"),nl_primitive_wrap(nl_val_list_to_memstr),env);
+	nl_bind_new(nl_sym_from_c_str("val->bin"),nl_primitive_wrap(nl_val_to_bin),env);
+	nl_bind_new(nl_sym_from_c_str("bin->val"),nl_primitive_wrap(nl_bin_to_val),env);
 	nl_bind_new(nl_sym_from_c_str("str->sym"),nl_primitive_wrap(nl_str_to_sym),env);
 	nl_bind_new(nl_sym_from_c_str("sym->str"),nl_primitive_wrap(nl_sym_to_str),env);
 	nl_bind_new(nl_sym_from_c_str("str->num"),nl_primitive_wrap(nl_str_to_num),env);
@@ -2485,6 +3134,38 @@ void nl_bind_stdlib(nl_env_frame *env){
 	//timing functions
 	nl_bind_new(nl_sym_from_c_str("sleep"),nl_primitive_wrap(nl_sleep),env);
 	
+	//wait for a future's result (see the future keyword)
+	nl_bind_new(nl_sym_from_c_str("touch"),nl_primitive_wrap(nl_touch),env);
+	
+	//make read-only data that threads can share without copying or counting references
+	nl_bind_new(nl_sym_from_c_str("freeze"),nl_primitive_wrap(nl_freeze),env);
+	nl_bind_new(nl_sym_from_c_str("chan"),nl_primitive_wrap(nl_chan_new),env);
+	nl_bind_new(nl_sym_from_c_str("send"),nl_primitive_wrap(nl_chan_send),env);
+	nl_bind_new(nl_sym_from_c_str("recv"),nl_primitive_wrap(nl_chan_recv),env);
+	nl_bind_new(nl_sym_from_c_str("chan-close"),nl_primitive_wrap(nl_chan_close),env);
+	nl_bind_new(nl_sym_from_c_str("yield"),nl_primitive_wrap(nl_co_yield),env);
+	nl_bind_new(nl_sym_from_c_str("isolate"),nl_primitive_wrap(nl_isolate_start),env);
+	nl_bind_new(nl_sym_from_c_str("isolate-post"),nl_primitive_wrap(nl_isolate_post),env);
+	nl_bind_new(nl_sym_from_c_str("isolate-recv"),nl_primitive_wrap(nl_isolate_recv),env);
+	nl_bind_new(nl_sym_from_c_str("isolate-self"),nl_primitive_wrap(nl_isolate_self_num),env);
+	nl_bind_new(nl_sym_from_c_str("isolate-parent"),nl_primitive_wrap(nl_isolate_parent),env);
+	nl_bind_new(nl_sym_from_c_str("isolate-wait"),nl_primitive_wrap(nl_isolate_wait),env);
+	
+	//profiler and memory statistics
+	nl_bind_new(nl_sym_from_c_str("prof-report"),nl_primitive_wrap(nl_prof_report),env);
+	nl_bind_new(nl_sym_from_c_str("mem-stats"),nl_primitive_wrap(nl_mem_stats),env);
+	nl_bind_new(nl_sym_from_c_str("leak-check"),nl_primitive_wrap(nl_leak_check),env);
+	
+	//file handle operations
+	nl_bind_new(nl_sym_from_c_str("file-open"),nl_primitive_wrap(nl_file_open),env);
+	nl_bind_new(nl_sym_from_c_str("file-read-line"),nl_primitive_wrap(nl_file_read_line),env);
+	nl_bind_new(nl_sym_from_c_str("file-read-chunk"),nl_primitive_wrap(nl_file_read_chunk),env);
+	nl_bind_new(nl_sym_from_c_str("file-eof"),nl_primitive_wrap(nl_file_eof),env);
+	nl_bind_new(nl_sym_from_c_str("file-write"),nl_primitive_wrap(nl_file_write),env);
+	nl_bind_new(nl_sym_from_c_str("file-close"),nl_primitive_wrap(nl_file_close),env);
+	nl_bind_new(nl_sym_from_c_str("file-tmp"),nl_primitive_wrap(nl_file_tmp),env);
+	nl_bind_new(nl_sym_from_c_str("file-delete"),nl_primitive_wrap(nl_file_delete),env);
+	
 	//pre-defined variables for convenience
 	nl_val *newline=nl_val_malloc(ARRAY);
 	nl_val *newline_char=nl_val_malloc(BYTE);
@@ -2515,30 +3196,56 @@ void nl_bind_stdlib(nl_env_frame *env){
 	nl_bind_new(nl_sym_from_c_str("squo"),squote,env);
 	//end of line (\n on *nix)
 	nl_bind_new(nl_sym_from_c_str("eol"),end_of_line,env);
+	
+	//standard input, as a handle (this shares its buffer with inline, inexp, and the repl)
+	nl_val *stdin_handle=nl_handle_from_fd(STDIN_FILENO,TRUE);
+	stdin_handle->d.handle->r=nl_reader_stdin();
+	nl_bind_new(nl_sym_from_c_str("stdin"),stdin_handle,env);
 }
 
 //the repl for neulang; this is separated from main for embedding purposes
 //the only thing you have to do outside this is give us an open file and close it when we're done
 //arguments given are interpreted as command-line arguments and are bound to argv in the interpreter (NULL works)
-int nl_repl(FILE *fp, nl_val *argv){
-	//the global NULL is allocated in main() so that argv handling can use it
-	//create and bind the global NULL
-//	nl_null=nl_val_malloc(NL_NULL);
-	
-	exit_status=0;
-	
-	//allocate keywords
-	nl_keyword_malloc();
+//if load_image isn't NULL the bindings saved in that image are loaded before anything is read
+//if save_image isn't NULL the global bindings are saved to that image once the program ends
+//if fname (the name fp was opened from) isn't NULL the file is run through the source cache rather than read an expression at a time
+int nl_repl(FILE *fp, nl_val *argv, const char *load_image, const char *save_image, const char *fname){
+	//every repl is its own interpreter, so this can be called from several threads at once
+	nl_vm *vm=nl_vm_malloc();
+	nl_vm *outer_vm=nl_vm_enter(vm);
+	if(nl_prof_fname!=NULL){
+		nl_prof_vm_init(vm,(fname!=NULL)?fname:"stdin");
+	}
+	if(nl_prof_counting){
+		nl_prof_count_vm_init(vm);
+	}
 	
 	//create the global environment
 	nl_env_frame *global_env=nl_env_frame_malloc(NULL);
 	
 	//bind the standard library functions in the global environment
 	nl_bind_stdlib(global_env);
+	if(nl_prof_counting){
+		nl_prof_count_names(global_env);
+	}
 	
 	//initialize the line number
-//	line_number=0;
-	line_number=1;
+//	nl_vm_cur->line_number=0;
+	nl_vm_cur->line_number=1;
+	
+	//load a saved image over the standard library, so a prelude doesn't have to be re-evaluated on every start
+	if(load_image!=NULL){
+		if(!nl_image_load(global_env,load_image)){
+			fprintf(stderr,"Err: Could not load image \"%s\"\n",load_image);
+			
+			//the program was meant to run with what's in the image, so nothing is evaluated without it
+			nl_val_free(argv);
+			nl_env_frame_free(global_env);
+			nl_vm_enter(outer_vm);
+			nl_vm_free(vm);
+			return 1;
+		}
+	}
 	
 	//if we got arguments, bind those too
 	if(argv!=NULL){
@@ -2555,49 +3262,58 @@ int nl_repl(FILE *fp, nl_val *argv){
 		printf("started with arguments: ");
 		nl_out(stdout,argv);
 		printf("\n");
-		printf("[line %u] nl >> ",line_number);
+		printf("[line %u] nl >> ",nl_vm_cur->line_number);
 	}
 	
-	//read in a little bit in case there's a shebang line
-	//read a character from the given file
-	char c=getc(fp);
-	
-	//peek a character after that, for two-char tokens
-	char next_c=getc(fp);
-	ungetc(next_c,fp);
+	nl_vm_cur->end_program=FALSE;
 	
-	//ignore shebang (#!) line, if there is one
-	if(c=='#' && next_c=='!'){
-		while(c!='\n'){
-			c=getc(fp);
-		}
-		line_number++;
+	nl_reader *reader=NULL;
+	if((fname!=NULL) && (fp!=stdin)){
+		//a named file is parsed all at once (or its cached parse is loaded) and then evaluated, the same as if it were sourced
+		nl_val *src_name=nl_str_from_c_str(fname);
+		nl_val_free(nl_source_eval(src_name,global_env));
+		nl_val_free(src_name);
+		nl_vm_cur->end_program=TRUE;
 	}else{
-		ungetc(c,fp);
+		//all reads from the source go through a buffered reader
+		reader=(fp==stdin)?nl_reader_stdin():nl_reader_malloc(fileno(fp));
+		
+		//ignore shebang (#!) line, if there is one
+		if((nl_reader_peek(reader,0)=='#') && (nl_reader_peek(reader,1)=='!')){
+			int c=nl_reader_getc(reader);
+			while((c!='\n') && (c!=EOF)){
+				c=nl_reader_getc(reader);
+			}
+			nl_vm_cur->line_number++;
+		}
 	}
 	
-	end_program=FALSE;
-	while(!end_program){
+	while(!nl_vm_cur->end_program){
 		//only display prompt for interactive mode
 		if(fp==stdin){
-			printf("[line %u] nl >> ",line_number);
+			printf("[line %u] nl >> ",nl_vm_cur->line_number);
 		}
 		
 		//read an expression in
-		nl_val *exp=nl_read_exp(fp);
+		nl_val *exp=nl_read_exp(reader);
 		
 /*
 #ifdef _DEBUG
 		printf("\n");
 		
-		printf("Info [line %i]: evaluating ",line_number);
+		printf("Info [line %i]: evaluating ",nl_vm_cur->line_number);
 		nl_out(stdout,exp);
 		printf("\n");
 #endif
 */
 		
 		//evalute the expression in the global environment
+		nl_perf_counts perf_start;
+		char perf=nl_perf_on && nl_perf_form_start(&perf_start);
 		nl_val *result=nl_eval(exp,global_env,FALSE,NULL);
+		if(perf){
+			nl_perf_form_end(&perf_start,nl_vm_cur->line_number);
+		}
 		
 		//expressions should be free-d in nl_eval, unless they are self-evaluating
 		
@@ -2616,50 +3332,136 @@ int nl_repl(FILE *fp, nl_val *argv){
 	}
 
 #ifdef _DEBUG
-	printf("Info [line %i]: exited program\n",line_number);
+	printf("Info [line %i]: exited program\n",nl_vm_cur->line_number);
 #endif
 	
-	//de-allocate the global environment
+	//coroutines that are still running get to finish before the program ends
+	nl_co_join();
+	
+	//futures nothing touched are finished before the program ends, the same as at the end of a subroutine call
+	//(if the program exited they were already waited for, and anything they didn't get to do doesn't happen)
+	nl_par_sync(NULL);
+	
+	//save the global bindings, if we were asked to
+	if(save_image!=NULL){
+		if(!nl_image_save(global_env,save_image)){
+			fprintf(stderr,"Err: Could not save image \"%s\"\n",save_image);
+			nl_vm_cur->exit_status=1;
+		}
+	}
+	
+	//write out anything still buffered before we exit
+	fflush(stdout);
+	
+	//de-allocate the global environment (after what its closures hold, which can include themselves)
+	nl_trie_free_closure_frames(global_env->trie);
 	nl_env_frame_free(global_env);
 	
-	//free (de-allocate) keywords
-	nl_keyword_free();
+	//free the source reader (the stdin reader, if input primitives used it, goes with the interpreter)
+	if(reader!=vm->stdin_reader){
+		nl_reader_free(reader);
+	}
 	
-	//free the global null
-	//NULL is not subject to reference counting
-	//instead it has one, global, value
-	free(nl_null);
-//	nl_val_free(nl_null);
+	//free (de-allocate) the interpreter, keywords and all
+	int ret=vm->exit_status;
+	nl_vm_enter(outer_vm);
+	nl_vm_free(vm);
 	
 	//return back to main with interpreter exit status
-	return exit_status;
+	return ret;
 }
 
+//(_NO_MAIN leaves this out, so other programs such as bench/microbench.c can be built with the interpreter)
+#ifndef _NO_MAIN
 //runtime!
 int main(int argc, char *argv[]){
 	FILE *fp=stdin;
 	
+	//shared constant values are set up before anything could use them
+	nl_packed_byte_vals_init();
+	
+	//output goes through one large buffer; when it's going to a terminal it's written out on every newline instead
+	setvbuf(stdout,NULL,isatty(STDOUT_FILENO)?_IOLBF:_IOFBF,NL_OUT_BUFFER);
+	
+	//interpreter options come before the file to run; everything from the file on is given to the program as argv
+	const char *load_image=NULL;
+	const char *save_image=NULL;
+	int first_arg=1;
+	while((first_arg<argc) && (strncmp(argv[first_arg],"--",2)==0)){
+		if((strcmp(argv[first_arg],"--image")==0) && ((first_arg+1)<argc)){
+			load_image=argv[first_arg+1];
+			first_arg+=2;
+		}else if((strcmp(argv[first_arg],"--save-image")==0) && ((first_arg+1)<argc)){
+			save_image=argv[first_arg+1];
+			first_arg+=2;
+		}else if(strcmp(argv[first_arg],"--no-cache")==0){
+			nl_source_cache=FALSE;
+			first_arg++;
+		}else if((strcmp(argv[first_arg],"--threads")==0) && ((first_arg+1)<argc) && (atoi(argv[first_arg+1])>0)){
+			nl_par_threads=(unsigned int)(atoi(argv[first_arg+1]));
+			first_arg+=2;
+		}else if((strcmp(argv[first_arg],"--profile")==0) && ((first_arg+1)<argc)){
+			if(!nl_prof_start(argv[first_arg+1])){
+				fprintf(stderr,"Err: Could not start the profiler\n");
+				return 1;
+			}
+			first_arg+=2;
+		}else if(strcmp(argv[first_arg],"--prof-count")==0){
+			nl_prof_count_start();
+			first_arg++;
+		}else if((strcmp(argv[first_arg],"--trace")==0) && ((first_arg+1)<argc)){
+			if(!nl_trace_start(argv[first_arg+1])){
+				fprintf(stderr,"Err: Could not write trace \"%s\"\n",argv[first_arg+1]);
+				return 1;
+			}
+			first_arg+=2;
+		}else if((strcmp(argv[first_arg],"--trace-min-us")==0) && ((first_arg+1)<argc) && (atoi(argv[first_arg+1])>=0)){
+			nl_trace_min_ns=((unsigned long long)(atoi(argv[first_arg+1])))*1000ULL;
+			first_arg+=2;
+		}else if(strcmp(argv[first_arg],"--mem-report")==0){
+			if(!nl_mem_report_exit){
+				nl_mem_report_exit=TRUE;
+				atexit(nl_mem_report_finish);
+			}
+			first_arg++;
+		}else if(strcmp(argv[first_arg],"--perf-counters")==0){
+			if(!nl_perf_on){
+				nl_perf_start();
+				if(nl_perf_on){
+					atexit(nl_perf_finish);
+				}
+			}
+			first_arg++;
+		}else if(strcmp(argv[first_arg],"--stats")==0){
+			if(!nl_stats_exit){
+				nl_stats_exit=TRUE;
+				atexit(nl_stats_finish);
+			}
+			first_arg++;
+		}else{
+			fprintf(stderr,"Err: Unknown or incomplete option \"%s\"\n",argv[first_arg]);
+			fprintf(stderr,"Usage: %s [--image <file>] [--save-image <file>] [--no-cache] [--threads <count>] [--profile <file>] [--prof-count] [--trace <file>] [--trace-min-us <microseconds>] [--stats] [--mem-report] [--perf-counters] [file [arguments...]]\n",argv[0]);
+			return 1;
+		}
+	}
+	
 	//if we were given a file, open it
-	if(argc>1){
-		fp=fopen(argv[1],"r");
+	if(first_arg<argc){
+		fp=fopen(argv[first_arg],"r");
 		if(fp==NULL){
-			fprintf(stderr,"Err: Could not open input file \"%s\"\n",argv[1]);
+			fprintf(stderr,"Err: Could not open input file \"%s\"\n",argv[first_arg]);
 			return 1;
 		}
 	}
 	
-	//TODO: find a way to allocate this in nl_repl instead of here
-	//but still allow it to be accessed from here
-	nl_null=nl_val_malloc(NL_NULL);
-	
 	nl_val *nl_argv=nl_null;
 	
 	//if we got more arguments, then pass them to the interpreter as strings
 	nl_argv=nl_val_malloc(PAIR);
-	if(argc>1){
+	if(first_arg<argc){
 		nl_val *current_arg=nl_argv;
 		int n;
-		for(n=1;n<argc;n++){
+		for(n=first_arg;n<argc;n++){
 			current_arg->d.pair.f=nl_val_malloc(ARRAY);
 			int n2;
 			for(n2=0;n2<strlen(argv[n]);n2++){
@@ -2682,14 +3484,20 @@ int main(int argc, char *argv[]){
 	}
 	
 	//go into the read eval print loop!
-	int ret=nl_repl(fp,nl_argv);
+	int ret=nl_repl(fp,nl_argv,load_image,save_image,(first_arg<argc)?argv[first_arg]:NULL);
 	
 	//if we were reading from a file then close that file
 	if((fp!=NULL) && (fp!=stdin)){
 		fclose(fp);
 	}
 	
+#ifdef _LEAKCHECK
+	//everything should have been free'd by now, so whatever's left leaked
+	nl_leak_report(stderr,TRUE);
+#endif
+	
 	//pass return up from repl
 	return ret;
 }
+#endif
 
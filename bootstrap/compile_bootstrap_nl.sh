@@ -14,7 +14,8 @@ echo "Compiling using ${CC}..."
 
 #the -O3 is a tailcall optimization option, and is necessary for the resultant interpreter to do tco
 #note that we're calling the binary "neul" rather than "nl" only because there exists an nl commandin *nix, which numbers lines
-$CC -o bootstrap-neul *.c -O3 -Wall $*
+#-pthread is for the worker threads used by parallel primitives (ar-pmap)
+$CC -o bootstrap-neul *.c -O3 -Wall -pthread $*
 
 # -O2 still gets tailcall optimization in gcc and clang, but tcc still doesn't tco with it :/
 #$CC -o bootstrap-nl *.c -O2 -Wall $*
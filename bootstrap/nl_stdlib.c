@@ -1,9 +1,28 @@
+//for memmem
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 #include "nl_structures.h"
 
@@ -12,6 +31,7 @@
 //allocate a trie
 nl_trie_node *nl_trie_malloc(){
 	nl_trie_node *ret=malloc(sizeof(nl_trie_node));
+	NL_STATS_MEM(nl_vm_cur,trie_nodes,1,sizeof(nl_trie_node));
 	
 	ret->child_count=0;
 	ret->children=NULL;
@@ -54,6 +74,28 @@ void nl_trie_free(nl_trie_node *trie_root){
 	
 	//then free the root
 	free(trie_root);
+	NL_STATS_MEM(nl_vm_cur,trie_nodes,-1,sizeof(nl_trie_node));
+}
+
+//empty the frames of the closures bound in a trie (for the end of a program)
+//a closure whose own frame holds onto it (say a variable, or a future's result, set to itself) is never free'd otherwise
+void nl_trie_free_closure_frames(nl_trie_node *trie_root){
+	if(trie_root==NULL){
+		return;
+	}
+	
+	int n;
+	for(n=0;n<trie_root->child_count;n++){
+		nl_trie_free_closure_frames(trie_root->children[n]);
+	}
+	
+	//the frame itself stays, since closures made in calls can still link up to it
+	if((trie_root->end_node) && (trie_root->value!=NULL) && (trie_root->value->t==SUB) && (trie_root->value->d.sub->env!=NULL)){
+		nl_env_frame *closure_env=trie_root->value->d.sub->env;
+		nl_trie_node *trie=closure_env->trie;
+		closure_env->trie=nl_trie_malloc();
+		nl_trie_free(trie);
+	}
 }
 
 //allocate a pointer array for trie children
@@ -92,8 +134,10 @@ nl_trie_node *nl_trie_cp(nl_trie_node *from){
 }
 
 //add a node to a trie that maps a c string to a value
+//if retire is TRUE other threads could be reading this trie right now, so anything replaced is retired rather than free'd (see nl_par_retire)
+//(new children and values are always published in an order that's safe for readers on other threads; see nl_trie_match)
 //returns TRUE on success, FALSE on failure
-char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int start_idx, unsigned int length, nl_val *value, const char chk_type){
+char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int start_idx, unsigned int length, nl_val *value, const char chk_type, const char retire){
 /*
 #ifdef _DEBUG
 	printf("nl_trie_add_node debug 0, got name %s, length %u, value ",name,length);
@@ -106,7 +150,9 @@ char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int st
 	//(this is the base case to stop recursion)
 	if(length<1){
 		if((trie_root->end_node) && ((chk_type==TRUE) && (trie_root->t[value->t]==FALSE))){
-			fprintf(stderr,"Err [line %u]: re-binding %s",value->line,name);
+			nl_par_impure();
+			fflush(stdout);
+			fprintf(stderr,"Err [line %u]: re-binding %s",nl_val_line(value),name);
 			fprintf(stderr," to value of wrong type (type %s not enabled) (symbol value unchanged)\n",nl_type_name(value->t));
 			nl_val_free(value);
 #ifdef _STRICT
@@ -115,15 +161,22 @@ char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int st
 			return FALSE;
 		}else{
 			//this is a legal re-bind because the types match; just free the old value
-			if(trie_root->end_node){
-				nl_val_free(trie_root->value);
-			}
-			trie_root->end_node=TRUE;
-			trie_root->value=value;
-			trie_root->t[value->t]=TRUE;
+			nl_val *old_value=(trie_root->end_node)?trie_root->value:NULL;
 			
 			//this is a new reference to this value
-			value->ref++;
+			NL_VAL_REF_INC(value);
+			
+			trie_root->t[value->t]=TRUE;
+			__atomic_store_n(&(trie_root->value),value,__ATOMIC_RELEASE);
+			__atomic_store_n(&(trie_root->end_node),TRUE,__ATOMIC_RELEASE);
+			
+			if(old_value!=NULL){
+				if(retire){
+					nl_par_retire(old_value,NULL);
+				}else{
+					nl_val_free(old_value);
+				}
+			}
 		}
 		return TRUE;
 	}
@@ -132,25 +185,32 @@ char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int st
 	for(n=0;n<trie_root->child_count;n++){
 		//found the value, so go to the next character and return early
 		if(name[start_idx]==trie_root->children[n]->name){
-			return nl_trie_add_node(trie_root->children[n],name,start_idx+1,length-1,value,chk_type);
+			return nl_trie_add_node(trie_root->children[n],name,start_idx+1,length-1,value,chk_type,retire);
 		}
 	}
 	
 	//if we got here and didn't return then this child didn't yet exist, so make it
-	trie_root->child_count++;
-	nl_trie_node **new_children=nl_trie_malloc_children(trie_root->child_count);
-	for(n=0;n<(trie_root->child_count-1);n++){
+	int child_count=trie_root->child_count+1;
+	nl_trie_node **new_children=nl_trie_malloc_children(child_count);
+	for(n=0;n<(child_count-1);n++){
 		new_children[n]=trie_root->children[n];
 	}
-	new_children[trie_root->child_count-1]=nl_trie_malloc();
-	new_children[trie_root->child_count-1]->name=(name[start_idx]);
+	new_children[child_count-1]=nl_trie_malloc();
+	new_children[child_count-1]->name=(name[start_idx]);
 	
 	//free the old children and set the trie node to point to the new children
-	free(trie_root->children);
-	trie_root->children=new_children;
+	//(the new children go in before the count changes, so a reader never sees a count bigger than the array it reads)
+	nl_trie_node **old_children=trie_root->children;
+	__atomic_store_n(&(trie_root->children),new_children,__ATOMIC_RELEASE);
+	__atomic_store_n(&(trie_root->child_count),child_count,__ATOMIC_RELEASE);
+	if(retire){
+		nl_par_retire(NULL,old_children);
+	}else{
+		free(old_children);
+	}
 	
 	//now go and try to add the next character to the newly-created child
-	return nl_trie_add_node(trie_root->children[trie_root->child_count-1],name,start_idx+1,length-1,value,chk_type);
+	return nl_trie_add_node(new_children[child_count-1],name,start_idx+1,length-1,value,chk_type,retire);
 }
 
 //check if a trie contains a given value; if so, return a pointer to the value
@@ -164,7 +224,8 @@ nl_val *nl_trie_match(nl_trie_node *trie_root, const char *name, unsigned int st
 	//a length of 0 indicates that we got to the end node already
 	//so just check if it's a valid end point (terminal)
 	if(length<1){
-		if(trie_root->end_node){
+		//(this is read before the value; see nl_trie_add_node)
+		if(__atomic_load_n(&(trie_root->end_node),__ATOMIC_ACQUIRE)){
 #ifdef _DEBUG
 /*
 			printf("nl_trie_match debug 0, found value for %s, value is ",name);
@@ -176,7 +237,7 @@ nl_val *nl_trie_match(nl_trie_node *trie_root, const char *name, unsigned int st
 			(*success)=TRUE;
 			
 			//we do NOT return a copy; copies are made by calling code if and when they are needed
-			return trie_root->value;
+			return __atomic_load_n(&(trie_root->value),__ATOMIC_ACQUIRE);
 		}else{
 			//signal the calling code so they know this failed
 			(*success)=FALSE;
@@ -186,12 +247,19 @@ nl_val *nl_trie_match(nl_trie_node *trie_root, const char *name, unsigned int st
 	
 	int found_child=-1;
 	nl_val *result=nl_null;
+	if(trie_root==NULL){
+		return result;
+	}
+	
+	//another thread could be adding children while parallel work is running, so the count is read before the children (see nl_trie_add_node)
+	int child_count=__atomic_load_n(&(trie_root->child_count),__ATOMIC_ACQUIRE);
+	nl_trie_node **children=__atomic_load_n(&(trie_root->children),__ATOMIC_ACQUIRE);
 	
 	int n;
-	for(n=0;(length>0) && (trie_root!=NULL) && (n<trie_root->child_count);n++){
+	for(n=0;(length>0) && (n<child_count);n++){
 		//if this node matched, then start on its children (recursively)
-		if(trie_root->children[n]->name==(name[start_idx])){
-			result=nl_trie_match(trie_root->children[n],name,start_idx+1,length-1,success,reorder);
+		if(children[n]->name==(name[start_idx])){
+			result=nl_trie_match(children[n],name,start_idx+1,length-1,success,reorder);
 			if(!reorder){
 				return result;
 			}
@@ -237,12 +305,19 @@ nl_trie_node *nl_trie_match_node(nl_trie_node *trie_root, const char *name, unsi
 	}
 	
 	nl_trie_node *result=NULL;
+	if(trie_root==NULL){
+		return result;
+	}
+	
+	//(read in the same order as nl_trie_match does)
+	int child_count=__atomic_load_n(&(trie_root->child_count),__ATOMIC_ACQUIRE);
+	nl_trie_node **children=__atomic_load_n(&(trie_root->children),__ATOMIC_ACQUIRE);
 	
 	int n;
-	for(n=0;(length>0) && (trie_root!=NULL) && (n<trie_root->child_count);n++){
+	for(n=0;(length>0) && (n<child_count);n++){
 		//if this node matched, then start on its children (recursively)
-		if(trie_root->children[n]->name==(name[start_idx])){
-			result=nl_trie_match_node(trie_root->children[n],name,start_idx+1,length-1);
+		if(children[n]->name==(name[start_idx])){
+			result=nl_trie_match_node(children[n],name,start_idx+1,length-1);
 			return result;
 		}
 	}
@@ -532,37 +607,40 @@ nl_val *nl_trie_associative_list(nl_trie_node *trie_root){
 
 //BEGIN STRING<->EXP I/O SUBROUTINES  -----------------------------------------------------------------------------
 
-//gets an entry out of the string at the given position or returns NULL if position is out of bounds
-//NOTE: this does NOT do type checking at the moment, use with care
-char nl_str_char_or_null(nl_val *string, unsigned int pos){
-	if(pos<(string->d.array.size)){
-		return string->d.array.v[pos]->d.byte.v;
+//NOTE: the reader parses directly from a C buffer (either the source reader's buffer or a flattened neulang string)
+//so that reading a file doesn't box every character before parsing it
+
+//gets an entry out of the buffer at the given position or returns NULL if position is out of bounds
+char nl_buf_char_or_null(const char *input, unsigned int length, unsigned int pos){
+	if(pos<length){
+		return input[pos];
 	}
 	return '\0';
 }
 
 //skip past any leading whitespaces in the string
-void nl_str_skip_whitespace(nl_val *input_string, unsigned int *persistent_pos){
+void nl_buf_skip_whitespace(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	while(nl_is_whitespace(c) && (c!='\0')){
 		if(c=='\n'){
-			line_number++;
+			nl_vm_cur->line_number++;
 		}
 		pos++;
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 	}
 	
 	(*persistent_pos)=pos;
 }
 
 //read a number from a string
-nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_num(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
 	//create a new number to return
 	nl_val *ret=nl_val_malloc(NUM);
+	nl_line_set(ret);
 	//initialize to 0, this should get reset
 	ret->d.num.n=0;
 	ret->d.num.d=1;
@@ -575,20 +653,20 @@ nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos){
 	//whether we've hit a . and are now reading a float as a rational
 	char reading_decimal=FALSE;
 	
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	pos++;
 	
 	//handle negative signs
 	if(c=='-'){
 		negative=TRUE;
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 		pos++;
 	}
 	
 	//handle numerical expressions starting with . (absolute value less than 1)
 	if(c=='.'){
 		reading_decimal=TRUE;
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 		pos++;
 	}
 	
@@ -616,13 +694,16 @@ nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos){
 			
 			(ret->d.num.d)*=10;
 		}else{
-			fprintf(stderr,"Err [line %u]: invalid character in numeric literal, \'%c\'\n",line_number,c);
+			nl_par_impure();
+			fflush(stdout);
+			nl_vm_cur->err_cnt++;
+			fprintf(stderr,"Err [line %u]: invalid character in numeric literal, \'%c\'\n",nl_vm_cur->line_number,c);
 #ifdef _STRICT
 			exit(1);
 #endif
 		}
 		
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 		if(c=='\0'){
 			break;
 		}
@@ -634,7 +715,7 @@ nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos){
 			pos--;
 		}
 	}else if(c=='\n'){
-		line_number++;
+		nl_vm_cur->line_number++;
 	}
 	
 	//incorporate negative values if a negative sign preceded the expression
@@ -656,14 +737,17 @@ nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos){
 }
 
 //read a string (byte array) from a string (trust me it makes sense)
-nl_val *nl_str_read_string(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_string(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
 	nl_val *ret=nl_null;
 	
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	if(c!='"'){
-		fprintf(stderr,"Err [line %u]: string literal didn't start with \"; WHAT DID YOU DO? (started with \'%c\')\n",line_number,c);
+		nl_par_impure();
+		fflush(stdout);
+		nl_vm_cur->err_cnt++;
+		fprintf(stderr,"Err [line %u]: string literal didn't start with \"; WHAT DID YOU DO? (started with \'%c\')\n",nl_vm_cur->line_number,c);
 #ifdef _STRICT
 		exit(1);
 #endif
@@ -671,52 +755,50 @@ nl_val *nl_str_read_string(nl_val *input_string, unsigned int *persistent_pos){
 	}
 	pos++;
 	
-	//allocate a byte array
-	ret=nl_val_malloc(ARRAY);
-	
-	if(pos<input_string->d.array.size){
-		c=input_string->d.array.v[pos]->d.byte.v;
-	}else{
-		nl_val_free(ret);
+	//find the end quote, THERE IS NO ESCAPE
+	const char *end_quote=NULL;
+	if(pos<length){
+		end_quote=memchr(input+pos,'"',length-pos);
+	}
+	//an unterminated string is just a NULL value
+	if(end_quote==NULL){
 		return nl_null;
 	}
 	
-	//read until end quote, THERE IS NO ESCAPE
-	while(c!='"'){
-		nl_val *ar_entry=nl_val_malloc(BYTE);
-		ar_entry->d.byte.v=c;
-		nl_array_push(ret,ar_entry);
-		
-		if(c=='\n'){
-			line_number++;
-		}
-		
-		pos++;
-		if(pos<input_string->d.array.size){
-			c=input_string->d.array.v[pos]->d.byte.v;
-		}else{
-			nl_val_free(ret);
-			return nl_null;
+	unsigned int str_length=(end_quote-(input+pos));
+	
+	//keep the line count consistent for multi-line strings
+	unsigned int n;
+	for(n=0;n<str_length;n++){
+		if(input[pos+n]=='\n'){
+			nl_vm_cur->line_number++;
 		}
 	}
-	if(c=='"'){
-		pos++;
-	}
+	
+	//make the byte array in one go rather than a push at a time
+	ret=nl_str_from_buf(input+pos,str_length);
+	nl_line_set(ret);
+	
+	//skip past the end quote
+	pos+=(str_length+1);
 	
 	(*persistent_pos)=pos;
 	return ret;
 }
 
 //read a single character (byte) from a string
-nl_val *nl_str_read_char(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_char(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
 	nl_val *ret=nl_null;
 	
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	pos++;
 	if(c!='\''){
-		fprintf(stderr,"Err [line %u]: character literal didn't start with \'; WHAT DID YOU DO? (started with \'%c\')\n",line_number,c);
+		nl_par_impure();
+		fflush(stdout);
+		nl_vm_cur->err_cnt++;
+		fprintf(stderr,"Err [line %u]: character literal didn't start with \'; WHAT DID YOU DO? (started with \'%c\')\n",nl_vm_cur->line_number,c);
 #ifdef _STRICT
 		exit(1);
 #endif
@@ -725,20 +807,24 @@ nl_val *nl_str_read_char(nl_val *input_string, unsigned int *persistent_pos){
 	
 	//allocate a byte
 	ret=nl_val_malloc(BYTE);
+	nl_line_set(ret);
 	
-	c=nl_str_char_or_null(input_string,pos);
+	c=nl_buf_char_or_null(input,length,pos);
 	pos++;
 	ret->d.byte.v=c;
 	
-	c=nl_str_char_or_null(input_string,pos);
+	c=nl_buf_char_or_null(input,length,pos);
 	pos++;
 	if(c!='\''){
-		fprintf(stderr,"Warn [line %u]: single-character literal didn't end with \'; (ended with \'%c\')\n",line_number,c);
+		nl_par_impure();
+		fflush(stdout);
+		nl_vm_cur->err_cnt++;
+		fprintf(stderr,"Warn [line %u]: single-character literal didn't end with \'; (ended with \'%c\')\n",nl_vm_cur->line_number,c);
 #ifdef _STRICT
 		exit(1);
 #endif
 		if(c=='\n'){
-			line_number++;
+			nl_vm_cur->line_number++;
 		}
 	}
 	
@@ -747,14 +833,17 @@ nl_val *nl_str_read_char(nl_val *input_string, unsigned int *persistent_pos){
 }
 
 //read an expression list from a string
-nl_val *nl_str_read_exp_list(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_exp_list(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
 	nl_val *ret=nl_null;
 	
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	if(c!='('){
-		fprintf(stderr,"Err [line %u]: expression list didn't start with (; WHAT DID YOU DO? (started with \'%c\')\n",line_number,c);
+		nl_par_impure();
+		fflush(stdout);
+		nl_vm_cur->err_cnt++;
+		fprintf(stderr,"Err [line %u]: expression list didn't start with (; WHAT DID YOU DO? (started with \'%c\')\n",nl_vm_cur->line_number,c);
 #ifdef _STRICT
 		exit(1);
 #endif
@@ -764,25 +853,27 @@ nl_val *nl_str_read_exp_list(nl_val *input_string, unsigned int *persistent_pos)
 	
 	//allocate a pair (the first element of a linked list)
 	ret=nl_val_malloc(PAIR);
+	nl_line_set(ret);
 	
 	nl_val *list_cell=ret;
 	
 	//read the first expression
-	nl_val *next_exp=nl_str_read_exp(input_string,&pos);
+	nl_val *next_exp=nl_buf_read_exp(input,length,&pos);
 	
 	//continue reading expressions until we hit a NULL
 	while(next_exp!=nl_null){
 		list_cell->d.pair.f=next_exp;
 		list_cell->d.pair.r=nl_null;
 		
-		next_exp=nl_str_read_exp(input_string,&pos);
+		next_exp=nl_buf_read_exp(input,length,&pos);
 		if(next_exp!=nl_null){
 			list_cell->d.pair.r=nl_val_malloc(PAIR);
+			nl_line_set(list_cell->d.pair.r);
 			list_cell=list_cell->d.pair.r;
 		}
 	}
 	//increment position to past the list termination character
-	if((pos+1)<(input_string->d.array.size)){
+	if((pos+1)<length){
 		pos++;
 	}
 	
@@ -792,7 +883,7 @@ nl_val *nl_str_read_exp_list(nl_val *input_string, unsigned int *persistent_pos)
 }
 
 //read a symbol (just a string with a wrapper) (with a rapper? drop them beats man) from a string
-nl_val *nl_str_read_symbol(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_symbol(const char *input, unsigned int length, unsigned int *persistent_pos){
 	unsigned int pos=(*persistent_pos);
 	
 	nl_val *ret=nl_null;
@@ -801,57 +892,63 @@ nl_val *nl_str_read_symbol(nl_val *input_string, unsigned int *persistent_pos){
 	
 	//allocate a symbol for the return
 	ret=nl_val_malloc(SYMBOL);
+	nl_line_set(ret);
 	
-	//allocate a byte array for the name
-	nl_val *name=nl_val_malloc(ARRAY);
+	//the name starts here; it's copied out once we know where it ends
+	unsigned int name_start=pos;
+	nl_val *name;
 	
-	c=nl_str_char_or_null(input_string,pos);
+	c=nl_buf_char_or_null(input,length,pos);
 	pos++;
 	
-	//read until whitespace or list-termination character
-	while(!nl_is_whitespace(c) && c!=')'){
+	//read until whitespace or list-termination character (or the end of the buffer)
+	while(!nl_is_whitespace(c) && c!=')' && (pos<=length)){
 		//an alternate list syntax has the symbol come first, followed by an open paren
 		if(c=='('){
+			name=nl_str_from_buf(input+name_start,pos-1-name_start);
 			ret->d.sym.name=name;
 			nl_val *symbol=ret;
 			
 			//read the rest of the list
 			pos--;
-			nl_val *list_remainder=nl_str_read_exp_list(input_string,&pos);
+			nl_val *list_remainder=nl_buf_read_exp_list(input,length,&pos);
 			
 			//return by pointer (must be set before a return)
 			(*persistent_pos)=pos;
 			
 			ret=nl_val_malloc(PAIR);
+			nl_line_set(ret);
 			ret->d.pair.f=symbol;
 			ret->d.pair.r=list_remainder;
 			return ret;
 		//the : syntax denotes a delayed binding
 		}else if(c==':'){
+			name=nl_str_from_buf(input+name_start,pos-1-name_start);
 			ret->d.sym.name=name;
 			nl_val *symbol=ret;
-			nl_val *value=nl_str_read_exp(input_string,&pos);
+			nl_val *value=nl_buf_read_exp(input,length,&pos);
 			
 			//return by pointer the position in string
 			(*persistent_pos)=pos;
 			
 			ret=nl_val_malloc(BIND);
+			nl_line_set(ret);
 			ret->d.bind.sym=symbol;
 			ret->d.bind.v=value;
 			return ret;
 		}
-		nl_val *ar_entry=nl_val_malloc(BYTE);
-		ar_entry->d.byte.v=c;
-		nl_array_push(name,ar_entry);
 		
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 		pos++;
 	}
 	
+	//the terminating character isn't part of the name (unless we ran off the end of the buffer)
+	name=nl_str_from_buf(input+name_start,((pos>length)?length:(pos-1))-name_start);
+	
 	if(c==')'){
 		pos--;
 	}else if(c=='\n'){
-		line_number++;
+		nl_vm_cur->line_number++;
 	}
 	
 	(*persistent_pos)=pos;
@@ -864,34 +961,18 @@ nl_val *nl_str_read_symbol(nl_val *input_string, unsigned int *persistent_pos){
 //read an expression from an existing neulang string
 //takes an input string, a position to start at (0 for whole string) and returns the new expression
 //start_pos is set to the end of the first expression read when a full expression is found
-nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
+nl_val *nl_buf_read_exp(const char *input, unsigned int length, unsigned int *persistent_pos){
 	//position in string
 	unsigned int pos=(*persistent_pos);
 	
-	//first ensure the string is valid
-	if((input_string->t!=ARRAY)){
-		ERR_EXIT(input_string,"null or incorrect type given to str_read_exp",TRUE);
-		return nl_null;
-	}
-	
-	unsigned int n;
-	for(n=0;n<input_string->d.array.size;n++){
-		//TODO: remove this null check? as a nl_val pointer it should never be NULL, only nl_null (which has its own type)
-		if((input_string->d.array.v[n]==NULL) || (input_string->d.array.v[n]->t!=BYTE)){
-			ERR_EXIT(input_string->d.array.v[n],"invalid string entry (null or non-byte) given to str_read_exp",TRUE);
-			return nl_null;
-		}
-	}
-	
 	//a position past the end of the array is just a NULL value
-	if((input_string->d.array.size)<=pos){
+	if(length<=pos){
 		return nl_null;
 	}
 	
 /*
 #ifdef _DEBUG
-	printf("nl_str_read_exp debug 0, reading an expression from ");
-	nl_out(stdout,input_string);
+	printf("nl_buf_read_exp debug 0, reading an expression from %.*s",length,input);
 	printf(" with starting position %u\n",pos);
 #endif
 */
@@ -900,31 +981,31 @@ nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
 	nl_val *ret=nl_null;
 	
 	//skip past any whitespace any time we go to read an expression
-	nl_str_skip_whitespace(input_string,&pos);
+	nl_buf_skip_whitespace(input,length,&pos);
 	
 	//if we hit the end of the string then exit
-	if((input_string->d.array.size)<=pos){
+	if(length<=pos){
 		return nl_null;
 	}
 	
 	//read a character from the given string
-	char c=nl_str_char_or_null(input_string,pos);
+	char c=nl_buf_char_or_null(input,length,pos);
 	
 	//peek a character after that, for two-char tokens
-	char next_c=nl_str_char_or_null(input_string,pos+1);
+	char next_c=nl_buf_char_or_null(input,length,pos+1);
 	
 	//if it starts with a digit or '.' then it's a number, or if it starts with '-' followed by a digit
 	if(isdigit(c) || (c=='.') || ((c=='-') && isdigit(next_c))){
-		ret=nl_str_read_num(input_string,&pos);
+		ret=nl_buf_read_num(input,length,&pos);
 	//if it starts with a quote read a string (byte array)
 	}else if(c=='"'){
-		ret=nl_str_read_string(input_string,&pos);
+		ret=nl_buf_read_string(input,length,&pos);
 	//if it starts with a single quote, read a character (byte)
 	}else if(c=='\''){
-		ret=nl_str_read_char(input_string,&pos);
+		ret=nl_buf_read_char(input,length,&pos);
 	//if it starts with a ( read a compound expression (a list of expressions)
 	}else if(c=='('){
-		ret=nl_str_read_exp_list(input_string,&pos);
+		ret=nl_buf_read_exp_list(input,length,&pos);
 	//an empty list is just a NULL value, so leave ret as NULL
 	}else if(c==')'){
 		
@@ -932,33 +1013,33 @@ nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
 	}else if(c=='/' && next_c=='/'){
 		//ignore everything until the next newline, then try to read again
 		while(c!='\n'){
-			if((pos+1)<(input_string->d.array.size)){
-				c=input_string->d.array.v[pos+1]->d.byte.v;
+			if((pos+1)<length){
+				c=input[pos+1];
 				pos++;
 			}else{
 				c='\n';
 			}
 		}
-		line_number++;
+		nl_vm_cur->line_number++;
 		//skip past the newline that terminated the comment
 		pos++;
-		ret=nl_str_read_exp(input_string,&pos);
+		ret=nl_buf_read_exp(input,length,&pos);
 	//the /* ... */ multi-line comment style, as in gnu89 C
 	}else if(c=='/' && next_c=='*'){
 		pos++;
 		pos++;
-		c=nl_str_char_or_null(input_string,pos);
+		c=nl_buf_char_or_null(input,length,pos);
 		pos++;
-		next_c=nl_str_char_or_null(input_string,pos);
+		next_c=nl_buf_char_or_null(input,length,pos);
 		
 //		if(next_c=='\n'){
-//			line_number++;
+//			nl_vm_cur->line_number++;
 //		}
 		
 //		printf("reading multi-line comment, c=%c, next_c=%c\n",c,next_c);
 		while(!((c=='*') && (next_c=='/'))){
 			c=next_c;
-			next_c=nl_str_char_or_null(input_string,pos+1);
+			next_c=nl_buf_char_or_null(input,length,pos+1);
 			if((c=='\0') || (next_c=='\0')){
 //				printf("hit a null byte\n");
 				break;
@@ -967,20 +1048,21 @@ nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
 			pos++;
 			
 			if(next_c=='\n'){
-				line_number++;
+				nl_vm_cur->line_number++;
 			}
 		}
 		//if we didn't hit the end of the string, skip past the / character that terminated the comment
-		if((pos+1)<input_string->d.array.size){
+		if((pos+1)<length){
 			pos++;
 		}
-		ret=nl_str_read_exp(input_string,&pos);
+		ret=nl_buf_read_exp(input,length,&pos);
 	//if it starts with a $ read an evaluation (a symbol to be looked up)
 	}else if(c=='$'){
 		//read an evaluation
 		pos++;
 		ret=nl_val_malloc(EVALUATION);
-		nl_val *symbol=nl_str_read_symbol(input_string,&pos);
+		nl_line_set(ret);
+		nl_val *symbol=nl_buf_read_symbol(input,length,&pos);
 		
 		if(symbol->t==SYMBOL){
 			ret->d.eval.sym=symbol;
@@ -996,17 +1078,43 @@ nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
 		}
 	//if it starts with anything not already handled read a symbol
 	}else{
-		ret=nl_str_read_symbol(input_string,&pos);
+		ret=nl_buf_read_symbol(input,length,&pos);
 	}
 	
 	//skip past trailing whitespace just for good measure
 	//(this is mostly for tracking line number consistently across multiple read_exp() calls, which may or may not contain trailing newlines)
-	nl_str_skip_whitespace(input_string,&pos);
+	nl_buf_skip_whitespace(input,length,&pos);
 	
 	(*persistent_pos)=pos;
 	return ret;
 }
 
+//read an expression from an existing neulang string
+//takes an input string, a position to start at (0 for whole string) and returns the new expression
+//start_pos is set to the end of the first expression read when a full expression is found
+nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
+	//first ensure the string is valid
+	if((input_string->t!=ARRAY)){
+		ERR_EXIT(input_string,"null or incorrect type given to str_read_exp",TRUE);
+		return nl_null;
+	}
+	
+	unsigned int n;
+	for(n=0;n<input_string->d.array.size;n++){
+		//TODO: remove this null check? as a nl_val pointer it should never be NULL, only nl_null (which has its own type)
+		if((nl_array_entry(input_string,n)==NULL) || (nl_array_entry(input_string,n)->t!=BYTE)){
+			ERR_EXIT(nl_array_entry(input_string,n),"invalid string entry (null or non-byte) given to str_read_exp",TRUE);
+			return nl_null;
+		}
+	}
+	
+	//flatten the string into a C buffer and parse from that
+	char *input=c_str_from_nl_str(input_string);
+	nl_val *ret=nl_buf_read_exp(input,input_string->d.array.size,persistent_pos);
+	free(input);
+	return ret;
+}
+
 //END STRING<->EXP I/O SUBROUTINES  -------------------------------------------------------------------------------
 
 
@@ -1014,6 +1122,8 @@ nl_val *nl_str_read_exp(nl_val *input_string, unsigned int *persistent_pos){
 
 //emulate getch() behavior on *nix /without/ ncurses
 int nix_getch(){
+	nl_par_impure();
+	
 	struct termios old_t;
 	struct termios new_t;
 	int ch;
@@ -1023,7 +1133,8 @@ int nix_getch(){
 	new_t.c_lflag &= ~(ICANON|ECHO);
 	tcsetattr(STDIN_FILENO,TCSANOW,&new_t);
 	
-	ch=getchar();
+	//anything already buffered by the stdin reader comes first
+	ch=nl_reader_getc(nl_reader_stdin());
 	
 	tcsetattr(STDIN_FILENO,TCSANOW,&old_t);
 	return ch;
@@ -1080,7 +1191,9 @@ int nl_val_cmp(const nl_val *v_a, const nl_val *v_b){
 	
 	//check type equality
 	if((v_a->t)!=(v_b->t)){
-		fprintf(stderr,"Err [line %u]: comparison between different types is nonsensical, assuming a<b...",line_number);
+		nl_par_impure();
+		fflush(stdout);
+		fprintf(stderr,"Err [line %u]: comparison between different types is nonsensical, assuming a<b...",nl_vm_cur->line_number);
 		fprintf(stderr,"(offending values were a=");
 		nl_out(stderr,v_a);
 		fprintf(stderr," (of type %s) and b=",nl_type_name(v_a->t));
@@ -1144,13 +1257,25 @@ int nl_val_cmp(const nl_val *v_a, const nl_val *v_b){
 			{
 				//look through the array
 				int n;
-				for(n=0;(n<v_a->d.array.size) && (n<v_b->d.array.size);n++){
-//					int element_cmp=nl_val_cmp(&(v_a->d.array.v[n]),&(v_b->d.array.v[n]));
-					int element_cmp=nl_val_cmp(v_a->d.array.v[n],v_b->d.array.v[n]);
-					
-					//if we find an unequal element stop and return the comparison result for that element
-					if(element_cmp!=0){
-						return element_cmp;
+				
+				//packed arrays can be compared directly (bytes compare as signed chars, same as BYTE values)
+				if((v_a->flags & NL_VAL_PACKED) && (v_b->flags & NL_VAL_PACKED)){
+					const char *a_bytes=nl_array_bytes(v_a);
+					const char *b_bytes=nl_array_bytes(v_b);
+					for(n=0;(n<v_a->d.array.size) && (n<v_b->d.array.size);n++){
+						if(a_bytes[n]!=b_bytes[n]){
+							return (a_bytes[n]<b_bytes[n])?-1:1;
+						}
+					}
+				}else{
+					for(n=0;(n<v_a->d.array.size) && (n<v_b->d.array.size);n++){
+//						int element_cmp=nl_val_cmp(&(v_a->d.array.v[n]),&(v_b->d.array.v[n]));
+						int element_cmp=nl_val_cmp(nl_array_entry(v_a,n),nl_array_entry(v_b,n));
+						
+						//if we find an unequal element stop and return the comparison result for that element
+						if(element_cmp!=0){
+							return element_cmp;
+						}
 					}
 				}
 				
@@ -1173,6 +1298,16 @@ int nl_val_cmp(const nl_val *v_a, const nl_val *v_b){
 				return 1;
 			}
 			break;
+		//handles are equal iff they are the same open file (pointer-equal), and futures and channels iff they're the same one
+		case HANDLE:
+		case FUTURE:
+		case CHANNEL:
+			if(v_a==v_b){
+				return 0;
+			}else{
+				return 1;
+			}
+			break;
 		//subroutines are equal iff they are pointer-equal
 		case SUB:
 			//remember 0 means equal here, just like C's strcmp
@@ -1238,15 +1373,7 @@ void nl_str_push_cstr(nl_val *nl_str, const char *cstr){
 		return;
 	}
 	
-	int n=0;
-	while(cstr[n]!='\0'){
-		nl_val *char_to_push=nl_val_malloc(BYTE);
-		char_to_push->d.byte.v=cstr[n];
-		
-		nl_array_push(nl_str,char_to_push);
-		
-		n++;
-	}
+	nl_array_push_bytes(nl_str,cstr,strlen(cstr));
 }
 
 //push a neulang string onto another neulang string (only the first one is changed, the second is not, and data is copied in element by element)
@@ -1261,9 +1388,15 @@ void nl_str_push_nlstr(nl_val *nl_str, const nl_val *str_to_push){
 		return;
 	}
 	
+	//packed strings are copied in as a block
+	if(str_to_push->flags & NL_VAL_PACKED){
+		nl_array_push_bytes(nl_str,nl_array_bytes(str_to_push),str_to_push->d.array.size);
+		return;
+	}
+	
 	int n;
 	for(n=0;n<(str_to_push->d.array.size);n++){
-		nl_val *char_to_push=nl_val_cp(str_to_push->d.array.v[n]);
+		nl_val *char_to_push=nl_val_cp(nl_array_entry(str_to_push,n));
 		
 		nl_array_push(nl_str,char_to_push);
 	}
@@ -1287,7 +1420,7 @@ nl_val *nl_num_to_byte(nl_val *num_list){
 		}
 		
 		if(arg_count>1){
-//			fprintf(stderr,"Warn [line %u]: too many arguments given to int_to_byte, ignoring all but the first...\n",line_number);
+//			fprintf(stderr,"Warn [line %u]: too many arguments given to int_to_byte, ignoring all but the first...\n",nl_vm_cur->line_number);
 			ERR(num_list,"too many arguments given to int_to_byte, ignoring all but the first...",TRUE);
 		}
 	}else{
@@ -1312,7 +1445,7 @@ nl_val *nl_byte_to_num(nl_val *byte_list){
 		}
 		
 		if(arg_count>1){
-//			fprintf(stderr,"Warn [line %u]: too many arguments given to int_to_byte, ignoring all but the first...\n",line_number);
+//			fprintf(stderr,"Warn [line %u]: too many arguments given to int_to_byte, ignoring all but the first...\n",nl_vm_cur->line_number);
 			ERR(byte_list,"too many arguments given to byte_to_num, ignoring all but the first...",TRUE);
 		}
 	}else{
@@ -1360,7 +1493,7 @@ nl_val *nl_array_to_list(nl_val *arg_list){
 		//go through each array element and add a copy to the list to return
 		unsigned int n;
 		for(n=0;n<current_ar->d.array.size;n++){
-			current_cell->d.pair.f=nl_val_cp(current_ar->d.array.v[n]);
+			current_cell->d.pair.f=nl_val_cp(nl_array_entry(current_ar,n));
 			//if this isn't the last element then make a container for the next element
 			if((n+1)<current_ar->d.array.size){
 				current_cell->d.pair.r=nl_val_malloc(PAIR);
@@ -1491,8 +1624,7 @@ nl_val *nl_val_to_memstr(const nl_val *exp){
 				sprintf(buffer,"%i",exp->d.byte.v);
 				nl_str_push_cstr(ret,buffer);
 			}else{
-				sprintf(buffer,"%c",exp->d.byte.v);
-				nl_str_push_cstr(ret,buffer);
+				nl_array_push_bytes(ret,&(exp->d.byte.v),1);
 			}
 			break;
 		case NUM:
@@ -1539,7 +1671,7 @@ nl_val *nl_val_to_memstr(const nl_val *exp){
 				unsigned int n;
 				for(n=0;n<(exp->d.array.size);n++){
 //					tmp_str=nl_val_to_memstr(&(exp->d.array.v[n]));
-					tmp_str=nl_val_to_memstr(exp->d.array.v[n]);
+					tmp_str=nl_val_to_memstr(nl_array_entry(exp,n));
 					nl_str_push_nlstr(ret,tmp_str);
 					nl_val_free(tmp_str);
 					
@@ -1551,10 +1683,19 @@ nl_val *nl_val_to_memstr(const nl_val *exp){
 		case PRI:
 			nl_str_push_cstr(ret,"<primitive procedure>");
 			break;
+		case HANDLE:
+			nl_str_push_cstr(ret,(exp->d.handle->fd<0)?"<closed file handle>":"<file handle>");
+			break;
+		case FUTURE:
+			nl_str_push_cstr(ret,"<future>");
+			break;
+		case CHANNEL:
+			nl_str_push_cstr(ret,"<channel>");
+			break;
 		case SUB:
 			nl_str_push_cstr(ret,"<closure/subroutine with args (");
 			{
-				nl_val *sub_args=exp->d.sub.args;
+				nl_val *sub_args=exp->d.sub->args;
 				while(sub_args!=nl_null){
 					tmp_str=nl_val_to_memstr(sub_args->d.pair.f);
 					nl_str_push_nlstr(ret,tmp_str);
@@ -1584,7 +1725,7 @@ nl_val *nl_val_to_memstr(const nl_val *exp){
 				unsigned int n;
 				for(n=0;n<(exp->d.sym.name->d.array.size);n++){
 //					tmp_str=nl_val_to_memstr(&(exp->d.sym.name->d.array.v[n]));
-					tmp_str=nl_val_to_memstr(exp->d.sym.name->d.array.v[n]);
+					tmp_str=nl_val_to_memstr(nl_array_entry(exp->d.sym.name,n));
 					nl_str_push_nlstr(ret,tmp_str);
 					nl_val_free(tmp_str);
 				}
@@ -1597,7 +1738,7 @@ nl_val *nl_val_to_memstr(const nl_val *exp){
 				unsigned int n;
 				for(n=0;n<(exp->d.eval.sym->d.sym.name->d.array.size);n++){
 //					tmp_str=nl_val_to_memstr(&(exp->d.eval.sym->d.sym.name->d.array.v[n]));
-					tmp_str=nl_val_to_memstr(exp->d.eval.sym->d.sym.name->d.array.v[n]);
+					tmp_str=nl_val_to_memstr(nl_array_entry(exp->d.eval.sym->d.sym.name,n));
 					nl_str_push_nlstr(ret,tmp_str);
 					nl_val_free(tmp_str);
 				}
@@ -1709,7 +1850,9 @@ nl_val *nl_str_to_num(nl_val *str_list){
 	
 	//read a number from a string
 	unsigned int persistent_pos=0;
-	ret=nl_str_read_num(str_list->d.pair.f, &persistent_pos);
+	char *input=c_str_from_nl_str(str_list->d.pair.f);
+	ret=nl_buf_read_num(input,str_list->d.pair.f->d.array.size,&persistent_pos);
+	free(input);
 	
 	return ret;
 }
@@ -1720,6 +1863,176 @@ nl_val *nl_str_to_num(nl_val *str_list){
 //TODO: write all array library functions
 //TODO: write the whole standard library
 
+//the BYTE values nl_array_entry hands out for packed arrays; one per possible byte value, these are never free'd
+nl_val nl_packed_byte_vals[256];
+char nl_packed_byte_vals_ready=FALSE;
+
+//set up the shared BYTE values for packed arrays; this happens when the first interpreter is allocated, before there are other threads
+void nl_packed_byte_vals_init(){
+	if(nl_packed_byte_vals_ready){
+		return;
+	}
+	int n;
+	for(n=0;n<256;n++){
+		nl_packed_byte_vals[n].t=BYTE;
+		//these are frozen, since every interpreter (and isolate) uses them at once
+		nl_packed_byte_vals[n].flags=NL_VAL_FROZEN;
+		nl_packed_byte_vals[n].line_slot=0;
+		//a huge reference count so an accidental free can't actually free this
+		nl_packed_byte_vals[n].ref=(1<<30);
+		nl_packed_byte_vals[n].d.byte.v=(char)(n);
+	}
+	nl_packed_byte_vals_ready=TRUE;
+}
+
+//allocate raw storage for a packed array, with room for at least len bytes
+nl_bytes *nl_bytes_malloc(size_t len){
+	if(len<16){
+		len=16;
+	}
+	
+	nl_bytes *b=(nl_bytes*)(malloc(sizeof(nl_bytes)));
+	if(b!=NULL){
+		b->data=(char*)(malloc(len));
+	}
+	if((b==NULL) || (b->data==NULL)){
+		ERR_EXIT(nl_null,"could not malloc array storage (out of memory?)",FALSE);
+		exit(1);
+	}
+	
+	b->ref=1;
+	b->len=len;
+	b->mapped=FALSE;
+	b->shared=FALSE;
+	NL_STATS_MEM(nl_vm_cur,packed_bytes,len,1);
+	return b;
+}
+
+//release a reference to raw packed storage, freeing (or unmapping) it once nothing uses it
+void nl_bytes_release(nl_bytes *b){
+	if(b==NULL){
+		return;
+	}
+	
+	if(NL_BYTES_REF_DEC(b)>0){
+		return;
+	}
+	
+	if(b->mapped){
+		nl_map_remove(b->data);
+		munmap(b->data,b->len);
+	}else{
+		free(b->data);
+		NL_STATS_MEM(nl_vm_cur,packed_bytes,-((long long)(b->len)),1);
+	}
+	free(b);
+}
+
+//make a packed array that's a view of the given shared storage (this takes a reference to the storage)
+nl_val *nl_array_from_bytes(nl_bytes *b, unsigned int offset, unsigned int size){
+	nl_val *ret=nl_val_malloc(ARRAY);
+	ret->flags|=NL_VAL_PACKED;
+	NL_BYTES_REF_INC(b);
+	ret->d.array.bytes=b;
+	ret->d.array.offset=offset;
+	ret->d.array.size=size;
+	return ret;
+}
+
+//returns a pointer to the raw bytes of a packed array
+char *nl_array_bytes(const nl_val *a){
+	return (a->d.array.bytes->data)+(a->d.array.offset);
+}
+
+//returns the element at the given index of an array (packed or not) without copying it
+//NOTE: for packed arrays this is a shared constant BYTE; never free or modify what this returns (copy it if you need to keep it)
+nl_val *nl_array_entry(const nl_val *a, unsigned int idx){
+	if(a->flags & NL_VAL_PACKED){
+		return &(nl_packed_byte_vals[(unsigned char)(nl_array_bytes(a)[idx])]);
+	}
+	return a->d.array.v[idx];
+}
+
+//convert a packed array back into a normal array of BYTE values (the shared storage is left unchanged for other users)
+void nl_array_unpack(nl_val *a){
+	if(!(a->flags & NL_VAL_PACKED)){
+		return;
+	}
+	
+	nl_bytes *b=a->d.array.bytes;
+	char *data=nl_array_bytes(a);
+	unsigned int size=a->d.array.size;
+	
+	nl_val **v=NULL;
+	unsigned int stored_size=0;
+	if(size>0){
+		//(stored_size is one more than size, consistent with nl_array_push)
+		stored_size=size+1;
+		v=(nl_val**)(malloc(stored_size*(sizeof(nl_val*))));
+		unsigned int n;
+		for(n=0;n<size;n++){
+			v[n]=nl_val_malloc(BYTE);
+			v[n]->d.byte.v=data[n];
+		}
+	}
+	
+	a->flags&=(~NL_VAL_PACKED);
+	a->d.array.v=v;
+	a->d.array.stored_size=stored_size;
+	NL_STATS_MEM(nl_vm_cur,array_slots,stored_size,sizeof(nl_val*));
+	NL_STATS_MEM(nl_vm_cur,array_slots_used,size,0);
+	nl_bytes_release(b);
+}
+
+//push raw bytes onto the end of an array (packing the array if it's empty)
+void nl_array_push_bytes(nl_val *a, const char *buf, unsigned int length){
+	//this operation is undefined on null and non-array values
+	if((a->t!=ARRAY)){
+		return;
+	}
+	
+	//an array that already has non-packed data just gets BYTE values
+	if((!(a->flags & NL_VAL_PACKED)) && (a->d.array.size>0)){
+		unsigned int n;
+		for(n=0;n<length;n++){
+			nl_val *byte=nl_val_malloc(BYTE);
+			byte->d.byte.v=buf[n];
+			nl_array_push(a,byte);
+		}
+		return;
+	}
+	
+	//an empty array becomes a packed array
+	if(!(a->flags & NL_VAL_PACKED)){
+		if(a->d.array.v!=NULL){
+			free(a->d.array.v);
+			NL_STATS_MEM(nl_vm_cur,array_slots,-((long long)(a->d.array.stored_size)),sizeof(nl_val*));
+		}
+		a->flags|=NL_VAL_PACKED;
+		a->d.array.bytes=NULL;
+		a->d.array.offset=0;
+		a->d.array.size=0;
+	}
+	
+	nl_bytes *b=a->d.array.bytes;
+	unsigned int size=a->d.array.size;
+	unsigned int new_size=size+length;
+	
+	//if this array doesn't have its own (writable) storage with room at the end, copy it first (copy-on-write)
+	if((b==NULL) || (NL_REF_GET(b->ref)>1) || (b->mapped) || (((a->d.array.offset)+new_size)>(b->len))){
+		nl_bytes *new_b=nl_bytes_malloc(((3*(size_t)(new_size))/2)+1);
+		if(size>0){
+			memcpy(new_b->data,nl_array_bytes(a),size);
+		}
+		nl_bytes_release(b);
+		a->d.array.bytes=new_b;
+		a->d.array.offset=0;
+	}
+	
+	memcpy(nl_array_bytes(a)+size,buf,length);
+	a->d.array.size=new_size;
+}
+
 //push a value onto the end of an array
 void nl_array_push(nl_val *a, nl_val *v){
 	//this operation is undefined on null and non-array values
@@ -1727,6 +2040,16 @@ void nl_array_push(nl_val *a, nl_val *v){
 		return;
 	}
 	
+	//bytes pushed onto a packed (or empty) array are stored packed
+	if((v->t==BYTE) && ((a->flags & NL_VAL_PACKED) || (a->d.array.size==0))){
+		nl_array_push_bytes(a,&(v->d.byte.v),1);
+		nl_val_free(v);
+		return;
+	}
+	
+	//anything else in a packed array means it can't be packed anymore
+	nl_array_unpack(a);
+	
 	unsigned int new_stored_size=a->d.array.stored_size;
 	unsigned int new_size=(a->d.array.size)+1;
 	
@@ -1759,11 +2082,13 @@ void nl_array_push(nl_val *a, nl_val *v){
 		a->d.array.v=new_array_v;
 		
 		//update size parameters
+		NL_STATS_MEM(nl_vm_cur,array_slots,((long long)(new_stored_size))-(a->d.array.stored_size),sizeof(nl_val*));
 		a->d.array.stored_size=new_stored_size;
 	}
 	
 	//update size
 	a->d.array.size=new_size;
+	NL_STATS_MEM(nl_vm_cur,array_slots_used,1,0);
 	
 	//copy in the new data
 //	memcpy(&(a->d.array.v[(new_size-1)]),v,sizeof(nl_val));
@@ -1804,7 +2129,7 @@ nl_val *nl_array_idx(nl_val *args){
 		return nl_null;
 	}
 //	return nl_val_cp(&(a->d.array.v[index]));
-	return nl_val_cp(a->d.array.v[index]);
+	return nl_val_cp(nl_array_entry(a,index));
 }
 
 //return the size of the first argument
@@ -1817,7 +2142,7 @@ nl_val *nl_array_size(nl_val *array_list){
 		acc->d.num.n=array_list->d.pair.f->d.array.size;
 		
 		if(array_list->d.pair.r!=nl_null){
-//			fprintf(stderr,"Warn [line %u]: too many arguments given to array size operation, only the first will be used...\n",line_number);
+//			fprintf(stderr,"Warn [line %u]: too many arguments given to array size operation, only the first will be used...\n",nl_vm_cur->line_number);
 			ERR(array_list,"too many arguments given to array size operation, only the first will be used...",TRUE);
 		}
 	}else{
@@ -1842,10 +2167,14 @@ nl_val *nl_array_cat(nl_val *array_list){
 		nl_val *current_array=array_list->d.pair.f;
 		
 		//push copies of each element into the larger accumulator
-		int n;
-		for(n=0;n<current_array->d.array.size;n++){
-//			nl_array_push(acc,nl_val_cp(&(current_array->d.array.v[n])));
-			nl_array_push(acc,nl_val_cp(current_array->d.array.v[n]));
+		if(current_array->flags & NL_VAL_PACKED){
+			nl_array_push_bytes(acc,nl_array_bytes(current_array),current_array->d.array.size);
+		}else{
+			int n;
+			for(n=0;n<current_array->d.array.size;n++){
+//				nl_array_push(acc,nl_val_cp(&(current_array->d.array.v[n])));
+				nl_array_push(acc,nl_val_cp(nl_array_entry(current_array,n)));
+			}
 		}
 		
 		array_list=array_list->d.pair.r;
@@ -1893,10 +2222,10 @@ nl_val *nl_array_replace(nl_val *arg_list){
 	int n;
 	for(n=0;n<(ar->d.array.size);n++){
 		if(n==(idx->d.num.n)){
-			new_val->ref++;
+			NL_VAL_REF_INC(new_val);
 			nl_array_push(ret,new_val);
 		}else{
-			nl_array_push(ret,nl_val_cp(ar->d.array.v[n]));
+			nl_array_push(ret,nl_val_cp(nl_array_entry(ar,n)));
 		}
 	}
 	
@@ -1963,18 +2292,59 @@ nl_val *nl_array_omit(nl_val *arg_list){
 		if(n==(idx->d.num.n)){
 			//skip this one
 		}else{
-			nl_array_push(ret,nl_val_cp(ar->d.array.v[n]));
+			nl_array_push(ret,nl_val_cp(nl_array_entry(ar,n)));
 		}
 	}
 	
 	return ret;
 }
 
-//TODO: write array find
 //returns the index of the first occurance of the given subarray within the given array
 //returns -1 for not found
 nl_val *nl_array_find(nl_val *arg_list){
-	nl_val *ret=nl_null;
+	if(nl_c_list_size(arg_list)!=2){
+		ERR_EXIT(arg_list,"incorrect number of arguments given to array find operation (takes array and subarray to find)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *haystack=arg_list->d.pair.f;
+	nl_val *needle=arg_list->d.pair.r->d.pair.f;
+	if((haystack->t!=ARRAY) || (needle->t!=ARRAY)){
+		ERR_EXIT(arg_list,"incorrect type given to array find operation",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_val_malloc(NUM);
+	ret->d.num.n=-1;
+	ret->d.num.d=1;
+	
+	//packed arrays can just use memmem
+	if((haystack->flags & NL_VAL_PACKED) && (needle->flags & NL_VAL_PACKED)){
+		const char *found=memmem(nl_array_bytes(haystack),haystack->d.array.size,nl_array_bytes(needle),needle->d.array.size);
+		if(found!=NULL){
+			ret->d.num.n=(found-nl_array_bytes(haystack));
+		}
+		return ret;
+	}
+	
+	//otherwise compare element by element
+	unsigned int n;
+	for(n=0;((n+(needle->d.array.size))<=(haystack->d.array.size));n++){
+		unsigned int n2;
+		for(n2=0;n2<(needle->d.array.size);n2++){
+			nl_val *h=nl_array_entry(haystack,n+n2);
+			nl_val *e=nl_array_entry(needle,n2);
+			//values of different types are never equal
+			if((h->t!=e->t) || (nl_val_cmp(h,e)!=0)){
+				break;
+			}
+		}
+		if(n2==(needle->d.array.size)){
+			ret->d.num.n=n;
+			break;
+		}
+	}
+	
 	return ret;
 }
 
@@ -2033,7 +2403,7 @@ nl_val *nl_array_insert(nl_val *arg_list){
 		
 		//if we're not past the end, then append a copy of the initial element here
 		if(idx<base_array->d.array.size){
-			nl_array_push(ret,nl_val_cp(base_array->d.array.v[idx]));
+			nl_array_push(ret,nl_val_cp(nl_array_entry(base_array,idx)));
 		}
 	}
 	
@@ -2064,13 +2434,27 @@ nl_val *nl_array_chop(nl_val *arg_list){
 	//okay, now the fun part
 	//allocate a new array to store the result
 	nl_val *ret=nl_val_malloc(ARRAY);
-	unsigned int ret_idx=0;
-	//create one entry on the array no matter what (if needle isn't found this will be haystack, if needle at pos 0 this will be empty)
-	nl_array_push(ret,nl_val_malloc(ARRAY));
 	
 	nl_val *haystack=arg_list->d.pair.f;
 	nl_val *needle=arg_list->d.pair.r->d.pair.f;
 	
+	//packed arrays can be searched with memmem, and each piece is a view of the haystack (no copy)
+	if((haystack->flags & NL_VAL_PACKED) && (needle->flags & NL_VAL_PACKED) && (needle->d.array.size>0)){
+		const char *start=nl_array_bytes(haystack);
+		const char *end=start+(haystack->d.array.size);
+		const char *found;
+		while((found=memmem(start,end-start,nl_array_bytes(needle),needle->d.array.size))!=NULL){
+			nl_array_push(ret,nl_array_from_bytes(haystack->d.array.bytes,(haystack->d.array.offset)+(start-nl_array_bytes(haystack)),found-start));
+			start=found+(needle->d.array.size);
+		}
+		nl_array_push(ret,nl_array_from_bytes(haystack->d.array.bytes,(haystack->d.array.offset)+(start-nl_array_bytes(haystack)),end-start));
+		return ret;
+	}
+	
+	unsigned int ret_idx=0;
+	//create one entry on the array no matter what (if needle isn't found this will be haystack, if needle at pos 0 this will be empty)
+	nl_array_push(ret,nl_val_malloc(ARRAY));
+	
 	//look through the haystack
 	int n;
 	for(n=0;n<(haystack->d.array.size);n++){
@@ -2084,20 +2468,20 @@ nl_val *nl_array_chop(nl_val *arg_list){
 				break;
 			//if they're both not null then check values
 //			}else if((haystack->d.array.v[n+n2]!=NULL) && (needle->d.array.v[n2]!=NULL)){
-			}else if((haystack->d.array.v[n+n2]!=nl_null) && (needle->d.array.v[n2]!=nl_null)){
+			}else if((nl_array_entry(haystack,n+n2)!=nl_null) && (nl_array_entry(needle,n2)!=nl_null)){
 				//if the values are of different types they cannot be equal
-				if((haystack->d.array.v[n+n2]->t)!=(needle->d.array.v[n2]->t)){
+				if((nl_array_entry(haystack,n+n2)->t)!=(nl_array_entry(needle,n2)->t)){
 					break;
 				}
 				
 				//if they values aren't equal they aren't equal (tautologically :P)
-				if(nl_val_cmp(haystack->d.array.v[n+n2],needle->d.array.v[n2])!=0){
+				if(nl_val_cmp(nl_array_entry(haystack,n+n2),nl_array_entry(needle,n2))!=0){
 					break;
 				}
 				
 			//if one, but not both, entries are null, then we DIDN'T find the needle
 //			}else if((haystack->d.array.v[n+n2]==NULL) || (needle->d.array.v[n2]==NULL)){
-			}else if((haystack->d.array.v[n+n2]==nl_null) || (needle->d.array.v[n2]==nl_null)){
+			}else if((nl_array_entry(haystack,n+n2)==nl_null) || (nl_array_entry(needle,n2)==nl_null)){
 				break;
 			//two nulls are equal
 			}
@@ -2119,7 +2503,7 @@ nl_val *nl_array_chop(nl_val *arg_list){
 		
 		//if we got here and didn't continue, then we didn't find the needle
 		//therefore shove the haystack element onto the return array
-		nl_array_push(ret->d.array.v[ret_idx],nl_val_cp(haystack->d.array.v[n]));
+		nl_array_push(nl_array_entry(ret,ret_idx),nl_val_cp(nl_array_entry(haystack,n)));
 	}
 	
 	return ret;
@@ -2165,11 +2549,24 @@ nl_val *nl_array_subarray(nl_val *arg_list){
 		length_int=llabs(length_int);
 	}
 	
+	//a subarray of a packed array is just a view of the same bytes (no copy)
+	if(full_array->flags & NL_VAL_PACKED){
+		unsigned long int start=(unsigned long int)(start_idx_int);
+		unsigned long int end=start_idx_int+length_int;
+		if(end>full_array->d.array.size){
+			end=full_array->d.array.size;
+		}
+		if(start>=end){
+			return nl_val_malloc(ARRAY);
+		}
+		return nl_array_from_bytes(full_array->d.array.bytes,(full_array->d.array.offset)+start,end-start);
+	}
+	
 	ret=nl_val_malloc(ARRAY);
 	
 	unsigned int n;
 	for(n=(unsigned int)(start_idx_int);(n<full_array->d.array.size) && (n<(start_idx_int+length_int));n++){
-		nl_array_push(ret,nl_val_cp(full_array->d.array.v[n]));
+		nl_array_push(ret,nl_val_cp(nl_array_entry(full_array,n)));
 	}
 	
 	return ret;
@@ -2216,11 +2613,24 @@ nl_val *nl_array_range(nl_val *arg_list){
 		end_idx_int=llabs(tmp);
 	}
 	
+	//a range of a packed array is just a view of the same bytes (no copy)
+	if(full_array->flags & NL_VAL_PACKED){
+		unsigned long int start=(unsigned long int)(start_idx_int);
+		unsigned long int end=end_idx_int+1;
+		if(end>full_array->d.array.size){
+			end=full_array->d.array.size;
+		}
+		if(start>=end){
+			return nl_val_malloc(ARRAY);
+		}
+		return nl_array_from_bytes(full_array->d.array.bytes,(full_array->d.array.offset)+start,end-start);
+	}
+	
 	ret=nl_val_malloc(ARRAY);
 	
 	unsigned int n;
 	for(n=(unsigned int)(start_idx_int);(n<full_array->d.array.size) && (n<=(end_idx_int));n++){
-		nl_array_push(ret,nl_val_cp(full_array->d.array.v[n]));
+		nl_array_push(ret,nl_val_cp(nl_array_entry(full_array,n)));
 	}
 	
 	return ret;
@@ -2256,7 +2666,7 @@ nl_val *nl_array_map(nl_val *arg_list){
 	for(n=0;(n<full_array->d.array.size);n++){
 		//pass the value in the array as an argument to the mapping subroutine
 		nl_val *args=nl_val_malloc(PAIR);
-		args->d.pair.f=nl_val_cp(full_array->d.array.v[n]);
+		args->d.pair.f=nl_val_cp(nl_array_entry(full_array,n));
 		
 		//apply the mapping subroutine and store the result in the return array
 		nl_array_push(ret,nl_apply(map,args,NULL));
@@ -2268,31 +2678,172 @@ nl_val *nl_array_map(nl_val *arg_list){
 	return ret;
 }
 
-//output the given list of strings in sequence
-//returns NULL (a void function)
-nl_val *nl_outstr(nl_val *array_list){
-	while(array_list->t==PAIR){
-		nl_val *output_str=array_list->d.pair.f;
-		
-		//non-array types are ignored in non-strict mode
-		//but cause a hard error in strict mode
-		if(output_str->t!=ARRAY){
-			ERR_EXIT(output_str,"argument to outs is of non-array type",TRUE);
-		}else{
-			int n;
-			for(n=0;n<output_str->d.array.size;n++){
-//				nl_out(stdout,&(output_str->d.array.v[n]));
-				nl_out(stdout,output_str->d.array.v[n]);
-			}
-		}
-		
-		array_list=array_list->d.pair.r;
+//apply a combining subroutine to an accumulator and a value (both of which are used up), and return the result
+nl_val *nl_fold_step(nl_val *combiner, nl_val *acc, nl_val *v){
+	nl_val *args=nl_val_malloc(PAIR);
+	args->d.pair.f=acc;
+	args->d.pair.r=nl_val_malloc(PAIR);
+	args->d.pair.r->d.pair.f=v;
+	
+	nl_val *ret=nl_apply(combiner,args,NULL);
+	nl_val_free(args);
+	return ret;
+}
+
+//fold the elements of an array from start up to (but not including) end into an accumulator (which is used up), in order
+nl_val *nl_array_fold_range(nl_val *a, unsigned int start, unsigned int end, nl_val *acc, nl_val *combiner){
+	unsigned int n;
+	for(n=start;n<end;n++){
+		acc=nl_fold_step(combiner,acc,nl_val_cp(nl_array_entry(a,n)));
 	}
-	
-	return nl_null;
+	return acc;
 }
 
-//outputs the given value to stdout
+//fold the elements of an array from start on into a copy of acc with a built-in combiner (+, *, b|, b&), as a native loop
+//the result is exactly what applying the combiner to each element in turn would give
+//returns NULL if the combiner isn't one of those or the values aren't all of the type it takes (so the caller folds normally)
+nl_val *nl_array_fold_native(nl_val *a, unsigned int start, nl_val *acc, nl_val *combiner){
+	if(combiner->t!=PRI){
+		return NULL;
+	}
+	nl_val *(*function)(nl_val *arglist)=combiner->d.pri.function;
+	unsigned int size=a->d.array.size;
+	unsigned int n;
+	
+	//numbers (add and mul)
+	if((function==nl_add) || (function==nl_mul)){
+		if((acc->t!=NUM) || (a->flags & NL_VAL_PACKED)){
+			return NULL;
+		}
+		for(n=start;n<size;n++){
+			if(nl_array_entry(a,n)->t!=NUM){
+				return NULL;
+			}
+		}
+		
+		nl_val *ret=nl_val_cp(acc);
+		for(n=start;n<size;n++){
+			nl_val *current_num=nl_array_entry(a,n);
+			
+			//integers stay integers, so there's nothing to reduce
+			if((ret->d.num.d==1) && (current_num->d.num.d==1)){
+				if(function==nl_add){
+					ret->d.num.n+=current_num->d.num.n;
+				}else{
+					ret->d.num.n*=current_num->d.num.n;
+				}
+				continue;
+			}
+			
+			//otherwise this is the same arithmetic nl_add and nl_mul do
+			long long int numerator;
+			if(function==nl_add){
+				numerator=((ret->d.num.n)*(current_num->d.num.d))+((current_num->d.num.n)*(ret->d.num.d));
+			}else{
+				numerator=((ret->d.num.n)*(current_num->d.num.n));
+			}
+			long long int denominator=(ret->d.num.d)*(current_num->d.num.d);
+			ret->d.num.n=numerator;
+			ret->d.num.d=denominator;
+			nl_gcd_reduce(ret);
+		}
+		return ret;
+	}
+	
+	//bytes (bitwise or and and)
+	if((function==nl_byte_or) || (function==nl_byte_and)){
+		if(acc->t!=BYTE){
+			return NULL;
+		}
+		if(!(a->flags & NL_VAL_PACKED)){
+			for(n=start;n<size;n++){
+				if(nl_array_entry(a,n)->t!=BYTE){
+					return NULL;
+				}
+			}
+		}
+		
+		nl_val *ret=nl_val_cp(acc);
+		if(a->flags & NL_VAL_PACKED){
+			//packed bytes are right there in memory
+			const char *bytes=nl_array_bytes(a);
+			if(function==nl_byte_or){
+				for(n=start;n<size;n++){
+					ret->d.byte.v|=bytes[n];
+				}
+			}else{
+				for(n=start;n<size;n++){
+					ret->d.byte.v&=bytes[n];
+				}
+			}
+		}else{
+			for(n=start;n<size;n++){
+				if(function==nl_byte_or){
+					ret->d.byte.v|=nl_array_entry(a,n)->d.byte.v;
+				}else{
+					ret->d.byte.v&=nl_array_entry(a,n)->d.byte.v;
+				}
+			}
+		}
+		return ret;
+	}
+	return NULL;
+}
+
+//fold an array into one value, starting from the given initial value and applying (combiner accumulator element) for each element in order
+//built-in combiners (+, *, b|, b&) on arrays of numbers or bytes are done as native loops
+nl_val *nl_array_fold(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=3){
+		ERR_EXIT(arg_list,"wrong number of arguments given to array fold (takes exactly 3 arguments: array, initial-value, combining-sub)",TRUE);
+		return nl_null;
+	}
+	nl_val *full_array=arg_list->d.pair.f;
+	nl_val *init=arg_list->d.pair.r->d.pair.f;
+	nl_val *combiner=arg_list->d.pair.r->d.pair.r->d.pair.f;
+	if(full_array->t!=ARRAY){
+		ERR_EXIT(arg_list,"wrong argument type given to array fold (require array as first operand)",TRUE);
+		return nl_null;
+	}
+	if(!((combiner->t==SUB) || (combiner->t==PRI))){
+		ERR_EXIT(arg_list,"wrong argument type given to array fold (require subroutine or primitive function as third operand)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_array_fold_native(full_array,0,init,combiner);
+	if(ret!=NULL){
+		return ret;
+	}
+	return nl_array_fold_range(full_array,0,full_array->d.array.size,nl_val_cp(init),combiner);
+}
+
+//output the given list of strings in sequence
+//returns NULL (a void function)
+nl_val *nl_outstr(nl_val *array_list){
+	while(array_list->t==PAIR){
+		nl_val *output_str=array_list->d.pair.f;
+		
+		//non-array types are ignored in non-strict mode
+		//but cause a hard error in strict mode
+		if(output_str->t!=ARRAY){
+			ERR_EXIT(output_str,"argument to outs is of non-array type",TRUE);
+		//packed strings are written as a block rather than byte by byte
+		}else if(output_str->flags & NL_VAL_PACKED){
+			nl_out_bytes(stdout,nl_array_bytes(output_str),output_str->d.array.size);
+		}else{
+			int n;
+			for(n=0;n<output_str->d.array.size;n++){
+//				nl_out(stdout,&(output_str->d.array.v[n]));
+				nl_out(stdout,nl_array_entry(output_str,n));
+			}
+		}
+		
+		array_list=array_list->d.pair.r;
+	}
+	
+	return nl_null;
+}
+
+//outputs the given value to stdout
 //returns NULL (a void function)
 nl_val *nl_outexp(nl_val *v_list){
 	while(v_list->t==PAIR){
@@ -2302,10 +2853,29 @@ nl_val *nl_outexp(nl_val *v_list){
 	return nl_null;
 }
 
+//writes out anything still buffered for stdout and stderr, or for the given handles if any are given
+//returns NULL (a void function)
+nl_val *nl_flush(nl_val *arg_list){
+	if(arg_list->t!=PAIR){
+		fflush(stdout);
+		fflush(stderr);
+		return nl_null;
+	}
+	
+	while(arg_list->t==PAIR){
+		nl_handle *h=nl_handle_for_writing(arg_list->d.pair.f,"wrong type argument given to flush, expecting a handle");
+		if((h!=NULL) && (!nl_handle_flush(h))){
+			ERR_EXIT(arg_list->d.pair.f,"could not write to file",TRUE);
+		}
+		arg_list=arg_list->d.pair.r;
+	}
+	return nl_null;
+}
+
 //reads input from stdin and returns the resulting expression
 nl_val *nl_inexp(nl_val *arg_list){
 	//TODO: support other files (by means of arguments)!
-	return nl_read_exp(stdin);
+	return nl_read_exp(nl_reader_stdin());
 }
 
 //TODO: add an argument for line-editing here! and one for file to read from
@@ -2322,9 +2892,11 @@ nl_val *nl_inline(nl_val *arg_list){
 	
 	nl_val *ret=nl_val_malloc(ARRAY);
 	
-	int c=fgetc(stdin);
+	//NOTE: stdin is read through the shared reader so this doesn't lose anything the repl has buffered
+	nl_reader *r=nl_reader_stdin();
+	int c=nl_reader_getc(r);
 	while((c!='\n') && (c!='\r')){
-		if(feof(stdin)){
+		if(c==EOF){
 			break;
 		}
 		
@@ -2342,7 +2914,7 @@ nl_val *nl_inline(nl_val *arg_list){
 		
 		nl_array_push(ret,next_char);
 		
-		c=fgetc(stdin);
+		c=nl_reader_getc(r);
 	}
 	
 	nl_val_free(ledit_keyword);
@@ -2381,7 +2953,9 @@ nl_val *nl_c_list_idx(nl_val *list, nl_val *idx){
 	nl_val *ret=nl_null;
 	
 	if((idx->t!=NUM) || (idx->d.num.d!=1)){
-		fprintf(stderr,"Err [line %u]: nl_list_idx only accepts integer list indices, given index was ",line_number);
+		nl_par_impure();
+		fflush(stdout);
+		fprintf(stderr,"Err [line %u]: nl_list_idx only accepts integer list indices, given index was ",nl_vm_cur->line_number);
 		nl_out(stderr,idx);
 		fprintf(stderr,"\n");
 #ifdef _STRICT
@@ -2412,7 +2986,7 @@ nl_val *nl_list_size(nl_val *list_list){
 	
 	if(list_list->t==PAIR){
 		if(list_list->d.pair.r!=nl_null){
-//			fprintf(stderr,"Warn [line %u]: too many arguments given to list size operation, only the first will be used...\n",line_number);
+//			fprintf(stderr,"Warn [line %u]: too many arguments given to list size operation, only the first will be used...\n",nl_vm_cur->line_number);
 			ERR(list_list,"too many arguments given to list size operation, only the first will be used...",TRUE);
 		}
 		
@@ -2546,7 +3120,7 @@ nl_val *nl_struct_replace(nl_val *rqst_list){
 	
 	//return this so it can be used (remember we don't do side-effects, referential transparency and whatnot)
 	//note that what was passed in was a copy (from evaluating an evaluation type) so it's okay to modify it here and return it
-	current_struct->ref++;
+	NL_VAL_REF_INC(current_struct);
 	return current_struct;
 }
 
@@ -3117,6 +3691,107 @@ nl_val *nl_byte_and(nl_val *byte_list){
 
 //BEGIN C-NL-STDLIB-FILE SUBROUTINES  -----------------------------------------------------------------------------
 
+//every file file->ar has mapped (see nl_map_slot); nl_map_lock protects changes to these, but nl_map_sigbus reads them without it
+//(slots are never free'd, and a slot's address is set last and cleared first, so the handler never sees a half-made one)
+nl_map_slot nl_map_slots[NL_MAP_SLOTS];
+unsigned int nl_map_cnt=0;
+pthread_mutex_t nl_map_lock=PTHREAD_MUTEX_INITIALIZER;
+size_t nl_map_page_size=0;
+
+//remember a new memory map of a file (see nl_map_slot), setting up nl_map_sigbus the first time
+//returns FALSE if there's no slot free for it, in which case it shouldn't stay mapped
+char nl_map_add(char *addr, size_t len, unsigned long long dev, unsigned long long ino){
+	pthread_mutex_lock(&nl_map_lock);
+	if(nl_map_page_size==0){
+		nl_map_page_size=(size_t)(sysconf(_SC_PAGESIZE));
+		
+		struct sigaction action;
+		memset(&action,0,sizeof(action));
+		action.sa_sigaction=nl_map_sigbus;
+		action.sa_flags=SA_SIGINFO;
+		sigemptyset(&(action.sa_mask));
+		sigaction(SIGBUS,&action,NULL);
+	}
+	
+	unsigned int n;
+	for(n=0;n<NL_MAP_SLOTS;n++){
+		if(nl_map_slots[n].addr==NULL){
+			nl_map_slots[n].len=len;
+			nl_map_slots[n].dev=dev;
+			nl_map_slots[n].ino=ino;
+			__atomic_store_n(&(nl_map_slots[n].addr),addr,__ATOMIC_RELEASE);
+			nl_map_cnt++;
+			pthread_mutex_unlock(&nl_map_lock);
+			return TRUE;
+		}
+	}
+	pthread_mutex_unlock(&nl_map_lock);
+	return FALSE;
+}
+
+//forget a memory map that's about to be unmapped (one that was replaced by nl_map_detach is already forgotten)
+void nl_map_remove(char *addr){
+	pthread_mutex_lock(&nl_map_lock);
+	unsigned int n;
+	for(n=0;n<NL_MAP_SLOTS;n++){
+		if(nl_map_slots[n].addr==addr){
+			__atomic_store_n(&(nl_map_slots[n].addr),NULL,__ATOMIC_RELEASE);
+			nl_map_cnt--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&nl_map_lock);
+}
+
+//replace every memory map of the given file with a private copy of it, in place, before this program truncates the file
+//so arrays that were read from it keep what they had
+void nl_map_detach(unsigned long long dev, unsigned long long ino){
+	pthread_mutex_lock(&nl_map_lock);
+	unsigned int n;
+	for(n=0;(n<NL_MAP_SLOTS) && (nl_map_cnt>0);n++){
+		nl_map_slot *slot=&(nl_map_slots[n]);
+		if((slot->addr==NULL) || (slot->dev!=dev) || (slot->ino!=ino)){
+			continue;
+		}
+		
+		//the copy is moved over the map in one step, so other threads reading it at the same time see the same bytes throughout
+		char *copy=(char*)(mmap(NULL,slot->len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0));
+		if(copy==MAP_FAILED){
+			ERR_EXIT(nl_null,"could not copy a mapped file before truncating it (out of memory?)",FALSE);
+			exit(1);
+		}
+		memcpy(copy,slot->addr,slot->len);
+		mprotect(copy,slot->len,PROT_READ);
+		if(mremap(copy,slot->len,slot->len,MREMAP_MAYMOVE|MREMAP_FIXED,slot->addr)==MAP_FAILED){
+			ERR_EXIT(nl_null,"could not replace a mapped file with its copy before truncating it (out of memory?)",FALSE);
+			exit(1);
+		}
+		
+		//it isn't a map of the file anymore, though it's still unmapped like one when nothing uses it
+		__atomic_store_n(&(slot->addr),NULL,__ATOMIC_RELEASE);
+		nl_map_cnt--;
+	}
+	pthread_mutex_unlock(&nl_map_lock);
+}
+
+//SIGBUS handler for reads past the end of a mapped file that something else made shorter; those read as zeros instead of crashing
+void nl_map_sigbus(int sig, siginfo_t *info, void *context){
+	char *fault=(char*)(info->si_addr);
+	unsigned int n;
+	for(n=0;n<NL_MAP_SLOTS;n++){
+		char *addr=__atomic_load_n(&(nl_map_slots[n].addr),__ATOMIC_ACQUIRE);
+		if((addr!=NULL) && (fault>=addr) && (fault<(addr+nl_map_slots[n].len))){
+			//the page gets zeros in place of the file, and the read is retried when this returns
+			char *page=(char*)(((uintptr_t)(fault))&(~((uintptr_t)(nl_map_page_size-1))));
+			mmap(page,nl_map_page_size,PROT_READ,MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED,-1,0);
+			return;
+		}
+	}
+	
+	//anything else is a real crash, which happens as usual when the access is retried
+	signal(SIGBUS,SIG_DFL);
+}
+
 //reads the given file and returns its contents as a byte array (aka a string)
 //returns NULL if file wasn't found or couldn't be opened
 nl_val *nl_str_from_file(nl_val *fname_list){
@@ -3132,80 +3807,5925 @@ nl_val *nl_str_from_file(nl_val *fname_list){
 	
 	char *fname=c_str_from_nl_str(fname_list->d.pair.f);
 	
-	FILE *fp=fopen(fname,"r");
-	if(fp==NULL){
+	int fd=open(fname,O_RDONLY);
+	if(fd<0){
 		free(fname);
 		ERR_EXIT(fname_list->d.pair.f,"could not open file",TRUE);
 		return nl_null;
 	}
 	
+	//a directory can be opened, but not read
+	struct stat file_stat;
+	char have_stat=(fstat(fd,&file_stat)==0);
+	if(have_stat && S_ISDIR(file_stat.st_mode)){
+		close(fd);
+		free(fname);
+		ERR_EXIT(fname_list->d.pair.f,"could not read file (it's a directory)",TRUE);
+		return nl_null;
+	}
+	
 	nl_val *ret=nl_val_malloc(ARRAY);
 	
-	while(!feof(fp)){
-		char c=fgetc(fp);
-		if(feof(fp)){
-			break;
+	//regular files are memory mapped, so the array is just a (copy-on-write) view of the file and nothing gets read until it's used
+	//NOTE: a map of a file that gets shorter would crash whatever reads past its new end;
+	//file-open copies maps before it truncates a file (see nl_map_detach), and truncation by other programs is caught (see nl_map_sigbus)
+	if(have_stat && S_ISREG(file_stat.st_mode) && (file_stat.st_size>0)){
+		if(file_stat.st_size>UINT_MAX){
+			close(fd);
+			free(fname);
+			ERR_EXIT(fname_list->d.pair.f,"file is too large to be read as an array",TRUE);
+			return ret;
 		}
 		
-		nl_val *current_byte=nl_val_malloc(BYTE);
-		current_byte->d.byte.v=c;
-		nl_array_push(ret,current_byte);
+		void *addr=mmap(NULL,file_stat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if((addr!=MAP_FAILED) && (!nl_map_add((char*)(addr),file_stat.st_size,file_stat.st_dev,file_stat.st_ino))){
+			munmap(addr,file_stat.st_size);
+			addr=MAP_FAILED;
+		}
+		if(addr!=MAP_FAILED){
+			//most things scan files from start to end
+			madvise(addr,file_stat.st_size,MADV_SEQUENTIAL);
+			
+			nl_bytes *b=(nl_bytes*)(malloc(sizeof(nl_bytes)));
+			b->ref=1;
+			b->data=(char*)(addr);
+			b->len=file_stat.st_size;
+			b->mapped=TRUE;
+			b->shared=FALSE;
+			
+			nl_val_free(ret);
+			ret=nl_array_from_bytes(b,0,file_stat.st_size);
+			
+			//the array holds the reference now
+			nl_bytes_release(b);
+			
+			close(fd);
+			free(fname);
+			return ret;
+		}
+		
+		//files that couldn't be mapped are read straight into storage of the size they are now
+		nl_bytes *b=nl_bytes_malloc(file_stat.st_size);
+		size_t len=0;
+		ssize_t n;
+		while((len<b->len) && (((n=read(fd,(b->data)+len,(b->len)-len))>0) || ((n<0) && (errno==EINTR)))){
+			if(n>0){
+				len+=n;
+			}
+		}
+		nl_val_free(ret);
+		ret=nl_array_from_bytes(b,0,len);
+		nl_bytes_release(b);
+		
+		//if the file grew since it was stat'd the rest is read in chunks below
+		if(len<(size_t)(file_stat.st_size)){
+			close(fd);
+			free(fname);
+			return ret;
+		}
 	}
+	free(fname);
 	
-	fclose(fp);
+	//anything that can't be mapped (pipes, /proc files, etc.) gets read in chunks
+	char buf[NL_READ_CHUNK];
+	ssize_t n;
+	while(((n=read(fd,buf,sizeof(buf)))>0) || ((n<0) && (errno==EINTR))){
+		if(n>0){
+			nl_array_push_bytes(ret,buf,n);
+		}
+	}
+	if(n<0){
+		ERR_EXIT(fname_list->d.pair.f,"could not read file",TRUE);
+	}
 	
-	free(fname);
+	close(fd);
 	return ret;
 }
 
-//END C-NL-STDLIB-FILE SUBROUTINES  -------------------------------------------------------------------------------
-
-
-//assert that all conditions in the given list are true; if not, exit (if compiled _STRICT) or return false (not strict)
-nl_val *nl_assert(nl_val *cond_list){
+//write a string to a file, replacing it atomically (the data is written to a temporary file which is then renamed over the original)
+//the optional third argument is a sync mode ("fsync" or "fdatasync"); with "fsync" the rename is synced too
+//returns TRUE on success, FALSE on error
+nl_val *nl_str_to_file(nl_val *arg_list){
+	//this changes the file system, so it can't be done speculatively (and has to be found out before anything is created)
+	nl_par_impure();
+	
+	int argc=nl_c_list_size(arg_list);
+	if((argc<2) || (argc>3)){
+		ERR_EXIT(arg_list,"wrong number of arguments given to ar->file (takes a file name, a string, and optionally a sync mode)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *fname_arg=arg_list->d.pair.f;
+	nl_val *data=arg_list->d.pair.r->d.pair.f;
+	if((fname_arg->t!=ARRAY) || (data->t!=ARRAY)){
+		ERR_EXIT(arg_list,"wrong type argument given to ar->file, expecting byte arrays",TRUE);
+		return nl_null;
+	}
+	
+	int sync=NL_SYNC_NONE;
+	if(argc>2){
+		sync=nl_sync_mode(arg_list->d.pair.r->d.pair.r->d.pair.f,"invalid sync mode given to ar->file, expecting \"fsync\" or \"fdatasync\"");
+		if(sync<0){
+			return nl_null;
+		}
+	}
+	
 	nl_val *ret=nl_val_malloc(BYTE);
-	ret->d.byte.v=TRUE;
-	while(cond_list->t==PAIR){
-		if(!nl_is_true(cond_list->d.pair.f)){
-			ret->d.byte.v=FALSE;
-#ifdef _STRICT
-			nl_val_free(ret);
-			ERR_EXIT(cond_list,"ASSERT FAILED",TRUE);
-#endif
+	ret->d.byte.v=FALSE;
+	
+	//an existing file has to be writable, just as it would to be opened for writing,
+	//and it's replaced through any symbolic links to it (so a link is never replaced by a regular file)
+	char *fname=c_str_from_nl_str(fname_arg);
+	struct stat file_stat;
+	char exists=(stat(fname,&file_stat)==0);
+	if(exists){
+		if(faccessat(AT_FDCWD,fname,W_OK,AT_EACCESS)!=0){
+			free(fname);
+			ERR_EXIT(fname_arg,"could not open file for writing",TRUE);
+			return ret;
 		}
 		
-		cond_list=cond_list->d.pair.r;
+		char *real_name=realpath(fname,NULL);
+		if(real_name!=NULL){
+			free(fname);
+			fname=real_name;
+		}
 	}
-#ifdef _DEBUG
-	if(cond_list!=nl_null){
-		printf("line %i: assert succeeded\n",cond_list->line);
+	
+	//the temporary file goes in the same directory, since a rename is only atomic within one filesystem
+	char *tmp_name=(char*)(malloc(strlen(fname)+8));
+	sprintf(tmp_name,"%s.XXXXXX",fname);
+	int fd=mkstemp(tmp_name);
+	if(fd<0){
+		free(tmp_name);
+		free(fname);
+		ERR_EXIT(fname_arg,"could not create temporary file for ar->file",TRUE);
+		return ret;
+	}
+	
+	//temporary files are only readable by their owner; give this one the owner and permissions of the file it replaces (or the usual ones for a new file)
+	//NOTE: only root can give a file away, so otherwise a file that belonged to someone else (but was writable) ends up owned by whoever wrote it
+	if(exists){
+		if(fchown(fd,file_stat.st_uid,file_stat.st_gid)!=0){
+			//the group alone can still be kept if the writer is in it
+			fchown(fd,-1,file_stat.st_gid);
+		}
+		fchmod(fd,file_stat.st_mode&07777);
 	}else{
-		printf("line %i: assert succeeded\n",line_number);
+		mode_t mask=umask(0);
+		umask(mask);
+		fchmod(fd,0666&(~mask));
 	}
-#endif
+	
+	nl_val *handle=nl_handle_from_fd(fd,FALSE);
+	nl_handle *h=handle->d.handle;
+	h->wbuf=(char*)(malloc(NL_WRITE_BUFFER));
+	h->sync=sync;
+	
+	char written=(nl_handle_write(h,data) && nl_handle_flush(h));
+	nl_val_free(handle);
+	
+	if(!written){
+		unlink(tmp_name);
+		ERR_EXIT(fname_arg,"could not write file",TRUE);
+	}else if(rename(tmp_name,fname)!=0){
+		unlink(tmp_name);
+		ERR_EXIT(fname_arg,"could not replace file",TRUE);
+	}else{
+		//the rename itself is only durable once the directory is synced
+		if(sync==NL_SYNC_FULL){
+			char *slash=strrchr(fname,'/');
+			if(slash==fname){
+				slash[1]='\0';
+			}else if(slash!=NULL){
+				slash[0]='\0';
+			}
+			int dir_fd=open((slash!=NULL)?fname:".",O_RDONLY);
+			if(dir_fd>=0){
+				fsync(dir_fd);
+				close(dir_fd);
+			}
+		}
+		ret->d.byte.v=TRUE;
+	}
+	
+	free(tmp_name);
+	free(fname);
 	return ret;
 }
 
-//sleep a given number of seconds (if multiple arguments are given they are added)
-nl_val *nl_sleep(nl_val *time_list){
-	if(nl_c_list_size(time_list)==0){
-		ERR_EXIT(time_list,"too few arguments given to sleep operation",FALSE);
+//append a string to the end of a file, creating the file if it doesn't exist
+//the optional third argument is a sync mode ("fsync" or "fdatasync")
+//returns TRUE on success, FALSE on error
+nl_val *nl_str_append_file(nl_val *arg_list){
+	//this changes the file system, so it can't be done speculatively (and has to be found out before anything is created)
+	nl_par_impure();
+	
+	int argc=nl_c_list_size(arg_list);
+	if((argc<2) || (argc>3)){
+		ERR_EXIT(arg_list,"wrong number of arguments given to ar->file-append (takes a file name, a string, and optionally a sync mode)",TRUE);
 		return nl_null;
 	}
 	
-	while(time_list->t==PAIR){
-		if((time_list->d.pair.f->t!=NUM)){
-			ERR_EXIT(time_list,"non-number argument given to sleep operation",TRUE);
+	nl_val *fname_arg=arg_list->d.pair.f;
+	nl_val *data=arg_list->d.pair.r->d.pair.f;
+	if((fname_arg->t!=ARRAY) || (data->t!=ARRAY)){
+		ERR_EXIT(arg_list,"wrong type argument given to ar->file-append, expecting byte arrays",TRUE);
+		return nl_null;
+	}
+	
+	int sync=NL_SYNC_NONE;
+	if(argc>2){
+		sync=nl_sync_mode(arg_list->d.pair.r->d.pair.r->d.pair.f,"invalid sync mode given to ar->file-append, expecting \"fsync\" or \"fdatasync\"");
+		if(sync<0){
 			return nl_null;
 		}
-		//perform the division (from the rational number) then mul by 1000000 for a precision of 1 microsecond
-		useconds_t time_to_sleep=(useconds_t)((1000000*(((double)(time_list->d.pair.f->d.num.n))/((double)(time_list->d.pair.f->d.num.d)))));
-/*
-#ifdef _DEBUG
-		printf("nl_sleep debug 0, sleeping for %u microseconds\n",time_to_sleep);
-#endif
-*/
-		usleep(time_to_sleep);
+	}
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=FALSE;
+	
+	char *fname=c_str_from_nl_str(fname_arg);
+	int fd=open(fname,O_WRONLY|O_CREAT|O_APPEND,0666);
+	free(fname);
+	if(fd<0){
+		ERR_EXIT(fname_arg,"could not open file",TRUE);
+		return ret;
+	}
+	
+	nl_val *handle=nl_handle_from_fd(fd,FALSE);
+	nl_handle *h=handle->d.handle;
+	h->wbuf=(char*)(malloc(NL_WRITE_BUFFER));
+	h->sync=sync;
+	
+	if(nl_handle_write(h,data) && nl_handle_flush(h)){
+		ret->d.byte.v=TRUE;
+	}else{
+		ERR_EXIT(fname_arg,"could not write file",TRUE);
+	}
+	nl_val_free(handle);
+	return ret;
+}
+
+//make a HANDLE value for an already-open file descriptor (the handle owns the descriptor unless is_std is TRUE)
+nl_val *nl_handle_from_fd(int fd, char is_std){
+	nl_val *ret=nl_val_malloc(HANDLE);
+	ret->d.handle->fd=fd;
+	ret->d.handle->is_std=is_std;
+	return ret;
+}
+
+//close the file behind a handle (and free its buffers); closing an already-closed handle does nothing
+void nl_handle_close(nl_handle *h){
+	if(h->fd<0){
+		return;
+	}
+	
+	//anything still buffered gets written out before the file is closed
+	if(h->wbuf!=NULL){
+		if(!nl_handle_flush(h)){
+			ERR(nl_null,"could not write out buffered data when closing a file handle",FALSE);
+		}
+		free(h->wbuf);
+		h->wbuf=NULL;
+	}
+	
+	//stdin's reader is shared with the repl, so it stays around
+	if(!(h->is_std)){
+		nl_reader_free(h->r);
+		close(h->fd);
+	}
+	h->r=NULL;
+	h->fd=-1;
+	
+	nl_bytes_release(h->line_bufs[0]);
+	nl_bytes_release(h->line_bufs[1]);
+	h->line_bufs[0]=NULL;
+	h->line_bufs[1]=NULL;
+}
+
+//get the handle argument for a handle operation, or NULL (after an error) if it isn't a readable handle
+nl_handle *nl_handle_for_reading(nl_val *arg, const char *op_err){
+	nl_par_impure();
+	if(arg->t!=HANDLE){
+		ERR_EXIT(arg,op_err,TRUE);
+		return NULL;
+	}
+	if((arg->d.handle->fd<0) || (arg->d.handle->r==NULL)){
+		ERR_EXIT(arg,"handle is closed or not open for reading",TRUE);
+		return NULL;
+	}
+	return arg->d.handle;
+}
+
+//get the handle argument for a handle operation, or NULL (after an error) if it isn't a writable handle
+nl_handle *nl_handle_for_writing(nl_val *arg, const char *op_err){
+	nl_par_impure();
+	if(arg->t!=HANDLE){
+		ERR_EXIT(arg,op_err,TRUE);
+		return NULL;
+	}
+	if((arg->d.handle->fd<0) || (arg->d.handle->wbuf==NULL)){
+		ERR_EXIT(arg,"handle is closed or not open for writing",TRUE);
+		return NULL;
+	}
+	return arg->d.handle;
+}
+
+//write the given bytes to a file descriptor, retrying on short writes and interrupts
+//returns TRUE on success, FALSE on error
+char nl_fd_write(int fd, const char *data, size_t length){
+	nl_par_impure();
+	while(length>0){
+		ssize_t n=write(fd,data,length);
+		if(n<0){
+			if(errno==EINTR){
+				continue;
+			}
+			return FALSE;
+		}
+		data+=n;
+		length-=n;
+	}
+	return TRUE;
+}
+
+//write out a handle's buffered data, then sync it to disk if the handle asks for that
+//returns TRUE on success, FALSE on error
+char nl_handle_flush(nl_handle *h){
+	char ret=TRUE;
+	if(h->wlen>0){
+		ret=nl_fd_write(h->fd,h->wbuf,h->wlen);
+		h->wlen=0;
+	}
+	
+	//only sync if something was written since the last time; syncing is slow
+	if(h->unsynced){
+		if((h->sync==NL_SYNC_DATA) && (fdatasync(h->fd)!=0)){
+			ret=FALSE;
+		}else if((h->sync==NL_SYNC_FULL) && (fsync(h->fd)!=0)){
+			ret=FALSE;
+		}
+		h->unsynced=FALSE;
+	}
+	return ret;
+}
+
+//write raw bytes to a handle; small writes are buffered, large ones go straight to the file
+//returns TRUE on success, FALSE on error
+char nl_handle_write_bytes(nl_handle *h, const char *data, unsigned int length){
+	h->unsynced=TRUE;
+	
+	//if this doesn't fit in the buffer, write out what's already there first
+	if(((h->wlen)+length)>NL_WRITE_BUFFER){
+		if((h->wlen>0) && (!nl_fd_write(h->fd,h->wbuf,h->wlen))){
+			h->wlen=0;
+			return FALSE;
+		}
+		h->wlen=0;
+		
+		//writes at least as big as the buffer gain nothing from it, so they go straight to the file without being copied
+		if(length>=NL_WRITE_BUFFER){
+			return nl_fd_write(h->fd,data,length);
+		}
+	}
+	
+	memcpy((h->wbuf)+(h->wlen),data,length);
+	h->wlen+=length;
+	return TRUE;
+}
+
+//write the given string to a handle; small writes are buffered, large packed ones go straight to the file
+//returns TRUE on success, FALSE on error
+char nl_handle_write(nl_handle *h, const nl_val *str){
+	if(str->flags & NL_VAL_PACKED){
+		return nl_handle_write_bytes(h,nl_array_bytes(str),str->d.array.size);
+	}
+	h->unsynced=TRUE;
+	
+	//arrays that aren't packed go through the buffer a byte at a time
+	unsigned int n;
+	for(n=0;n<(str->d.array.size);n++){
+		const nl_val *c=nl_array_entry(str,n);
+		if(c->t!=BYTE){
+			ERR_EXIT(c,"non-byte value in string given to file write operation",TRUE);
+			return FALSE;
+		}
+		
+		if(h->wlen==NL_WRITE_BUFFER){
+			if(!nl_fd_write(h->fd,h->wbuf,h->wlen)){
+				h->wlen=0;
+				return FALSE;
+			}
+			h->wlen=0;
+		}
+		h->wbuf[h->wlen]=c->d.byte.v;
+		h->wlen++;
+	}
+	return TRUE;
+}
+
+//get the sync mode named by the given string argument ("fsync" or "fdatasync")
+//returns -1 (after an error) if it isn't a sync mode
+int nl_sync_mode(nl_val *mode, const char *op_err){
+	if(mode->t!=ARRAY){
+		ERR_EXIT(mode,op_err,TRUE);
+		return -1;
+	}
+	
+	int ret=-1;
+	char *mode_str=c_str_from_nl_str(mode);
+	if(strcmp(mode_str,"fsync")==0){
+		ret=NL_SYNC_FULL;
+	}else if(strcmp(mode_str,"fdatasync")==0){
+		ret=NL_SYNC_DATA;
+	}else{
+		ERR_EXIT(mode,op_err,TRUE);
+	}
+	free(mode_str);
+	return ret;
+}
+
+//open a file and return a handle to it
+//the optional second argument is "r" (read, the default), "w" (write, replacing the file), or "a" (append)
+//the optional third argument is a sync mode for written data ("fsync" or "fdatasync")
+nl_val *nl_file_open(nl_val *arg_list){
+	nl_par_impure();
+	
+	int argc=nl_c_list_size(arg_list);
+	if((argc<1) || (argc>3)){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-open (takes a file name, and optionally a mode and a sync mode)",TRUE);
+		return nl_null;
+	}
+	
+	if(arg_list->d.pair.f->t!=ARRAY){
+		ERR_EXIT(arg_list->d.pair.f,"wrong type argument given to file-open, expecting byte array",TRUE);
+		return nl_null;
+	}
+	
+	int flags=O_RDONLY;
+	if(argc>1){
+		nl_val *mode=arg_list->d.pair.r->d.pair.f;
+		char *mode_str=(mode->t==ARRAY)?c_str_from_nl_str(mode):NULL;
+		if((mode_str!=NULL) && (strcmp(mode_str,"r")==0)){
+			flags=O_RDONLY;
+		}else if((mode_str!=NULL) && (strcmp(mode_str,"w")==0)){
+			flags=O_WRONLY|O_CREAT|O_TRUNC;
+		}else if((mode_str!=NULL) && (strcmp(mode_str,"a")==0)){
+			flags=O_WRONLY|O_CREAT|O_APPEND;
+		}else{
+			free(mode_str);
+			ERR_EXIT(mode,"invalid mode given to file-open, expecting \"r\", \"w\", or \"a\"",TRUE);
+			return nl_null;
+		}
+		free(mode_str);
+	}
+	
+	int sync=NL_SYNC_NONE;
+	if(argc>2){
+		sync=nl_sync_mode(arg_list->d.pair.r->d.pair.r->d.pair.f,"invalid sync mode given to file-open, expecting \"fsync\" or \"fdatasync\"");
+		if(sync<0){
+			return nl_null;
+		}
+	}
+	
+	char *fname=c_str_from_nl_str(arg_list->d.pair.f);
+	
+	//arrays mapped from a file that's about to be truncated get their own copies first
+	struct stat file_stat;
+	if((flags & O_TRUNC) && (__atomic_load_n(&nl_map_cnt,__ATOMIC_RELAXED)>0) && (stat(fname,&file_stat)==0) && S_ISREG(file_stat.st_mode)){
+		nl_map_detach(file_stat.st_dev,file_stat.st_ino);
+	}
+	
+	int fd=open(fname,flags,0666);
+	free(fname);
+	if(fd<0){
+		ERR_EXIT(arg_list->d.pair.f,"could not open file",TRUE);
+		return nl_null;
+	}
+	
+	//a directory can be opened for reading, but not read
+	if((fstat(fd,&file_stat)==0) && S_ISDIR(file_stat.st_mode)){
+		close(fd);
+		ERR_EXIT(arg_list->d.pair.f,"could not open file (it's a directory)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_handle_from_fd(fd,FALSE);
+	if(flags==O_RDONLY){
+		ret->d.handle->r=nl_reader_malloc(fd);
+	}else{
+		ret->d.handle->wbuf=(char*)(malloc(NL_WRITE_BUFFER));
+		ret->d.handle->sync=sync;
+	}
+	return ret;
+}
+
+//read a line from the given handle, returned without the trailing newline
+//returns NULL at end of file
+nl_val *nl_file_read_line(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-read-line (takes a handle)",TRUE);
+		return nl_null;
+	}
+	
+	nl_handle *h=nl_handle_for_reading(arg_list->d.pair.f,"wrong type argument given to file-read-line, expecting a handle");
+	if(h==NULL){
+		return nl_null;
+	}
+	nl_reader *r=h->r;
+	
+	//look for the end of the line, reading more as needed
+	unsigned int scanned=0;
+	char *line_end=NULL;
+	while(TRUE){
+		unsigned int avail=(r->len)-(r->pos);
+		if(scanned<avail){
+			line_end=memchr((r->buf)+(r->pos)+scanned,'\n',avail-scanned);
+			if(line_end!=NULL){
+				break;
+			}
+		}
+		scanned=avail;
+		if(nl_reader_fill(r)==0){
+			break;
+		}
+	}
+	
+	unsigned int length;
+	unsigned int consumed;
+	if(line_end!=NULL){
+		length=line_end-((r->buf)+(r->pos));
+		consumed=length+1;
+	}else{
+		//at end of file the last line doesn't need a newline
+		length=(r->len)-(r->pos);
+		consumed=length;
+		if(length==0){
+			return nl_null;
+		}
+	}
+	
+	//windows line endings lose the \r too
+	if((length>0) && (r->buf[(r->pos)+length-1]=='\r')){
+		length--;
+	}
+	
+	//if the program is done with a line we returned before, reuse its storage rather than allocating more
+	nl_bytes *b=NULL;
+	int n;
+	for(n=0;n<2;n++){
+		if((h->line_bufs[n]!=NULL) && (NL_REF_GET(h->line_bufs[n]->ref)==1) && (h->line_bufs[n]->len>=length)){
+			b=h->line_bufs[n];
+			break;
+		}
+	}
+	if(b==NULL){
+		b=nl_bytes_malloc((length<256)?256:length);
+		nl_bytes_release(h->line_bufs[h->next_line_buf]);
+		h->line_bufs[h->next_line_buf]=b;
+		h->next_line_buf=(h->next_line_buf+1)%2;
+	}
+	memcpy(b->data,(r->buf)+(r->pos),length);
+	r->pos+=consumed;
+	
+	return nl_array_from_bytes(b,0,length);
+}
+
+//read up to the given number of bytes from the given handle
+//returns NULL at end of file
+nl_val *nl_file_read_chunk(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=2){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-read-chunk (takes a handle and a byte count)",TRUE);
+		return nl_null;
+	}
+	
+	nl_handle *h=nl_handle_for_reading(arg_list->d.pair.f,"wrong type argument given to file-read-chunk, expecting a handle");
+	if(h==NULL){
+		return nl_null;
+	}
+	
+	nl_val *count=arg_list->d.pair.r->d.pair.f;
+	if((count->t!=NUM) || (count->d.num.d!=1) || (count->d.num.n<1) || (count->d.num.n>UINT_MAX)){
+		ERR_EXIT(count,"byte count given to file-read-chunk must be a positive integer",TRUE);
+		return nl_null;
+	}
+	unsigned int length=count->d.num.n;
+	nl_reader *r=h->r;
+	
+	//if nothing's buffered, see if there's anything left at all
+	if((r->pos>=r->len) && (nl_reader_peek(r,0)==EOF)){
+		return nl_null;
+	}
+	
+	//the count is only an upper bound, so storage is sized by what's actually left (when that's known) and grown as needed
+	//(for a regular file this is one more byte than is left, so reaching the end doesn't make it grow)
+	unsigned int buffered=(r->len)-(r->pos);
+	size_t cap=((size_t)(buffered))+NL_READ_CHUNK;
+	struct stat file_stat;
+	off_t file_pos;
+	if((fstat(r->fd,&file_stat)==0) && S_ISREG(file_stat.st_mode) && ((file_pos=lseek(r->fd,0,SEEK_CUR))>=0)){
+		cap=((size_t)(buffered))+1;
+		if(file_stat.st_size>file_pos){
+			cap+=file_stat.st_size-file_pos;
+		}
+	}
+	if(cap>length){
+		cap=length;
+	}
+	nl_bytes *b=nl_bytes_malloc(cap);
+	
+	//first take whatever is already buffered
+	unsigned int got=buffered;
+	if(got>length){
+		got=length;
+	}
+	memcpy(b->data,(r->buf)+(r->pos),got);
+	r->pos+=got;
+	
+	//then read the rest straight into the result (no point copying it through the reader's buffer)
+	while((got<length) && !(r->eof)){
+		if(got>=b->len){
+			size_t new_len=2*(b->len);
+			if(new_len>length){
+				new_len=length;
+			}
+			char *new_data=(char*)(realloc(b->data,new_len));
+			if(new_data==NULL){
+				ERR_EXIT(nl_null,"could not malloc array storage (out of memory?)",FALSE);
+				exit(1);
+			}
+			NL_STATS_MEM(nl_vm_cur,packed_bytes,((long long)(new_len))-((long long)(b->len)),1);
+			b->data=new_data;
+			b->len=new_len;
+		}
+		
+		size_t room=(b->len<length)?(b->len):length;
+		ssize_t n=read(r->fd,(b->data)+got,room-got);
+		if(n<0 && errno==EINTR){
+			continue;
+		}
+		if(n<=0){
+			r->eof=TRUE;
+			break;
+		}
+		got+=n;
+	}
+	
+	nl_val *ret=nl_array_from_bytes(b,0,got);
+	nl_bytes_release(b);
+	return ret;
+}
+
+//returns TRUE if there's nothing left to read from the given handle
+nl_val *nl_file_eof(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-eof (takes a handle)",TRUE);
+		return nl_null;
+	}
+	
+	nl_handle *h=nl_handle_for_reading(arg_list->d.pair.f,"wrong type argument given to file-eof, expecting a handle");
+	if(h==NULL){
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=(nl_reader_peek(h->r,0)==EOF)?TRUE:FALSE;
+	return ret;
+}
+
+//write the given string(s) to the given handle
+//returns TRUE on success, FALSE on error
+nl_val *nl_file_write(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)<1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-write (takes a handle and strings to write)",TRUE);
+		return nl_null;
+	}
+	
+	nl_handle *h=nl_handle_for_writing(arg_list->d.pair.f,"wrong type argument given to file-write, expecting a handle");
+	if(h==NULL){
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=TRUE;
+	
+	arg_list=arg_list->d.pair.r;
+	while(arg_list->t==PAIR){
+		if(arg_list->d.pair.f->t!=ARRAY){
+			ERR_EXIT(arg_list->d.pair.f,"wrong type argument given to file-write, expecting byte array",TRUE);
+			ret->d.byte.v=FALSE;
+		}else if(!nl_handle_write(h,arg_list->d.pair.f)){
+			ERR_EXIT(arg_list->d.pair.f,"could not write to file",TRUE);
+			ret->d.byte.v=FALSE;
+			break;
+		}
+		arg_list=arg_list->d.pair.r;
+	}
+	return ret;
+}
+
+//close the given handle(s)
+nl_val *nl_file_close(nl_val *arg_list){
+	nl_par_impure();
+	
+	while(arg_list->t==PAIR){
+		if(arg_list->d.pair.f->t!=HANDLE){
+			ERR_EXIT(arg_list->d.pair.f,"wrong type argument given to file-close, expecting a handle",TRUE);
+		}else{
+			nl_handle_close(arg_list->d.pair.f->d.handle);
+		}
+		arg_list=arg_list->d.pair.r;
+	}
+	return nl_null;
+}
+
+//create a new empty file whose name is the given prefix, then six random characters, then the optional suffix
+//returns the name of the file (which no other file had)
+nl_val *nl_file_tmp(nl_val *arg_list){
+	//this changes the file system, so it can't be done speculatively
+	nl_par_impure();
+	
+	int argc=nl_c_list_size(arg_list);
+	if((argc<1) || (argc>2)){
+		ERR_EXIT(arg_list,"wrong number of arguments given to file-tmp (takes a prefix, and optionally a suffix)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *prefix_arg=arg_list->d.pair.f;
+	nl_val *suffix_arg=(argc>1)?arg_list->d.pair.r->d.pair.f:NULL;
+	if((prefix_arg->t!=ARRAY) || ((suffix_arg!=NULL) && (suffix_arg->t!=ARRAY))){
+		ERR_EXIT(arg_list,"wrong type argument given to file-tmp, expecting byte arrays",TRUE);
+		return nl_null;
+	}
+	
+	char *prefix=c_str_from_nl_str(prefix_arg);
+	char *suffix=(suffix_arg!=NULL)?c_str_from_nl_str(suffix_arg):NULL;
+	size_t suffix_len=(suffix!=NULL)?strlen(suffix):0;
+	char *tmp_name=(char*)(malloc(strlen(prefix)+7+suffix_len));
+	if(tmp_name==NULL){
+		ERR_EXIT(nl_null,"could not malloc a temporary file name (out of memory?)",FALSE);
+		exit(1);
+	}
+	sprintf(tmp_name,"%sXXXXXX%s",prefix,(suffix!=NULL)?suffix:"");
+	free(prefix);
+	free(suffix);
+	
+	int fd=mkstemps(tmp_name,(int)(suffix_len));
+	if(fd<0){
+		free(tmp_name);
+		ERR_EXIT(prefix_arg,"could not create temporary file",TRUE);
+		return nl_null;
+	}
+	close(fd);
+	
+	nl_val *ret=nl_str_from_c_str(tmp_name);
+	free(tmp_name);
+	return ret;
+}
+
+//remove the given file(s)
+//returns TRUE if they were all removed, FALSE if any couldn't be (a file that doesn't exist isn't an error, so caches can be cleaned up)
+nl_val *nl_file_delete(nl_val *arg_list){
+	//this changes the file system, so it can't be done speculatively
+	nl_par_impure();
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=TRUE;
+	while(arg_list->t==PAIR){
+		if(arg_list->d.pair.f->t!=ARRAY){
+			ERR_EXIT(arg_list->d.pair.f,"wrong type argument given to file-delete, expecting a byte array",TRUE);
+			ret->d.byte.v=FALSE;
+		}else{
+			char *fname=c_str_from_nl_str(arg_list->d.pair.f);
+			if(unlink(fname)!=0){
+				if(errno!=ENOENT){
+					ERR_EXIT(arg_list->d.pair.f,"could not delete file",TRUE);
+				}
+				ret->d.byte.v=FALSE;
+			}
+			free(fname);
+		}
+		arg_list=arg_list->d.pair.r;
+	}
+	return ret;
+}
+
+//END C-NL-STDLIB-FILE SUBROUTINES  -------------------------------------------------------------------------------
+
+
+//BEGIN C-NL-STDLIB-BIN SUBROUTINES  ------------------------------------------------------------------------------
+
+//NOTE: the binary format is a tag byte per value followed by that value's data (see nl_bin_tag)
+//numbers are varints, packed strings are length-prefixed raw bytes, and a value that was already written
+//(the same value, or a copy of the same string) is written as a back-reference to the first one
+
+//set up a binary writer for writing to memory (or to the given handle, if it isn't NULL)
+void nl_bin_writer_init(nl_bin_writer *w, nl_handle *h){
+	w->h=h;
+	w->out=(h==NULL)?nl_bytes_malloc(BUFFER_SIZE):NULL;
+	w->len=0;
+	w->seen=NULL;
+	w->seen_cnt=0;
+	w->seen_cap=0;
+	w->val_cnt=0;
+	w->env_cnt=0;
+	w->global_env=NULL;
+	w->pri_env=NULL;
+	w->pri_list=NULL;
+	w->cur_sub=NULL;
+	w->lines=FALSE;
+	w->line=0;
+	w->keep=nl_null;
+	w->err=FALSE;
+}
+
+//free a binary writer's internal tables (the output itself is left alone)
+void nl_bin_writer_cleanup(nl_bin_writer *w){
+	free(w->seen);
+	w->seen=NULL;
+	nl_val_free(w->keep);
+	w->keep=nl_null;
+	if(w->pri_list!=NULL){
+		nl_val_free(w->pri_list);
+		w->pri_list=NULL;
+	}
+}
+
+//set up a binary reader for reading from the given packed array (or from the given file reader, if it isn't NULL)
+void nl_bin_reader_init(nl_bin_reader *rd, nl_val *packed, nl_reader *r){
+	rd->b=NULL;
+	rd->data=NULL;
+	rd->len=0;
+	rd->pos=0;
+	rd->r=r;
+	if((r==NULL) && (packed->flags & NL_VAL_PACKED)){
+		rd->b=packed->d.array.bytes;
+		rd->data=nl_array_bytes(packed);
+		rd->len=packed->d.array.size;
+	}
+	rd->refs=NULL;
+	rd->ref_cnt=0;
+	rd->ref_cap=0;
+	rd->envs=NULL;
+	rd->env_cnt=0;
+	rd->env_cap=0;
+	rd->global_env=NULL;
+	rd->pri_env=NULL;
+	rd->cur_sub=NULL;
+	rd->line=0;
+	rd->err=FALSE;
+}
+
+//add raw bytes to binary output
+void nl_bin_put(nl_bin_writer *w, const char *data, unsigned int length){
+	if(w->h!=NULL){
+		if(!nl_handle_write_bytes(w->h,data,length)){
+			w->err=TRUE;
+		}
+		return;
+	}
+	
+	//grow the output as needed
+	if(((size_t)(w->len)+length)>(w->out->len)){
+		size_t new_len=(w->out->len)*2;
+		if(new_len<((size_t)(w->len)+length)){
+			new_len=(w->len)+length;
+		}
+		if(new_len>UINT_MAX){
+			ERR_EXIT(nl_null,"binary value is too large to be stored in an array",FALSE);
+			w->err=TRUE;
+			return;
+		}
+		w->out->data=(char*)(realloc(w->out->data,new_len));
+		NL_STATS_MEM(nl_vm_cur,packed_bytes,((long long)(new_len))-((long long)(w->out->len)),1);
+		w->out->len=new_len;
+	}
+	memcpy((w->out->data)+(w->len),data,length);
+	w->len+=length;
+}
+
+//add an unsigned number to binary output as a varint (7 bits per byte, low bits first, high bit set on all but the last byte)
+void nl_bin_put_varint(nl_bin_writer *w, unsigned long long int v){
+	char buf[10];
+	unsigned int n=0;
+	while(v>=0x80){
+		buf[n]=(char)((v&0x7f)|0x80);
+		v>>=7;
+		n++;
+	}
+	buf[n]=(char)(v);
+	nl_bin_put(w,buf,n+1);
+}
+
+//add a name to binary output (a varint length plus one, then the bytes; a 0 length marks the end of a list of names)
+void nl_bin_put_name(nl_bin_writer *w, const char *name, unsigned int length){
+	nl_bin_put_varint(w,((unsigned long long int)(length))+1);
+	nl_bin_put(w,name,length);
+}
+
+//look up a key in the writer's table of things already written, adding it (with the next index from the given counter) if it isn't there
+//returns the index plus one if it was already written, 0 if it's new
+unsigned int nl_bin_seen_check(nl_bin_writer *w, const void *p, unsigned int offset, unsigned int size, unsigned int *counter){
+	//keep the table at most half full
+	if(((w->seen_cnt)+1)*2>(w->seen_cap)){
+		unsigned int old_cap=w->seen_cap;
+		nl_bin_seen *old_seen=w->seen;
+		
+		w->seen_cap=(old_cap==0)?64:(old_cap*2);
+		w->seen=(nl_bin_seen*)(calloc(w->seen_cap,sizeof(nl_bin_seen)));
+		
+		unsigned int n;
+		for(n=0;n<old_cap;n++){
+			if(old_seen[n].idx>0){
+				size_t hash=(((size_t)(old_seen[n].p))>>4)^(old_seen[n].offset*31)^(old_seen[n].size*17);
+				size_t slot=hash&((w->seen_cap)-1);
+				while(w->seen[slot].idx>0){
+					slot=(slot+1)&((w->seen_cap)-1);
+				}
+				w->seen[slot]=old_seen[n];
+			}
+		}
+		free(old_seen);
+	}
+	
+	size_t hash=(((size_t)(p))>>4)^(offset*31)^(size*17);
+	size_t slot=hash&((w->seen_cap)-1);
+	while(w->seen[slot].idx>0){
+		if((w->seen[slot].p==p) && (w->seen[slot].offset==offset) && (w->seen[slot].size==size)){
+			return w->seen[slot].idx;
+		}
+		slot=(slot+1)&((w->seen_cap)-1);
+	}
+	
+	w->seen_cnt++;
+	(*counter)++;
+	w->seen[slot].p=p;
+	w->seen[slot].offset=offset;
+	w->seen[slot].size=size;
+	w->seen[slot].idx=*counter;
+	return 0;
+}
+
+//write an environment frame in the binary format (frames are shared, so each is written once and referred back to)
+void nl_bin_write_env(nl_bin_writer *w, nl_env_frame *env){
+	char tag;
+	if(env==NULL){
+		tag=NL_BIN_ENV_NONE;
+		nl_bin_put(w,&tag,1);
+		return;
+	}
+	if(env==w->global_env){
+		tag=NL_BIN_ENV_GLOBAL;
+		nl_bin_put(w,&tag,1);
+		return;
+	}
+	
+	//frames are keyed with an offset and size no value can have, so they never match a value
+	unsigned int idx=nl_bin_seen_check(w,env,UINT_MAX,UINT_MAX,&(w->env_cnt));
+	if(idx>0){
+		tag=NL_BIN_ENV_REF;
+		nl_bin_put(w,&tag,1);
+		nl_bin_put_varint(w,idx-1);
+		return;
+	}
+	
+	tag=NL_BIN_ENV_NEW;
+	nl_bin_put(w,&tag,1);
+	nl_bin_put(w,&(env->shared),1);
+	nl_bin_write_env(w,env->up_scope);
+	
+	nl_bin_write_trie(w,env->trie,NULL);
+}
+
+//write the bindings in a trie as (name, allowed types, value) entries, ending with an empty name
+//bindings that are the same in the skip trie (if given) are left out
+void nl_bin_write_trie(nl_bin_writer *w, nl_trie_node *trie_root, nl_trie_node *skip){
+	nl_val *name=nl_val_malloc(ARRAY);
+	nl_bin_write_trie_entries(w,trie_root,name,skip);
+	nl_val_free(name);
+	
+	//names are written with their length plus one, so a 0 length ends the list
+	nl_bin_put_varint(w,0);
+}
+
+//write the entries of nl_bin_write_trie for the given node and everything under it (name holds the name so far, the path to this node)
+void nl_bin_write_trie_entries(nl_bin_writer *w, nl_trie_node *node, nl_val *name, nl_trie_node *skip){
+	if(node->end_node){
+		const char *name_bytes=(name->d.array.size>0)?nl_array_bytes(name):"";
+		nl_val *v=node->value;
+		
+		char write=TRUE;
+		if(skip!=NULL){
+			//standard library bindings that haven't changed are bound again when the image is loaded
+			//(handles compare by identity, so a standard handle still bound to a handle counts as unchanged)
+			nl_trie_node *skip_node=nl_trie_match_node(skip,name_bytes,0,name->d.array.size);
+			if((skip_node!=NULL) && (skip_node->value->t==v->t) && ((v->t==HANDLE) || (nl_val_cmp(skip_node->value,v)==0))){
+				write=FALSE;
+			}
+			
+			//argv is bound fresh for every run
+			if((name->d.array.size==4) && (memcmp(name_bytes,"argv",4)==0)){
+				write=FALSE;
+			}
+		}
+		
+		//open files, channels, and futures only mean anything while the program runs, so they can't be saved;
+		//leave those bindings out rather than failing the whole write
+		if(write && ((v->t==HANDLE) || (v->t==CHANNEL) || (v->t==FUTURE))){
+			fflush(stdout);
+			fprintf(stderr,"Warn [line %u]: %s values can't be saved in an image; leaving out the binding for %.*s\n",nl_vm_cur->line_number,nl_type_name(v->t),(int)(name->d.array.size),name_bytes);
+			write=FALSE;
+		}
+		
+		if(write){
+			nl_bin_put_name(w,name_bytes,name->d.array.size);
+			
+			unsigned long long int types=0;
+			int t;
+			for(t=0;t<NL_TYPE_CNT;t++){
+				if(node->t[t]){
+					types|=(1ULL<<t);
+				}
+			}
+			nl_bin_put_varint(w,types);
+			
+			nl_bin_write_val(w,v);
+		}
+	}
+	
+	int n;
+	for(n=0;n<(node->child_count);n++){
+		nl_array_push_bytes(name,&(node->children[n]->name),1);
+		nl_bin_write_trie_entries(w,node->children[n],name,skip);
+		name->d.array.size--;
+	}
+}
+
+//write a value in the binary format (without the header)//write a value in the binary format (without the header)
+void nl_bin_write_val(nl_bin_writer *w, const nl_val *v){
+	char tag;
+	
+	if(w->err){
+		return;
+	}
+	
+	if(v==nl_null){
+		tag=NL_BIN_NULL;
+		nl_bin_put(w,&tag,1);
+		return;
+	}
+	
+	//a future that's finished is written as its result (reading it back gives just the result, which touch passes through)
+	if((v->t==FUTURE) && (v->d.future->state==NL_PAR_TASK_DONE) && (v->d.future->result!=NULL)){
+		nl_bin_write_val(w,v->d.future->result);
+		return;
+	}
+	
+	//recur in a closure's body was replaced with the closure itself (without a new reference), so that's written specially
+	if((v->t==SUB) && (v==w->cur_sub)){
+		tag=NL_BIN_RECUR;
+		nl_bin_put(w,&tag,1);
+		return;
+	}
+	
+	//anything that can be shared gets written once and referred back to after that
+	//(the reader gives these indices in the same order, so the two stay in step)
+	if((v->t==PAIR) || (v->t==ARRAY) || (v->t==STRUCT) || (v->t==SYMBOL) || (v->t==EVALUATION) || (v->t==BIND) || ((v->t==SUB) && (w->global_env!=NULL))){
+		//packed arrays are keyed on their storage, so copies of a string (which share storage) match
+		unsigned int idx;
+		if((v->t==ARRAY) && (v->flags & NL_VAL_PACKED)){
+			idx=nl_bin_seen_check(w,v->d.array.bytes,v->d.array.offset,v->d.array.size,&(w->val_cnt));
+		}else{
+			idx=nl_bin_seen_check(w,v,0,0,&(w->val_cnt));
+		}
+		if(idx>0){
+			tag=NL_BIN_REF;
+			nl_bin_put(w,&tag,1);
+			nl_bin_put_varint(w,idx-1);
+			return;
+		}
+	}
+	
+	//values from source carry the line they were read on, which only needs writing when it changes
+	if((w->lines) && (v->line_slot>0) && (nl_val_line(v)!=(w->line))){
+		w->line=nl_val_line(v);
+		tag=NL_BIN_LINE;
+		nl_bin_put(w,&tag,1);
+		nl_bin_put_varint(w,w->line);
+	}
+	
+	switch(v->t){
+		case BYTE:
+			tag=NL_BIN_BYTE;
+			nl_bin_put(w,&tag,1);
+			nl_bin_put(w,&(v->d.byte.v),1);
+			break;
+		case NUM:
+			tag=NL_BIN_NUM;
+			nl_bin_put(w,&tag,1);
+			//zigzag encoding so small negative numerators are small too
+			nl_bin_put_varint(w,(((unsigned long long int)(v->d.num.n))<<1)^((unsigned long long int)((v->d.num.n)>>63)));
+			nl_bin_put_varint(w,(unsigned long long int)(v->d.num.d));
+			break;
+		//lists are written flat rather than as nested pairs, so long lists don't recurse
+		case PAIR:
+			{
+				//when lines are written, the list is split wherever a pair is on a different line (the rest is written as the tail, with its own line)
+				unsigned long long int len=0;
+				const nl_val *tail=v;
+				while((tail->t==PAIR) && ((len==0) || !(w->lines) || (tail->line_slot==v->line_slot))){
+					len++;
+					tail=tail->d.pair.r;
+				}
+				
+				tag=NL_BIN_LIST;
+				nl_bin_put(w,&tag,1);
+				nl_bin_put_varint(w,len);
+				while(v!=tail){
+					nl_bin_write_val(w,v->d.pair.f);
+					v=v->d.pair.r;
+				}
+				nl_bin_write_val(w,tail);
+			}
+			break;
+		case ARRAY:
+			if(v->flags & NL_VAL_PACKED){
+				tag=NL_BIN_STRING;
+				nl_bin_put(w,&tag,1);
+				nl_bin_put_varint(w,v->d.array.size);
+				nl_bin_put(w,nl_array_bytes(v),v->d.array.size);
+			}else{
+				tag=NL_BIN_ARRAY;
+				nl_bin_put(w,&tag,1);
+				nl_bin_put_varint(w,v->d.array.size);
+				unsigned int n;
+				for(n=0;n<(v->d.array.size);n++){
+					nl_bin_write_val(w,nl_array_entry(v,n));
+				}
+			}
+			break;
+		case STRUCT:
+			{
+				//entries come from the struct's trie as (symbol . value) pairs; nulls mark the ends of trie nodes and aren't entries
+				nl_val *entries=nl_trie_associative_list(v->d.nl_struct.env->trie);
+				
+				//these are copies, which are kept until we're done so that nothing else gets their addresses in the table of values written
+				nl_val *keep=nl_val_malloc(PAIR);
+				keep->d.pair.f=entries;
+				keep->d.pair.r=w->keep;
+				w->keep=keep;
+				
+				unsigned int len=0;
+				nl_val *entry;
+				for(entry=entries;entry->t==PAIR;entry=entry->d.pair.r){
+					if(entry->d.pair.f!=nl_null){
+						len++;
+					}
+				}
+				
+				//the list is in reverse order of the trie; entries are written in trie order so they're bound back in the same order
+				nl_val **entry_array=(nl_val**)(malloc(len*sizeof(nl_val*)));
+				unsigned int n=len;
+				for(entry=entries;entry->t==PAIR;entry=entry->d.pair.r){
+					if(entry->d.pair.f!=nl_null){
+						n--;
+						entry_array[n]=entry->d.pair.f;
+					}
+				}
+				
+				tag=NL_BIN_STRUCT;
+				nl_bin_put(w,&tag,1);
+				nl_bin_put_varint(w,len);
+				for(n=0;n<len;n++){
+					nl_bin_write_val(w,entry_array[n]->d.pair.f->d.sym.name);
+					nl_bin_write_val(w,entry_array[n]->d.pair.r);
+				}
+				free(entry_array);
+			}
+			break;
+		case SYMBOL:
+			tag=NL_BIN_SYMBOL;
+			nl_bin_put(w,&tag,1);
+			tag=v->d.sym.t;
+			nl_bin_put(w,&tag,1);
+			nl_bin_write_val(w,v->d.sym.name);
+			break;
+		case EVALUATION:
+			tag=NL_BIN_EVALUATION;
+			nl_bin_put(w,&tag,1);
+			nl_bin_write_val(w,v->d.eval.sym);
+			break;
+		case BIND:
+			tag=NL_BIN_BIND;
+			nl_bin_put(w,&tag,1);
+			nl_bin_write_val(w,v->d.bind.sym);
+			nl_bin_write_val(w,v->d.bind.v);
+			break;
+		//closures (only in images) are written with their whole environment, up to the global one
+		case SUB:
+			if(w->global_env==NULL){
+				ERR_EXIT(v,"value of this type can't be encoded in binary",TRUE);
+				w->err=TRUE;
+				break;
+			}
+			tag=NL_BIN_SUB;
+			nl_bin_put(w,&tag,1);
+			{
+				const nl_val *outer_sub=w->cur_sub;
+				w->cur_sub=v;
+				nl_bin_write_val(w,v->d.sub->args);
+				nl_bin_write_val(w,v->d.sub->dflt_args);
+				nl_bin_write_val(w,v->d.sub->body);
+				w->cur_sub=outer_sub;
+			}
+			nl_bin_write_env(w,v->d.sub->env);
+			break;
+		//primitives (only in images) are written as the name they have in the standard library
+		case PRI:
+			if(w->pri_env==NULL){
+				ERR_EXIT(v,"value of this type can't be encoded in binary",TRUE);
+				w->err=TRUE;
+				break;
+			}
+			if(w->pri_list==NULL){
+				w->pri_list=nl_trie_associative_list(w->pri_env->trie);
+			}
+			{
+				nl_val *entry;
+				for(entry=w->pri_list;entry->t==PAIR;entry=entry->d.pair.r){
+					nl_val *binding=entry->d.pair.f;
+					if((binding!=nl_null) && (binding->d.pair.r->t==PRI) && (binding->d.pair.r->d.pri.function==v->d.pri.function)){
+						break;
+					}
+				}
+				if(entry->t!=PAIR){
+					ERR_EXIT(v,"primitive procedure isn't in the standard library and can't be saved",TRUE);
+					w->err=TRUE;
+					break;
+				}
+				
+				nl_val *name=entry->d.pair.f->d.pair.f->d.sym.name;
+				tag=NL_BIN_PRI;
+				nl_bin_put(w,&tag,1);
+				nl_bin_put_name(w,nl_array_bytes(name),name->d.array.size);
+			}
+			break;
+		//file handles refer to things outside of the value itself, so they can't be written out (and neither can unfinished futures)
+		default:
+			ERR_EXIT(v,"value of this type can't be encoded in binary",TRUE);
+			w->err=TRUE;
+			break;
+	}
+}
+
+//get the next length bytes of binary input
+//returns NULL (and sets the reader's error flag) if the input ends first
+//NOTE: when reading from a file the returned pointer is only good until the next call
+const char *nl_bin_take(nl_bin_reader *rd, unsigned int length){
+	if(rd->err){
+		return NULL;
+	}
+	
+	const char *ret=NULL;
+	if(rd->r!=NULL){
+		if(length==0){
+			ret="";
+		}else if(nl_reader_peek(rd->r,length-1)!=EOF){
+			ret=(rd->r->buf)+(rd->r->pos);
+			rd->r->pos+=length;
+		}
+	}else if(((rd->len)-(rd->pos))>=length){
+		ret=(rd->data)+(rd->pos);
+		rd->pos+=length;
+	}
+	
+	if(ret==NULL){
+		rd->err=TRUE;
+	}
+	return ret;
+}
+
+//read a varint from binary input
+unsigned long long int nl_bin_take_varint(nl_bin_reader *rd){
+	unsigned long long int ret=0;
+	unsigned int shift=0;
+	while(shift<64){
+		const char *c=nl_bin_take(rd,1);
+		if(c==NULL){
+			return 0;
+		}
+		ret|=((unsigned long long int)((*c)&0x7f))<<shift;
+		if(!((*c)&0x80)){
+			return ret;
+		}
+		shift+=7;
+	}
+	
+	//more than 64 bits of varint means this isn't data we wrote
+	rd->err=TRUE;
+	return 0;
+}
+
+//remember a value read from binary input so later back-references can refer to it
+void nl_bin_ref_add(nl_bin_reader *rd, nl_val *v){
+	if(rd->ref_cnt==rd->ref_cap){
+		rd->ref_cap=(rd->ref_cap==0)?64:((rd->ref_cap)*2);
+		rd->refs=(nl_val**)(realloc(rd->refs,(rd->ref_cap)*sizeof(nl_val*)));
+	}
+	rd->refs[rd->ref_cnt]=v;
+	rd->ref_cnt++;
+}
+
+//read a name written by nl_bin_put_name into a new c string (which you must free)
+//returns NULL at the end of a list of names, or on error (check the reader's error flag)
+char *nl_bin_take_name(nl_bin_reader *rd, unsigned int *length){
+	unsigned long long int len=nl_bin_take_varint(rd);
+	if((rd->err) || (len==0)){
+		return NULL;
+	}
+	if(len>UINT_MAX){
+		rd->err=TRUE;
+		return NULL;
+	}
+	len--;
+	
+	const char *data=nl_bin_take(rd,len);
+	if(data==NULL){
+		return NULL;
+	}
+	char *ret=(char*)(malloc(len+1));
+	memcpy(ret,data,len);
+	ret[len]='\0';
+	*length=len;
+	return ret;
+}
+
+//read an environment frame written by nl_bin_write_env
+nl_env_frame *nl_bin_read_env(nl_bin_reader *rd){
+	const char *tag=nl_bin_take(rd,1);
+	if(tag==NULL){
+		return NULL;
+	}
+	
+	switch(*tag){
+		case NL_BIN_ENV_NONE:
+			return NULL;
+		case NL_BIN_ENV_GLOBAL:
+			if(rd->global_env==NULL){
+				rd->err=TRUE;
+			}
+			return rd->global_env;
+		case NL_BIN_ENV_REF:
+			{
+				unsigned long long int idx=nl_bin_take_varint(rd);
+				if((rd->err) || (idx>=(rd->env_cnt))){
+					rd->err=TRUE;
+					return NULL;
+				}
+				return rd->envs[idx];
+			}
+		case NL_BIN_ENV_NEW:
+			{
+				const char *shared=nl_bin_take(rd,1);
+				if(shared==NULL){
+					return NULL;
+				}
+				nl_env_frame *ret=nl_env_frame_malloc(NULL);
+				ret->shared=*shared;
+				
+				//register the frame before reading what's in it, since closures bound in it refer back to it
+				if(rd->env_cnt==rd->env_cap){
+					rd->env_cap=(rd->env_cap==0)?16:((rd->env_cap)*2);
+					rd->envs=(nl_env_frame**)(realloc(rd->envs,(rd->env_cap)*sizeof(nl_env_frame*)));
+				}
+				rd->envs[rd->env_cnt]=ret;
+				rd->env_cnt++;
+				
+				ret->up_scope=nl_bin_read_env(rd);
+				nl_bin_read_trie(rd,ret);
+				return ret;
+			}
+		default:
+			break;
+	}
+	rd->err=TRUE;
+	return NULL;
+}
+
+//read bindings written by nl_bin_write_trie into the given environment frame
+void nl_bin_read_trie(nl_bin_reader *rd, nl_env_frame *env){
+	while(!(rd->err)){
+		unsigned int length=0;
+		char *name=nl_bin_take_name(rd,&length);
+		if(name==NULL){
+			return;
+		}
+		
+		unsigned long long int types=nl_bin_take_varint(rd);
+		nl_val *v=nl_bin_read_val(rd);
+		if(!(rd->err)){
+			nl_val *sym=nl_val_malloc(SYMBOL);
+			sym->d.sym.name=nl_str_from_buf(name,length);
+			nl_bind(sym,v,env,FALSE);
+			nl_val_free(sym);
+			
+			//restore exactly which types this binding allows
+			nl_trie_node *node=nl_trie_match_node(env->trie,name,0,length);
+			if(node!=NULL){
+				int t;
+				for(t=0;t<NL_TYPE_CNT;t++){
+					node->t[t]=(types&(1ULL<<t))?TRUE:FALSE;
+				}
+			}
+		}
+		nl_val_free(v);
+		free(name);
+	}
+}
+
+//read a value in the binary format (without the header)
+//returns NULL (and sets the reader's error flag) if the data is bad; anything partially read is still a valid value
+nl_val *nl_bin_read_val(nl_bin_reader *rd){
+	const char *tag=nl_bin_take(rd,1);
+	if(tag==NULL){
+		return nl_null;
+	}
+	//when reading from a file the tag's buffer can move as more is read, so keep the tag itself
+	const char tag_val=*tag;
+	//likewise the line this value was on, since what's inside it can be on other lines
+	unsigned int line=rd->line;
+	
+	nl_val *ret=nl_null;
+	switch(tag_val){
+		case NL_BIN_NULL:
+			break;
+		case NL_BIN_BYTE:
+			{
+				const char *c=nl_bin_take(rd,1);
+				if(c!=NULL){
+					ret=nl_val_malloc(BYTE);
+					ret->d.byte.v=*c;
+				}
+			}
+			break;
+		case NL_BIN_NUM:
+			{
+				unsigned long long int n=nl_bin_take_varint(rd);
+				unsigned long long int d=nl_bin_take_varint(rd);
+				if(!(rd->err)){
+					ret=nl_val_malloc(NUM);
+					ret->d.num.n=(long long int)((n>>1)^(-(n&1)));
+					ret->d.num.d=(long long int)(d);
+				}
+			}
+			break;
+		case NL_BIN_LIST:
+			{
+				unsigned long long int len=nl_bin_take_varint(rd);
+				if((rd->err) || (len==0)){
+					rd->err=TRUE;
+					break;
+				}
+				
+				ret=nl_val_malloc(PAIR);
+				nl_bin_ref_add(rd,ret);
+				
+				nl_val *current=ret;
+				while(TRUE){
+					current->d.pair.f=nl_bin_read_val(rd);
+					len--;
+					if((len==0) || (rd->err)){
+						break;
+					}
+					current->d.pair.r=nl_val_malloc(PAIR);
+					current=current->d.pair.r;
+					//every pair written together was on the same line (the first gets its line below, like everything else)
+					if(line>0){
+						current->line_slot=nl_line_slot(line);
+					}
+				}
+				if(!(rd->err)){
+					current->d.pair.r=nl_bin_read_val(rd);
+				}
+			}
+			break;
+		case NL_BIN_STRING:
+			{
+				unsigned long long int len=nl_bin_take_varint(rd);
+				if((rd->err) || (len>UINT_MAX)){
+					rd->err=TRUE;
+					break;
+				}
+				const char *data=nl_bin_take(rd,len);
+				if(data==NULL){
+					break;
+				}
+				
+				//strings read from memory are views of the input (nothing is copied until one is modified)
+				if(rd->r==NULL){
+					ret=nl_array_from_bytes(rd->b,data-(rd->b->data),len);
+				}else{
+					ret=nl_str_from_buf(data,len);
+				}
+				nl_bin_ref_add(rd,ret);
+			}
+			break;
+		case NL_BIN_ARRAY:
+			{
+				unsigned long long int len=nl_bin_take_varint(rd);
+				if(rd->err){
+					break;
+				}
+				ret=nl_val_malloc(ARRAY);
+				nl_bin_ref_add(rd,ret);
+				while((len>0) && (!(rd->err))){
+					nl_array_push(ret,nl_bin_read_val(rd));
+					len--;
+				}
+			}
+			break;
+		case NL_BIN_SYMBOL:
+			{
+				const char *t=nl_bin_take(rd,1);
+				if(t==NULL){
+					break;
+				}
+				ret=nl_val_malloc(SYMBOL);
+				nl_bin_ref_add(rd,ret);
+				ret->d.sym.t=(nl_type)(*t);
+				ret->d.sym.name=nl_bin_read_val(rd);
+				if((!(rd->err)) && ((ret->d.sym.t>=NL_TYPE_CNT) || (ret->d.sym.name->t!=ARRAY))){
+					rd->err=TRUE;
+				}
+			}
+			break;
+		case NL_BIN_EVALUATION:
+			ret=nl_val_malloc(EVALUATION);
+			nl_bin_ref_add(rd,ret);
+			ret->d.eval.sym=nl_bin_read_val(rd);
+			if((!(rd->err)) && (ret->d.eval.sym->t!=SYMBOL)){
+				rd->err=TRUE;
+			}
+			break;
+		case NL_BIN_BIND:
+			ret=nl_val_malloc(BIND);
+			nl_bin_ref_add(rd,ret);
+			ret->d.bind.sym=nl_bin_read_val(rd);
+			ret->d.bind.v=nl_bin_read_val(rd);
+			if((!(rd->err)) && (ret->d.bind.sym->t!=SYMBOL)){
+				rd->err=TRUE;
+			}
+			break;
+		case NL_BIN_STRUCT:
+			{
+				unsigned long long int len=nl_bin_take_varint(rd);
+				if(rd->err){
+					break;
+				}
+				ret=nl_val_malloc(STRUCT);
+				nl_bin_ref_add(rd,ret);
+				while((len>0) && (!(rd->err))){
+					nl_val *sym=nl_val_malloc(SYMBOL);
+					sym->d.sym.name=nl_bin_read_val(rd);
+					nl_val *v=nl_bin_read_val(rd);
+					if((!(rd->err)) && (sym->d.sym.name->t==ARRAY)){
+						nl_bind(sym,v,ret->d.nl_struct.env,FALSE);
+					}else{
+						rd->err=TRUE;
+					}
+					nl_val_free(sym);
+					nl_val_free(v);
+					len--;
+				}
+			}
+			break;
+		case NL_BIN_SUB:
+			if(rd->global_env==NULL){
+				rd->err=TRUE;
+				break;
+			}
+			ret=nl_val_malloc(SUB);
+			nl_bin_ref_add(rd,ret);
+			{
+				nl_val *outer_sub=rd->cur_sub;
+				rd->cur_sub=ret;
+				ret->d.sub->args=nl_bin_read_val(rd);
+				ret->d.sub->dflt_args=nl_bin_read_val(rd);
+				ret->d.sub->body=nl_bin_read_val(rd);
+				rd->cur_sub=outer_sub;
+			}
+			ret->d.sub->env=nl_bin_read_env(rd);
+			//a closure always owns its own frame; one that's missing (from bad data) gets an empty one so it can still be freed normally
+			if(ret->d.sub->env==NULL){
+				rd->err=TRUE;
+				ret->d.sub->env=nl_env_frame_malloc(NULL);
+			}
+			break;
+		case NL_BIN_PRI:
+			{
+				unsigned int length=0;
+				char *name=nl_bin_take_name(rd,&length);
+				if((name==NULL) || (rd->pri_env==NULL)){
+					free(name);
+					rd->err=TRUE;
+					break;
+				}
+				char success=FALSE;
+				nl_val *pri=nl_trie_match(rd->pri_env->trie,name,0,length,&success,FALSE);
+				if((!success) || (pri->t!=PRI)){
+					ERR(nl_null,"primitive procedure in image isn't in this version's standard library",FALSE);
+					rd->err=TRUE;
+				}else{
+					ret=nl_val_cp(pri);
+				}
+				free(name);
+			}
+			break;
+		//recur is the closure being read, without a new reference (just like nl_eval_sub substitutes it)
+		case NL_BIN_RECUR:
+			if(rd->cur_sub==NULL){
+				rd->err=TRUE;
+				break;
+			}
+			ret=rd->cur_sub;
+			break;
+		//a back-reference gets a copy of the value it refers to (for strings this shares storage)
+		case NL_BIN_REF:
+			{
+				unsigned long long int idx=nl_bin_take_varint(rd);
+				if((rd->err) || (idx>=(rd->ref_cnt))){
+					rd->err=TRUE;
+					break;
+				}
+				ret=nl_val_cp(rd->refs[idx]);
+			}
+			break;
+		//a line tag just applies to what comes after it
+		case NL_BIN_LINE:
+			rd->line=(unsigned int)(nl_bin_take_varint(rd));
+			if(!(rd->err)){
+				return nl_bin_read_val(rd);
+			}
+			break;
+		default:
+			rd->err=TRUE;
+			break;
+	}
+	
+	//values made here (rather than copied or shared) are given the source line they were on, if there was one
+	if((line>0) && (ret!=nl_null) && (ret->line_slot==0) && (tag_val!=NL_BIN_REF) && (tag_val!=NL_BIN_RECUR) && (tag_val!=NL_BIN_PRI)){
+		ret->line_slot=nl_line_slot(line);
+	}
+	return ret;
+}
+
+//add the header (magic bytes and version) to the start of binary output
+void nl_bin_put_header(nl_bin_writer *w){
+	char version=NL_BIN_VERSION;
+	nl_bin_put(w,NL_BIN_MAGIC,strlen(NL_BIN_MAGIC));
+	nl_bin_put(w,&version,1);
+}
+
+//check the header (magic bytes and version) at the start of binary input
+//returns TRUE if it's fine, otherwise outputs an error about err_val and returns FALSE
+char nl_bin_read_header(nl_bin_reader *rd, nl_val *err_val){
+	const char *header=nl_bin_take(rd,strlen(NL_BIN_MAGIC)+1);
+	if((header==NULL) || (memcmp(header,NL_BIN_MAGIC,strlen(NL_BIN_MAGIC))!=0)){
+		ERR_EXIT(err_val,"data is not a value encoded in binary",TRUE);
+		return FALSE;
+	}
+	//anything from an earlier version can still be read, since tags are only ever added
+	char version=header[strlen(NL_BIN_MAGIC)];
+	if((version<1) || (version>NL_BIN_VERSION)){
+		ERR_EXIT(err_val,"data was encoded in binary by a newer version of neulang",TRUE);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//encode a value in the compact binary format
+//returns the encoded bytes, or, if a handle is given as the second argument, writes them to that handle and returns TRUE
+nl_val *nl_val_to_bin(nl_val *arg_list){
+	int argc=nl_c_list_size(arg_list);
+	if((argc<1) || (argc>2)){
+		ERR_EXIT(arg_list,"wrong number of arguments given to val->bin (takes a value, and optionally a handle to write to)",TRUE);
+		return nl_null;
+	}
+	
+	nl_handle *h=NULL;
+	if(argc>1){
+		h=nl_handle_for_writing(arg_list->d.pair.r->d.pair.f,"wrong type argument given to val->bin, expecting a handle");
+		if(h==NULL){
+			return nl_null;
+		}
+	}
+	
+	nl_bin_writer w;
+	nl_bin_writer_init(&w,h);
+	nl_bin_put_header(&w);
+	nl_bin_write_val(&w,arg_list->d.pair.f);
+	nl_bin_writer_cleanup(&w);
+	
+	nl_val *ret=nl_null;
+	if(h!=NULL){
+		ret=nl_val_malloc(BYTE);
+		ret->d.byte.v=(w.err)?FALSE:TRUE;
+		if(w.err){
+			ERR_EXIT(arg_list->d.pair.r->d.pair.f,"could not write binary value to file",TRUE);
+		}
+	}else{
+		if(!(w.err)){
+			ret=nl_array_from_bytes(w.out,0,w.len);
+		}
+		nl_bytes_release(w.out);
+	}
+	return ret;
+}
+
+//decode a value from the binary format, given either a byte array or a handle to read the next value from
+//returns NULL if the data isn't a valid encoded value
+nl_val *nl_bin_to_val(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to bin->val (takes a byte array or a handle)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *src=arg_list->d.pair.f;
+	
+	//arrays that aren't packed are packed into a temporary copy first
+	nl_val *packed=nl_null;
+	nl_reader *r=NULL;
+	if(src->t==HANDLE){
+		nl_handle *h=nl_handle_for_reading(src,"wrong type argument given to bin->val, expecting a byte array or a handle");
+		if(h==NULL){
+			return nl_null;
+		}
+		r=h->r;
+	}else if(src->t==ARRAY){
+		if(src->flags & NL_VAL_PACKED){
+			packed=nl_val_cp(src);
+		}else{
+			packed=nl_val_malloc(ARRAY);
+			unsigned int n;
+			for(n=0;n<(src->d.array.size);n++){
+				const nl_val *c=nl_array_entry(src,n);
+				if(c->t!=BYTE){
+					nl_val_free(packed);
+					ERR_EXIT(src,"non-byte value in array given to bin->val",TRUE);
+					return nl_null;
+				}
+				nl_array_push_bytes(packed,&(c->d.byte.v),1);
+			}
+		}
+	}else{
+		ERR_EXIT(src,"wrong type argument given to bin->val, expecting a byte array or a handle",TRUE);
+		return nl_null;
+	}
+	
+	nl_bin_reader rd;
+	nl_bin_reader_init(&rd,packed,r);
+	
+	nl_val *ret=nl_null;
+	if(nl_bin_read_header(&rd,src)){
+		ret=nl_bin_read_val(&rd);
+		if(rd.err){
+			nl_val_free(ret);
+			ret=nl_null;
+			ERR_EXIT(src,"data given to bin->val is truncated or corrupt",TRUE);
+		}
+	}
+	
+	free(rd.refs);
+	free(rd.envs);
+	nl_val_free(packed);
+	return ret;
+}
+
+//save an interpreter image; this is every global binding that isn't just what the standard library binds anyway (and isn't argv)
+//returns TRUE on success, FALSE on error
+char nl_image_save(nl_env_frame *global_env, const char *fname){
+	//a fresh standard library environment, to compare against and to name primitives by
+	nl_env_frame *stdlib_env=nl_env_frame_malloc(NULL);
+	nl_bind_stdlib(stdlib_env);
+	
+	nl_bin_writer w;
+	nl_bin_writer_init(&w,NULL);
+	w.global_env=global_env;
+	w.pri_env=stdlib_env;
+	
+	nl_bin_put_header(&w);
+	nl_bin_write_trie(&w,global_env->trie,stdlib_env->trie);
+	nl_bin_writer_cleanup(&w);
+	nl_env_frame_free(stdlib_env);
+	
+	//the image is written the same way ar->file writes files, so a half-written image is never seen
+	nl_val *args=nl_null;
+	if(!(w.err)){
+		args=nl_val_malloc(PAIR);
+		args->d.pair.f=nl_str_from_c_str(fname);
+		args->d.pair.r=nl_val_malloc(PAIR);
+		args->d.pair.r->d.pair.f=nl_array_from_bytes(w.out,0,w.len);
+	}
+	nl_bytes_release(w.out);
+	if(w.err){
+		return FALSE;
+	}
+	
+	nl_val *written=nl_str_to_file(args);
+	char ret=nl_is_true(written);
+	nl_val_free(written);
+	nl_val_free(args);
+	return ret;
+}
+
+//evaluate an image-save statement; this saves an image of the global environment (the one the given environment is in) to the named file right away
+//returns TRUE on success, FALSE on error
+nl_val *nl_eval_image_save(nl_val *arguments, nl_env_frame *env){
+	//this writes a file, so it can't be done speculatively
+	nl_par_impure();
+	
+	if((arguments->t!=PAIR) || (arguments->d.pair.r!=nl_null)){
+		ERR_EXIT(arguments,"wrong syntax for image-save statement (takes exactly one file name)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *fname=nl_eval(arguments->d.pair.f,env,FALSE,NULL);
+	//null-out the list element we got rid of
+	arguments->d.pair.f=nl_null;
+	if(fname->t!=ARRAY){
+		ERR_EXIT(fname,"wrong type argument given to image-save, expecting a file name",TRUE);
+		nl_val_free(fname);
+		return nl_null;
+	}
+	
+	nl_env_frame *global_env=env;
+	while(global_env->up_scope!=NULL){
+		global_env=global_env->up_scope;
+	}
+	
+	char *fname_str=c_str_from_nl_str(fname);
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=nl_image_save(global_env,fname_str);
+	if(!(ret->d.byte.v)){
+		ERR_EXIT(fname,"could not save image",TRUE);
+	}
+	free(fname_str);
+	nl_val_free(fname);
+	return ret;
+}
+
+//load an interpreter image saved with nl_image_save into the given global environment
+//returns TRUE on success, FALSE on error
+char nl_image_load(nl_env_frame *global_env, const char *fname){
+	//images are memory mapped, and the strings in them stay views of the mapping
+	nl_val *args=nl_val_malloc(PAIR);
+	args->d.pair.f=nl_str_from_c_str(fname);
+	nl_val *image=nl_str_from_file(args);
+	if(image==nl_null){
+		nl_val_free(args);
+		return FALSE;
+	}
+	
+	//primitives are looked up by name in a fresh standard library, since the global environment could have anything bound by now
+	nl_env_frame *stdlib_env=nl_env_frame_malloc(NULL);
+	nl_bind_stdlib(stdlib_env);
+	
+	nl_bin_reader rd;
+	nl_bin_reader_init(&rd,image,NULL);
+	rd.global_env=global_env;
+	rd.pri_env=stdlib_env;
+	
+	char ret=FALSE;
+	if(nl_bin_read_header(&rd,args->d.pair.f)){
+		nl_bin_read_trie(&rd,global_env);
+		if(rd.err){
+			ERR_EXIT(args->d.pair.f,"image is truncated or corrupt",TRUE);
+		}else{
+			ret=TRUE;
+		}
+	}
+	
+	free(rd.refs);
+	free(rd.envs);
+	nl_env_frame_free(stdlib_env);
+	nl_val_free(image);
+	nl_val_free(args);
+	return ret;
+}
+
+//END C-NL-STDLIB-BIN SUBROUTINES  --------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-SOURCE SUBROUTINES  ---------------------------------------------------------------------------
+
+//hash source text for the source cache (64-bit FNV-1a)
+unsigned long long int nl_source_hash(const char *data, unsigned int length){
+	unsigned long long int hash=14695981039346656037ULL;
+	unsigned int n;
+	for(n=0;n<length;n++){
+		hash^=(unsigned char)(data[n]);
+		hash*=1099511628211ULL;
+	}
+	return hash;
+}
+
+//parse all of a source file's text into a list of (line . expression) pairs, where line is the line the reader was on after that expression
+//the global line number and end of program flag are left as they were
+nl_val *nl_source_parse(const char *data, unsigned int length){
+	unsigned int outer_line=nl_vm_cur->line_number;
+	char outer_end=nl_vm_cur->end_program;
+	nl_vm_cur->line_number=1;
+	nl_vm_cur->end_program=FALSE;
+	
+	nl_reader *reader=nl_reader_from_buf(data,length);
+	
+	//ignore shebang (#!) line, if there is one
+	if((nl_reader_peek(reader,0)=='#') && (nl_reader_peek(reader,1)=='!')){
+		int c=nl_reader_getc(reader);
+		while((c!='\n') && (c!=EOF)){
+			c=nl_reader_getc(reader);
+		}
+		nl_vm_cur->line_number++;
+	}
+	
+	nl_val *ret=nl_null;
+	nl_val *last=nl_null;
+	while(!nl_vm_cur->end_program){
+		nl_val *exp=nl_read_exp(reader);
+		
+		//nothing was read (trailing whitespace or comments); there's nothing to evaluate
+		if(exp==nl_null){
+			continue;
+		}
+		
+		nl_val *entry=nl_val_malloc(PAIR);
+		entry->d.pair.f=nl_val_malloc(NUM);
+		entry->d.pair.f->d.num.n=nl_vm_cur->line_number;
+		entry->d.pair.f->d.num.d=1;
+		entry->d.pair.r=exp;
+		
+		nl_val *cell=nl_val_malloc(PAIR);
+		cell->d.pair.f=entry;
+		cell->d.pair.r=nl_null;
+		if(last==nl_null){
+			ret=cell;
+		}else{
+			last->d.pair.r=cell;
+		}
+		last=cell;
+	}
+	
+	nl_reader_free(reader);
+	
+	nl_vm_cur->line_number=outer_line;
+	nl_vm_cur->end_program=outer_end;
+	return ret;
+}
+
+//load the cached parse of a source file, if the cache is there and was made from exactly this text by this interpreter
+//returns the list of (line . expression) pairs, or NULL if the cache can't be used
+nl_val *nl_source_cache_load(nl_val *cache_fname, unsigned long long int hash){
+	//a missing cache is the usual case the first time, and not worth an error
+	char *c_fname=c_str_from_nl_str(cache_fname);
+	char exists=(access(c_fname,R_OK)==0);
+	free(c_fname);
+	if(!exists){
+		return NULL;
+	}
+	
+	nl_val *args=nl_val_malloc(PAIR);
+	args->d.pair.f=nl_val_cp(cache_fname);
+	nl_val *cache=nl_str_from_file(args);
+	nl_val_free(args);
+	if((cache==nl_null) || !(cache->flags & NL_VAL_PACKED)){
+		nl_val_free(cache);
+		return NULL;
+	}
+	
+	nl_bin_reader rd;
+	nl_bin_reader_init(&rd,cache,NULL);
+	
+	//anything that doesn't match exactly (an old format, another build, or changed source) is just ignored, and re-written later
+	nl_val *ret=NULL;
+	const char *header=nl_bin_take(&rd,strlen(NL_BIN_MAGIC)+1);
+	if((header!=NULL) && (memcmp(header,NL_BIN_MAGIC,strlen(NL_BIN_MAGIC))==0) && (header[strlen(NL_BIN_MAGIC)]==NL_BIN_VERSION)){
+		unsigned int length=0;
+		char *key=nl_bin_take_name(&rd,&length);
+		if((key!=NULL) && (strcmp(key,NL_SOURCE_CACHE_KEY)==0) && (nl_bin_take_varint(&rd)==hash) && !(rd.err)){
+			ret=nl_bin_read_val(&rd);
+			if(rd.err){
+				nl_val_free(ret);
+				ret=NULL;
+			}
+		}
+		free(key);
+	}
+	
+	free(rd.refs);
+	free(rd.envs);
+	nl_val_free(cache);
+	return ret;
+}
+
+//write the cached parse of a source file; failure (for instance a read-only directory) just means there's no cache next time
+void nl_source_cache_save(nl_val *cache_fname, unsigned long long int hash, nl_val *exps){
+	//this changes the file system, so it can't be done speculatively
+	nl_par_impure();
+	
+	nl_bin_writer w;
+	nl_bin_writer_init(&w,NULL);
+	w.lines=TRUE;
+	
+	nl_bin_put_header(&w);
+	nl_bin_put_name(&w,NL_SOURCE_CACHE_KEY,strlen(NL_SOURCE_CACHE_KEY));
+	nl_bin_put_varint(&w,hash);
+	nl_bin_write_val(&w,exps);
+	nl_bin_writer_cleanup(&w);
+	
+	//this is written like ar->file writes, so a script started while the cache is being written never sees half of it
+	if(!(w.err)){
+		char *fname=c_str_from_nl_str(cache_fname);
+		char *tmp_name=(char*)(malloc(strlen(fname)+8));
+		sprintf(tmp_name,"%s.XXXXXX",fname);
+		int fd=mkstemp(tmp_name);
+		if(fd>=0){
+			mode_t mask=umask(0);
+			umask(mask);
+			fchmod(fd,0666&(~mask));
+			
+			char written=nl_fd_write(fd,w.out->data,w.len);
+			if((close(fd)!=0) || (!written) || (rename(tmp_name,fname)!=0)){
+				unlink(tmp_name);
+			}
+		}
+		free(tmp_name);
+		free(fname);
+	}
+	nl_bytes_release(w.out);
+}
+
+//read a source file into a list of (line . expression) pairs, from the cache when the file hasn't changed since it was cached
+//returns NULL if the file is empty or couldn't be read (in which case an error is output)
+nl_val *nl_source_read(nl_val *fname){
+	nl_val *args=nl_val_malloc(PAIR);
+	args->d.pair.f=nl_val_cp(fname);
+	nl_val *src=nl_str_from_file(args);
+	nl_val_free(args);
+	if((src==nl_null) || (src->d.array.size==0)){
+		nl_val_free(src);
+		return nl_null;
+	}
+	
+	//file->ar gives a packed array, but this keeps working if it ever doesn't
+	if(!(src->flags & NL_VAL_PACKED)){
+		nl_val *packed=nl_val_malloc(ARRAY);
+		unsigned int n;
+		for(n=0;n<(src->d.array.size);n++){
+			nl_array_push_bytes(packed,&(nl_array_entry(src,n)->d.byte.v),1);
+		}
+		nl_val_free(src);
+		src=packed;
+	}
+	
+	const char *data=nl_array_bytes(src);
+	unsigned int length=src->d.array.size;
+	unsigned long long int hash=nl_source_hash(data,length);
+	
+	nl_val *ret=NULL;
+	nl_val *cache_fname=NULL;
+	if(nl_source_cache){
+		cache_fname=nl_val_cp(fname);
+		nl_str_push_cstr(cache_fname,NL_SOURCE_CACHE_EXT);
+		ret=nl_source_cache_load(cache_fname,hash);
+	}
+	
+	if(ret==NULL){
+		//a file with errors or warnings isn't cached, so they're output every time it's run (and not just the first)
+		unsigned int err_cnt=nl_vm_cur->err_cnt;
+		ret=nl_source_parse(data,length);
+		if((cache_fname!=NULL) && (nl_vm_cur->err_cnt==err_cnt)){
+			nl_source_cache_save(cache_fname,hash,ret);
+		}
+	}
+	
+	if(cache_fname!=NULL){
+		nl_val_free(cache_fname);
+	}
+	nl_val_free(src);
+	return ret;
+}
+
+//read and evaluate each expression of a source file in the given environment, stopping early if the program exits
+//returns the result of the last expression
+nl_val *nl_source_eval(nl_val *fname, nl_env_frame *env){
+	unsigned int outer_line=nl_vm_cur->line_number;
+	
+	nl_val *exps=nl_source_read(fname);
+	
+	nl_val *ret=nl_null;
+	nl_val *current=exps;
+	while((current!=nl_null) && (!nl_vm_cur->end_program)){
+		nl_val *entry=current->d.pair.f;
+		
+		//evaluation changes expressions as it goes, so each one is taken out of the list rather than shared with it
+		nl_val *exp=entry->d.pair.r;
+		entry->d.pair.r=nl_null;
+		nl_vm_cur->line_number=(unsigned int)(entry->d.pair.f->d.num.n);
+		
+		nl_val_free(ret);
+		nl_perf_counts perf_start;
+		char perf=nl_perf_on && nl_perf_form_start(&perf_start);
+		ret=nl_eval(exp,env,FALSE,NULL);
+		if(perf){
+			nl_perf_form_end(&perf_start,(unsigned int)(entry->d.pair.f->d.num.n));
+		}
+		
+		current=current->d.pair.r;
+	}
+	nl_val_free(exps);
+	
+	nl_vm_cur->line_number=outer_line;
+	return ret;
+}
+
+//END C-NL-STDLIB-SOURCE SUBROUTINES  -----------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-PAR SUBROUTINES  ------------------------------------------------------------------------------
+
+//the worker threads are started the first time there's parallel work, and then wait for more until the process exits
+//one job runs at a time; nl_par_lock protects the current job, workers wait on nl_par_wake for chunks to claim,
+//and the thread that started the job waits on nl_par_finished for the last chunk to be done
+pthread_mutex_t nl_par_lock=PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t nl_par_wake=PTHREAD_COND_INITIALIZER;
+pthread_cond_t nl_par_finished=PTHREAD_COND_INITIALIZER;
+nl_par_job *nl_par_job_cur=NULL;
+unsigned int nl_par_worker_cnt=0;
+char nl_par_started=FALSE;
+
+//the task scheduler has one deque per thread; worker n has deque n, and deque 0 is for the first interpreter that wants one
+nl_par_deque *nl_par_deques=NULL;
+unsigned int nl_par_deque_cnt=0;
+char nl_par_root_claimed=FALSE;
+
+//the number of workers that are (about to be) asleep on nl_par_wake; new tasks wake one up if there are any
+int nl_par_sleeping=0;
+
+//values and memory taken out of environments other threads could be reading (see nl_par_retire)
+pthread_mutex_t nl_par_retired_lock=PTHREAD_MUTEX_INITIALIZER;
+nl_val **nl_par_retired_vals=NULL;
+unsigned int nl_par_retired_val_cnt=0;
+unsigned int nl_par_retired_val_size=0;
+void **nl_par_retired_mem=NULL;
+unsigned int nl_par_retired_mem_cnt=0;
+unsigned int nl_par_retired_mem_size=0;
+
+//called before anything a parallel map chunk can't do in parallel and still act exactly like a sequential map would
+//(output, input, file changes, errors, exit); a chunk that gets here is abandoned and its part of the array is mapped in order later
+void nl_par_impure(){
+	if((nl_vm_cur!=NULL) && (nl_vm_cur->par_task)){
+		longjmp(*(nl_vm_cur->par_abort),1);
+	}
+}
+
+//returns the time in nanoseconds (from an arbitrary starting point; for measuring how long things take)
+unsigned long long int nl_par_now_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return (((unsigned long long int)(t.tv_sec))*1000000000ULL)+((unsigned long long int)(t.tv_nsec));
+}
+
+//make a copy of a mapping subroutine for one thread to use
+//a closure's own reference count is changed on every recursive call, so if threads shared one they'd all be fighting over it
+//the copy has its own body (with recursion pointing at the copy) and an empty closure environment above the original one
+nl_val *nl_par_sub_clone(nl_val *sub){
+	if(sub->t!=SUB){
+		return nl_val_cp(sub);
+	}
+	
+	nl_val *ret=nl_val_malloc(SUB);
+	ret->d.sub->args=nl_val_cp(sub->d.sub->args);
+	ret->d.sub->dflt_args=nl_val_cp(sub->d.sub->dflt_args);
+	ret->d.sub->body=nl_val_cp(sub->d.sub->body);
+	ret->d.sub->env=nl_env_frame_malloc(sub->d.sub->env);
+	ret->d.sub->env->par_call=TRUE;
+	ret->d.sub->line=sub->d.sub->line;
+	ret->d.sub->prof_name=sub->d.sub->prof_name;
+	ret->d.sub->prof_id=__atomic_load_n(&(sub->d.sub->prof_id),__ATOMIC_RELAXED);
+	
+	//recur was substituted with the original closure; make it the copy instead
+	if(ret->d.sub->body!=nl_null){
+		nl_substitute_elements_skipsub(ret->d.sub->body,sub,ret);
+	}
+	return ret;
+}
+
+//map (or fold) a chunk of a parallel job on the current thread
+void nl_par_run_chunk(nl_par_job *job, unsigned int chunk){
+	nl_vm *vm=nl_vm_cur;
+	
+	//values being mapped were read by the interpreter that started the job, so errors need its line numbers
+	unsigned int *line_table=vm->line_table;
+	unsigned int line_number=vm->line_number;
+	unsigned int prof_depth=vm->prof_depth;
+	unsigned int prof_call_depth=vm->prof_call_depth;
+	vm->line_table=job->line_table;
+	vm->line_number=job->line_number;
+	
+	unsigned int start=job->start+(chunk*job->grain);
+	unsigned int end=start+job->grain;
+	if(end>job->a->d.array.size){
+		end=job->a->d.array.size;
+	}
+	
+	jmp_buf abort_point;
+	vm->par_abort=&abort_point;
+	vm->par_task=TRUE;
+	if(setjmp(abort_point)==0){
+		nl_val *sub=nl_par_sub_clone(job->sub);
+		
+		//closures made by the mapping subroutine link up to the copy's environment, so if any are returned the copy has to stay
+		char keep_sub=FALSE;
+		
+		unsigned int n;
+		if(job->fold){
+			job->res[start]=nl_array_fold_range(job->a,start+1,end,nl_val_cp(nl_array_entry(job->a,start)),sub);
+			keep_sub=nl_val_has_sub(job->res[start]);
+		}else{
+			for(n=start;n<end;n++){
+				//pass the value in the array as an argument to the mapping subroutine
+				nl_val *args=nl_val_malloc(PAIR);
+				args->d.pair.f=nl_val_cp(nl_array_entry(job->a,n));
+				
+				job->res[n]=nl_apply(sub,args,NULL);
+				if(nl_val_has_sub(job->res[n])){
+					keep_sub=TRUE;
+				}
+				
+				nl_val_free(args);
+			}
+		}
+		
+		if(!keep_sub){
+			nl_val_free(sub);
+		}
+	}else{
+		//NOTE: whatever the abandoned element was in the middle of isn't free'd; this only happens on errors and side effects, which are rare here
+		job->aborted[chunk]=TRUE;
+	}
+	vm->par_task=FALSE;
+	vm->par_abort=NULL;
+	
+	vm->line_table=line_table;
+	vm->line_number=line_number;
+	vm->prof_depth=prof_depth;
+	if(nl_prof_counting){
+		nl_prof_count_unwind(vm,prof_call_depth);
+	}
+}
+
+//claim and map chunks of the current job until there are none left; returns FALSE if there was no job with chunks left
+//NOTE: nl_par_lock must be held when this is called, and is held again when it returns
+char nl_par_work(){
+	nl_par_job *job=nl_par_job_cur;
+	if((job==NULL) || (job->next_chunk>=job->chunk_cnt)){
+		return FALSE;
+	}
+	
+	while(job->next_chunk<job->chunk_cnt){
+		unsigned int chunk=job->next_chunk;
+		job->next_chunk++;
+		
+		//chunks after an abandoned one will be redone in order anyway, so there's no point in mapping them now
+		if(chunk>job->first_aborted){
+			job->aborted[chunk]=TRUE;
+		}else{
+			pthread_mutex_unlock(&nl_par_lock);
+			nl_par_run_chunk(job,chunk);
+			pthread_mutex_lock(&nl_par_lock);
+			
+			if((job->aborted[chunk]) && (chunk<job->first_aborted)){
+				job->first_aborted=chunk;
+			}
+		}
+		
+		job->done_chunks++;
+		if(job->done_chunks==job->chunk_cnt){
+			pthread_cond_broadcast(&nl_par_finished);
+		}
+	}
+	return TRUE;
+}
+
+//keep a value (or other memory) that was taken out of an environment until no parallel work is running
+//other threads could still be reading it, so it's free'd by nl_par_release instead of here; either argument can be NULL
+void nl_par_retire(nl_val *v, void *mem){
+	pthread_mutex_lock(&nl_par_retired_lock);
+	if(v!=NULL){
+		if(nl_par_retired_val_cnt>=nl_par_retired_val_size){
+			nl_par_retired_val_size=(nl_par_retired_val_size>0)?(nl_par_retired_val_size*2):64;
+			nl_par_retired_vals=(nl_val**)(realloc(nl_par_retired_vals,nl_par_retired_val_size*sizeof(nl_val*)));
+			if(nl_par_retired_vals==NULL){
+				ERR_EXIT(nl_null,"could not realloc retired values (out of memory?)",FALSE);
+				exit(1);
+			}
+		}
+		nl_par_retired_vals[nl_par_retired_val_cnt]=v;
+		nl_par_retired_val_cnt++;
+	}
+	if(mem!=NULL){
+		if(nl_par_retired_mem_cnt>=nl_par_retired_mem_size){
+			nl_par_retired_mem_size=(nl_par_retired_mem_size>0)?(nl_par_retired_mem_size*2):64;
+			nl_par_retired_mem=(void**)(realloc(nl_par_retired_mem,nl_par_retired_mem_size*sizeof(void*)));
+			if(nl_par_retired_mem==NULL){
+				ERR_EXIT(nl_null,"could not realloc retired memory (out of memory?)",FALSE);
+				exit(1);
+			}
+		}
+		nl_par_retired_mem[nl_par_retired_mem_cnt]=mem;
+		nl_par_retired_mem_cnt++;
+	}
+	pthread_mutex_unlock(&nl_par_retired_lock);
+}
+
+//finish with the given number of pieces of parallel work (see nl_par_active)
+//once there's none left nothing else can be reading anything that was retired, so it's all free'd
+void nl_par_release(int cnt){
+	if(__atomic_sub_fetch(&nl_par_active,cnt,__ATOMIC_SEQ_CST)>0){
+		return;
+	}
+	
+	pthread_mutex_lock(&nl_par_retired_lock);
+	nl_val **vals=nl_par_retired_vals;
+	unsigned int val_cnt=nl_par_retired_val_cnt;
+	void **mem=nl_par_retired_mem;
+	unsigned int mem_cnt=nl_par_retired_mem_cnt;
+	nl_par_retired_vals=NULL;
+	nl_par_retired_val_cnt=0;
+	nl_par_retired_val_size=0;
+	nl_par_retired_mem=NULL;
+	nl_par_retired_mem_cnt=0;
+	nl_par_retired_mem_size=0;
+	pthread_mutex_unlock(&nl_par_retired_lock);
+	
+	unsigned int n;
+	for(n=0;n<val_cnt;n++){
+		nl_val_free(vals[n]);
+	}
+	free(vals);
+	for(n=0;n<mem_cnt;n++){
+		free(mem[n]);
+	}
+	free(mem);
+}
+
+//mark the given frame and every frame above it as visible to tasks, so changes to them are made safely (see nl_bind)
+void nl_par_expose(nl_env_frame *env){
+	//anything above a frame that's already visible is visible too
+	while((env!=NULL) && (!env->par_visible)){
+		env->par_visible=TRUE;
+		env=env->up_scope;
+	}
+}
+
+//push a task onto the bottom of a deque; only the thread that owns the deque does this
+//returns FALSE if the deque is full
+char nl_par_deque_push(nl_par_deque *dq, nl_par_task *task){
+	long b=__atomic_load_n(&(dq->bottom),__ATOMIC_RELAXED);
+	long t=__atomic_load_n(&(dq->top),__ATOMIC_ACQUIRE);
+	if((b-t)>=NL_PAR_DEQUE_SIZE){
+		return FALSE;
+	}
+	__atomic_store_n(&(dq->tasks[b%NL_PAR_DEQUE_SIZE]),task,__ATOMIC_RELAXED);
+	__atomic_store_n(&(dq->bottom),b+1,__ATOMIC_RELEASE);
+	return TRUE;
+}
+
+//pop the newest task off the bottom of a deque; only the thread that owns the deque does this
+//returns NULL if the deque was empty (or a thief took the last task first)
+nl_par_task *nl_par_deque_pop(nl_par_deque *dq){
+	long b=__atomic_load_n(&(dq->bottom),__ATOMIC_RELAXED)-1;
+	__atomic_store_n(&(dq->bottom),b,__ATOMIC_SEQ_CST);
+	long t=__atomic_load_n(&(dq->top),__ATOMIC_SEQ_CST);
+	
+	nl_par_task *ret=NULL;
+	if(t<=b){
+		ret=__atomic_load_n(&(dq->tasks[b%NL_PAR_DEQUE_SIZE]),__ATOMIC_RELAXED);
+		//the last task could be stolen at the same time, so the owner has to take it the same way a thief would
+		if(t==b){
+			if(!__atomic_compare_exchange_n(&(dq->top),&t,t+1,FALSE,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED)){
+				ret=NULL;
+			}
+			__atomic_store_n(&(dq->bottom),b+1,__ATOMIC_RELAXED);
+		}
+	}else{
+		__atomic_store_n(&(dq->bottom),b+1,__ATOMIC_RELAXED);
+	}
+	return ret;
+}
+
+//steal the oldest task off the top of a deque; any thread can do this
+//returns NULL if the deque was empty or another thread got there first
+nl_par_task *nl_par_deque_steal(nl_par_deque *dq){
+	long t=__atomic_load_n(&(dq->top),__ATOMIC_SEQ_CST);
+	long b=__atomic_load_n(&(dq->bottom),__ATOMIC_SEQ_CST);
+	if(t>=b){
+		return NULL;
+	}
+	nl_par_task *ret=__atomic_load_n(&(dq->tasks[t%NL_PAR_DEQUE_SIZE]),__ATOMIC_RELAXED);
+	if(!__atomic_compare_exchange_n(&(dq->top),&t,t+1,FALSE,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED)){
+		return NULL;
+	}
+	return ret;
+}
+
+//returns TRUE if any deque has tasks on it
+char nl_par_tasks_ready(){
+	unsigned int cnt=__atomic_load_n(&nl_par_deque_cnt,__ATOMIC_ACQUIRE);
+	unsigned int n;
+	for(n=0;n<cnt;n++){
+		if(__atomic_load_n(&(nl_par_deques[n].top),__ATOMIC_SEQ_CST)<__atomic_load_n(&(nl_par_deques[n].bottom),__ATOMIC_SEQ_CST)){
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+//find a task for this thread to run: its own newest task if it has one, otherwise (if steal is TRUE) the oldest task of another thread
+//returns NULL if there's nothing to do
+nl_par_task *nl_par_find_task(char steal){
+	nl_vm *vm=nl_vm_cur;
+	nl_par_task *ret=NULL;
+	if(vm->par_deque!=NULL){
+		ret=nl_par_deque_pop(vm->par_deque);
+	}
+	
+	unsigned int cnt=__atomic_load_n(&nl_par_deque_cnt,__ATOMIC_ACQUIRE);
+	if((ret==NULL) && (steal) && (cnt>0)){
+		vm->par_victim++;
+		unsigned int n;
+		for(n=0;(ret==NULL) && (n<cnt);n++){
+			nl_par_deque *dq=&(nl_par_deques[(vm->par_victim+n)%cnt]);
+			if(dq!=vm->par_deque){
+				ret=nl_par_deque_steal(dq);
+			}
+		}
+	}
+	return ret;
+}
+
+//wake up a sleeping worker (if there are any) because there's a new task
+void nl_par_notify(){
+	//the task was published before this check, and a worker counts itself as sleeping before it checks for tasks one last time,
+	//so either it sees the task or this sees it
+	if(__atomic_load_n(&nl_par_sleeping,__ATOMIC_SEQ_CST)>0){
+		pthread_mutex_lock(&nl_par_lock);
+		pthread_cond_signal(&nl_par_wake);
+		pthread_mutex_unlock(&nl_par_lock);
+	}
+}
+
+//give back the deque an interpreter claimed in nl_par_start (if it has one), so another interpreter can use it
+void nl_par_deque_release(nl_vm *vm){
+	if((vm->par_deque!=NULL) && (vm->par_deque==&(nl_par_deques[0]))){
+		pthread_mutex_lock(&nl_par_lock);
+		nl_par_root_claimed=FALSE;
+		pthread_mutex_unlock(&nl_par_lock);
+	}
+	vm->par_deque=NULL;
+}
+
+//make a task to evaluate the given statements (which become part of the task) with the variables they use from the given environment
+nl_par_task *nl_par_task_malloc(nl_val *body, nl_env_frame *env){
+	nl_par_task *ret=(nl_par_task*)(malloc(sizeof(nl_par_task)));
+	if(ret==NULL){
+		ERR_EXIT(nl_null,"could not malloc a task (out of memory?)",FALSE);
+		exit(1);
+	}
+	ret->body=body;
+	
+	//variables are captured into a frame above the nearest shared one (like a closure's), since application frames can go away first
+	nl_env_frame *shared_env=env;
+	while((shared_env!=NULL) && (!shared_env->shared)){
+		shared_env=shared_env->up_scope;
+	}
+	ret->env=nl_env_frame_malloc(shared_env);
+	nl_par_capture(body,env,ret->env);
+	
+	ret->run_env=NULL;
+	ret->result=NULL;
+	ret->state=NL_PAR_TASK_WAITING;
+	ret->runner=NULL;
+	ret->pushed=FALSE;
+	ret->ref=1;
+	ret->next=NULL;
+	return ret;
+}
+
+//drop a reference to a task, freeing it if that was the last one
+void nl_par_task_release(nl_par_task *task){
+	//a future can be let go of on one thread while its interpreter finishes it on another, so this is always atomic
+	if(__atomic_sub_fetch(&(task->ref),1,__ATOMIC_ACQ_REL)>0){
+		return;
+	}
+	
+	nl_val_free(task->body);
+	
+	//closures made in the result's evaluation link up to the frames it was evaluated in, so those stay if there are any
+	//(a finished task has usually let go of them already; see nl_par_task_eval)
+	if((task->result==NULL) || (!nl_val_links_env(task->result,task->env))){
+		nl_env_frame_free(task->run_env);
+		nl_env_frame_free(task->env);
+	}
+	if(task->result!=NULL){
+		nl_val_free(task->result);
+	}
+	free(task);
+}
+
+//offer a task to other threads by pushing it onto this thread's deque
+//returns FALSE if it couldn't be (this interpreter has no deque, or it's full); the task is then only run when it's needed
+char nl_par_task_spawn(nl_par_task *task){
+	nl_par_deque *dq=nl_vm_cur->par_deque;
+	if(dq==NULL){
+		return FALSE;
+	}
+	
+	//from now on other threads can see the frames above the task, so changes to those have to be made safely
+	nl_par_expose(task->env);
+	__atomic_add_fetch(&nl_par_active,1,__ATOMIC_SEQ_CST);
+	
+	task->pushed=TRUE;
+	if(!nl_par_deque_push(dq,task)){
+		task->pushed=FALSE;
+		nl_par_release(1);
+		return FALSE;
+	}
+	nl_par_notify();
+	return TRUE;
+}
+
+//evaluate a task on this thread, in a fresh frame above its variables
+//futures it makes are finished before it's done, like they are for a subroutine call
+void nl_par_task_eval(nl_par_task *task){
+	nl_vm *vm=nl_vm_cur;
+	nl_par_task *futures=vm->futures;
+	__atomic_store_n(&(task->runner),vm,__ATOMIC_RELAXED);
+	
+	task->run_env=nl_env_frame_malloc(task->env);
+	if(vm->prof_stack!=NULL){
+		nl_prof_push(vm,((unsigned long long)(NL_PROF_NAME_FUTURE))<<32);
+	}
+	unsigned int prof_call_depth=vm->prof_call_depth;
+	if(nl_prof_counting){
+		nl_prof_count_enter(vm,nl_prof_key(FALSE,((unsigned long long)(NL_PROF_NAME_FUTURE))<<32,0),TRUE);
+	}
+	nl_val *ret=nl_eval_sequence(nl_val_cp(task->body),task->run_env,NULL);
+	if(nl_prof_counting){
+		nl_prof_count_leave(vm,prof_call_depth);
+	}
+	if(vm->prof_stack!=NULL){
+		nl_prof_pop(vm);
+	}
+	if(vm->futures!=futures){
+		nl_par_sync(futures);
+	}
+	
+	task->result=ret;
+	
+	//a finished task doesn't need its body or the variables it captured anymore, unless closures in the result link up to them;
+	//letting go of them now breaks the cycle when the future is bound in a closure the body uses (such as with recur)
+	if(!nl_val_links_env(ret,task->env)){
+		nl_env_frame_free(task->run_env);
+		task->run_env=NULL;
+		nl_env_frame_free(task->env);
+		task->env=NULL;
+		nl_val_free(task->body);
+		task->body=nl_null;
+	}
+	__atomic_store_n(&(task->runner),NULL,__ATOMIC_RELAXED);
+}
+
+//run a task speculatively; like a parallel map chunk, it's abandoned (and left NL_PAR_TASK_ABORTED) if it does anything with side effects
+void nl_par_task_run(nl_par_task *task){
+	nl_vm *vm=nl_vm_cur;
+	
+	//tasks can be run while waiting on other tasks (or inside other tasks), so whatever this thread was doing is put back afterward
+	char par_task=vm->par_task;
+	jmp_buf *par_abort=vm->par_abort;
+	nl_par_task *futures=vm->futures;
+	unsigned int prof_depth=vm->prof_depth;
+	unsigned int prof_call_depth=vm->prof_call_depth;
+	
+	__atomic_store_n(&(task->state),NL_PAR_TASK_RUNNING,__ATOMIC_RELAXED);
+	
+	jmp_buf abort_point;
+	vm->par_abort=&abort_point;
+	vm->par_task=TRUE;
+	if(setjmp(abort_point)==0){
+		nl_par_task_eval(task);
+		
+		vm->par_task=par_task;
+		vm->par_abort=par_abort;
+		__atomic_store_n(&(task->state),NL_PAR_TASK_DONE,__ATOMIC_RELEASE);
+	}else{
+		//futures made by this run can see its frame, so they have to be out of the way before it's free'd
+		//NOTE: as with parallel map chunks, whatever the run was in the middle of isn't free'd
+		nl_par_wait(futures);
+		nl_env_frame_free(task->run_env);
+		task->run_env=NULL;
+		__atomic_store_n(&(task->runner),NULL,__ATOMIC_RELAXED);
+		
+		vm->par_task=par_task;
+		vm->par_abort=par_abort;
+		vm->prof_depth=prof_depth;
+		if(nl_prof_counting){
+			nl_prof_count_unwind(vm,prof_call_depth);
+		}
+		__atomic_store_n(&(task->state),NL_PAR_TASK_ABORTED,__ATOMIC_RELEASE);
+	}
+}
+
+//do something useful while waiting for a task another thread is running
+//a thread that's in the middle of a task only runs its own newer tasks, since a stolen one could end up waiting on the task it's in
+void nl_par_help(){
+	nl_par_task *task=nl_par_find_task(!nl_vm_cur->par_task);
+	if(task!=NULL){
+		nl_par_task_run(task);
+	}else{
+		sched_yield();
+	}
+}
+
+//get the result of a task, running it here if nothing else has (or if its last run was abandoned)
+//returns NULL if the task is being run by this thread already (it's waiting on itself)
+nl_val *nl_par_force(nl_par_task *task){
+	nl_vm *vm=nl_vm_cur;
+	while(TRUE){
+		int state=__atomic_load_n(&(task->state),__ATOMIC_ACQUIRE);
+		if(state==NL_PAR_TASK_DONE){
+			return task->result;
+		}
+		
+		//a task that isn't on a deque or was abandoned is run by whichever thread that needs it gets to it first
+		if((state==NL_PAR_TASK_ABORTED) || ((state==NL_PAR_TASK_WAITING) && (!task->pushed))){
+			if(__atomic_compare_exchange_n(&(task->state),&state,NL_PAR_TASK_RUNNING,FALSE,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)){
+				if(vm->par_task){
+					//inside a task this is speculative too, so if the task needs side effects, so does the one waiting on it
+					nl_par_task_run(task);
+					if(__atomic_load_n(&(task->state),__ATOMIC_ACQUIRE)==NL_PAR_TASK_ABORTED){
+						nl_par_impure();
+					}
+				}else{
+					nl_par_task_eval(task);
+					__atomic_store_n(&(task->state),NL_PAR_TASK_DONE,__ATOMIC_RELEASE);
+				}
+			}
+			continue;
+		}
+		
+		if(__atomic_load_n(&(task->runner),__ATOMIC_RELAXED)==vm){
+			return NULL;
+		}
+		nl_par_help();
+	}
+	return NULL;
+}
+
+//finish every future this interpreter made after the given one (NULL for all of them), oldest first
+//they can see the frames of the call that made them, so this is done before that call returns (see nl_apply)
+//and because abandoned futures are evaluated again here, in order, their side effects happen just as they would have sequentially
+void nl_par_sync(nl_par_task *mark){
+	nl_vm *vm=nl_vm_cur;
+	unsigned int cnt=0;
+	nl_par_task *task;
+	for(task=vm->futures;task!=mark;task=task->next){
+		cnt++;
+	}
+	if(cnt==0){
+		return;
+	}
+	
+	//the list is newest first
+	nl_par_task **order=(nl_par_task**)(malloc(cnt*sizeof(nl_par_task*)));
+	if(order==NULL){
+		ERR_EXIT(nl_null,"could not malloc futures to finish (out of memory?)",FALSE);
+		exit(1);
+	}
+	unsigned int n=cnt;
+	for(task=vm->futures;task!=mark;task=task->next){
+		n--;
+		order[n]=task;
+	}
+	for(n=0;n<cnt;n++){
+		nl_par_force(order[n]);
+	}
+	free(order);
+	
+	nl_par_wait(mark);
+}
+
+//wait for (but don't finish) every future this interpreter made after the given one, and let go of them
+//this is for when the frames they can see are about to go away anyway (an abandoned task, or an exit)
+void nl_par_wait(nl_par_task *mark){
+	nl_vm *vm=nl_vm_cur;
+	while(vm->futures!=mark){
+		nl_par_task *task=vm->futures;
+		
+		//a future that's on a deque or being run somewhere has to be finished with before anything it can see is free'd
+		int state;
+		while(((state=__atomic_load_n(&(task->state),__ATOMIC_ACQUIRE))==NL_PAR_TASK_RUNNING) || ((state==NL_PAR_TASK_WAITING) && (task->pushed))){
+			nl_par_help();
+		}
+		if(task->pushed){
+			nl_par_release(1);
+		}
+		
+		vm->futures=task->next;
+		task->next=NULL;
+		nl_par_task_release(task);
+	}
+}
+
+//capture the variables the given expression uses from the given environment into the captured frame
+//so a task sees them as they were when it was made, whatever happens to the environment afterward
+void nl_par_capture(nl_val *exp, nl_env_frame *env, nl_env_frame *captured){
+	while(exp->t==PAIR){
+		nl_par_capture(exp->d.pair.f,env,captured);
+		exp=exp->d.pair.r;
+	}
+	
+	if(exp->t==BIND){
+		nl_par_capture(exp->d.bind.v,env,captured);
+	}else if(exp->t==EVALUATION){
+		nl_val *symbol=exp->d.eval.sym;
+		char *symbol_c_str=c_str_from_nl_str(symbol->d.sym.name);
+		unsigned int length=symbol->d.sym.name->d.array.size;
+		
+		char success=FALSE;
+		nl_trie_match(captured->trie,symbol_c_str,0,length,&success,FALSE);
+		
+		//a variable that isn't bound anywhere yet is left for the task to find (or not) when it runs
+		nl_env_frame *frame;
+		for(frame=env;(!success) && (frame!=NULL);frame=frame->up_scope){
+			nl_val *value=nl_trie_match(frame->trie,symbol_c_str,0,length,&success,FALSE);
+			if(success){
+				nl_bind(symbol,value,captured,FALSE);
+			}
+		}
+		free(symbol_c_str);
+	}
+}
+
+//evaluate each argument as a task, and return an array of the results (in order)
+//the first branch is evaluated here while other threads take the rest; any a thread doesn't get to are evaluated here too
+nl_val *nl_eval_par(nl_val *arguments, nl_env_frame *env){
+	nl_val *ret=nl_val_malloc(ARRAY);
+	unsigned int cnt=nl_c_list_size(arguments);
+	if(cnt==0){
+		return ret;
+	}
+	
+	nl_par_task **tasks=(nl_par_task**)(malloc(cnt*sizeof(nl_par_task*)));
+	if(tasks==NULL){
+		ERR_EXIT(nl_null,"could not malloc par tasks (out of memory?)",FALSE);
+		exit(1);
+	}
+	unsigned int n=0;
+	nl_val *branch;
+	for(branch=arguments;branch->t==PAIR;branch=branch->d.pair.r){
+		nl_val *body=nl_val_malloc(PAIR);
+		body->d.pair.f=nl_val_cp(branch->d.pair.f);
+		tasks[n]=nl_par_task_malloc(body,env);
+		n++;
+	}
+	
+	//branches are pushed last first, so if no other thread takes them this one pops them back in order
+	unsigned int pushed=0;
+	if((cnt>1) && (nl_par_start()>1)){
+		for(n=cnt-1;n>0;n--){
+			if(nl_par_task_spawn(tasks[n])){
+				pushed++;
+			}
+		}
+	}
+	if(pushed>0){
+		nl_par_task_run(tasks[0]);
+	}
+	
+	//abandoned branches (and all of them, with only one thread) are evaluated as their results are collected, in order
+	for(n=0;n<cnt;n++){
+		nl_val *result=nl_par_force(tasks[n]);
+		nl_array_push(ret,nl_val_cp(result));
+	}
+	if(pushed>0){
+		nl_par_release(pushed);
+	}
+	
+	for(n=0;n<cnt;n++){
+		nl_par_task_release(tasks[n]);
+	}
+	free(tasks);
+	return ret;
+}
+
+//start evaluating the given statements as a task, and return a future for the result right away (see nl_touch)
+nl_val *nl_eval_future(nl_val *arguments, nl_env_frame *env){
+	if(arguments->t!=PAIR){
+		ERR_EXIT(arguments,"wrong syntax for future statement (takes at least one expression)",TRUE);
+		return nl_null;
+	}
+	
+	nl_par_task *task=nl_par_task_malloc(nl_val_cp(arguments),env);
+	
+	//one reference for the future value and one for this interpreter's list of futures to finish
+	task->ref=2;
+	task->next=nl_vm_cur->futures;
+	nl_vm_cur->futures=task;
+	
+	if(nl_par_start()>1){
+		nl_par_task_spawn(task);
+	}
+	
+	nl_val *ret=nl_val_malloc(FUTURE);
+	ret->d.future=task;
+	return ret;
+}
+
+//wait for the result of a future (evaluating it here if no other thread has), and return it
+//anything that isn't a future is already its own result
+nl_val *nl_touch(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to touch (takes exactly 1 argument)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *v=arg_list->d.pair.f;
+	if(v->t!=FUTURE){
+		return nl_val_cp(v);
+	}
+	
+	nl_val *result=nl_par_force(v->d.future);
+	if(result==NULL){
+		ERR_EXIT(v,"future was touched while it was still being evaluated (it's waiting for itself)",TRUE);
+		return nl_null;
+	}
+	return nl_val_cp(result);
+}
+
+//returns TRUE if the given value is plain data (no closures, primitives, structs, handles, or futures) and so can be frozen
+char nl_val_freezable(nl_val *v){
+	while((v->t==PAIR) && (!(v->flags & NL_VAL_FROZEN))){
+		if(!nl_val_freezable(v->d.pair.f)){
+			return FALSE;
+		}
+		v=v->d.pair.r;
+	}
+	
+	if(v->flags & NL_VAL_FROZEN){
+		return TRUE;
+	}
+	switch(v->t){
+		case BYTE:
+		case NUM:
+		case SYMBOL:
+		case EVALUATION:
+		case NL_NULL:
+			return TRUE;
+		case BIND:
+			return nl_val_freezable(v->d.bind.v);
+		case ARRAY:
+			if(!(v->flags & NL_VAL_PACKED)){
+				unsigned int n;
+				for(n=0;n<v->d.array.size;n++){
+					if(!nl_val_freezable(nl_array_entry(v,n))){
+						return FALSE;
+					}
+				}
+			}
+			return TRUE;
+		default:
+			break;
+	}
+	return FALSE;
+}
+
+//mark the given value and everything in it as frozen (see NL_VAL_FROZEN)
+//NOTE: nothing else may have a reference to any part of the value yet (nl_freeze makes a copy first)
+void nl_val_freeze(nl_val *v){
+	while((v->t==PAIR) && (!(v->flags & NL_VAL_FROZEN))){
+		v->flags|=NL_VAL_FROZEN;
+		nl_val_freeze(v->d.pair.f);
+		v=v->d.pair.r;
+	}
+	if(v->flags & NL_VAL_FROZEN){
+		return;
+	}
+	v->flags|=NL_VAL_FROZEN;
+	
+	switch(v->t){
+		case SYMBOL:
+			nl_val_freeze(v->d.sym.name);
+			break;
+		case EVALUATION:
+			nl_val_freeze(v->d.eval.sym);
+			break;
+		case BIND:
+			nl_val_freeze(v->d.bind.sym);
+			nl_val_freeze(v->d.bind.v);
+			break;
+		//packed storage is counted separately from the arrays that use it, and this array just keeps its reference forever
+		//copies of frozen data can end up in other isolates, so the storage is counted atomically from now on
+		case ARRAY:
+			if(!(v->flags & NL_VAL_PACKED)){
+				unsigned int n;
+				for(n=0;n<v->d.array.size;n++){
+					nl_val_freeze(nl_array_entry(v,n));
+				}
+			}else{
+				__atomic_store_n(&(v->d.array.bytes->shared),TRUE,__ATOMIC_RELEASE);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+//return a frozen copy of the given value (see NL_VAL_FROZEN); this is for large read-only data that parallel work shares
+//looking up a frozen value only copies its top level (arrays and lists share their elements), and threads never contend over it
+//frozen values are never free'd, so this is meant for data that's kept for the rest of the program
+nl_val *nl_freeze(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=1){
+		ERR_EXIT(arg_list,"wrong number of arguments given to freeze (takes exactly 1 argument)",TRUE);
+		return nl_null;
+	}
+	nl_val *v=arg_list->d.pair.f;
+	if(!nl_val_freezable(v)){
+		ERR_EXIT(v,"only plain data can be frozen (not closures, primitives, structs, handles, or futures)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_val_cp(v);
+	nl_val_freeze(ret);
+	return ret;
+}
+
+//the main loop for a worker thread; runs tasks and helps with parallel jobs, and sleeps when there's nothing to do
+//arg is the worker's own task deque
+void *nl_par_worker(void *arg){
+	//every worker has its own interpreter state (keywords, error count, and so on)
+	nl_vm_enter(nl_vm_malloc());
+	nl_vm_cur->par_deque=(nl_par_deque*)(arg);
+	if(nl_prof_fname!=NULL){
+		nl_prof_vm_init(nl_vm_cur,"par-worker");
+	}
+	if(nl_prof_counting){
+		nl_prof_count_vm_init(nl_vm_cur);
+	}
+	
+	unsigned int idle=0;
+	while(TRUE){
+		char worked=FALSE;
+		nl_par_task *task=nl_par_find_task(TRUE);
+		if(task!=NULL){
+			nl_par_task_run(task);
+			worked=TRUE;
+		}else if(__atomic_load_n(&nl_par_job_cur,__ATOMIC_ACQUIRE)!=NULL){
+			pthread_mutex_lock(&nl_par_lock);
+			worked=nl_par_work();
+			pthread_mutex_unlock(&nl_par_lock);
+		}
+		
+		//tasks tend to come in bursts, so an idle worker keeps looking for a little while before it goes to sleep
+		if(worked){
+			idle=0;
+		}else if(idle<NL_PAR_IDLE_SPINS){
+			idle++;
+			sched_yield();
+		}else{
+			pthread_mutex_lock(&nl_par_lock);
+			__atomic_add_fetch(&nl_par_sleeping,1,__ATOMIC_SEQ_CST);
+			if((!nl_par_work()) && (!nl_par_tasks_ready())){
+				pthread_cond_wait(&nl_par_wake,&nl_par_lock);
+			}
+			__atomic_sub_fetch(&nl_par_sleeping,1,__ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&nl_par_lock);
+			idle=0;
+		}
+	}
+	return NULL;
+}
+
+//start the worker threads, if they aren't already running, and give this interpreter a task deque if one is free
+//returns the total number of threads available for parallel work (1 if there are no workers)
+unsigned int nl_par_start(){
+	if(!__atomic_load_n(&nl_par_started,__ATOMIC_ACQUIRE)){
+		nl_par_start_workers();
+	}
+	
+	//the first interpreter to get here gets the task deque that isn't a worker's; any others run their tasks when they're needed
+	if((nl_vm_cur->par_deque==NULL) && (nl_par_worker_cnt>0)){
+		pthread_mutex_lock(&nl_par_lock);
+		if(!nl_par_root_claimed){
+			nl_par_root_claimed=TRUE;
+			nl_vm_cur->par_deque=&(nl_par_deques[0]);
+		}
+		pthread_mutex_unlock(&nl_par_lock);
+	}
+	return nl_par_worker_cnt+1;
+}
+
+//start the worker threads and their task deques (see nl_par_start)
+void nl_par_start_workers(){
+	pthread_mutex_lock(&nl_par_lock);
+	if(!nl_par_started){
+		//by default there's one thread per processor
+		unsigned int threads=nl_par_threads;
+		if(threads==0){
+			long cpus=sysconf(_SC_NPROCESSORS_ONLN);
+			threads=(cpus>0)?((unsigned int)(cpus)):1;
+		}
+		
+		nl_par_deques=(nl_par_deque*)(calloc(threads,sizeof(nl_par_deque)));
+		if(nl_par_deques==NULL){
+			ERR_EXIT(nl_null,"could not malloc task deques (out of memory?)",FALSE);
+			exit(1);
+		}
+		__atomic_store_n(&nl_par_deque_cnt,threads,__ATOMIC_RELEASE);
+		
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+		pthread_attr_setstacksize(&attr,NL_PAR_STACK_SIZE);
+		
+		//the thread that starts a job works on it too, so it's not counted as a worker
+		unsigned int n;
+		for(n=1;n<threads;n++){
+			pthread_t worker;
+			if(pthread_create(&worker,&attr,nl_par_worker,&(nl_par_deques[n]))!=0){
+				//fewer workers just means less parallelism
+				break;
+			}
+			nl_par_worker_cnt++;
+		}
+		pthread_attr_destroy(&attr);
+		
+		__atomic_store_n(&nl_par_started,TRUE,__ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&nl_par_lock);
+}
+
+//split the elements of an array from start on into chunks and map them (or if fold is TRUE, fold each chunk) on all free threads
+//elem_ns is about how long each element takes; if that's not enough work to be worth splitting up, nothing is done here
+//results go in res (see nl_par_job), and for folds the chunk size is put in grain
+//returns the index of the first element without a result; everything from there on has to be done in order by the caller
+unsigned int nl_par_run_job(nl_val *a, nl_val *sub, nl_val **res, unsigned int start, unsigned long long int elem_ns, char fold, unsigned int *grain){
+	unsigned int size=a->d.array.size;
+	unsigned int n=start;
+	
+	//parallel work inside a chunk of another job just runs in order, since the other threads are already busy
+	if((n<size) && (!nl_vm_cur->par_task) && ((((unsigned long long int)(size-n))*elem_ns)>=NL_PAR_MIN_WORK_NS) && (nl_par_start()>1)){
+		unsigned int threads=nl_par_worker_cnt+1;
+		unsigned int left=size-n;
+		
+		//chunks are big enough to be worth handing out, but there are enough of them to keep every thread busy
+		unsigned int chunk_grain=(unsigned int)(NL_PAR_GRAIN_NS/elem_ns);
+		if(chunk_grain<1){
+			chunk_grain=1;
+		}
+		//(every chunk of a fold leaves a result to combine in order at the end, so folds use fewer, bigger chunks)
+		unsigned int max_chunks=threads*(fold?NL_PAR_FOLD_CHUNKS_PER_THREAD:NL_PAR_CHUNKS_PER_THREAD);
+		if(fold){
+			chunk_grain=(left+max_chunks-1)/max_chunks;
+		}
+		if(((left+chunk_grain-1)/chunk_grain)>max_chunks){
+			chunk_grain=(left+max_chunks-1)/max_chunks;
+		}
+		if(grain!=NULL){
+			(*grain)=chunk_grain;
+		}
+		
+		nl_par_job job;
+		job.sub=sub;
+		job.a=a;
+		job.fold=fold;
+		job.res=res;
+		job.start=n;
+		job.grain=chunk_grain;
+		job.chunk_cnt=(left+chunk_grain-1)/chunk_grain;
+		job.next_chunk=0;
+		job.done_chunks=0;
+		job.aborted=(char*)(calloc(job.chunk_cnt,sizeof(char)));
+		job.first_aborted=job.chunk_cnt;
+		job.line_table=nl_vm_cur->line_table;
+		job.line_number=nl_vm_cur->line_number;
+		
+		pthread_mutex_lock(&nl_par_lock);
+		//if another interpreter is using the workers then this just continues in order
+		if((job.aborted!=NULL) && (nl_par_job_cur==NULL)){
+			__atomic_add_fetch(&nl_par_active,1,__ATOMIC_SEQ_CST);
+			__atomic_store_n(&nl_par_job_cur,&job,__ATOMIC_RELEASE);
+			pthread_cond_broadcast(&nl_par_wake);
+			
+			//this thread works on the job too, then waits for any chunks still being done elsewhere
+			nl_par_work();
+			while(job.done_chunks<job.chunk_cnt){
+				pthread_cond_wait(&nl_par_finished,&nl_par_lock);
+			}
+			
+			__atomic_store_n(&nl_par_job_cur,NULL,__ATOMIC_RELEASE);
+			nl_par_release(1);
+			
+			//results up to the first abandoned chunk are kept; anything after that is done again, in order, by the caller
+			//so errors and side effects happen exactly as (and in the order) they would have sequentially
+			unsigned int kept=job.start+(job.first_aborted*job.grain);
+			if(kept>size){
+				kept=size;
+			}
+			unsigned int idx;
+			for(idx=kept;idx<size;idx++){
+				if(res[idx]!=NULL){
+					nl_val_free(res[idx]);
+					res[idx]=NULL;
+				}
+			}
+			n=kept;
+		}
+		pthread_mutex_unlock(&nl_par_lock);
+		free(job.aborted);
+	}
+	return n;
+}
+
+//map a subroutine over an array, using as many threads as is worthwhile
+//the result (and any errors or output) is exactly what ar-map would give; chunks that do anything with side effects,
+//or that read state a closure's earlier calls left in its environment (see nl_lookup), are redone in order
+nl_val *nl_array_pmap(nl_val *arg_list){
+	int argc=nl_c_list_size(arg_list);
+	if(argc!=2){
+		ERR_EXIT(arg_list,"wrong number of arguments given to parallel array map (takes exactly 2 arguments: array, mapping-sub)",TRUE);
+		return nl_null;
+	}
+	
+	if((arg_list->d.pair.f->t!=ARRAY)){
+		ERR_EXIT(arg_list,"wrong argument type given to parallel array map (require array as first operand)",TRUE);
+		return nl_null;
+	}
+	if(!((arg_list->d.pair.r->d.pair.f->t==SUB) || (arg_list->d.pair.r->d.pair.f->t==PRI))){
+		ERR_EXIT(arg_list,"wrong argument type given to parallel array map (require subroutine or primitive function as second operand)",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *full_array=arg_list->d.pair.f;
+	nl_val *map=arg_list->d.pair.r->d.pair.f;
+	unsigned int size=full_array->d.array.size;
+	
+	//results are collected here (in order) and put into the return array at the end
+	nl_val **res=(nl_val**)(calloc((size>0)?size:1,sizeof(nl_val*)));
+	if(res==NULL){
+		ERR_EXIT(nl_null,"could not malloc parallel map results (out of memory?)",FALSE);
+		exit(1);
+	}
+	
+	//map the first elements in order until there's a good idea how long each one takes
+	//(small arrays and cheap subroutines never get past this, since it's not worth waking other threads for them)
+	unsigned int n=0;
+	unsigned long long int elem_ns=0;
+	unsigned long long int sample_start=nl_par_now_ns();
+	while(n<size){
+		nl_val *args=nl_val_malloc(PAIR);
+		args->d.pair.f=nl_val_cp(nl_array_entry(full_array,n));
+		res[n]=nl_apply(map,args,NULL);
+		nl_val_free(args);
+		n++;
+		
+		unsigned long long int elapsed=nl_par_now_ns()-sample_start;
+		if(elapsed>=NL_PAR_SAMPLE_NS){
+			elem_ns=(elapsed/n)+1;
+			break;
+		}
+	}
+	
+	n=nl_par_run_job(full_array,map,res,n,elem_ns,FALSE,NULL);
+	
+	//anything left is mapped in order
+	while(n<size){
+		nl_val *args=nl_val_malloc(PAIR);
+		args->d.pair.f=nl_val_cp(nl_array_entry(full_array,n));
+		res[n]=nl_apply(map,args,NULL);
+		nl_val_free(args);
+		n++;
+	}
+	
+	nl_val *ret=nl_val_malloc(ARRAY);
+	for(n=0;n<size;n++){
+		nl_array_push(ret,res[n]);
+	}
+	free(res);
+	return ret;
+}
+
+//reduce an array to one value by combining its elements with an associative subroutine, using as many threads as is worthwhile
+//chunks of the array are each folded on their own thread and the results are combined in order, so with an associative combiner
+//the result is the same as ar-fold would give starting from the first element; chunks with side effects are redone in order
+//built-in combiners (+, *, b|, b&) on arrays of numbers or bytes are done as native loops instead
+nl_val *nl_array_reduce(nl_val *arg_list){
+	if(nl_c_list_size(arg_list)!=2){
+		ERR_EXIT(arg_list,"wrong number of arguments given to array reduce (takes exactly 2 arguments: array, combining-sub)",TRUE);
+		return nl_null;
+	}
+	nl_val *full_array=arg_list->d.pair.f;
+	nl_val *combiner=arg_list->d.pair.r->d.pair.f;
+	if(full_array->t!=ARRAY){
+		ERR_EXIT(arg_list,"wrong argument type given to array reduce (require array as first operand)",TRUE);
+		return nl_null;
+	}
+	if(!((combiner->t==SUB) || (combiner->t==PRI))){
+		ERR_EXIT(arg_list,"wrong argument type given to array reduce (require subroutine or primitive function as second operand)",TRUE);
+		return nl_null;
+	}
+	
+	//there's nothing to combine in an empty array
+	unsigned int size=full_array->d.array.size;
+	if(size==0){
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_array_fold_native(full_array,1,nl_array_entry(full_array,0),combiner);
+	if(ret!=NULL){
+		return ret;
+	}
+	
+	//fold the first elements in order until there's a good idea how long each one takes (see nl_array_pmap)
+	nl_val *acc=nl_val_cp(nl_array_entry(full_array,0));
+	unsigned int n=1;
+	unsigned long long int elem_ns=0;
+	unsigned long long int sample_start=nl_par_now_ns();
+	while(n<size){
+		acc=nl_array_fold_range(full_array,n,n+1,acc,combiner);
+		n++;
+		
+		unsigned long long int elapsed=nl_par_now_ns()-sample_start;
+		if(elapsed>=NL_PAR_SAMPLE_NS){
+			elem_ns=(elapsed/n)+1;
+			break;
+		}
+	}
+	
+	if(n<size){
+		nl_val **res=(nl_val**)(calloc(size,sizeof(nl_val*)));
+		if(res==NULL){
+			ERR_EXIT(nl_null,"could not malloc parallel reduce results (out of memory?)",FALSE);
+			exit(1);
+		}
+		
+		unsigned int grain=1;
+		unsigned int kept=nl_par_run_job(full_array,combiner,res,n,elem_ns,TRUE,&grain);
+		
+		//each finished chunk's result is combined into the accumulator in order
+		unsigned int idx;
+		for(idx=n;idx<kept;idx+=grain){
+			acc=nl_fold_step(combiner,acc,res[idx]);
+		}
+		n=kept;
+		free(res);
+	}
+	
+	//anything left is folded in order
+	return nl_array_fold_range(full_array,n,size,acc,combiner);
+}
+
+//END C-NL-STDLIB-PAR SUBROUTINES  --------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-CO SUBROUTINES  -------------------------------------------------------------------------------
+
+//coroutines are cooperative: only one of an interpreter's coroutines runs at a time, on the interpreter's own thread, and it only
+//stops at a channel operation, sleep, read, or yield; so unlike parallel work, coroutines can do anything with side effects
+//(work that just needs more processors still goes to the worker threads, through par, future, and ar-pmap)
+
+//make a coroutine to evaluate the given statements (which become part of it) with the variables they use from the given environment
+//with a NULL body this makes the coroutine for the program itself, which runs on the thread's own stack
+nl_co *nl_co_malloc(nl_val *body, nl_env_frame *env){
+	nl_co *ret=(nl_co*)(malloc(sizeof(nl_co)));
+	if(ret==NULL){
+		ERR_EXIT(nl_null,"could not malloc a coroutine (out of memory?)",FALSE);
+		exit(1);
+	}
+	ret->stack=NULL;
+	ret->body=body;
+	ret->env=NULL;
+	ret->state=NL_CO_READY;
+	ret->wake_ns=0;
+	ret->wait_fd=-1;
+	ret->queue=NULL;
+	ret->val=NULL;
+	ret->closed=FALSE;
+	ret->deadlock=FALSE;
+	ret->sent_sub=FALSE;
+	ret->line_number=nl_vm_cur->line_number;
+	ret->futures=NULL;
+	ret->prof_stack=NULL;
+	ret->prof_depth=0;
+	ret->prof_calls=NULL;
+	ret->prof_call_depth=0;
+	ret->prof_call_size=0;
+	ret->prof_paused_ns=0;
+	ret->prof_paused_allocs=0;
+	ret->next=NULL;
+	ret->all_next=NULL;
+	ret->all_prev=NULL;
+	
+	if(body==NULL){
+		return ret;
+	}
+	
+	//variables are captured into a frame that links to the global one; the frames of whatever spawned this can go away first
+	nl_env_frame *global_env=env;
+	while(global_env->up_scope!=NULL){
+		global_env=global_env->up_scope;
+	}
+	ret->env=nl_env_frame_malloc(global_env);
+	nl_par_capture(body,env,ret->env);
+	
+	//the lowest page of the stack is left unmapped, so a coroutine that recurses too far crashes rather than writing over memory
+	long page=sysconf(_SC_PAGESIZE);
+	ret->stack=(char*)(mmap(NULL,NL_CO_STACK_SIZE,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0));
+	if((ret->stack==MAP_FAILED) || (getcontext(&(ret->ctx))!=0)){
+		ERR_EXIT(nl_null,"could not make a stack for a coroutine (out of memory?)",FALSE);
+		exit(1);
+	}
+	mprotect(ret->stack,page,PROT_NONE);
+	
+	ret->ctx.uc_stack.ss_sp=(ret->stack)+page;
+	ret->ctx.uc_stack.ss_size=NL_CO_STACK_SIZE-page;
+	ret->ctx.uc_link=NULL;
+	makecontext(&(ret->ctx),nl_co_entry,0);
+	return ret;
+}
+
+//free a coroutine that isn't running (anything still on its stack is left as it is)
+void nl_co_free(nl_co *co){
+	if(co->stack!=NULL){
+		munmap(co->stack,NL_CO_STACK_SIZE);
+	}
+	if(co->body!=NULL){
+		nl_val_free(co->body);
+	}
+	if((co->env!=NULL) && (!co->sent_sub)){
+		nl_env_frame_free(co->env);
+	}
+	if(co->val!=NULL){
+		nl_val_free(co->val);
+	}
+	free(co->prof_stack);
+	free(co->prof_calls);
+	free(co);
+}
+
+//put a coroutine at the end of the queue of coroutines that are ready to run
+void nl_co_ready(nl_co *co){
+	nl_vm *vm=nl_vm_cur;
+	co->state=NL_CO_READY;
+	co->next=NULL;
+	if(vm->co_ready_last!=NULL){
+		vm->co_ready_last->next=co;
+	}else{
+		vm->co_ready=co;
+	}
+	vm->co_ready_last=co;
+}
+
+//put a coroutine at the end of the given channel queue
+void nl_co_queue(nl_co **queue, nl_co *co){
+	co->queue=queue;
+	co->next=NULL;
+	while(*queue!=NULL){
+		queue=&((*queue)->next);
+	}
+	*queue=co;
+}
+
+//take a coroutine out of the channel queue it's in
+void nl_co_unqueue(nl_co *co){
+	nl_co **link=co->queue;
+	while((link!=NULL) && (*link!=NULL)){
+		if(*link==co){
+			*link=co->next;
+			break;
+		}
+		link=&((*link)->next);
+	}
+	co->queue=NULL;
+	co->next=NULL;
+}
+
+//take the coroutine at the front of the given channel queue out of it and return it (NULL if the queue is empty)
+nl_co *nl_co_dequeue(nl_co **queue){
+	nl_co *ret=*queue;
+	if(ret!=NULL){
+		nl_co_unqueue(ret);
+	}
+	return ret;
+}
+
+//wait until a sleeping coroutine is due to wake up or one waiting for input can read it, and make those ready
+void nl_co_idle(nl_vm *vm){
+	unsigned long long int now=nl_par_now_ns();
+	long long int wait_ns=-1;
+	if(vm->co_sleeping!=NULL){
+		wait_ns=(vm->co_sleeping->wake_ns>now)?((long long int)(vm->co_sleeping->wake_ns-now)):0;
+	}
+	
+	if(vm->co_io!=NULL){
+		unsigned int cnt=0;
+		nl_co *co;
+		for(co=vm->co_io;co!=NULL;co=co->next){
+			cnt++;
+		}
+		struct pollfd *fds=(struct pollfd*)(malloc(cnt*sizeof(struct pollfd)));
+		if(fds==NULL){
+			ERR_EXIT(nl_null,"could not malloc descriptors to wait on (out of memory?)",FALSE);
+			exit(1);
+		}
+		unsigned int n=0;
+		for(co=vm->co_io;co!=NULL;co=co->next){
+			fds[n].fd=co->wait_fd;
+			fds[n].events=POLLIN;
+			fds[n].revents=0;
+			n++;
+		}
+		
+		//(errors and hangups count as something to read, since the read will see them)
+		int timeout=(wait_ns<0)?-1:((int)((wait_ns+999999)/1000000));
+		if(poll(fds,cnt,timeout)>0){
+			nl_co **link=&(vm->co_io);
+			for(n=0;n<cnt;n++){
+				co=*link;
+				if(fds[n].revents!=0){
+					*link=co->next;
+					co->wait_fd=-1;
+					nl_co_ready(co);
+				}else{
+					link=&(co->next);
+				}
+			}
+		}
+		free(fds);
+	}else if(wait_ns>0){
+		struct timespec t;
+		t.tv_sec=wait_ns/1000000000LL;
+		t.tv_nsec=wait_ns%1000000000LL;
+		nanosleep(&t,NULL);
+	}
+	
+	now=nl_par_now_ns();
+	while((vm->co_sleeping!=NULL) && (vm->co_sleeping->wake_ns<=now)){
+		nl_co *co=vm->co_sleeping;
+		vm->co_sleeping=co->next;
+		nl_co_ready(co);
+	}
+}
+
+//free the coroutine that finished last, if there is one; this is done by whichever coroutine runs next
+void nl_co_resumed(nl_vm *vm){
+	if(vm->co_dead!=NULL){
+		nl_co_free(vm->co_dead);
+		vm->co_dead=NULL;
+	}
+}
+
+//pause the running coroutine and run the next one that's ready (the running one has to be put wherever it's waiting first)
+//if nothing is ready this waits for a sleeping coroutine or input; if nothing ever could be ready again, whatever is waiting
+//is marked as deadlocked and carries on instead (see nl_co_wait)
+void nl_co_switch(){
+	nl_vm *vm=nl_vm_cur;
+	nl_co *cur=vm->co_cur;
+	while(vm->co_ready==NULL){
+		if((vm->co_sleeping!=NULL) || (vm->co_io!=NULL)){
+			nl_co_idle(vm);
+		}else if((cur->state!=NL_CO_DONE) && ((!vm->co_joining) || (cur==vm->co_main))){
+			cur->deadlock=TRUE;
+			cur->state=NL_CO_READY;
+			return;
+		}else{
+			//the program itself is the one left waiting (either on a channel, or for its coroutines to finish)
+			nl_co *main_co=vm->co_main;
+			main_co->deadlock=TRUE;
+			if(main_co->queue!=NULL){
+				nl_co_unqueue(main_co);
+			}
+			nl_co_ready(main_co);
+		}
+	}
+	
+	nl_co *next=vm->co_ready;
+	vm->co_ready=next->next;
+	if(vm->co_ready==NULL){
+		vm->co_ready_last=NULL;
+	}
+	next->next=NULL;
+	if(next==cur){
+		return;
+	}
+	
+	cur->line_number=vm->line_number;
+	cur->futures=vm->futures;
+	vm->co_cur=next;
+	vm->line_number=next->line_number;
+	vm->futures=next->futures;
+	if(vm->prof_stack!=NULL){
+		nl_prof_co_switch(vm,cur,next);
+	}
+	if(nl_prof_counting){
+		nl_prof_count_co_switch(vm,cur,next);
+	}
+	
+	swapcontext(&(cur->ctx),&(next->ctx));
+	nl_co_resumed(vm);
+}
+
+//where every spawned coroutine starts; this evaluates the coroutine's body and then runs the next one
+void nl_co_entry(){
+	nl_vm *vm=nl_vm_cur;
+	nl_co_resumed(vm);
+	nl_co *co=vm->co_cur;
+	
+	nl_env_frame *run_env=nl_env_frame_malloc(co->env);
+	if(vm->prof_stack!=NULL){
+		nl_prof_push(vm,((unsigned long long)(NL_PROF_NAME_SPAWN))<<32);
+	}
+	if(nl_prof_counting){
+		nl_prof_count_enter(vm,nl_prof_key(FALSE,((unsigned long long)(NL_PROF_NAME_SPAWN))<<32,0),TRUE);
+	}
+	nl_val_free(nl_eval_sequence(nl_val_cp(co->body),run_env,NULL));
+	if(nl_prof_counting){
+		nl_prof_count_leave(vm,0);
+	}
+	if(vm->prof_stack!=NULL){
+		nl_prof_pop(vm);
+	}
+	
+	//futures it made are finished before it's done, like they are for a subroutine call
+	nl_par_sync(NULL);
+	if(!co->sent_sub){
+		nl_env_frame_free(run_env);
+	}
+	
+	//the stack this is running on is free'd once the next coroutine is running
+	co->state=NL_CO_DONE;
+	if(co->all_prev!=NULL){
+		co->all_prev->all_next=co->all_next;
+	}else{
+		vm->co_all=co->all_next;
+	}
+	if(co->all_next!=NULL){
+		co->all_next->all_prev=co->all_prev;
+	}
+	vm->co_cnt--;
+	vm->co_dead=co;
+	
+	if((vm->co_cnt==0) && (vm->co_joining)){
+		nl_co_ready(vm->co_main);
+	}
+	nl_co_switch();
+}
+
+//make the running coroutine wait in the given channel queue until another one wakes it up
+//returns FALSE if nothing ever could (it's been taken back out of the queue)
+char nl_co_wait(nl_co **queue){
+	nl_vm *vm=nl_vm_cur;
+	
+	//without any coroutines there's nothing else that could wake this up
+	if(vm->co_cur==NULL){
+		return FALSE;
+	}
+	
+	nl_co *co=vm->co_cur;
+	nl_co_queue(queue,co);
+	co->state=NL_CO_WAITING;
+	nl_co_switch();
+	
+	if(co->deadlock){
+		co->deadlock=FALSE;
+		if(co->queue!=NULL){
+			nl_co_unqueue(co);
+		}
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//before a read that could block, let other coroutines run until the given file descriptor has something to read
+void nl_co_wait_fd(int fd){
+	nl_vm *vm=nl_vm_cur;
+	if((vm->co_cur==NULL) || (vm->co_cnt==0) || (vm->par_task)){
+		return;
+	}
+	
+	struct pollfd p;
+	p.fd=fd;
+	p.events=POLLIN;
+	p.revents=0;
+	if(poll(&p,1,0)!=0){
+		return;
+	}
+	
+	nl_co *co=vm->co_cur;
+	co->wait_fd=fd;
+	co->state=NL_CO_WAITING;
+	co->next=vm->co_io;
+	vm->co_io=co;
+	nl_co_switch();
+}
+
+//let other coroutines run while the running one sleeps for the given number of microseconds
+//returns FALSE if there are no other coroutines (so the caller should just sleep)
+char nl_co_sleep(unsigned long long int usec){
+	nl_vm *vm=nl_vm_cur;
+	if((vm->co_cur==NULL) || (vm->co_cnt==0) || (vm->par_task)){
+		return FALSE;
+	}
+	
+	nl_co *co=vm->co_cur;
+	co->wake_ns=nl_par_now_ns()+(usec*1000ULL);
+	co->state=NL_CO_WAITING;
+	
+	//the sleeping list is kept soonest first
+	nl_co **link=&(vm->co_sleeping);
+	while((*link!=NULL) && ((*link)->wake_ns<=co->wake_ns)){
+		link=&((*link)->next);
+	}
+	co->next=*link;
+	*link=co;
+	
+	nl_co_switch();
+	return TRUE;
+}
+
+//run the program's coroutines until they've all finished, before the program ends
+//any that are left waiting on something that will never happen are abandoned
+void nl_co_join(){
+	nl_vm *vm=nl_vm_cur;
+	if(vm->co_main==NULL){
+		return;
+	}
+	
+	vm->co_joining=TRUE;
+	while((vm->co_cnt>0) && (!vm->co_main->deadlock)){
+		vm->co_main->state=NL_CO_WAITING;
+		nl_co_switch();
+	}
+	vm->co_joining=FALSE;
+	vm->co_main->deadlock=FALSE;
+	
+	nl_co_abandon_all();
+}
+
+//free every coroutine that hasn't finished, without running any more of them (for the end of the program)
+void nl_co_abandon_all(){
+	nl_vm *vm=nl_vm_cur;
+	while(vm->co_all!=NULL){
+		nl_co *co=vm->co_all;
+		vm->co_all=co->all_next;
+		nl_co_free(co);
+	}
+	nl_co_resumed(vm);
+	vm->co_cnt=0;
+	vm->co_ready=NULL;
+	vm->co_ready_last=NULL;
+	vm->co_sleeping=NULL;
+	vm->co_io=NULL;
+}
+
+//start a coroutine to evaluate the given statements; it runs once the running coroutine waits or yields
+nl_val *nl_eval_spawn(nl_val *arguments, nl_env_frame *env){
+	nl_par_impure();
+	if(arguments->t!=PAIR){
+		ERR_EXIT(arguments,"wrong syntax for spawn statement (takes at least one expression)",TRUE);
+		return nl_null;
+	}
+	
+	//the program becomes a coroutine itself the first time it spawns one
+	nl_vm *vm=nl_vm_cur;
+	if(vm->co_main==NULL){
+		vm->co_main=nl_co_malloc(NULL,NULL);
+		vm->co_cur=vm->co_main;
+	}
+	
+	nl_co *co=nl_co_malloc(nl_val_cp(arguments),env);
+	co->all_next=vm->co_all;
+	if(vm->co_all!=NULL){
+		vm->co_all->all_prev=co;
+	}
+	vm->co_all=co;
+	vm->co_cnt++;
+	
+	nl_co_ready(co);
+	return nl_null;
+}
+
+//let other coroutines that are ready run before this one carries on
+nl_val *nl_co_yield(nl_val *arg_list){
+	nl_par_impure();
+	if(nl_vm_cur->co_cur!=NULL){
+		nl_co_ready(nl_vm_cur->co_cur);
+		nl_co_switch();
+	}
+	return nl_null;
+}
+
+//make a new channel, which holds at most the given number of values (0 if none is given)
+nl_val *nl_chan_new(nl_val *arg_list){
+	unsigned int cap=0;
+	if(arg_list->t==PAIR){
+		nl_val *cap_val=arg_list->d.pair.f;
+		if((cap_val->t!=NUM) || (cap_val->d.num.d!=1) || (cap_val->d.num.n<0) || (arg_list->d.pair.r!=nl_null)){
+			ERR_EXIT(arg_list,"wrong arguments given to chan (takes an optional capacity, a non-negative integer)",TRUE);
+			return nl_null;
+		}
+		cap=(unsigned int)(cap_val->d.num.n);
+	}
+	
+	nl_chan *ch=(nl_chan*)(malloc(sizeof(nl_chan)));
+	if(ch!=NULL){
+		ch->buf=NULL;
+		if(cap>0){
+			ch->buf=(nl_val**)(malloc(cap*sizeof(nl_val*)));
+		}
+	}
+	if((ch==NULL) || ((cap>0) && (ch->buf==NULL))){
+		ERR_EXIT(arg_list,"could not malloc a channel (out of memory?)",FALSE);
+		exit(1);
+	}
+	ch->cap=cap;
+	ch->head=0;
+	ch->cnt=0;
+	ch->closed=FALSE;
+	ch->senders=NULL;
+	ch->receivers=NULL;
+	
+	nl_val *ret=nl_val_malloc(CHANNEL);
+	ret->d.chan=ch;
+	return ret;
+}
+
+//free a channel and anything still queued in it
+//(nothing can be waiting on it, since a waiting coroutine has the channel in its arguments)
+void nl_chan_free(nl_chan *ch){
+	unsigned int n;
+	for(n=0;n<ch->cnt;n++){
+		nl_val_free(ch->buf[((ch->head)+n)%(ch->cap)]);
+	}
+	free(ch->buf);
+	free(ch);
+}
+
+//send a value on a channel, waiting until there's room for it (or, with a capacity of 0, until something receives it)
+//returns TRUE once the value is sent
+nl_val *nl_chan_send(nl_val *arg_list){
+	nl_par_impure();
+	if((nl_c_list_size(arg_list)!=2) || (arg_list->d.pair.f->t!=CHANNEL)){
+		ERR_EXIT(arg_list,"wrong arguments given to send (takes a channel and a value)",TRUE);
+		return nl_null;
+	}
+	nl_vm *vm=nl_vm_cur;
+	nl_chan *ch=arg_list->d.pair.f->d.chan;
+	nl_val *v=arg_list->d.pair.r->d.pair.f;
+	
+	if(ch->closed){
+		ERR_EXIT(arg_list->d.pair.f,"can't send on a closed channel",TRUE);
+		return nl_null;
+	}
+	if((vm->co_cur!=NULL) && (vm->co_cur->env!=NULL) && nl_val_links_env(v,vm->co_cur->env)){
+		vm->co_cur->sent_sub=TRUE;
+	}
+	
+	//a receiver can only be waiting if the queue is empty, so it's given the value straight away
+	nl_co *receiver=nl_co_dequeue(&(ch->receivers));
+	if(receiver!=NULL){
+		receiver->val=nl_val_cp(v);
+		nl_co_ready(receiver);
+	}else if(ch->cnt<ch->cap){
+		ch->buf[((ch->head)+(ch->cnt))%(ch->cap)]=nl_val_cp(v);
+		ch->cnt++;
+	}else{
+		//wait for a receive to take the value from here (see nl_chan_recv)
+		nl_co *co=vm->co_cur;
+		char sent=FALSE;
+		if(co!=NULL){
+			co->val=nl_val_cp(v);
+			sent=nl_co_wait(&(ch->senders));
+			if(co->val!=NULL){
+				nl_val_free(co->val);
+				co->val=NULL;
+			}
+			if(co->closed){
+				co->closed=FALSE;
+				ERR_EXIT(arg_list->d.pair.f,"channel was closed while send was waiting",TRUE);
+				return nl_null;
+			}
+		}
+		if(!sent){
+			ERR_EXIT(arg_list,"send would wait forever (deadlock; no other coroutine can ever receive from this channel)",TRUE);
+			return nl_null;
+		}
+	}
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=TRUE;
+	return ret;
+}
+
+//receive the next value from a channel, waiting until there is one; returns NULL once the channel is closed and empty
+nl_val *nl_chan_recv(nl_val *arg_list){
+	nl_par_impure();
+	if((nl_c_list_size(arg_list)!=1) || (arg_list->d.pair.f->t!=CHANNEL)){
+		ERR_EXIT(arg_list,"wrong arguments given to recv (takes a channel)",TRUE);
+		return nl_null;
+	}
+	nl_chan *ch=arg_list->d.pair.f->d.chan;
+	
+	nl_val *ret;
+	if(ch->cnt>0){
+		ret=ch->buf[ch->head];
+		ch->head=((ch->head)+1)%(ch->cap);
+		ch->cnt--;
+		
+		//that made room for the value of the sender that's been waiting longest
+		nl_co *sender=nl_co_dequeue(&(ch->senders));
+		if(sender!=NULL){
+			ch->buf[((ch->head)+(ch->cnt))%(ch->cap)]=sender->val;
+			ch->cnt++;
+			sender->val=NULL;
+			nl_co_ready(sender);
+		}
+		return ret;
+	}
+	
+	//with a capacity of 0, senders wait for a receive to take their value directly
+	nl_co *sender=nl_co_dequeue(&(ch->senders));
+	if(sender!=NULL){
+		ret=sender->val;
+		sender->val=NULL;
+		nl_co_ready(sender);
+		return ret;
+	}
+	
+	if(ch->closed){
+		return nl_null;
+	}
+	
+	if(!nl_co_wait(&(ch->receivers))){
+		ERR_EXIT(arg_list,"recv would wait forever (deadlock; no other coroutine can ever send on this channel)",TRUE);
+		return nl_null;
+	}
+	
+	//a sender (or a close, which leaves nothing) woke this up
+	nl_co *co=nl_vm_cur->co_cur;
+	ret=(co->val!=NULL)?co->val:nl_null;
+	co->val=NULL;
+	return ret;
+}
+
+//close the given channel(s); waiting receivers get NULL, and waiting senders get an error
+nl_val *nl_chan_close(nl_val *arg_list){
+	nl_par_impure();
+	while(arg_list->t==PAIR){
+		if(arg_list->d.pair.f->t!=CHANNEL){
+			ERR_EXIT(arg_list->d.pair.f,"wrong type argument given to chan-close, expecting a channel",TRUE);
+			return nl_null;
+		}
+		nl_chan *ch=arg_list->d.pair.f->d.chan;
+		ch->closed=TRUE;
+		
+		nl_co *co;
+		while((co=nl_co_dequeue(&(ch->receivers)))!=NULL){
+			nl_co_ready(co);
+		}
+		while((co=nl_co_dequeue(&(ch->senders)))!=NULL){
+			co->closed=TRUE;
+			nl_co_ready(co);
+		}
+		
+		arg_list=arg_list->d.pair.r;
+	}
+	return nl_null;
+}
+
+//END C-NL-STDLIB-CO SUBROUTINES  ---------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-ISOLATE SUBROUTINES  --------------------------------------------------------------------------
+
+//isolates are numbered in the order they're made, and stay registered (so their exit status can be found) until the process ends
+//nl_isolate_lock protects the registry and whether each isolate is done; anything waiting for one to end waits on nl_isolate_finished
+pthread_mutex_t nl_isolate_lock=PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t nl_isolate_finished=PTHREAD_COND_INITIALIZER;
+nl_isolate **nl_isolates=NULL;
+unsigned int nl_isolate_cnt=0;
+unsigned int nl_isolate_size=0;
+
+//the number of isolates that haven't ended yet
+unsigned int nl_isolate_running=0;
+
+__thread nl_isolate *nl_isolate_cur=NULL;
+
+//register a new isolate for the given program (which takes ownership of fname and argv), started by the given isolate
+nl_isolate *nl_isolate_malloc(char *fname, nl_val *argv, unsigned int parent){
+	nl_isolate *ret=(nl_isolate*)(malloc(sizeof(nl_isolate)));
+	if(ret==NULL){
+		ERR_EXIT(nl_null,"could not malloc an isolate (out of memory?)",FALSE);
+		exit(1);
+	}
+	ret->parent=parent;
+	ret->fname=fname;
+	ret->argv=argv;
+	ret->fp=NULL;
+	pthread_mutex_init(&(ret->lock),NULL);
+	ret->msgs=NULL;
+	ret->msgs_last=NULL;
+	ret->done=FALSE;
+	ret->exit_status=0;
+	
+	//receivers that find the count at 0 either let other coroutines run or block, so reads never wait here
+	ret->wake_fd=eventfd(0,EFD_SEMAPHORE|EFD_NONBLOCK|EFD_CLOEXEC);
+	if(ret->wake_fd<0){
+		ERR_EXIT(nl_null,"could not make a mailbox for an isolate (too many open files?)",FALSE);
+		exit(1);
+	}
+	
+	pthread_mutex_lock(&nl_isolate_lock);
+	if(nl_isolate_cnt>=nl_isolate_size){
+		nl_isolate_size=(nl_isolate_size==0)?8:(nl_isolate_size*2);
+		nl_isolates=(nl_isolate**)(realloc(nl_isolates,nl_isolate_size*sizeof(nl_isolate*)));
+		if(nl_isolates==NULL){
+			ERR_EXIT(nl_null,"could not malloc the isolate registry (out of memory?)",FALSE);
+			exit(1);
+		}
+	}
+	ret->id=nl_isolate_cnt;
+	nl_isolates[nl_isolate_cnt]=ret;
+	nl_isolate_cnt++;
+	nl_isolate_running++;
+	pthread_mutex_unlock(&nl_isolate_lock);
+	
+	return ret;
+}
+
+//get the isolate with the given number, or NULL if there isn't one
+nl_isolate *nl_isolate_lookup(unsigned int id){
+	nl_isolate *ret=NULL;
+	pthread_mutex_lock(&nl_isolate_lock);
+	if(id<nl_isolate_cnt){
+		ret=nl_isolates[id];
+	}
+	pthread_mutex_unlock(&nl_isolate_lock);
+	return ret;
+}
+
+//get this thread's isolate, making the running program an isolate if it isn't one yet
+//(so the program started from the command line is isolate 0, since it has to be one before it can start any others)
+nl_isolate *nl_isolate_self(){
+	if(nl_isolate_cur==NULL){
+		nl_isolate_cur=nl_isolate_malloc(NULL,NULL,0);
+		nl_isolate_cur->parent=nl_isolate_cur->id;
+	}
+	return nl_isolate_cur;
+}
+
+//the main subroutine of an isolate's thread; runs the isolate's program in a new interpreter
+//like the program started from the command line, it gets its file name and arguments as argv
+void *nl_isolate_main(void *arg){
+	nl_isolate *iso=(nl_isolate*)(arg);
+	nl_isolate_cur=iso;
+	
+	int status=1;
+	iso->fp=fopen(iso->fname,"r");
+	if(iso->fp==NULL){
+		fprintf(stderr,"Err: Could not open isolate program \"%s\"\n",iso->fname);
+		nl_val_free(iso->argv);
+	}else{
+		status=nl_repl(iso->fp,iso->argv,NULL,NULL,iso->fname);
+	}
+	iso->argv=NULL;
+	
+	nl_isolate_finish(iso,status);
+	return NULL;
+}
+
+//mark an isolate as done with the given exit status, dropping any messages it never received
+void nl_isolate_finish(nl_isolate *iso, int status){
+	if(iso->fp!=NULL){
+		fclose(iso->fp);
+		iso->fp=NULL;
+	}
+	
+	pthread_mutex_lock(&nl_isolate_lock);
+	pthread_mutex_lock(&(iso->lock));
+	iso->done=TRUE;
+	iso->exit_status=status;
+	nl_msg *msg=iso->msgs;
+	iso->msgs=NULL;
+	iso->msgs_last=NULL;
+	pthread_mutex_unlock(&(iso->lock));
+	nl_isolate_running--;
+	pthread_cond_broadcast(&nl_isolate_finished);
+	pthread_mutex_unlock(&nl_isolate_lock);
+	
+	while(msg!=NULL){
+		nl_msg *next=msg->next;
+		nl_val_free(msg->v);
+		free(msg);
+		msg=next;
+	}
+}
+
+//returns TRUE if this thread is running an isolate that was started by another (rather than the program itself)
+char nl_isolate_started(){
+	return ((nl_isolate_cur!=NULL) && (nl_isolate_cur->fname!=NULL));
+}
+
+//mark packed storage in the given value as shared between isolates, so that a copy of it can be given to another isolate
+//(frozen parts are already marked, see nl_val_freeze)
+void nl_val_share(nl_val *v){
+	while((v->t==PAIR) && (!(v->flags & NL_VAL_FROZEN))){
+		nl_val_share(v->d.pair.f);
+		v=v->d.pair.r;
+	}
+	if(v->flags & NL_VAL_FROZEN){
+		return;
+	}
+	
+	switch(v->t){
+		case SYMBOL:
+			nl_val_share(v->d.sym.name);
+			break;
+		case EVALUATION:
+			nl_val_share(v->d.eval.sym);
+			break;
+		case BIND:
+			nl_val_share(v->d.bind.sym);
+			nl_val_share(v->d.bind.v);
+			break;
+		case ARRAY:
+			if(!(v->flags & NL_VAL_PACKED)){
+				unsigned int n;
+				for(n=0;n<v->d.array.size;n++){
+					nl_val_share(nl_array_entry(v,n));
+				}
+			}else{
+				__atomic_store_n(&(v->d.array.bytes->shared),TRUE,__ATOMIC_RELEASE);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+//make the copy of a value that gets given to another isolate; the value must be plain data (see nl_val_freezable)
+//packed strings share their storage and frozen data is shared outright (see nl_val_cp), so only the rest is actually copied
+nl_val *nl_isolate_msg_cp(nl_val *v){
+	nl_val_share(v);
+	return nl_val_cp(v);
+}
+
+//start a new isolate running the given program file with the given arguments (plain data); returns its number
+//the isolate gets its own interpreter and global environment on its own thread, and shares nothing with this one
+nl_val *nl_isolate_start(nl_val *arg_list){
+	nl_par_impure();
+	if((arg_list->t!=PAIR) || (arg_list->d.pair.f->t!=ARRAY)){
+		ERR_EXIT(arg_list,"wrong arguments given to isolate (takes a program file name and then any arguments for it)",TRUE);
+		return nl_null;
+	}
+	if(!nl_val_freezable(arg_list)){
+		ERR_EXIT(arg_list,"only plain data can be given to an isolate (not closures, primitives, structs, handles, futures, or channels)",TRUE);
+		return nl_null;
+	}
+	
+	nl_isolate *self=nl_isolate_self();
+	nl_isolate *iso=nl_isolate_malloc(c_str_from_nl_str(arg_list->d.pair.f),nl_isolate_msg_cp(arg_list),self->id);
+	
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr,NL_PAR_STACK_SIZE);
+	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+	int err=pthread_create(&thread,&attr,nl_isolate_main,iso);
+	pthread_attr_destroy(&attr);
+	if(err!=0){
+		nl_val_free(iso->argv);
+		iso->argv=NULL;
+		nl_isolate_finish(iso,1);
+		ERR_EXIT(arg_list,"could not start a thread for an isolate",TRUE);
+		return nl_null;
+	}
+	
+	nl_val *ret=nl_val_malloc(NUM);
+	ret->d.num.n=iso->id;
+	ret->d.num.d=1;
+	return ret;
+}
+
+//get the isolate given by number as the first argument of a primitive, or NULL (after an error) if there isn't one
+nl_isolate *nl_isolate_arg(nl_val *arg_list, const char *err_msg){
+	if((arg_list->t!=PAIR) || (arg_list->d.pair.f->t!=NUM) || (arg_list->d.pair.f->d.num.d!=1) || (arg_list->d.pair.f->d.num.n<0)){
+		ERR_EXIT(arg_list,err_msg,TRUE);
+		return NULL;
+	}
+	nl_isolate *ret=nl_isolate_lookup((unsigned int)(arg_list->d.pair.f->d.num.n));
+	if(ret==NULL){
+		ERR_EXIT(arg_list->d.pair.f,"there is no isolate with that number",TRUE);
+	}
+	return ret;
+}
+
+//post a message (plain data) to the given isolate; returns TRUE, or FALSE if that isolate has already ended
+nl_val *nl_isolate_post(nl_val *arg_list){
+	nl_par_impure();
+	if(nl_c_list_size(arg_list)!=2){
+		ERR_EXIT(arg_list,"wrong number of arguments given to isolate-post (takes an isolate number and a message)",TRUE);
+		return nl_null;
+	}
+	nl_isolate *iso=nl_isolate_arg(arg_list,"wrong arguments given to isolate-post (takes an isolate number and a message)");
+	if(iso==NULL){
+		return nl_null;
+	}
+	nl_val *v=arg_list->d.pair.r->d.pair.f;
+	if(!nl_val_freezable(v)){
+		ERR_EXIT(v,"only plain data can be posted to an isolate (not closures, primitives, structs, handles, futures, or channels)",TRUE);
+		return nl_null;
+	}
+	
+	nl_msg *msg=(nl_msg*)(malloc(sizeof(nl_msg)));
+	if(msg==NULL){
+		ERR_EXIT(arg_list,"could not malloc a message (out of memory?)",FALSE);
+		exit(1);
+	}
+	msg->v=nl_isolate_msg_cp(v);
+	msg->next=NULL;
+	
+	pthread_mutex_lock(&(iso->lock));
+	char done=iso->done;
+	if(!done){
+		if(iso->msgs_last!=NULL){
+			iso->msgs_last->next=msg;
+		}else{
+			iso->msgs=msg;
+		}
+		iso->msgs_last=msg;
+	}
+	pthread_mutex_unlock(&(iso->lock));
+	
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=(!done);
+	if(done){
+		nl_val_free(msg->v);
+		free(msg);
+		return ret;
+	}
+	
+	//one count per message, so a receiver that wakes up always has one to take
+	uint64_t one=1;
+	while((write(iso->wake_fd,&one,sizeof(one))<0) && (errno==EINTR));
+	return ret;
+}
+
+//receive the next message posted to this isolate, waiting until there is one
+//only the coroutine that's receiving waits; other coroutines in this isolate keep running
+nl_val *nl_isolate_recv(nl_val *arg_list){
+	nl_par_impure();
+	if(arg_list!=nl_null){
+		ERR_EXIT(arg_list,"wrong number of arguments given to isolate-recv (takes no arguments)",TRUE);
+		return nl_null;
+	}
+	nl_isolate *self=nl_isolate_self();
+	nl_vm *vm=nl_vm_cur;
+	
+	//if nothing could ever post a message this would wait forever
+	pthread_mutex_lock(&nl_isolate_lock);
+	char alone=(nl_isolate_running<=1);
+	pthread_mutex_unlock(&nl_isolate_lock);
+	pthread_mutex_lock(&(self->lock));
+	char empty=(self->msgs==NULL);
+	pthread_mutex_unlock(&(self->lock));
+	if(empty && alone && ((vm->co_cur==NULL) || (vm->co_cnt==0))){
+		ERR_EXIT(nl_null,"isolate-recv would wait forever (there's no message, and no other isolate or coroutine to post one)",TRUE);
+		return nl_null;
+	}
+	
+	//take one count from the mailbox; another coroutine can take the count this one was woken for, so it checks again
+	uint64_t cnt;
+	while(read(self->wake_fd,&cnt,sizeof(cnt))!=sizeof(cnt)){
+		if((errno!=EAGAIN) && (errno!=EINTR)){
+			ERR_EXIT(nl_null,"could not read this isolate's mailbox",TRUE);
+			return nl_null;
+		}
+		if((vm->co_cur!=NULL) && (vm->co_cnt>0)){
+			nl_co_wait_fd(self->wake_fd);
+		}else{
+			struct pollfd p;
+			p.fd=self->wake_fd;
+			p.events=POLLIN;
+			p.revents=0;
+			poll(&p,1,-1);
+		}
+	}
+	
+	pthread_mutex_lock(&(self->lock));
+	nl_msg *msg=self->msgs;
+	self->msgs=msg->next;
+	if(self->msgs==NULL){
+		self->msgs_last=NULL;
+	}
+	pthread_mutex_unlock(&(self->lock));
+	
+	nl_val *ret=msg->v;
+	free(msg);
+	return ret;
+}
+
+//the number of the running isolate
+nl_val *nl_isolate_self_num(nl_val *arg_list){
+	nl_val *ret=nl_val_malloc(NUM);
+	ret->d.num.n=nl_isolate_self()->id;
+	ret->d.num.d=1;
+	return ret;
+}
+
+//the number of the isolate that started this one (NULL for the program itself)
+nl_val *nl_isolate_parent(nl_val *arg_list){
+	nl_isolate *self=nl_isolate_self();
+	if(self->parent==self->id){
+		return nl_null;
+	}
+	nl_val *ret=nl_val_malloc(NUM);
+	ret->d.num.n=self->parent;
+	ret->d.num.d=1;
+	return ret;
+}
+
+//wait for the given isolate to end; returns its exit status
+//this waits with the whole interpreter (coroutines included), like a blocking read would
+nl_val *nl_isolate_wait(nl_val *arg_list){
+	nl_par_impure();
+	nl_isolate *iso=nl_isolate_arg(arg_list,"wrong arguments given to isolate-wait (takes an isolate number)");
+	if(iso==NULL){
+		return nl_null;
+	}
+	if(iso==nl_isolate_self()){
+		ERR_EXIT(arg_list->d.pair.f,"an isolate can't wait for itself to end",TRUE);
+		return nl_null;
+	}
+	
+	pthread_mutex_lock(&nl_isolate_lock);
+	while(!iso->done){
+		pthread_cond_wait(&nl_isolate_finished,&nl_isolate_lock);
+	}
+	int status=iso->exit_status;
+	pthread_mutex_unlock(&nl_isolate_lock);
+	
+	nl_val *ret=nl_val_malloc(NUM);
+	ret->d.num.n=status;
+	ret->d.num.d=1;
+	return ret;
+}
+
+//END C-NL-STDLIB-ISOLATE SUBROUTINES  ----------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-PROF SUBROUTINES  -----------------------------------------------------------------------------
+
+const char *nl_prof_fname=NULL;
+char nl_prof_counting=FALSE;
+char nl_prof_on=FALSE;
+
+//the profile; nl_prof_lock protects the names, the list of rings, and the table of sampled stacks
+pthread_mutex_t nl_prof_lock=PTHREAD_MUTEX_INITIALIZER;
+
+//names used in frames; 0 is for subroutines that were never bound to a name
+char **nl_prof_names=NULL;
+unsigned int nl_prof_name_cnt=0;
+unsigned int nl_prof_name_size=0;
+
+//every interpreter's ring of samples
+nl_prof_ring *nl_prof_rings=NULL;
+
+//every distinct stack that's been sampled (each is its frame count and then its frames) and how many times it was
+//this is an open-addressed hash table of nl_prof_stack_size entries (a power of 2), with NULL for an empty entry
+unsigned long long **nl_prof_stacks=NULL;
+unsigned long long *nl_prof_counts=NULL;
+unsigned int nl_prof_stack_cnt=0;
+unsigned int nl_prof_stack_size=0;
+
+//samples dropped by interpreters that have been free'd
+unsigned long long nl_prof_dropped=0;
+
+timer_t nl_prof_timer;
+
+//get the number for a name used in profile frames, adding it if it's new
+unsigned int nl_prof_name(const char *name){
+	pthread_mutex_lock(&nl_prof_lock);
+	unsigned int n;
+	for(n=0;n<nl_prof_name_cnt;n++){
+		if(strcmp(nl_prof_names[n],name)==0){
+			pthread_mutex_unlock(&nl_prof_lock);
+			return n;
+		}
+	}
+	
+	if(nl_prof_name_cnt>=nl_prof_name_size){
+		nl_prof_name_size=(nl_prof_name_size==0)?64:(nl_prof_name_size*2);
+		nl_prof_names=(char**)(realloc(nl_prof_names,nl_prof_name_size*sizeof(char*)));
+	}
+	if(nl_prof_names!=NULL){
+		nl_prof_names[nl_prof_name_cnt]=strdup(name);
+	}
+	if((nl_prof_names==NULL) || (nl_prof_names[nl_prof_name_cnt]==NULL)){
+		ERR_EXIT(nl_null,"could not malloc a profile name (out of memory?)",FALSE);
+		exit(1);
+	}
+	n=nl_prof_name_cnt;
+	nl_prof_name_cnt++;
+	pthread_mutex_unlock(&nl_prof_lock);
+	return n;
+}
+
+//name a subroutine for the profiler after the symbol it's being bound to, if it doesn't have a name yet
+void nl_prof_name_sub(nl_val *sub, nl_val *sym){
+	if((sub->t!=SUB) || (sub->d.sub->prof_name!=0) || (sym->t!=SYMBOL)){
+		return;
+	}
+	char *name=c_str_from_nl_str(sym->d.sym.name);
+	if(name!=NULL){
+		sub->d.sub->prof_name=nl_prof_name(name);
+		free(name);
+	}
+}
+
+//returns the profile frame for a call to the given subroutine (its name number, and its line)
+unsigned long long nl_prof_frame(nl_val *sub){
+	if(sub->t!=SUB){
+		return 0;
+	}
+	return (((unsigned long long)(sub->d.sub->prof_name))<<32)|(sub->d.sub->line);
+}
+
+//record a call (the given frame) on the profiler's call stack
+void nl_prof_push(nl_vm *vm, unsigned long long frame){
+	if(vm->prof_depth<NL_PROF_MAX_DEPTH){
+		vm->prof_stack[vm->prof_depth]=frame;
+	}
+	//the signal handler can run between any two instructions, so the frame has to be there before the depth says it is
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	vm->prof_depth++;
+}
+
+//take the newest call off the profiler's call stack
+void nl_prof_pop(nl_vm *vm){
+	if(vm->prof_depth>0){
+		vm->prof_depth--;
+	}
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+//the newest call on the profiler's call stack made a tailcall (the given frame), which takes its place
+void nl_prof_tail(nl_vm *vm, unsigned long long frame){
+	if((vm->prof_depth>0) && (vm->prof_depth<=NL_PROF_MAX_DEPTH)){
+		vm->prof_stack[vm->prof_depth-1]=frame;
+	}
+}
+
+//switch the profiler's call stack from one coroutine to another (see nl_co_switch)
+void nl_prof_co_switch(nl_vm *vm, nl_co *cur, nl_co *next){
+	if(cur->prof_stack==NULL){
+		cur->prof_stack=(unsigned long long*)(malloc(NL_PROF_MAX_DEPTH*sizeof(unsigned long long)));
+		if(cur->prof_stack==NULL){
+			ERR_EXIT(nl_null,"could not malloc a coroutine's profile (out of memory?)",FALSE);
+			exit(1);
+		}
+	}
+	
+	unsigned int depth=vm->prof_depth;
+	memcpy(cur->prof_stack,vm->prof_stack,((depth<NL_PROF_MAX_DEPTH)?depth:NL_PROF_MAX_DEPTH)*sizeof(unsigned long long));
+	cur->prof_depth=depth;
+	
+	//a sample taken while the frames are being copied just sees an empty stack
+	vm->prof_depth=0;
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	depth=next->prof_depth;
+	if(depth>0){
+		memcpy(vm->prof_stack,next->prof_stack,((depth<NL_PROF_MAX_DEPTH)?depth:NL_PROF_MAX_DEPTH)*sizeof(unsigned long long));
+	}
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	vm->prof_depth=depth;
+}
+
+//set up profiling for a new interpreter, with the given name for the frame its samples start with
+void nl_prof_vm_init(nl_vm *vm, const char *root){
+	nl_prof_ring *ring=(nl_prof_ring*)(malloc(sizeof(nl_prof_ring)));
+	vm->prof_stack=(unsigned long long*)(malloc(NL_PROF_MAX_DEPTH*sizeof(unsigned long long)));
+	if(ring!=NULL){
+		ring->samples=(unsigned long long*)(malloc(NL_PROF_RING_SIZE*NL_PROF_SAMPLE_LEN*sizeof(unsigned long long)));
+	}
+	if((ring==NULL) || (ring->samples==NULL) || (vm->prof_stack==NULL)){
+		ERR_EXIT(nl_null,"could not malloc an interpreter's profile (out of memory?)",FALSE);
+		exit(1);
+	}
+	ring->head=0;
+	ring->tail=0;
+	ring->dropped=0;
+	vm->prof_depth=0;
+	vm->prof_root=nl_prof_name(root);
+	
+	pthread_mutex_lock(&nl_prof_lock);
+	ring->next=nl_prof_rings;
+	nl_prof_rings=ring;
+	pthread_mutex_unlock(&nl_prof_lock);
+	
+	//the signal handler only samples interpreters that have a ring, so this goes last
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	vm->prof_ring=ring;
+}
+
+//add an interpreter's remaining samples to the profile and stop sampling it (before it's free'd)
+void nl_prof_vm_free(nl_vm *vm){
+	nl_prof_ring *ring=vm->prof_ring;
+	if(ring==NULL){
+		return;
+	}
+	vm->prof_ring=NULL;
+	
+	pthread_mutex_lock(&nl_prof_lock);
+	nl_prof_drain(ring);
+	nl_prof_dropped+=ring->dropped;
+	nl_prof_ring **link=&nl_prof_rings;
+	while(*link!=ring){
+		link=&((*link)->next);
+	}
+	*link=ring->next;
+	pthread_mutex_unlock(&nl_prof_lock);
+	
+	free(ring->samples);
+	free(ring);
+	free(vm->prof_stack);
+	vm->prof_stack=NULL;
+}
+
+//the SIGPROF handler; records the call stack of whatever interpreter this thread is running
+//this can interrupt anything at all, so it only copies the stack into a ring that was allocated ahead of time
+void nl_prof_sample(int sig){
+	nl_vm *vm=nl_vm_cur;
+	if((vm==NULL) || (vm->prof_ring==NULL)){
+		return;
+	}
+	nl_prof_ring *ring=vm->prof_ring;
+	unsigned int head=ring->head;
+	if((head-__atomic_load_n(&(ring->tail),__ATOMIC_ACQUIRE))>=NL_PROF_RING_SIZE){
+		ring->dropped++;
+		return;
+	}
+	
+	unsigned long long *sample=ring->samples+((head%NL_PROF_RING_SIZE)*NL_PROF_SAMPLE_LEN);
+	unsigned int depth=vm->prof_depth;
+	if(depth>NL_PROF_MAX_DEPTH){
+		depth=NL_PROF_MAX_DEPTH;
+	}
+	sample[0]=depth+2;
+	sample[1]=((unsigned long long)(vm->prof_root))<<32;
+	memcpy(sample+2,vm->prof_stack,depth*sizeof(unsigned long long));
+	sample[depth+2]=(((unsigned long long)(NL_PROF_LINE))<<32)|(vm->line_number);
+	__atomic_store_n(&(ring->head),head+1,__ATOMIC_RELEASE);
+}
+
+//find the given stack (its frame count and then its frames) in the profile's table, or the empty entry where it belongs
+unsigned int nl_prof_slot(const unsigned long long *stack){
+	unsigned long long len=stack[0]+1;
+	
+	//FNV-1a, over the whole 64 bits of each frame
+	unsigned long long hash=14695981039346656037ULL;
+	unsigned long long n;
+	for(n=0;n<len;n++){
+		hash=(hash^stack[n])*1099511628211ULL;
+	}
+	
+	unsigned int pos=(unsigned int)(hash&(nl_prof_stack_size-1));
+	while(nl_prof_stacks[pos]!=NULL){
+		if((nl_prof_stacks[pos][0]==stack[0]) && (memcmp(nl_prof_stacks[pos],stack,len*sizeof(unsigned long long))==0)){
+			break;
+		}
+		pos=(pos+1)&(nl_prof_stack_size-1);
+	}
+	return pos;
+}
+
+//count one sample of the given stack (its frame count and then its frames) in the profile (nl_prof_lock must be held)
+void nl_prof_add(const unsigned long long *stack){
+	//the table is kept at most half full, so a probe never has far to go
+	if(((nl_prof_stack_cnt+1)*2)>nl_prof_stack_size){
+		unsigned int old_size=nl_prof_stack_size;
+		unsigned long long **old_stacks=nl_prof_stacks;
+		unsigned long long *old_counts=nl_prof_counts;
+		
+		nl_prof_stack_size=(old_size==0)?1024:(old_size*2);
+		nl_prof_stacks=(unsigned long long**)(calloc(nl_prof_stack_size,sizeof(unsigned long long*)));
+		nl_prof_counts=(unsigned long long*)(calloc(nl_prof_stack_size,sizeof(unsigned long long)));
+		if((nl_prof_stacks==NULL) || (nl_prof_counts==NULL)){
+			ERR_EXIT(nl_null,"could not malloc the profile (out of memory?)",FALSE);
+			exit(1);
+		}
+		
+		unsigned int n;
+		for(n=0;n<old_size;n++){
+			if(old_stacks[n]!=NULL){
+				unsigned int pos=nl_prof_slot(old_stacks[n]);
+				nl_prof_stacks[pos]=old_stacks[n];
+				nl_prof_counts[pos]=old_counts[n];
+			}
+		}
+		free(old_stacks);
+		free(old_counts);
+	}
+	
+	unsigned int pos=nl_prof_slot(stack);
+	if(nl_prof_stacks[pos]==NULL){
+		unsigned long long len=stack[0]+1;
+		nl_prof_stacks[pos]=(unsigned long long*)(malloc(len*sizeof(unsigned long long)));
+		if(nl_prof_stacks[pos]==NULL){
+			ERR_EXIT(nl_null,"could not malloc the profile (out of memory?)",FALSE);
+			exit(1);
+		}
+		memcpy(nl_prof_stacks[pos],stack,len*sizeof(unsigned long long));
+		nl_prof_stack_cnt++;
+	}
+	nl_prof_counts[pos]++;
+}
+
+//add the samples in the given ring to the profile (nl_prof_lock must be held)
+void nl_prof_drain(nl_prof_ring *ring){
+	unsigned int head=__atomic_load_n(&(ring->head),__ATOMIC_ACQUIRE);
+	unsigned int tail=ring->tail;
+	while(tail!=head){
+		nl_prof_add(ring->samples+((tail%NL_PROF_RING_SIZE)*NL_PROF_SAMPLE_LEN));
+		tail++;
+	}
+	__atomic_store_n(&(ring->tail),tail,__ATOMIC_RELEASE);
+}
+
+//add the running interpreter's samples to the profile once its ring is half full
+//(this is done by the interpreter itself rather than another thread, since a second thread makes malloc slower for the whole process)
+void nl_prof_check(nl_vm *vm){
+	nl_prof_ring *ring=vm->prof_ring;
+	if((__atomic_load_n(&(ring->head),__ATOMIC_ACQUIRE)-ring->tail)>=(NL_PROF_RING_SIZE/2)){
+		pthread_mutex_lock(&nl_prof_lock);
+		nl_prof_drain(ring);
+		pthread_mutex_unlock(&nl_prof_lock);
+	}
+}
+
+//start profiling the process, writing the profile to the given file when it exits
+//returns FALSE if the profiler's timer couldn't be started
+char nl_prof_start(const char *fname){
+	nl_prof_fname=fname;
+	nl_prof_on=TRUE;
+	nl_prof_names_init();
+	
+	struct sigaction action;
+	memset(&action,0,sizeof(action));
+	action.sa_handler=nl_prof_sample;
+	action.sa_flags=SA_RESTART;
+	sigemptyset(&(action.sa_mask));
+	sigaction(SIGPROF,&action,NULL);
+	
+	//the timer counts processor time used by every thread, and the signal goes to a thread that's using it
+	struct sigevent event;
+	memset(&event,0,sizeof(event));
+	event.sigev_notify=SIGEV_SIGNAL;
+	event.sigev_signo=SIGPROF;
+	if(timer_create(CLOCK_PROCESS_CPUTIME_ID,&event,&nl_prof_timer)!=0){
+		nl_prof_fname=NULL;
+		return FALSE;
+	}
+	struct itimerspec interval;
+	interval.it_interval.tv_sec=0;
+	interval.it_interval.tv_nsec=NL_PROF_INTERVAL_NS;
+	interval.it_value=interval.it_interval;
+	timer_settime(nl_prof_timer,0,&interval,NULL);
+	
+	atexit(nl_prof_finish);
+	return TRUE;
+}
+
+//add the names every profile has (see NL_PROF_NAME_SUB), if they aren't there yet
+void nl_prof_names_init(){
+	if(nl_prof_name_cnt==0){
+		//(these are NL_PROF_NAME_SUB, NL_PROF_NAME_FUTURE, and NL_PROF_NAME_SPAWN)
+		nl_prof_name("sub");
+		nl_prof_name("future");
+		nl_prof_name("spawn");
+	}
+}
+
+//write one frame of a profile stack
+void nl_prof_out_frame(FILE *fp, unsigned long long frame){
+	unsigned int name=(unsigned int)(frame>>32);
+	unsigned int line=(unsigned int)(frame&0xffffffffULL);
+	if(name==NL_PROF_LINE){
+		fprintf(fp,"line %u",line);
+	}else if(line==0){
+		fprintf(fp,"%s",nl_prof_names[name]);
+	}else{
+		fprintf(fp,"%s:%u",nl_prof_names[name],line);
+	}
+}
+
+//stop sampling and write the profile, as collapsed stacks (one "frame;frame;... count" line per distinct stack, for flamegraph.pl)
+void nl_prof_finish(){
+	if(nl_prof_fname==NULL){
+		return;
+	}
+	timer_delete(nl_prof_timer);
+	signal(SIGPROF,SIG_IGN);
+	
+	pthread_mutex_lock(&nl_prof_lock);
+	unsigned long long dropped=nl_prof_dropped;
+	nl_prof_ring *ring;
+	for(ring=nl_prof_rings;ring!=NULL;ring=ring->next){
+		nl_prof_drain(ring);
+		dropped+=ring->dropped;
+	}
+	
+	FILE *fp=fopen(nl_prof_fname,"w");
+	if(fp==NULL){
+		fprintf(stderr,"Err: Could not write profile \"%s\"\n",nl_prof_fname);
+	}else{
+		unsigned int n;
+		for(n=0;n<nl_prof_stack_size;n++){
+			unsigned long long *stack=nl_prof_stacks[n];
+			if(stack==NULL){
+				continue;
+			}
+			unsigned long long frame;
+			for(frame=1;frame<=stack[0];frame++){
+				if(frame>1){
+					fputc(';',fp);
+				}
+				nl_prof_out_frame(fp,stack[frame]);
+			}
+			fprintf(fp," %llu\n",nl_prof_counts[n]);
+		}
+		fclose(fp);
+	}
+	if(dropped>0){
+		fprintf(stderr,"Warn: %llu profile samples were dropped\n",dropped);
+	}
+	nl_prof_fname=NULL;
+	pthread_mutex_unlock(&nl_prof_lock);
+}
+
+//the keys calls are counted under (see nl_prof_key); key number n (from 1) is subroutine frame or primitive function
+//nl_prof_key_vals[n], and the rest describe it; nl_prof_key_slots is an open-addressed hash table of key numbers (0 is empty)
+unsigned long long *nl_prof_key_vals=NULL;
+char *nl_prof_key_pri=NULL;
+unsigned int *nl_prof_key_names=NULL;
+unsigned int nl_prof_key_cnt=0;
+unsigned int nl_prof_key_size=0;
+unsigned int *nl_prof_key_slots=NULL;
+unsigned int nl_prof_key_slot_size=0;
+
+//every interpreter's counts, including interpreters that have been free'd
+nl_prof_tally *nl_prof_tallies=NULL;
+
+//find the given key in the table of keys, or the empty slot where it belongs (nl_prof_lock must be held)
+unsigned int nl_prof_key_slot(char pri, unsigned long long k){
+	unsigned long long hash=(k^((unsigned long long)(pri)))*11400714819323198485ULL;
+	unsigned int pos=(unsigned int)((hash>>32)&(nl_prof_key_slot_size-1));
+	while(nl_prof_key_slots[pos]!=0){
+		unsigned int id=nl_prof_key_slots[pos];
+		if((nl_prof_key_vals[id]==k) && (nl_prof_key_pri[id]==pri)){
+			break;
+		}
+		pos=(pos+1)&(nl_prof_key_slot_size-1);
+	}
+	return pos;
+}
+
+//get the key number that calls are counted under for a subroutine frame (see nl_prof_frame) or a primitive's function
+//pri is TRUE for primitives; name is the primitive's name number, or 0 if it isn't known yet
+unsigned int nl_prof_key(char pri, unsigned long long k, unsigned int name){
+	pthread_mutex_lock(&nl_prof_lock);
+	if(((nl_prof_key_cnt+1)*2)>nl_prof_key_slot_size){
+		unsigned int *old_slots=nl_prof_key_slots;
+		unsigned int old_size=nl_prof_key_slot_size;
+		nl_prof_key_slot_size=(old_size==0)?256:(old_size*2);
+		nl_prof_key_slots=(unsigned int*)(calloc(nl_prof_key_slot_size,sizeof(unsigned int)));
+		if(nl_prof_key_slots==NULL){
+			ERR_EXIT(nl_null,"could not malloc the profile (out of memory?)",FALSE);
+			exit(1);
+		}
+		unsigned int n;
+		for(n=0;n<old_size;n++){
+			if(old_slots[n]!=0){
+				nl_prof_key_slots[nl_prof_key_slot(nl_prof_key_pri[old_slots[n]],nl_prof_key_vals[old_slots[n]])]=old_slots[n];
+			}
+		}
+		free(old_slots);
+	}
+	
+	unsigned int pos=nl_prof_key_slot(pri,k);
+	unsigned int id=nl_prof_key_slots[pos];
+	if(id==0){
+		//key numbers start at 1, so 0 can mean a value doesn't have one yet
+		if((nl_prof_key_cnt+2)>nl_prof_key_size){
+			nl_prof_key_size=(nl_prof_key_size==0)?256:(nl_prof_key_size*2);
+			nl_prof_key_vals=(unsigned long long*)(realloc(nl_prof_key_vals,nl_prof_key_size*sizeof(unsigned long long)));
+			nl_prof_key_pri=(char*)(realloc(nl_prof_key_pri,nl_prof_key_size*sizeof(char)));
+			nl_prof_key_names=(unsigned int*)(realloc(nl_prof_key_names,nl_prof_key_size*sizeof(unsigned int)));
+			if((nl_prof_key_vals==NULL) || (nl_prof_key_pri==NULL) || (nl_prof_key_names==NULL)){
+				ERR_EXIT(nl_null,"could not malloc the profile (out of memory?)",FALSE);
+				exit(1);
+			}
+		}
+		nl_prof_key_cnt++;
+		id=nl_prof_key_cnt;
+		nl_prof_key_vals[id]=k;
+		nl_prof_key_pri[id]=pri;
+		nl_prof_key_names[id]=0;
+		nl_prof_key_slots[pos]=id;
+	}
+	if((name!=0) && (nl_prof_key_names[id]==0)){
+		nl_prof_key_names[id]=name;
+	}
+	pthread_mutex_unlock(&nl_prof_lock);
+	return id;
+}
+
+//get the key a subroutine's calls are counted under
+unsigned int nl_prof_sub_key(nl_val *sub){
+	//closures can be shared between threads, and they'd all store the same key
+	unsigned int id=__atomic_load_n(&(sub->d.sub->prof_id),__ATOMIC_RELAXED);
+	if(id==0){
+		id=nl_prof_key(FALSE,nl_prof_frame(sub),0);
+		__atomic_store_n(&(sub->d.sub->prof_id),id,__ATOMIC_RELAXED);
+	}
+	return id;
+}
+
+//start counting a call under the given key (keep is TRUE for the start of a future or coroutine; see nl_prof_call)
+void nl_prof_count_enter(nl_vm *vm, unsigned int id, char keep){
+	nl_prof_tally *tally=vm->prof_tally;
+	if(id>=tally->size){
+		//reports read the counts from other threads, so they're only ever moved with the lock held
+		pthread_mutex_lock(&nl_prof_lock);
+		unsigned int size=(tally->size==0)?256:tally->size;
+		while(id>=size){
+			size*=2;
+		}
+		nl_prof_cnt *cnts=(nl_prof_cnt*)(realloc(tally->cnts,size*sizeof(nl_prof_cnt)));
+		if(cnts==NULL){
+			ERR_EXIT(nl_null,"could not malloc an interpreter's profile (out of memory?)",FALSE);
+			exit(1);
+		}
+		memset(cnts+tally->size,0,(size-tally->size)*sizeof(nl_prof_cnt));
+		tally->cnts=cnts;
+		tally->size=size;
+		pthread_mutex_unlock(&nl_prof_lock);
+	}
+	
+	if(vm->prof_call_depth>=vm->prof_call_size){
+		vm->prof_call_size=(vm->prof_call_size==0)?64:(vm->prof_call_size*2);
+		vm->prof_calls=(nl_prof_call*)(realloc(vm->prof_calls,vm->prof_call_size*sizeof(nl_prof_call)));
+		if(vm->prof_calls==NULL){
+			ERR_EXIT(nl_null,"could not malloc an interpreter's profile (out of memory?)",FALSE);
+			exit(1);
+		}
+	}
+	nl_prof_call *call=&(vm->prof_calls[vm->prof_call_depth]);
+	call->id=id;
+	call->keep=keep;
+	call->trace=NL_TRACE_SUB;
+	call->child_ns=0;
+	call->start_allocs=vm->stats.allocs;
+	call->child_allocs=0;
+	vm->prof_call_depth++;
+	
+	nl_prof_cnt *cnt=&(tally->cnts[id]);
+	NL_COUNT_ADD(cnt->calls,1);
+	cnt->active++;
+	
+	//the clock is read last so that none of the counting is counted
+	call->start_ns=nl_par_now_ns();
+}
+
+//finish counting the newest call
+void nl_prof_count_exit(nl_vm *vm){
+	unsigned long long now=nl_par_now_ns();
+	if(vm->prof_call_depth==0){
+		return;
+	}
+	vm->prof_call_depth--;
+	nl_prof_call *call=&(vm->prof_calls[vm->prof_call_depth]);
+	unsigned long long ns=now-call->start_ns;
+	unsigned long long allocs=vm->stats.allocs-call->start_allocs;
+	
+	nl_prof_cnt *cnt=&(vm->prof_tally->cnts[call->id]);
+	NL_COUNT_ADD(cnt->excl_ns,ns-call->child_ns);
+	NL_COUNT_ADD(cnt->excl_allocs,allocs-call->child_allocs);
+	cnt->active--;
+	if(cnt->active==0){
+		NL_COUNT_ADD(cnt->incl_ns,ns);
+		NL_COUNT_ADD(cnt->incl_allocs,allocs);
+	}
+	if(vm->trace_buf!=NULL){
+		nl_trace_add(vm,call,ns);
+	}
+	
+	if(vm->prof_call_depth>0){
+		call--;
+		call->child_ns+=ns;
+		call->child_allocs+=allocs;
+	}
+}
+
+//the newest call being counted made a tailcall (counted under the given key), which takes its place
+void nl_prof_count_tail(nl_vm *vm, unsigned int id){
+	//a tailcall from outside of any call (at the top level) isn't counted, since nothing would finish counting it
+	if(vm->prof_call_depth==0){
+		return;
+	}
+	if(!vm->prof_calls[vm->prof_call_depth-1].keep){
+		nl_prof_count_exit(vm);
+	}
+	nl_prof_count_enter(vm,id,FALSE);
+}
+
+//finish counting every call past the given depth (the start of a future or coroutine, and any tailcalls on top of it)
+void nl_prof_count_leave(nl_vm *vm, unsigned int depth){
+	while(vm->prof_call_depth>depth){
+		nl_prof_count_exit(vm);
+	}
+}
+
+//stop counting calls past the given depth without adding anything for them (for abandoned parallel work)
+void nl_prof_count_unwind(nl_vm *vm, unsigned int depth){
+	while(vm->prof_call_depth>depth){
+		vm->prof_call_depth--;
+		vm->prof_tally->cnts[vm->prof_calls[vm->prof_call_depth].id].active--;
+	}
+}
+
+//call a primitive, counting the call
+nl_val *nl_prof_count_pri(nl_val *pri, nl_val *arguments){
+	//primitive values can be shared between threads, and they'd all store the same key
+	unsigned int id=__atomic_load_n(&(pri->d.pri.prof_id),__ATOMIC_RELAXED);
+	if(id==0){
+		id=nl_prof_key(TRUE,(unsigned long long)((uintptr_t)(pri->d.pri.function)),0);
+		__atomic_store_n(&(pri->d.pri.prof_id),id,__ATOMIC_RELAXED);
+	}
+	
+	nl_vm *vm=nl_vm_cur;
+	nl_prof_count_enter(vm,id,FALSE);
+	if(vm->trace_buf!=NULL){
+		vm->prof_calls[vm->prof_call_depth-1].trace=nl_trace_io(pri->d.pri.function)?NL_TRACE_IO:NL_TRACE_PRI;
+	}
+	nl_val *ret=(*(pri->d.pri.function))(arguments);
+	nl_prof_count_exit(vm);
+	return ret;
+}
+
+//switch the calls being counted from one coroutine to another (see nl_co_switch)
+//time a coroutine isn't running isn't counted for it, and neither is what's allocated meanwhile
+void nl_prof_count_co_switch(nl_vm *vm, nl_co *cur, nl_co *next){
+	unsigned long long now=nl_par_now_ns();
+	cur->prof_calls=vm->prof_calls;
+	cur->prof_call_depth=vm->prof_call_depth;
+	cur->prof_call_size=vm->prof_call_size;
+	cur->prof_paused_ns=now;
+	cur->prof_paused_allocs=vm->stats.allocs;
+	
+	vm->prof_calls=next->prof_calls;
+	vm->prof_call_depth=next->prof_call_depth;
+	vm->prof_call_size=next->prof_call_size;
+	next->prof_calls=NULL;
+	next->prof_call_depth=0;
+	next->prof_call_size=0;
+	
+	//the calls that were paused start later by however long they were paused for (and however much was allocated meanwhile)
+	unsigned int n;
+	for(n=0;n<vm->prof_call_depth;n++){
+		vm->prof_calls[n].start_ns+=(now-next->prof_paused_ns);
+		vm->prof_calls[n].start_allocs+=(vm->stats.allocs-next->prof_paused_allocs);
+	}
+}
+
+//set up call counting for a new interpreter
+void nl_prof_count_vm_init(nl_vm *vm){
+	nl_prof_tally *tally=(nl_prof_tally*)(malloc(sizeof(nl_prof_tally)));
+	if(tally==NULL){
+		ERR_EXIT(nl_null,"could not malloc an interpreter's profile (out of memory?)",FALSE);
+		exit(1);
+	}
+	tally->cnts=NULL;
+	tally->size=0;
+	
+	pthread_mutex_lock(&nl_prof_lock);
+	tally->next=nl_prof_tallies;
+	nl_prof_tallies=tally;
+	pthread_mutex_unlock(&nl_prof_lock);
+	
+	vm->prof_tally=tally;
+	vm->prof_calls=NULL;
+	vm->prof_call_depth=0;
+	vm->prof_call_size=0;
+	if(nl_trace_on){
+		nl_trace_vm_init(vm);
+	}
+}
+
+//stop counting calls for an interpreter (before it's free'd); its counts are kept for reports
+void nl_prof_count_vm_free(nl_vm *vm){
+	if(vm->prof_tally==NULL){
+		return;
+	}
+	nl_prof_count_unwind(vm,0);
+	nl_trace_vm_free(vm);
+	free(vm->prof_calls);
+	vm->prof_calls=NULL;
+	vm->prof_call_size=0;
+	vm->prof_tally=NULL;
+}
+
+//name every primitive bound in the given environment, so reports can say which is which
+void nl_prof_count_names(nl_env_frame *env){
+	nl_val *list=nl_trie_associative_list(env->trie);
+	nl_val *entry;
+	for(entry=list;entry->t==PAIR;entry=entry->d.pair.r){
+		nl_val *binding=entry->d.pair.f;
+		if((binding==nl_null) || (binding->d.pair.r->t!=PRI)){
+			continue;
+		}
+		char *name=c_str_from_nl_str(binding->d.pair.f->d.sym.name);
+		if(name!=NULL){
+			nl_prof_key(TRUE,(unsigned long long)((uintptr_t)(binding->d.pair.r->d.pri.function)),nl_prof_name(name));
+			free(name);
+		}
+	}
+	nl_val_free(list);
+}
+
+//count calls for the whole process (without writing a report; see nl_prof_count_start)
+void nl_prof_count_enable(){
+	nl_prof_names_init();
+	nl_prof_counting=TRUE;
+	nl_prof_on=TRUE;
+}
+
+//start counting calls for the whole process, and write a report to stderr when it exits
+void nl_prof_count_start(){
+	nl_prof_count_enable();
+	atexit(nl_prof_count_finish);
+}
+
+//write the counts (added up over every interpreter) to the given file as a table, most exclusive time first
+void nl_prof_count_report(FILE *fp){
+	pthread_mutex_lock(&nl_prof_lock);
+	unsigned int key_cnt=nl_prof_key_cnt;
+	nl_prof_cnt *totals=(nl_prof_cnt*)(calloc(key_cnt+1,sizeof(nl_prof_cnt)));
+	unsigned int *order=(unsigned int*)(malloc((key_cnt+1)*sizeof(unsigned int)));
+	if((totals==NULL) || (order==NULL)){
+		ERR_EXIT(nl_null,"could not malloc the profile (out of memory?)",FALSE);
+		exit(1);
+	}
+	
+	nl_prof_tally *tally;
+	for(tally=nl_prof_tallies;tally!=NULL;tally=tally->next){
+		unsigned int id;
+		for(id=1;(id<tally->size) && (id<=key_cnt);id++){
+			nl_prof_cnt *cnt=&(tally->cnts[id]);
+			totals[id].calls+=__atomic_load_n(&(cnt->calls),__ATOMIC_RELAXED);
+			totals[id].incl_ns+=__atomic_load_n(&(cnt->incl_ns),__ATOMIC_RELAXED);
+			totals[id].excl_ns+=__atomic_load_n(&(cnt->excl_ns),__ATOMIC_RELAXED);
+			totals[id].incl_allocs+=__atomic_load_n(&(cnt->incl_allocs),__ATOMIC_RELAXED);
+			totals[id].excl_allocs+=__atomic_load_n(&(cnt->excl_allocs),__ATOMIC_RELAXED);
+		}
+	}
+	
+	//most exclusive time first (an insertion sort; there are only as many entries as there are distinct subroutines)
+	unsigned int order_cnt=0;
+	unsigned int id;
+	for(id=1;id<=key_cnt;id++){
+		if(totals[id].calls==0){
+			continue;
+		}
+		unsigned int pos=order_cnt;
+		while((pos>0) && (totals[order[pos-1]].excl_ns<totals[id].excl_ns)){
+			order[pos]=order[pos-1];
+			pos--;
+		}
+		order[pos]=id;
+		order_cnt++;
+	}
+	
+	fprintf(fp,"%12s %12s %12s %12s %12s  %s\n","calls","incl ms","excl ms","incl allocs","excl allocs","name");
+	unsigned int n;
+	for(n=0;n<order_cnt;n++){
+		nl_prof_cnt *total=&(totals[order[n]]);
+		fprintf(fp,"%12llu %12.3f %12.3f %12llu %12llu  ",total->calls,total->incl_ns/1000000.0,total->excl_ns/1000000.0,total->incl_allocs,total->excl_allocs);
+		if(!nl_prof_key_pri[order[n]]){
+			nl_prof_out_frame(fp,nl_prof_key_vals[order[n]]);
+		}else if(nl_prof_key_names[order[n]]!=0){
+			fprintf(fp,"%s (primitive)",nl_prof_names[nl_prof_key_names[order[n]]]);
+		}else{
+			fprintf(fp,"(primitive)");
+		}
+		fputc('\n',fp);
+	}
+	pthread_mutex_unlock(&nl_prof_lock);
+	
+	free(totals);
+	free(order);
+}
+
+//write the counts report at exit (see nl_prof_count_start)
+void nl_prof_count_finish(){
+	fflush(stdout);
+	nl_prof_count_report(stderr);
+}
+
+//write the counts so far to stdout (see --prof-count)
+//returns NULL
+nl_val *nl_prof_report(nl_val *arg_list){
+	if(!nl_prof_counting){
+		ERR(nl_null,"prof-report needs calls to be counted (see --prof-count)",TRUE);
+		return nl_null;
+	}
+	fflush(stdout);
+	nl_prof_count_report(stdout);
+	fflush(stdout);
+	return nl_null;
+}
+
+//END C-NL-STDLIB-PROF SUBROUTINES  -------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-STATS SUBROUTINES  ----------------------------------------------------------------------------
+
+char nl_stats_exit=FALSE;
+
+//the statistics of every interpreter that's still running, and the totals of every one that's been free'd (protected by nl_stats_lock)
+pthread_mutex_t nl_stats_lock=PTHREAD_MUTEX_INITIALIZER;
+nl_stats *nl_stats_all=NULL;
+nl_stats nl_stats_freed;
+
+nl_stats nl_stats_outside;
+
+//start keeping statistics for a new interpreter
+void nl_stats_vm_init(nl_vm *vm){
+	memset(&(vm->stats),0,sizeof(nl_stats));
+	
+	pthread_mutex_lock(&nl_stats_lock);
+	vm->stats.next=nl_stats_all;
+	nl_stats_all=&(vm->stats);
+	pthread_mutex_unlock(&nl_stats_lock);
+}
+
+//add an interpreter's statistics to the totals of interpreters that are done (before it's free'd)
+void nl_stats_vm_free(nl_vm *vm){
+	pthread_mutex_lock(&nl_stats_lock);
+	nl_stats_add(&nl_stats_freed,&(vm->stats));
+	nl_stats **link=&nl_stats_all;
+	while(*link!=&(vm->stats)){
+		link=&((*link)->next);
+	}
+	*link=vm->stats.next;
+	pthread_mutex_unlock(&nl_stats_lock);
+}
+
+//add one interpreter's statistics to a total
+//(the interpreter may still be running, so every counter is read atomically)
+void nl_stats_add(nl_stats *total, nl_stats *stats){
+	total->allocs+=__atomic_load_n(&(stats->allocs),__ATOMIC_RELAXED);
+	total->frees+=__atomic_load_n(&(stats->frees),__ATOMIC_RELAXED);
+	int t;
+	for(t=NL_TYPE_START;t<NL_TYPE_CNT;t++){
+		total->live[t]+=__atomic_load_n(&(stats->live[t]),__ATOMIC_RELAXED);
+	}
+	total->array_slots+=__atomic_load_n(&(stats->array_slots),__ATOMIC_RELAXED);
+	total->array_slots_used+=__atomic_load_n(&(stats->array_slots_used),__ATOMIC_RELAXED);
+	total->packed_bytes+=__atomic_load_n(&(stats->packed_bytes),__ATOMIC_RELAXED);
+	total->env_frames+=__atomic_load_n(&(stats->env_frames),__ATOMIC_RELAXED);
+	total->trie_nodes+=__atomic_load_n(&(stats->trie_nodes),__ATOMIC_RELAXED);
+	total->bytes+=__atomic_load_n(&(stats->bytes),__ATOMIC_RELAXED);
+	total->peak_bytes+=__atomic_load_n(&(stats->peak_bytes),__ATOMIC_RELAXED);
+}
+
+//add up the statistics of every interpreter, running or not
+void nl_stats_total(nl_stats *total){
+	memset(total,0,sizeof(nl_stats));
+	
+	pthread_mutex_lock(&nl_stats_lock);
+	nl_stats_add(total,&nl_stats_freed);
+	nl_stats_add(total,&nl_stats_outside);
+	nl_stats *stats;
+	for(stats=nl_stats_all;stats!=NULL;stats=stats->next){
+		nl_stats_add(total,stats);
+	}
+	pthread_mutex_unlock(&nl_stats_lock);
+	
+	//nothing can be using less than nothing (see nl_stats for how a single interpreter's counts can be negative)
+	if(total->bytes>total->peak_bytes){
+		total->peak_bytes=total->bytes;
+	}
+}
+
+//write the statistics for the whole run to stderr as JSON (see --stats)
+void nl_stats_finish(){
+	nl_stats total;
+	nl_stats_total(&total);
+	
+	//the high-water mark of the process's resident memory, in kilobytes
+	struct rusage usage;
+	long peak_rss_kb=0;
+	if(getrusage(RUSAGE_SELF,&usage)==0){
+		peak_rss_kb=usage.ru_maxrss;
+	}
+	
+	fflush(stdout);
+	fprintf(stderr,"{\"allocs\": %llu, \"peak_rss_kb\": %ld}\n",total.allocs,peak_rss_kb);
+}
+
+char nl_mem_report_exit=FALSE;
+
+//bind a number to the given name in a struct (for building the result of mem-stats)
+void nl_mem_stats_bind(nl_val *s, const char *name, long long n){
+	nl_val *v=nl_val_malloc(NUM);
+	v->d.num.n=n;
+	v->d.num.d=1;
+	nl_bind_new(nl_sym_from_c_str(name),v,s->d.nl_struct.env);
+}
+
+//returns memory statistics for the whole process (see nl_stats) as a struct
+nl_val *nl_mem_stats(nl_val *arg_list){
+	nl_stats total;
+	nl_stats_total(&total);
+	
+	//the live value counts by type go in a struct of their own, named like the types but in lowercase ("num", "pair", ...)
+	nl_val *live=nl_val_malloc(STRUCT);
+	long long live_total=0;
+	int t;
+	for(t=NL_TYPE_START;t<NL_TYPE_CNT;t++){
+		char name[32];
+		const char *type_name=nl_type_name(t);
+		int n;
+		for(n=0;(type_name[n]!='\0') && (n<(sizeof(name)-1));n++){
+			name[n]=((type_name[n]>='A') && (type_name[n]<='Z'))?(type_name[n]-'A'+'a'):type_name[n];
+		}
+		name[n]='\0';
+		nl_mem_stats_bind(live,name,total.live[t]);
+		live_total+=total.live[t];
+	}
+	
+	nl_val *ret=nl_val_malloc(STRUCT);
+	nl_mem_stats_bind(ret,"allocs",total.allocs);
+	nl_mem_stats_bind(ret,"frees",total.frees);
+	nl_mem_stats_bind(ret,"live",live_total);
+	nl_bind_new(nl_sym_from_c_str("live-by-type"),live,ret->d.nl_struct.env);
+	nl_mem_stats_bind(ret,"array-slots",total.array_slots);
+	nl_mem_stats_bind(ret,"array-slots-used",total.array_slots_used);
+	nl_mem_stats_bind(ret,"array-slack-bytes",(total.array_slots-total.array_slots_used)*((long long)(sizeof(nl_val*))));
+	nl_mem_stats_bind(ret,"packed-bytes",total.packed_bytes);
+	nl_mem_stats_bind(ret,"env-frames",total.env_frames);
+	nl_mem_stats_bind(ret,"trie-nodes",total.trie_nodes);
+	nl_mem_stats_bind(ret,"bytes",total.bytes);
+	nl_mem_stats_bind(ret,"peak-bytes",total.peak_bytes);
+	return ret;
+}
+
+//write the memory statistics for the whole process to the given file, in a form meant for people to read
+void nl_mem_report(FILE *fp){
+	nl_stats total;
+	nl_stats_total(&total);
+	
+	fprintf(fp,"memory report (bytes are for the interpreter's own structures, without the allocator's overhead)\n");
+	fprintf(fp,"\t%-20s %lld\n","values allocated",(long long)(total.allocs));
+	fprintf(fp,"\t%-20s %lld\n","values free'd",(long long)(total.frees));
+	int t;
+	for(t=NL_TYPE_START;t<NL_TYPE_CNT;t++){
+		if(total.live[t]!=0){
+			fprintf(fp,"\t%-20s %lld (%lld bytes)\n",nl_type_name(t),total.live[t],total.live[t]*((long long)(sizeof(nl_val))));
+		}
+	}
+	fprintf(fp,"\t%-20s %lld used of %lld (%lld bytes of slack)\n","array slots",total.array_slots_used,total.array_slots,(total.array_slots-total.array_slots_used)*((long long)(sizeof(nl_val*))));
+	fprintf(fp,"\t%-20s %lld bytes\n","packed arrays",total.packed_bytes);
+	fprintf(fp,"\t%-20s %lld (%lld bytes)\n","env frames",total.env_frames,total.env_frames*((long long)(sizeof(nl_env_frame))));
+	fprintf(fp,"\t%-20s %lld (%lld bytes)\n","trie nodes",total.trie_nodes,total.trie_nodes*((long long)(sizeof(nl_trie_node))));
+	fprintf(fp,"\t%-20s %lld bytes\n","in use",total.bytes);
+	fprintf(fp,"\t%-20s %lld bytes\n","peak",total.peak_bytes);
+}
+
+//write the memory report at exit (see --mem-report)
+void nl_mem_report_finish(){
+	fflush(stdout);
+	nl_mem_report(stderr);
+}
+
+//returns the processor time the whole process has used, in nanoseconds
+unsigned long long int nl_stats_cpu_ns(){
+	struct timespec t;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&t);
+	return (((unsigned long long int)(t.tv_sec))*1000000000ULL)+((unsigned long long int)(t.tv_nsec));
+}
+
+//evaluate a time statement's body (a sequence, like begin), and write how long it took and how many values were allocated and free'd meanwhile to stderr
+//the counts and processor time are for the whole process, so they include work the body hands to other threads (and anything else those are doing)
+//returns the value of the body
+nl_val *nl_eval_time(nl_val *arguments, nl_env_frame *env, char *early_ret){
+	//this writes output, so it can't be done speculatively (and it's better to find that out before the body is evaluated)
+	nl_par_impure();
+	
+	unsigned int line=nl_vm_cur->line_number;
+	
+	//(the body is copied before anything is counted, since the copy isn't part of the work being timed)
+	nl_val *body=nl_val_cp(arguments);
+	
+	nl_stats start;
+	nl_stats_total(&start);
+	unsigned long long int start_cpu_ns=nl_stats_cpu_ns();
+	unsigned long long int start_ns=nl_par_now_ns();
+	
+	//with --perf-counters the hardware counters are read too (when this thread is the one they count)
+	char perf=nl_perf_here();
+	nl_perf_counts perf_start;
+	nl_perf_counts perf_end;
+	if(perf){
+		nl_perf_read(&perf_start);
+	}
+	
+	nl_val *ret=nl_eval_sequence(body,env,early_ret);
+	
+	if(perf){
+		nl_perf_read(&perf_end);
+	}
+	unsigned long long int ns=nl_par_now_ns()-start_ns;
+	unsigned long long int cpu_ns=nl_stats_cpu_ns()-start_cpu_ns;
+	nl_stats end;
+	nl_stats_total(&end);
+	
+	fflush(stdout);
+	fprintf(stderr,"time [line %u]: %.3f ms wall, %.3f ms cpu, %llu values allocated, %llu free'd\n",line,ns/1000000.0,cpu_ns/1000000.0,end.allocs-start.allocs,end.frees-start.frees);
+	if(perf){
+		nl_perf_report(stderr,line,&perf_start,&perf_end);
+	}
+	return ret;
+}
+
+//END C-NL-STDLIB-STATS SUBROUTINES  ------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-LEAKCHECK SUBROUTINES  ------------------------------------------------------------------------
+
+#ifdef _LEAKCHECK
+//every live value, newest first, and how many reports there have been (protected by nl_leak_lock)
+//a global list rather than one per interpreter, since a value can be free'd by a different interpreter than the one that made it
+pthread_mutex_t nl_leak_lock=PTHREAD_MUTEX_INITIALIZER;
+nl_val *nl_leak_vals=NULL;
+unsigned int nl_leak_gen=0;
+
+//record the C source location a value was allocated at, and return it
+nl_val *nl_leak_track(nl_val *v, const char *file, unsigned int c_line){
+	v->leak_file=file;
+	v->leak_c_line=c_line;
+	return v;
+}
+
+//add a new value to the list of live values
+void nl_leak_link(nl_val *v){
+	v->leak_file=NULL;
+	v->leak_c_line=0;
+	v->leak_line=(nl_vm_cur!=NULL)?nl_vm_cur->line_number:0;
+	v->leak_prev=NULL;
+	
+	pthread_mutex_lock(&nl_leak_lock);
+	v->leak_gen=nl_leak_gen;
+	v->leak_next=nl_leak_vals;
+	if(nl_leak_vals!=NULL){
+		nl_leak_vals->leak_prev=v;
+	}
+	nl_leak_vals=v;
+	pthread_mutex_unlock(&nl_leak_lock);
+}
+
+//take a value that's about to be free'd out of the list of live values
+void nl_leak_unlink(nl_val *v){
+	pthread_mutex_lock(&nl_leak_lock);
+	if(v->leak_prev!=NULL){
+		v->leak_prev->leak_next=v->leak_next;
+	}else{
+		nl_leak_vals=v->leak_next;
+	}
+	if(v->leak_next!=NULL){
+		v->leak_next->leak_prev=v->leak_prev;
+	}
+	pthread_mutex_unlock(&nl_leak_lock);
+}
+
+//the hash of where a value was allocated and its type, for grouping values in a report
+unsigned int nl_leak_hash(const char *file, unsigned int c_line, unsigned int line, unsigned char t){
+	unsigned long long h=(((unsigned long long)(size_t)(file))*0x9e3779b97f4a7c15ULL)^(c_line*0x85ebca6bU)^(line*0xc2b2ae35U)^t;
+	return (unsigned int)(h^(h>>29));
+}
+
+//write the live values to the given file, grouped by where they were allocated and their type, most first, with a sample of each
+//all is TRUE to include every live value, or FALSE for only the ones allocated since the last report
+//returns the number of values reported
+unsigned long long nl_leak_report(FILE *fp, char all){
+	//the groups are found with an open addressing hash table, which doubles when it's half full
+	unsigned int size=256;
+	unsigned int used=0;
+	nl_leak_group *groups=(nl_leak_group*)(calloc(size,sizeof(nl_leak_group)));
+	if(groups==NULL){
+		ERR_EXIT(nl_null,"could not malloc a leak report (out of memory?)",FALSE);
+		exit(1);
+	}
+	unsigned long long total=0;
+	
+	pthread_mutex_lock(&nl_leak_lock);
+	unsigned int gen=nl_leak_gen;
+	nl_val *v;
+	for(v=nl_leak_vals;v!=NULL;v=v->leak_next){
+		if((!all) && (v->leak_gen!=gen)){
+			continue;
+		}
+		//frozen values are never free'd on purpose (see NL_VAL_FROZEN), so they aren't leaks
+		if(v->flags & NL_VAL_FROZEN){
+			continue;
+		}
+		
+		if((used*2)>=size){
+			unsigned int new_size=size*2;
+			nl_leak_group *new_groups=(nl_leak_group*)(calloc(new_size,sizeof(nl_leak_group)));
+			if(new_groups==NULL){
+				ERR_EXIT(nl_null,"could not malloc a leak report (out of memory?)",FALSE);
+				exit(1);
+			}
+			unsigned int n;
+			for(n=0;n<size;n++){
+				if(groups[n].cnt>0){
+					unsigned int slot=nl_leak_hash(groups[n].file,groups[n].c_line,groups[n].line,groups[n].t)&(new_size-1);
+					while(new_groups[slot].cnt>0){
+						slot=(slot+1)&(new_size-1);
+					}
+					new_groups[slot]=groups[n];
+				}
+			}
+			free(groups);
+			groups=new_groups;
+			size=new_size;
+		}
+		
+		unsigned int slot=nl_leak_hash(v->leak_file,v->leak_c_line,v->leak_line,v->t)&(size-1);
+		while((groups[slot].cnt>0) && !((groups[slot].file==v->leak_file) && (groups[slot].c_line==v->leak_c_line) && (groups[slot].line==v->leak_line) && (groups[slot].t==v->t))){
+			slot=(slot+1)&(size-1);
+		}
+		if(groups[slot].cnt==0){
+			groups[slot].file=v->leak_file;
+			groups[slot].c_line=v->leak_c_line;
+			groups[slot].line=v->leak_line;
+			groups[slot].t=v->t;
+			groups[slot].sample=v;
+			used++;
+		}
+		groups[slot].cnt++;
+		total++;
+	}
+	//the next report only looks at what's allocated after this one (including what this one allocates to write samples)
+	nl_leak_gen++;
+	pthread_mutex_unlock(&nl_leak_lock);
+	
+	//sort the groups, most values first (insertion sort into the front of the table)
+	unsigned int n;
+	unsigned int cnt=0;
+	for(n=0;n<size;n++){
+		if(groups[n].cnt>0){
+			nl_leak_group g=groups[n];
+			unsigned int pos=cnt;
+			while((pos>0) && (groups[pos-1].cnt<g.cnt)){
+				groups[pos]=groups[pos-1];
+				pos--;
+			}
+			groups[pos]=g;
+			cnt++;
+		}
+	}
+	
+	fflush(stdout);
+	fprintf(fp,"leak check: %llu live value%s in %u group%s%s\n",total,(total==1)?"":"s",cnt,(cnt==1)?"":"s",all?"":" (allocated since the last leak check)");
+	for(n=0;(n<cnt) && (n<NL_LEAK_GROUPS_SHOWN);n++){
+		fprintf(fp,"\t%llu %s allocated at line %u (%s:%u), e.g. ",groups[n].cnt,nl_type_name(groups[n].t),groups[n].line,(groups[n].file!=NULL)?groups[n].file:"?",groups[n].c_line);
+		
+		//samples are written out in full and then cut short, since some values are very long
+		char *sample=NULL;
+		size_t sample_len=0;
+		FILE *sample_fp=open_memstream(&sample,&sample_len);
+		if(sample_fp!=NULL){
+			nl_out(sample_fp,groups[n].sample);
+			fclose(sample_fp);
+			
+			//(one line per group, even for samples with newlines in them)
+			size_t c;
+			for(c=0;c<sample_len;c++){
+				if((sample[c]>=0) && (sample[c]<' ')){
+					sample[c]=' ';
+				}
+			}
+			if(sample_len>NL_LEAK_SAMPLE_LEN){
+				fprintf(fp,"%.*s...\n",NL_LEAK_SAMPLE_LEN,sample);
+			}else{
+				fprintf(fp,"%s\n",sample);
+			}
+			free(sample);
+		}else{
+			nl_out(fp,groups[n].sample);
+			fprintf(fp,"\n");
+		}
+	}
+	if(cnt>NL_LEAK_GROUPS_SHOWN){
+		fprintf(fp,"\t(and %u more group%s)\n",cnt-NL_LEAK_GROUPS_SHOWN,((cnt-NL_LEAK_GROUPS_SHOWN)==1)?"":"s");
+	}
+	
+	free(groups);
+	return total;
+}
+#endif
+
+//report the values allocated since the last leak-check that are still live (to stdout), and return how many there were
+//this is only available in interpreters built with _LEAKCHECK (make leakcheck)
+nl_val *nl_leak_check(nl_val *arg_list){
+	nl_val *ret=nl_null;
+#ifdef _LEAKCHECK
+	//(the report comes first so the number it returns isn't in it)
+	unsigned long long cnt=nl_leak_report(stdout,FALSE);
+	ret=nl_val_malloc(NUM);
+	ret->d.num.n=cnt;
+	ret->d.num.d=1;
+#else
+	ERR_EXIT(nl_null,"leak-check needs an interpreter built with _LEAKCHECK (make leakcheck)",FALSE);
+#endif
+	return ret;
+}
+
+//END C-NL-STDLIB-LEAKCHECK SUBROUTINES  --------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-PERF SUBROUTINES  -----------------------------------------------------------------------------
+
+char nl_perf_on=FALSE;
+
+//the counters (-1 for any that couldn't be opened), the thread they count, and the readings when they were opened
+int nl_perf_fds[NL_PERF_CNT];
+pthread_t nl_perf_thread;
+nl_perf_counts nl_perf_opened;
+
+//how many top-level expressions are being counted right now (see nl_perf_form_start; only the thread the counters count changes this)
+unsigned int nl_perf_depth=0;
+
+//the perf_event_open type and configuration of each NL_PERF_* event, and their names (for errors)
+unsigned int nl_perf_types[NL_PERF_CNT]={
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HW_CACHE,
+	PERF_TYPE_HW_CACHE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+};
+unsigned long long nl_perf_configs[NL_PERF_CNT]={
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_L1D|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_ACCESS<<16),
+	PERF_COUNT_HW_CACHE_L1D|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16),
+	//(the generic cache events are the last level cache on most processors)
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES,
+};
+const char *nl_perf_names[NL_PERF_CNT]={
+	"cycles",
+	"instructions",
+	"branches",
+	"branch misses",
+	"L1d loads",
+	"L1d misses",
+	"LLC references",
+	"LLC misses",
+};
+
+//open the hardware performance counters for the calling thread; if none of them can be opened this writes why to stderr and leaves nl_perf_on FALSE
+void nl_perf_start(){
+	int first_errno=0;
+	unsigned int opened=0;
+	int n;
+	for(n=0;n<NL_PERF_CNT;n++){
+		struct perf_event_attr attr;
+		memset(&attr,0,sizeof(attr));
+		attr.size=sizeof(attr);
+		attr.type=nl_perf_types[n];
+		attr.config=nl_perf_configs[n];
+		//only the program's own work is counted, which is also all that unprivileged users are allowed to count
+		attr.exclude_kernel=1;
+		attr.exclude_hv=1;
+		//there are usually fewer hardware counters than events, so the kernel takes turns and these say for how long each one counted
+		attr.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+		
+		nl_perf_fds[n]=syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+		if(nl_perf_fds[n]<0){
+			if(first_errno==0){
+				first_errno=errno;
+			}
+		}else{
+			opened++;
+		}
+	}
+	
+	if(opened==0){
+		fprintf(stderr,"Warn: hardware performance counters aren't available (%s); continuing without --perf-counters\n",strerror(first_errno));
+		return;
+	}
+	for(n=0;n<NL_PERF_CNT;n++){
+		if(nl_perf_fds[n]<0){
+			fprintf(stderr,"Warn: the %s performance counter isn't available; it won't be reported\n",nl_perf_names[n]);
+		}
+	}
+	
+	nl_perf_thread=pthread_self();
+	nl_perf_on=TRUE;
+	nl_perf_read(&nl_perf_opened);
+}
+
+//returns TRUE if the counters are open and count the calling thread (they only count the thread that opened them)
+char nl_perf_here(){
+	return nl_perf_on && pthread_equal(pthread_self(),nl_perf_thread);
+}
+
+//read the counters
+void nl_perf_read(nl_perf_counts *counts){
+	int n;
+	for(n=0;n<NL_PERF_CNT;n++){
+		counts->v[n]=0;
+		
+		//the value, then the time the counter was enabled and the time it was actually counting
+		unsigned long long buf[3];
+		if((nl_perf_fds[n]>=0) && (read(nl_perf_fds[n],buf,sizeof(buf))==sizeof(buf))){
+			if(buf[2]>0){
+				counts->v[n]=(unsigned long long)(((double)(buf[0]))*((double)(buf[1]))/((double)(buf[2])));
+			}
+		}
+	}
+}
+
+//returns how much a counter went up between two readings (scaling can make a later estimate a little lower)
+unsigned long long nl_perf_delta(nl_perf_counts *start, nl_perf_counts *end, int n){
+	return (end->v[n]>start->v[n])?(end->v[n]-start->v[n]):0;
+}
+
+//write a miss count and what percentage of the given total it is, or n/a if either counter isn't available
+void nl_perf_out_rate(FILE *fp, const char *name, nl_perf_counts *start, nl_perf_counts *end, int misses, int total){
+	if((nl_perf_fds[misses]<0) || (nl_perf_fds[total]<0)){
+		fprintf(fp,", %s n/a",name);
+		return;
+	}
+	unsigned long long miss_cnt=nl_perf_delta(start,end,misses);
+	unsigned long long total_cnt=nl_perf_delta(start,end,total);
+	fprintf(fp,", %llu %s (%.2f%%)",miss_cnt,name,(total_cnt>0)?((100.0*miss_cnt)/total_cnt):0.0);
+}
+
+//write the counts between two readings to the given file, with instructions per cycle and miss rates, labelled with the given line number
+//(a line of 0 labels them as the total)
+void nl_perf_report(FILE *fp, unsigned int line, nl_perf_counts *start, nl_perf_counts *end){
+	fflush(stdout);
+	if(line>0){
+		fprintf(fp,"perf [line %u]: ",line);
+	}else{
+		fprintf(fp,"perf [total]: ");
+	}
+	
+	unsigned long long cycles=nl_perf_delta(start,end,NL_PERF_CYCLES);
+	unsigned long long instructions=nl_perf_delta(start,end,NL_PERF_INSTRUCTIONS);
+	if((nl_perf_fds[NL_PERF_CYCLES]>=0) && (nl_perf_fds[NL_PERF_INSTRUCTIONS]>=0)){
+		fprintf(fp,"%llu cycles, %llu instructions (%.2f IPC)",cycles,instructions,(cycles>0)?(((double)(instructions))/cycles):0.0);
+	}else{
+		fprintf(fp,"cycles and instructions n/a");
+	}
+	nl_perf_out_rate(fp,"branch misses",start,end,NL_PERF_BRANCH_MISSES,NL_PERF_BRANCHES);
+	nl_perf_out_rate(fp,"L1d misses",start,end,NL_PERF_L1D_MISSES,NL_PERF_L1D_LOADS);
+	nl_perf_out_rate(fp,"LLC misses",start,end,NL_PERF_LLC_MISSES,NL_PERF_LLC_REFS);
+	fprintf(fp,"\n");
+}
+
+//start counting a top-level expression, if counters are on and this isn't inside another one; returns TRUE if it is being counted
+//(expressions of a file that's sourced from a top-level expression are part of that one)
+char nl_perf_form_start(nl_perf_counts *start){
+	if((!nl_perf_here()) || (nl_perf_depth>0)){
+		return FALSE;
+	}
+	nl_perf_depth++;
+	nl_perf_read(start);
+	return TRUE;
+}
+
+//finish counting a top-level expression that nl_perf_form_start started, and report it
+void nl_perf_form_end(nl_perf_counts *start, unsigned int line){
+	nl_perf_counts end;
+	nl_perf_read(&end);
+	nl_perf_depth--;
+	nl_perf_report(stderr,line,start,&end);
+}
+
+//report the counts for the whole program, and close the counters (see --perf-counters)
+void nl_perf_finish(){
+	if(!nl_perf_on){
+		return;
+	}
+	nl_perf_counts end;
+	nl_perf_read(&end);
+	nl_perf_report(stderr,0,&nl_perf_opened,&end);
+	
+	nl_perf_on=FALSE;
+	int n;
+	for(n=0;n<NL_PERF_CNT;n++){
+		if(nl_perf_fds[n]>=0){
+			close(nl_perf_fds[n]);
+		}
+	}
+}
+
+//END C-NL-STDLIB-PERF SUBROUTINES  -------------------------------------------------------------------------------
+
+//BEGIN C-NL-STDLIB-TRACE SUBROUTINES  ----------------------------------------------------------------------------
+
+char nl_trace_on=FALSE;
+unsigned long long nl_trace_min_ns=NL_TRACE_MIN_US*1000ULL;
+
+//the trace file, when tracing started, and every interpreter's buffer of spans (all protected by nl_trace_lock)
+//spans are only written with the lock held, so the ones from different threads don't get mixed up
+pthread_mutex_t nl_trace_lock=PTHREAD_MUTEX_INITIALIZER;
+FILE *nl_trace_fp=NULL;
+unsigned long long nl_trace_start_ns=0;
+nl_trace_buf *nl_trace_bufs=NULL;
+
+//TRUE once any span's been written (every one after the first has a comma before it)
+char nl_trace_written=FALSE;
+
+//the name of each key as a JSON string, made the first time it's written (indexed by key; protected by nl_trace_lock)
+char **nl_trace_names=NULL;
+unsigned int nl_trace_names_size=0;
+
+//the calling thread's id (0 until it's looked up)
+__thread int nl_trace_tid=0;
+
+//start tracing calls to the given file (which is written as a Chrome trace, a JSON array of trace events); returns FALSE if it can't be written
+//spans come from the same calls that --prof-count counts, so this counts calls too (but doesn't write a report of the counts)
+char nl_trace_start(const char *fname){
+	if(nl_trace_on){
+		return TRUE;
+	}
+	nl_trace_fp=fopen(fname,"w");
+	if(nl_trace_fp==NULL){
+		return FALSE;
+	}
+	//(viewers accept a trace without the closing bracket, so a program that crashes still leaves one that can be read)
+	fprintf(nl_trace_fp,"[\n");
+	nl_trace_start_ns=nl_par_now_ns();
+	
+	nl_prof_count_enable();
+	nl_trace_on=TRUE;
+	atexit(nl_trace_finish);
+	return TRUE;
+}
+
+//returns TRUE if the given primitive function reads or writes files (calls to these are always traced)
+char nl_trace_io(nl_val *(*function)(nl_val *arglist)){
+	return (function==nl_file_open) || (function==nl_file_read_line) || (function==nl_file_read_chunk) || (function==nl_file_eof) ||
+		(function==nl_file_write) || (function==nl_file_close) || (function==nl_file_tmp) || (function==nl_file_delete) ||
+		(function==nl_str_from_file) || (function==nl_str_to_file) || (function==nl_str_append_file);
+}
+
+//add a finished call to an interpreter's trace, if it's a kind that's traced
+void nl_trace_add(nl_vm *vm, nl_prof_call *call, unsigned long long ns){
+	if((call->trace==NL_TRACE_PRI) && (ns<nl_trace_min_ns)){
+		return;
+	}
+	if(nl_trace_tid==0){
+		nl_trace_tid=(int)(syscall(SYS_gettid));
+	}
+	
+	nl_trace_buf *buf=vm->trace_buf;
+	if(buf->cnt>=NL_TRACE_BUF_SIZE){
+		pthread_mutex_lock(&nl_trace_lock);
+		nl_trace_flush(buf);
+		pthread_mutex_unlock(&nl_trace_lock);
+	}
+	nl_trace_span *span=&(buf->spans[buf->cnt]);
+	span->id=call->id;
+	span->kind=call->trace;
+	span->tid=nl_trace_tid;
+	span->start_ns=call->start_ns;
+	span->ns=ns;
+	//(a buffer can be written out by another thread when the program ends, so the count is only changed once the span is ready)
+	__atomic_store_n(&(buf->cnt),buf->cnt+1,__ATOMIC_RELEASE);
+}
+
+//write a string as a JSON string
+void nl_trace_out_str(FILE *fp, const char *str, size_t len){
+	fputc('"',fp);
+	size_t n;
+	for(n=0;n<len;n++){
+		unsigned char c=(unsigned char)(str[n]);
+		if((c=='"') || (c=='\\')){
+			fprintf(fp,"\\%c",c);
+		}else if(c<' '){
+			fprintf(fp,"\\u%04x",c);
+		}else{
+			fputc(c,fp);
+		}
+	}
+	fputc('"',fp);
+}
+
+//returns the name of the given key as a JSON string (nl_trace_lock must be held)
+const char *nl_trace_name(unsigned int id){
+	if(id>=nl_trace_names_size){
+		unsigned int size=(nl_trace_names_size==0)?256:nl_trace_names_size;
+		while(id>=size){
+			size*=2;
+		}
+		nl_trace_names=(char**)(realloc(nl_trace_names,size*sizeof(char*)));
+		if(nl_trace_names==NULL){
+			ERR_EXIT(nl_null,"could not malloc the trace (out of memory?)",FALSE);
+			exit(1);
+		}
+		memset(nl_trace_names+nl_trace_names_size,0,(size-nl_trace_names_size)*sizeof(char*));
+		nl_trace_names_size=size;
+	}
+	
+	if(nl_trace_names[id]==NULL){
+		//names are written the same way the --prof-count report writes them, then quoted
+		char *name=NULL;
+		size_t name_len=0;
+		FILE *name_fp=open_memstream(&name,&name_len);
+		if(name_fp==NULL){
+			ERR_EXIT(nl_null,"could not malloc the trace (out of memory?)",FALSE);
+			exit(1);
+		}
+		pthread_mutex_lock(&nl_prof_lock);
+		if(!nl_prof_key_pri[id]){
+			nl_prof_out_frame(name_fp,nl_prof_key_vals[id]);
+		}else if(nl_prof_key_names[id]!=0){
+			fprintf(name_fp,"%s",nl_prof_names[nl_prof_key_names[id]]);
+		}else{
+			fprintf(name_fp,"(primitive)");
+		}
+		pthread_mutex_unlock(&nl_prof_lock);
+		fclose(name_fp);
+		
+		char *quoted=NULL;
+		size_t quoted_len=0;
+		FILE *quoted_fp=open_memstream(&quoted,&quoted_len);
+		if(quoted_fp==NULL){
+			ERR_EXIT(nl_null,"could not malloc the trace (out of memory?)",FALSE);
+			exit(1);
+		}
+		nl_trace_out_str(quoted_fp,name,name_len);
+		fclose(quoted_fp);
+		free(name);
+		nl_trace_names[id]=quoted;
+	}
+	return nl_trace_names[id];
+}
+
+//write out the spans in a buffer (nl_trace_lock must be held)
+void nl_trace_flush(nl_trace_buf *buf){
+	unsigned int cnt=__atomic_load_n(&(buf->cnt),__ATOMIC_ACQUIRE);
+	if(nl_trace_fp==NULL){
+		return;
+	}
+	
+	//the names of the kinds of spans (see NL_TRACE_SUB and the others), which viewers can filter by
+	const char *cats[]={"sub","io","primitive"};
+	int pid=(int)(getpid());
+	unsigned int n;
+	for(n=0;n<cnt;n++){
+		nl_trace_span *span=&(buf->spans[n]);
+		//spans are complete events (ph X), with times in microseconds since tracing started
+		fprintf(nl_trace_fp,"%s{\"name\":%s,\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+			nl_trace_written?",\n":"",nl_trace_name(span->id),cats[span->kind],
+			(span->start_ns>nl_trace_start_ns)?((span->start_ns-nl_trace_start_ns)/1000.0):0.0,span->ns/1000.0,pid,span->tid);
+		nl_trace_written=TRUE;
+	}
+	__atomic_store_n(&(buf->cnt),0,__ATOMIC_RELEASE);
+}
+
+//set up tracing for a new interpreter
+void nl_trace_vm_init(nl_vm *vm){
+	nl_trace_buf *buf=(nl_trace_buf*)(malloc(sizeof(nl_trace_buf)));
+	if(buf==NULL){
+		ERR_EXIT(nl_null,"could not malloc an interpreter's trace (out of memory?)",FALSE);
+		exit(1);
+	}
+	buf->cnt=0;
+	
+	pthread_mutex_lock(&nl_trace_lock);
+	buf->next=nl_trace_bufs;
+	nl_trace_bufs=buf;
+	pthread_mutex_unlock(&nl_trace_lock);
+	
+	vm->trace_buf=buf;
+}
+
+//write out an interpreter's spans and stop tracing it (before it's free'd)
+void nl_trace_vm_free(nl_vm *vm){
+	nl_trace_buf *buf=vm->trace_buf;
+	if(buf==NULL){
+		return;
+	}
+	
+	pthread_mutex_lock(&nl_trace_lock);
+	nl_trace_flush(buf);
+	nl_trace_buf **link=&nl_trace_bufs;
+	while(*link!=buf){
+		link=&((*link)->next);
+	}
+	*link=buf->next;
+	pthread_mutex_unlock(&nl_trace_lock);
+	
+	free(buf);
+	vm->trace_buf=NULL;
+}
+
+//write out every interpreter's spans and finish the trace file (see --trace)
+//(interpreters that are still running, like the parallel workers, are idle by now)
+void nl_trace_finish(){
+	pthread_mutex_lock(&nl_trace_lock);
+	nl_trace_buf *buf;
+	for(buf=nl_trace_bufs;buf!=NULL;buf=buf->next){
+		nl_trace_flush(buf);
+	}
+	if(nl_trace_fp!=NULL){
+		fprintf(nl_trace_fp,"\n]\n");
+		fclose(nl_trace_fp);
+		//(anything traced after this isn't written)
+		nl_trace_fp=NULL;
+	}
+	pthread_mutex_unlock(&nl_trace_lock);
+}
+
+//END C-NL-STDLIB-TRACE SUBROUTINES  ------------------------------------------------------------------------------
+
+
+
+//assert that all conditions in the given list are true; if not, exit (if compiled _STRICT) or return false (not strict)
+nl_val *nl_assert(nl_val *cond_list){
+	nl_val *ret=nl_val_malloc(BYTE);
+	ret->d.byte.v=TRUE;
+	while(cond_list->t==PAIR){
+		if(!nl_is_true(cond_list->d.pair.f)){
+			ret->d.byte.v=FALSE;
+#ifdef _STRICT
+			nl_val_free(ret);
+			ERR_EXIT(cond_list,"ASSERT FAILED",TRUE);
+#endif
+		}
+		
+		cond_list=cond_list->d.pair.r;
+	}
+#ifdef _DEBUG
+	if(cond_list!=nl_null){
+		printf("line %u: assert succeeded\n",nl_val_line(cond_list));
+	}else{
+		printf("line %i: assert succeeded\n",nl_vm_cur->line_number);
+	}
+#endif
+	return ret;
+}
+
+//sleep a given number of seconds (if multiple arguments are given they are added)
+nl_val *nl_sleep(nl_val *time_list){
+	if(nl_c_list_size(time_list)==0){
+		ERR_EXIT(time_list,"too few arguments given to sleep operation",FALSE);
+		return nl_null;
+	}
+	
+	while(time_list->t==PAIR){
+		if((time_list->d.pair.f->t!=NUM)){
+			ERR_EXIT(time_list,"non-number argument given to sleep operation",TRUE);
+			return nl_null;
+		}
+		//perform the division (from the rational number) then mul by 1000000 for a precision of 1 microsecond
+		useconds_t time_to_sleep=(useconds_t)((1000000*(((double)(time_list->d.pair.f->d.num.n))/((double)(time_list->d.pair.f->d.num.d)))));
+/*
+#ifdef _DEBUG
+		printf("nl_sleep debug 0, sleeping for %u microseconds\n",time_to_sleep);
+#endif
+*/
+		//with coroutines, only the one that's sleeping waits
+		if(!nl_co_sleep(time_to_sleep)){
+			usleep(time_to_sleep);
+		}
 		
 		time_list=time_list->d.pair.r;
 	}
@@ -9,6 +9,120 @@
 #define FALSE 0
 #define BUFFER_SIZE 1024
 
+//how much the source reader asks the operating system for at once
+#define NL_READ_CHUNK 65536
+
+//size of the stdout buffer (output is written to the operating system in blocks of this size when not interactive)
+#define NL_OUT_BUFFER 65536
+
+//size of the write buffer for file handles; writes at least this big go straight to the operating system
+#define NL_WRITE_BUFFER 65536
+
+//the most files file->ar keeps memory mapped at once (see nl_map_slot); past that, files are read into memory instead
+#define NL_MAP_SLOTS 1024
+
+//how hard file writes try to make sure data is on disk before returning (see nl_handle.sync)
+#define NL_SYNC_NONE 0
+#define NL_SYNC_DATA 1
+#define NL_SYNC_FULL 2
+
+//binary value format (see nl_val_to_bin); every encoded value starts with the magic bytes and the format version
+//bump the version whenever the encoding changes; data from any earlier version can still be read as long as tags are only ever added
+#define NL_BIN_MAGIC "NLB"
+#define NL_BIN_VERSION 3
+
+//cached parse of a source file (see nl_source_read); a file's cache is its name with this appended
+#define NL_SOURCE_CACHE_EXT "c"
+//caches are only used by the exact interpreter build that wrote them, since the parser can change without the version changing
+#define NL_SOURCE_CACHE_KEY VERSION " " __DATE__ " " __TIME__
+
+//number of slots in the source line side table (slot 0 means "no line recorded")
+//the table starts with NL_LINE_SLOTS_INIT slots and doubles as needed up to NL_LINE_SLOTS (the most a slot index can address)
+#define NL_LINE_SLOTS 65536
+#define NL_LINE_SLOTS_INIT 1024
+
+//parallel array mapping (see nl_array_pmap); times are in nanoseconds
+//the first elements are mapped in order until this much time has passed, to estimate how long each element takes
+#define NL_PAR_SAMPLE_NS 50000
+//if the rest of the array would take less than this it's not worth waking other threads
+#define NL_PAR_MIN_WORK_NS 500000
+//each chunk handed to a thread is at least this much work, so threads spend their time mapping rather than coordinating
+#define NL_PAR_GRAIN_NS 200000
+//at most this many chunks per thread (more chunks balance uneven elements better, fewer cost less to hand out)
+#define NL_PAR_CHUNKS_PER_THREAD 8
+//a parallel fold splits the array into at most this many chunks per thread (each chunk's result is combined in order at the end)
+#define NL_PAR_FOLD_CHUNKS_PER_THREAD 2
+//stack size for worker threads; evaluation recurses, so this is as much as a main thread would typically get
+#define NL_PAR_STACK_SIZE (64*1024*1024)
+
+//task scheduler (see nl_par_task); each thread's work-stealing deque holds at most this many tasks
+//(a task that doesn't fit is just run by the thread that made it)
+#define NL_PAR_DEQUE_SIZE 4096
+//an idle worker looks for work this many times before it goes to sleep
+#define NL_PAR_IDLE_SPINS 64
+
+//the state of a task (see nl_par_task.state)
+#define NL_PAR_TASK_WAITING 0
+#define NL_PAR_TASK_RUNNING 1
+#define NL_PAR_TASK_DONE 2
+#define NL_PAR_TASK_ABORTED 3
+
+//coroutines (see nl_co); each one evaluates on a stack of this size (only the part that gets used is ever touched)
+#define NL_CO_STACK_SIZE (8*1024*1024)
+
+//the state of a coroutine (see nl_co.state)
+#define NL_CO_READY 0
+#define NL_CO_WAITING 1
+#define NL_CO_DONE 2
+
+//the sampling profiler (see --profile); samples are taken every this many nanoseconds of the process's processor time
+#define NL_PROF_INTERVAL_NS 1000000
+
+//the deepest neulang call stack the profiler records (deeper calls are counted but not recorded)
+#define NL_PROF_MAX_DEPTH 128
+
+//how many samples each interpreter can hold before they're added to the profile (see nl_prof_ring)
+//(a second's worth, so a single primitive that runs for longer than that loses samples)
+#define NL_PROF_RING_SIZE 1024
+
+//a sample is its frame count, then the root frame, the call stack, and the line being evaluated
+#define NL_PROF_SAMPLE_LEN (NL_PROF_MAX_DEPTH+3)
+
+//the name given in a profile frame for the line being evaluated (a frame is a name number and a line, see nl_prof_frame)
+#define NL_PROF_LINE 0xffffffffU
+
+//the names of the frames for subroutines that were never bound to a name, and for futures and coroutines (see nl_prof_start)
+#define NL_PROF_NAME_SUB 0
+#define NL_PROF_NAME_FUTURE 1
+#define NL_PROF_NAME_SPAWN 2
+
+//the hardware events counted with --perf-counters (see nl_perf_counts), in the order they're reported
+#define NL_PERF_CYCLES 0
+#define NL_PERF_INSTRUCTIONS 1
+#define NL_PERF_BRANCHES 2
+#define NL_PERF_BRANCH_MISSES 3
+#define NL_PERF_L1D_LOADS 4
+#define NL_PERF_L1D_MISSES 5
+#define NL_PERF_LLC_REFS 6
+#define NL_PERF_LLC_MISSES 7
+#define NL_PERF_CNT 8
+
+//what a span in a trace is for (see --trace and nl_prof_call): a subroutine call (or a future or coroutine),
+//a file input/output primitive, or any other primitive (which is only traced when it takes at least nl_trace_min_ns)
+#define NL_TRACE_SUB 0
+#define NL_TRACE_IO 1
+#define NL_TRACE_PRI 2
+
+//how many spans each interpreter holds before they're written to the trace file
+#define NL_TRACE_BUF_SIZE 4096
+
+//the shortest primitive call that's traced, by default (in microseconds; see --trace-min-us)
+#define NL_TRACE_MIN_US 100
+
+//the most groups of live values a leak report lists, and the most characters it shows of each group's sample (see nl_leak_report)
+#define NL_LEAK_GROUPS_SHOWN 50
+#define NL_LEAK_SAMPLE_LEN 120
+
 //END GLOBAL CONSTANTS --------------------------------------------------------------------------------------------
 
 //BEGIN GLOBAL MACROS ---------------------------------------------------------------------------------------------
@@ -20,6 +134,43 @@
 	#define ERR_EXIT(val,msg,output) ERR(val,msg,output)
 #endif
 
+//change or read a reference count (of a value or of packed array storage); the decrement gives the new count
+//while parallel work is running (see nl_par_active) shared values are reachable from several threads, so counts change atomically
+#define NL_REF_INC(cnt) ((__atomic_load_n(&nl_par_active,__ATOMIC_RELAXED)>0)?__atomic_add_fetch(&(cnt),1,__ATOMIC_RELAXED):(++(cnt)))
+#define NL_REF_DEC(cnt) ((__atomic_load_n(&nl_par_active,__ATOMIC_RELAXED)>0)?__atomic_sub_fetch(&(cnt),1,__ATOMIC_ACQ_REL):(--(cnt)))
+#define NL_REF_GET(cnt) (__atomic_load_n(&(cnt),__ATOMIC_RELAXED))
+
+//add a reference to a value; pinned and frozen values aren't reference counted at all (see NL_VAL_FROZEN)
+#define NL_VAL_REF_INC(v) do{ if(!((v)->flags & (NL_VAL_PINNED|NL_VAL_FROZEN))){ NL_REF_INC((v)->ref); } }while(0)
+
+//change the reference count of packed array storage; storage that's shared with other isolates is always counted atomically
+#define NL_BYTES_REF_INC(b) (__atomic_load_n(&((b)->shared),__ATOMIC_ACQUIRE)?__atomic_add_fetch(&((b)->ref),1,__ATOMIC_RELAXED):NL_REF_INC((b)->ref))
+#define NL_BYTES_REF_DEC(b) (__atomic_load_n(&((b)->shared),__ATOMIC_ACQUIRE)?__atomic_sub_fetch(&((b)->ref),1,__ATOMIC_ACQ_REL):NL_REF_DEC((b)->ref))
+
+//add to a counter that only its own interpreter changes, but that reports can read from any thread (see nl_stats and nl_prof_cnt)
+#define NL_COUNT_ADD(cnt,n) __atomic_store_n(&(cnt),__atomic_load_n(&(cnt),__ATOMIC_RELAXED)+(n),__ATOMIC_RELAXED)
+
+//add to a counter in an interpreter's statistics, or (when there's no interpreter) to nl_stats_outside
+//threads without an interpreter can add to those at the same time, so they're added to atomically
+#define NL_STATS_COUNT(vm,field,cnt) do{ \
+		if((vm)!=NULL){ \
+			NL_COUNT_ADD((vm)->stats.field,(cnt)); \
+		}else{ \
+			__atomic_fetch_add(&(nl_stats_outside.field),(cnt),__ATOMIC_RELAXED); \
+		} \
+	}while(0)
+
+//count memory in an interpreter's statistics: cnt more of the given counter (fewer if it's negative),
+//each taking up size bytes (see nl_stats)
+//(the peak isn't kept for what's outside of any interpreter, which is only ever a few values)
+#define NL_STATS_MEM(vm,field,cnt,size) do{ \
+		NL_STATS_COUNT(vm,field,(cnt)); \
+		NL_STATS_COUNT(vm,bytes,((long long)(cnt))*((long long)(size))); \
+		if(((vm)!=NULL) && ((vm)->stats.bytes>(vm)->stats.peak_bytes)){ \
+			__atomic_store_n(&((vm)->stats.peak_bytes),(vm)->stats.bytes,__ATOMIC_RELAXED); \
+		} \
+	}while(0)
+
 //END GLOBAL MACROS -----------------------------------------------------------------------------------------------
 
 //BEGIN DATA STRUCTURES -------------------------------------------------------------------------------------------
@@ -36,6 +187,7 @@ typedef enum {
 	PRI, //primitive procedure (C code)
 	SUB, //closure (subroutine)
 	STRUCT, //structure (named array)
+	HANDLE, //open file (buffered reads and writes on a file descriptor)
 	
 	//internal types (might still be user visible, but mostly an implementation detail)
 	SYMBOL, //variable names, for the symbol table, internally this is a [byte]array
@@ -43,23 +195,115 @@ typedef enum {
 	BIND, //delayed variable binding
 	NL_NULL, //null type
 	
+	//types added since the binary format (see nl_val_to_bin) go here, so the numbers of the types above don't change
+	FUTURE, //the result of an expression that may be evaluated on another thread (see nl_par_task)
+	CHANNEL, //a queue of values that coroutines send to and receive from (see nl_chan)
+	
 	NL_TYPE_CNT,
 } nl_type;
 
 typedef struct nl_env_frame nl_env_frame;
+typedef struct nl_reader nl_reader;
+typedef struct nl_handle nl_handle;
+typedef struct nl_par_task nl_par_task;
+typedef struct nl_co nl_co;
+typedef struct nl_chan nl_chan;
+typedef struct nl_isolate nl_isolate;
+typedef struct nl_prof_ring nl_prof_ring;
+typedef struct nl_prof_call nl_prof_call;
+typedef struct nl_prof_tally nl_prof_tally;
+typedef struct nl_stats nl_stats;
+typedef struct nl_perf_counts nl_perf_counts;
+typedef struct nl_trace_span nl_trace_span;
+typedef struct nl_trace_buf nl_trace_buf;
+typedef struct nl_msg nl_msg;
 
-//a primitive value structure, the basic unit of evalution in neulang
 typedef struct nl_val nl_val;
+
+//value flags (see nl_val.flags)
+//a packed array stores raw bytes (in shared nl_bytes storage) rather than pointers to BYTE values
+#define NL_VAL_PACKED 0x01
+//a pinned value belongs to the interpreter that made it and is free'd along with it (see nl_vm_free), so it isn't reference counted
+//primitive procedures are pinned; they never change, and every call looks one up, so parallel threads would all be counting the same few values
+#define NL_VAL_PINNED 0x02
+//a frozen value (and everything in it) never changes and is never free'd, so it isn't reference counted either
+//any number of threads can read one at once without touching its memory, and copies share everything in it (see nl_val_cp)
+#define NL_VAL_FROZEN 0x04
+
+//raw storage for packed byte arrays; this is shared between copies and subarrays (which are read-only views)
+//and gets copied before it's modified (copy-on-write)
+typedef struct nl_bytes nl_bytes;
+struct nl_bytes {
+	//the number of arrays using this storage
+	unsigned int ref;
+	
+	//the bytes themselves
+	char *data;
+	
+	//how many bytes are allocated (or mapped)
+	size_t len;
+	
+	//TRUE if data is a (read-only) memory map of a file, FALSE if it was malloc'd
+	char mapped;
+	
+	//TRUE once this storage is (or may be) used by more than one isolate; from then on its count changes atomically
+	char shared;
+};
+
+//a file file->ar has memory mapped, so the map can be found again when the file gets shorter (see nl_map_detach and nl_map_sigbus)
+typedef struct nl_map_slot nl_map_slot;
+struct nl_map_slot {
+	//the start of the map (NULL for a slot that isn't in use) and how many bytes it maps
+	char *addr;
+	size_t len;
+	
+	//the device and inode of the file
+	unsigned long long dev;
+	unsigned long long ino;
+};
+
+//subroutine (closure) data; this is large and rarely allocated compared to other values, so it's stored out-of-line
+typedef struct nl_sub_data nl_sub_data;
+struct nl_sub_data {
+	//return type of the subroutine
+//	nl_type t;
+	
+	//arguments (linked list of symbols to bind to values during apply)
+	nl_val *args;
+	
+	//named arguments, a list of pairs with default values
+	nl_val *dflt_args;
+	
+	//body (linked list of statements to execute)
+	nl_val *body;
+	
+	//environment (since this is a closure)
+	nl_env_frame *env;
+	
+	//where this was defined, and the name it was first bound to (a profiler name number; 0 for none), for the profiler
+	unsigned int line;
+	unsigned int prof_name;
+	
+	//the subroutine's key for counting calls (see nl_prof_key); 0 until it's first called with --prof-count
+	unsigned int prof_id;
+};
+
+//a primitive value structure, the basic unit of evalution in neulang
+//the header (type, line slot, and reference count) fits in one machine word and the data union is 16 bytes
+//so a value is 24 bytes total (check with sizeof if you change anything here; smaller values mean more values per cache line)
 struct nl_val {
-	//type
-	nl_type t;
+	//type (an nl_type, stored in a byte to keep the header small)
+	unsigned char t;
+	
+	//NL_VAL_* flags
+	unsigned char flags;
+	
+	//index into the source line side table (see nl_line_slot); 0 if this value wasn't created by the reader
+	unsigned short line_slot;
 	
 	//count the references to this value
 	unsigned int ref;
 	
-	//the line this value was allocated on
-	unsigned int line;
-	
 	//union to save memory; called d (short for data)
 	union {
 		//byte value
@@ -84,43 +328,49 @@ struct nl_val {
 		} pair;
 		
 		//array value
-		//TODO: make this continguous instead of an array of pointers to who-knows-where (I don't know how feasible this is due to other handling, I tried it once and it kinda failed hard, that might just be from trying to free the first entry or something; also I'm not sure how to store NULLs)
 		//note that all neulang arrays internally store a size
+		//arrays of only bytes are packed (contiguous raw bytes, see NL_VAL_PACKED); use nl_array_entry to read elements of either kind
 		struct {
 			//sub-type of the array
 //			nl_type t;
 			
-			//the memory itself and the number of elements stored
-			nl_val **v;
-//			nl_val *v;
+			//the memory itself (pointers for normal arrays, shared raw bytes for packed arrays)
+			union {
+				nl_val **v;
+				nl_bytes *bytes;
+			};
+			
+			//the number of elements stored
 			unsigned int size;
 			
-			//how much storage is used internally; this is so dynamic resizing is a little more efficient
-			unsigned int stored_size;
+			union {
+				//how much storage is used internally; this is so dynamic resizing is a little more efficient
+				unsigned int stored_size;
+				
+				//for packed arrays, where in the shared bytes this array starts
+				unsigned int offset;
+			};
 		} array;
 		
 		//primitive procedure value
 		struct {
 			nl_val *(*function)(nl_val *arglist);
+			
+			//the primitive's key for counting calls (see nl_prof_key); 0 until it's first called with --prof-count
+			unsigned int prof_id;
 		} pri;
 		
-		//subroutine value
-		struct {
-			//return type of the subroutine
-//			nl_type t;
-			
-			//arguments (linked list of symbols to bind to values during apply)
-			nl_val *args;
-			
-			//named arguments, a list of pairs with default values
-			nl_val *dflt_args;
-			
-			//body (linked list of statements to execute)
-			nl_val *body;
-			
-			//environment (since this is a closure)
-			nl_env_frame *env;
-		} sub;
+		//subroutine value (out-of-line, see nl_sub_data)
+		nl_sub_data *sub;
+		
+		//file handle value (like subroutines, handles are copied by reference)
+		nl_handle *handle;
+		
+		//future value (also copied by reference)
+		nl_par_task *future;
+		
+		//channel value (also copied by reference)
+		nl_chan *chan;
 		
 		struct {
 			//environment (what to bind the various symbols in so we can look them up)
@@ -150,6 +400,18 @@ struct nl_val {
 			nl_val *v;
 		} bind;
 	} d;
+	
+#ifdef _LEAKCHECK
+	//(leak checking builds only) every live value is in one list, along with where it was allocated (see nl_leak_report)
+	nl_val *leak_prev;
+	nl_val *leak_next;
+	//the C source file and line of the nl_val_malloc call, and the line the interpreter was on
+	const char *leak_file;
+	unsigned int leak_c_line;
+	unsigned int leak_line;
+	//the number of leak-check calls before this was allocated
+	unsigned int leak_gen;
+#endif
 };
 
 //a trie to act as a hash table for environment frames
@@ -184,19 +446,693 @@ struct nl_env_frame {
 	
 	//the environment above this one (THIS MUST BE FREE'D SEPERATELY)
 	nl_env_frame *up_scope;
+	
+	//TRUE once a task (see nl_par_task) that can see this frame has been started on the task scheduler
+	//from then on, while parallel work is running, bindings here are changed so that other threads can keep reading them
+	char par_visible;
+	
+	//TRUE for a frame that stands in for a closure's environment in parallel work (see nl_apply and nl_par_sub_clone);
+	//variables the closure reads from the real one above it were left there by earlier calls (see nl_lookup)
+	char par_call;
+};
+
+//buffered source reader; reads go straight to the underlying file descriptor in large chunks
+//and expressions are parsed directly out of the buffer
+//NOTE: once a reader is used for a file, all reads from that file must go through the reader
+struct nl_reader {
+	//the file descriptor being read
+	int fd;
+	
+	//the read buffer
+	char *buf;
+	
+	//position of the next unread byte in the buffer
+	unsigned int pos;
+	
+	//number of valid bytes in the buffer
+	unsigned int len;
+	
+	//allocated size of the buffer
+	unsigned int cap;
+	
+	//TRUE once the end of the file has been hit
+	char eof;
+};
+
+//an open file (the data behind a HANDLE value)
+struct nl_handle {
+	//the file descriptor (-1 once the file is closed)
+	int fd;
+	
+	//TRUE for the standard streams; these are never actually closed and share their reader with the repl
+	char is_std;
+	
+	//buffered reader for input (NULL if the file isn't open for reading)
+	nl_reader *r;
+	
+	//storage for the last couple of lines returned, reused once the program is done with them
+	nl_bytes *line_bufs[2];
+	unsigned char next_line_buf;
+	
+	//buffered output (NULL if the file isn't open for writing); wlen is how much is waiting to be written
+	char *wbuf;
+	unsigned int wlen;
+	
+	//what to do to make written data durable when the handle is flushed or closed (NL_SYNC_NONE, NL_SYNC_DATA, or NL_SYNC_FULL)
+	char sync;
+	
+	//TRUE if data has been written since the last sync
+	char unsynced;
+};
+
+//tags for the binary value format, one byte before each encoded value
+typedef enum {
+	NL_BIN_NULL,
+	//a byte value (followed by the byte)
+	NL_BIN_BYTE,
+	//a number (followed by a zigzag varint numerator and a varint denominator)
+	NL_BIN_NUM,
+	//a list (followed by a varint element count, the elements, and then whatever ends the list, usually NULL)
+	//a single pair is a list with one element
+	NL_BIN_LIST,
+	//a packed byte array (followed by a varint length and the bytes themselves)
+	NL_BIN_STRING,
+	//any other array (followed by a varint element count and the elements)
+	NL_BIN_ARRAY,
+	//a symbol (followed by the type byte and the name)
+	NL_BIN_SYMBOL,
+	//an evaluation (followed by its symbol)
+	NL_BIN_EVALUATION,
+	//a delayed bind (followed by its symbol and value)
+	NL_BIN_BIND,
+	//a struct (followed by a varint entry count, then a name string and a value for each entry)
+	NL_BIN_STRUCT,
+	//a back-reference to a value already written (followed by the varint index of that value)
+	NL_BIN_REF,
+	
+	//these are only written in interpreter images (see nl_image_save); plain val->bin can't encode procedures
+	//a closure (followed by its arguments, default arguments, body, and environment; see nl_bin_write_env)
+	NL_BIN_SUB,
+	//a primitive procedure (followed by the name it has in the standard library, see nl_bin_put_name)
+	NL_BIN_PRI,
+	//the closure whose body is being written (this is where recur was substituted in)
+	NL_BIN_RECUR,
+	
+	//the source line of the value after it and everything read after that until the next line tag (followed by the varint line, 0 for none)
+	//this is only written in the source cache (see nl_source_read), so errors in cached code still report the right line
+	NL_BIN_LINE,
+} nl_bin_tag;
+
+//how an environment frame is written in the binary format (one byte, before the frame data if there is any)
+typedef enum {
+	NL_BIN_ENV_NONE,
+	NL_BIN_ENV_GLOBAL,
+	//followed by the varint index of a frame already written
+	NL_BIN_ENV_REF,
+	//followed by the shared flag, the frame above this one, and then the bindings (see nl_bin_write_trie)
+	NL_BIN_ENV_NEW,
+} nl_bin_env_tag;
+
+//an entry in the binary writer's table of values already written
+//(packed arrays are keyed on their storage, so copies of the same string are only written once)
+typedef struct nl_bin_seen nl_bin_seen;
+struct nl_bin_seen {
+	const void *p;
+	unsigned int offset;
+	unsigned int size;
+	
+	//index of the value (in the order values were written), plus one; 0 for an empty table slot
+	unsigned int idx;
+};
+
+//state for writing a value in the binary format
+typedef struct nl_bin_writer nl_bin_writer;
+struct nl_bin_writer {
+	//output storage and how much of it is used (unused when writing to a handle)
+	nl_bytes *out;
+	unsigned int len;
+	
+	//handle to write to instead of memory (NULL for none)
+	nl_handle *h;
+	
+	//open-addressed hash table of values (and environment frames) already written, for back-references
+	//values and frames are numbered separately
+	nl_bin_seen *seen;
+	unsigned int seen_cnt;
+	unsigned int seen_cap;
+	unsigned int val_cnt;
+	unsigned int env_cnt;
+	
+	//for images, the global environment (written as a marker) and a fresh standard library environment (primitives are written by name)
+	//both are NULL for plain values, which can't contain procedures
+	nl_env_frame *global_env;
+	nl_env_frame *pri_env;
+	
+	//list of (symbol . primitive) pairs from the standard library environment, made the first time a primitive is written
+	nl_val *pri_list;
+	
+	//the closure whose arguments and body are being written, if any
+	const nl_val *cur_sub;
+	
+	//TRUE to write the source line of values read from source (see NL_BIN_LINE), and the last line written
+	char lines;
+	unsigned int line;
+	
+	//temporary values that have to be kept alive until writing is done (so their addresses aren't re-used)
+	nl_val *keep;
+	
+	//TRUE once something couldn't be written
+	char err;
+};
+
+//state for reading a value in the binary format
+typedef struct nl_bin_reader nl_bin_reader;
+struct nl_bin_reader {
+	//when reading from memory, the packed storage being read (strings are returned as views of it) and the readable range
+	nl_bytes *b;
+	const char *data;
+	unsigned int len;
+	unsigned int pos;
+	
+	//when reading from a file, the file's reader (NULL when reading from memory)
+	nl_reader *r;
+	
+	//values read so far that a back-reference can refer to (not owned by this array)
+	nl_val **refs;
+	unsigned int ref_cnt;
+	unsigned int ref_cap;
+	
+	//environment frames read so far, likewise
+	nl_env_frame **envs;
+	unsigned int env_cnt;
+	unsigned int env_cap;
+	
+	//for images, the global environment and a fresh standard library environment to look primitives up in (see nl_bin_writer)
+	nl_env_frame *global_env;
+	nl_env_frame *pri_env;
+	
+	//the closure whose arguments and body are being read, if any
+	nl_val *cur_sub;
+	
+	//the source line values being read were on (0 for none)
+	unsigned int line;
+	
+	//TRUE once the data turns out to be truncated or corrupt
+	char err;
+};
+
+//counts every interpreter keeps of what it's done, whether or not anything's reading them (see --stats)
+//only the interpreter itself changes these (with NL_COUNT_ADD), so keeping them never waits on other threads
+struct nl_stats {
+	//values allocated and free'd
+	unsigned long long allocs;
+	unsigned long long frees;
+	
+	//values of each type that haven't been free'd
+	//(a value can be free'd by a different interpreter than the one that made it, so one interpreter's counts can go negative; the totals are right)
+	long long live[NL_TYPE_CNT];
+	
+	//element slots allocated for (unpacked) arrays, and how many of them are in use; the rest is slack from growing arrays ahead of time
+	long long array_slots;
+	long long array_slots_used;
+	
+	//bytes allocated for packed array storage (memory-mapped files aren't counted)
+	long long packed_bytes;
+	
+	//environment frames and trie nodes (see nl_env_frame and nl_trie_node)
+	long long env_frames;
+	long long trie_nodes;
+	
+	//how many bytes all of the above take up (not counting the allocator's overhead), and the most that's been at once
+	long long bytes;
+	long long peak_bytes;
+	
+	//the counts of the next interpreter that's still running (see nl_stats_all)
+	nl_stats *next;
+};
+
+//hardware performance counter readings (see --perf-counters), one for each NL_PERF_* event
+//every count is scaled up for the time the kernel had to share the hardware counters with other events, so it's an estimate
+struct nl_perf_counts {
+	unsigned long long v[NL_PERF_CNT];
+};
+
+//the state of one interpreter; nothing that changes as a program runs is process-global, so separate interpreters can run at once on different threads
+//each thread has a current interpreter (nl_vm_cur, see nl_vm_enter) that evaluation and the primitives work in
+typedef struct nl_vm nl_vm;
+typedef struct nl_par_deque nl_par_deque;
+
+struct nl_vm {
+	//bookkeeping
+	char end_program;
+	int exit_status;
+	unsigned int line_number;
+	
+	//number of errors and warnings output so far
+	unsigned int err_cnt;
+	
+	//the reader for stdin; shared by the repl and the input primitives so no buffered input gets lost between them
+	nl_reader *stdin_reader;
+	
+	//source line side table; values created by the reader store an index into this rather than a full line number
+	//NOTE: slot 0 is reserved to mean "no line"; the reader reads lines in order so consecutive nodes almost always share a slot
+	unsigned int *line_table;
+	unsigned int line_table_cnt;
+	unsigned int line_table_size;
+	//hash index from line number to slot (0 for an empty entry), so re-reading a line (a loop of inexp, the repl) reuses its slot
+	//this has twice as many entries as the table has slots
+	unsigned short *line_index;
+	//TRUE once the table has been full and a warning has been output for it
+	char line_table_full;
+	
+	//pinned values (see NL_VAL_PINNED), which are free'd when the interpreter is
+	nl_val **pinned;
+	unsigned int pinned_cnt;
+	unsigned int pinned_size;
+	
+	//TRUE while this thread is running a chunk of a parallel map or a task (see nl_par_impure); par_abort is where it gets abandoned to
+	char par_task;
+	jmp_buf *par_abort;
+	
+	//this thread's work-stealing deque (NULL if this interpreter doesn't have one, in which case its tasks run in order)
+	nl_par_deque *par_deque;
+	
+	//where this thread looks first for a task to steal (this moves around so thieves spread out)
+	unsigned int par_victim;
+	
+	//futures made by this interpreter that haven't been finished yet, newest first (see nl_par_sync)
+	//(each coroutine has its own list; this is the running one's)
+	nl_par_task *futures;
+	
+	//coroutines (see nl_co); co_cur is the one running and co_main is the program itself (both NULL until the first spawn)
+	nl_co *co_main;
+	nl_co *co_cur;
+	
+	//coroutines that are ready to run (in order), sleeping (soonest to wake first), and waiting for input
+	nl_co *co_ready;
+	nl_co *co_ready_last;
+	nl_co *co_sleeping;
+	nl_co *co_io;
+	
+	//every spawned coroutine that hasn't finished, and how many there are
+	nl_co *co_all;
+	unsigned int co_cnt;
+	
+	//TRUE while the program is waiting for its coroutines to finish before it ends (see nl_co_join)
+	char co_joining;
+	
+	//a coroutine that just finished; its stack is free'd by the next one to run, since it can't free the stack it's on
+	nl_co *co_dead;
+	
+	//when profiling (see --profile), the neulang call stack (a frame for every subroutine call, see nl_prof_frame)
+	//prof_depth can be more than NL_PROF_MAX_DEPTH, but only that many frames are recorded; these are NULL when not profiling
+	unsigned long long *prof_stack;
+	unsigned int prof_depth;
+	
+	//the samples taken while this interpreter was running, and the name of the frame every one of them starts with
+	nl_prof_ring *prof_ring;
+	unsigned int prof_root;
+	
+	//when counting calls (see --prof-count), this interpreter's counts and the calls that haven't returned yet
+	//(prof_calls has room for prof_call_size of them); these are NULL otherwise
+	nl_prof_tally *prof_tally;
+	nl_prof_call *prof_calls;
+	unsigned int prof_call_depth;
+	unsigned int prof_call_size;
+	
+	//when tracing (see --trace), the spans that haven't been written yet; NULL otherwise
+	nl_trace_buf *trace_buf;
+	
+	//what this interpreter has done (see --stats)
+	nl_stats stats;
+	
+	//keywords (every interpreter has its own, since these are reference counted like any other value)
+	nl_val *true_keyword;
+	nl_val *false_keyword;
+	nl_val *null_keyword;
+	
+	nl_val *pair_keyword;
+	nl_val *f_keyword;
+	nl_val *r_keyword;
+	nl_val *if_keyword;
+	nl_val *else_keyword;
+	nl_val *and_keyword;
+	nl_val *or_keyword;
+	nl_val *not_keyword;
+	nl_val *xor_keyword;
+	nl_val *exit_keyword;
+	nl_val *lit_keyword;
+	nl_val *let_keyword;
+	nl_val *sub_keyword;
+	nl_val *begin_keyword;
+	nl_val *recur_keyword;
+	nl_val *return_keyword;
+	nl_val *with_keyword;
+	nl_val *while_keyword;
+	nl_val *for_keyword;
+	nl_val *after_keyword;
+	nl_val *array_keyword;
+	nl_val *list_keyword;
+	nl_val *struct_keyword;
+	nl_val *type_keyword;
+	nl_val *source_keyword;
+	nl_val *par_keyword;
+	nl_val *future_keyword;
+	nl_val *spawn_keyword;
+	nl_val *time_keyword;
+	nl_val *image_save_keyword;
+	
+	nl_val *byte_t_keyword;
+	nl_val *num_t_keyword;
+	nl_val *pair_t_keyword;
+	nl_val *array_t_keyword;
+	nl_val *pri_t_keyword;
+	nl_val *sub_t_keyword;
+	nl_val *struct_t_keyword;
+	nl_val *handle_t_keyword;
+	nl_val *symbol_t_keyword;
+	nl_val *evaluation_t_keyword;
+	nl_val *bind_t_keyword;
+	nl_val *null_t_keyword;
+	nl_val *future_t_keyword;
+	nl_val *channel_t_keyword;
+};
+
+//one parallel array map or fold (see nl_par_run_job); the work is split into chunks which threads claim in order
+typedef struct nl_par_job nl_par_job;
+struct nl_par_job {
+	//the mapping (or combining) subroutine and the array being mapped
+	nl_val *sub;
+	nl_val *a;
+	
+	//TRUE if each chunk is folded with sub (see nl_array_reduce) rather than mapped
+	char fold;
+	
+	//the results, one per array element (NULL for elements that weren't mapped); a fold's result for a chunk goes at its first element
+	nl_val **res;
+	
+	//chunk c covers elements start+(c*grain) up to (but not including) start+((c+1)*grain), or the end of the array
+	unsigned int start;
+	unsigned int grain;
+	unsigned int chunk_cnt;
+	
+	//the next chunk to be claimed, and how many chunks are finished
+	unsigned int next_chunk;
+	unsigned int done_chunks;
+	
+	//TRUE for each chunk that was abandoned (because it had an error or tried to do something it can't do in parallel)
+	//only results before the first abandoned chunk are kept, so chunks after it aren't started once it's known
+	char *aborted;
+	unsigned int first_aborted;
+	
+	//the line table and line number of the interpreter that started this job (the values being mapped came from it)
+	unsigned int *line_table;
+	unsigned int line_number;
+};
+
+//a task for the work-stealing scheduler; this is one branch of a par expression, or the expression of a future
+//like a parallel map chunk, a task is first run speculatively on whichever thread gets to it, and if it has to do anything
+//with side effects it's abandoned and evaluated again (in order) by the thread that needs its result
+struct nl_par_task {
+	//the statements to evaluate (like a begin body)
+	nl_val *body;
+	
+	//the variables the body uses, as they were when the task was made (see nl_par_capture); this links up to the nearest shared frame
+	//each run of the task gets a fresh frame of its own above this one, so anything it binds stays with that run
+	nl_env_frame *env;
+	
+	//the frame the task was last run in (kept along with the result if the result has closures which link up to it)
+	nl_env_frame *run_env;
+	
+	//the result, once the task is done
+	nl_val *result;
+	
+	//NL_PAR_TASK_WAITING until a thread takes the task, then NL_PAR_TASK_RUNNING until it's NL_PAR_TASK_DONE
+	//or NL_PAR_TASK_ABORTED (abandoned, and waiting to be evaluated again by something that needs the result)
+	int state;
+	
+	//the interpreter running the task (NULL when nothing is)
+	nl_vm *runner;
+	
+	//TRUE if the task was put on a deque (otherwise it only runs when something needs its result)
+	char pushed;
+	
+	//references to this task (a future value, and the list of unfinished futures of the interpreter that made it)
+	unsigned int ref;
+	
+	//the next (older) unfinished future made by the same interpreter (see nl_vm.futures)
+	nl_par_task *next;
+};
+
+//a work-stealing deque (Chase and Lev's); the thread that owns it pushes and pops tasks at the bottom
+//and other threads steal from the top, so the owner works depth-first while thieves take the biggest, oldest work
+//top and bottom only ever increase (apart from the owner's pop), and index tasks modulo NL_PAR_DEQUE_SIZE
+struct nl_par_deque {
+	long top;
+	long bottom;
+	nl_par_task *tasks[NL_PAR_DEQUE_SIZE];
+};
+
+//a coroutine (see nl_eval_spawn); an interpreter's coroutines take turns on its thread, each evaluating on a stack of its own
+//one runs until it has to wait (on a channel, a sleep, or input) or yields, and then the next one that's ready runs
+struct nl_co {
+	//where the coroutine is paused, and the stack it runs on (the program itself uses the thread's stack, so this is NULL for it)
+	ucontext_t ctx;
+	char *stack;
+	
+	//the statements to evaluate (like a begin body), and the variables they use as they were when the coroutine was spawned
+	//the captured frame links straight up to the global one, since the frames of whatever spawned it can go away first
+	nl_val *body;
+	nl_env_frame *env;
+	
+	//NL_CO_READY, NL_CO_WAITING, or NL_CO_DONE
+	int state;
+	
+	//when a sleeping coroutine wakes up (see nl_par_now_ns), and what one that's waiting for input is waiting to read
+	unsigned long long int wake_ns;
+	int wait_fd;
+	
+	//the channel queue it's waiting in (NULL if it isn't), and the value it's sending or has been given
+	nl_co **queue;
+	nl_val *val;
+	
+	//TRUE if the channel it was waiting to send on was closed, or if nothing could ever wake it up (a deadlock)
+	char closed;
+	char deadlock;
+	
+	//TRUE once it's sent something with closures made in it (see nl_val_links_env); those link up to its frames, so the frames are kept
+	char sent_sub;
+	
+	//interpreter state that's this coroutine's own (see nl_vm), kept here while another one runs
+	unsigned int line_number;
+	nl_par_task *futures;
+	
+	//the profiler's call stack for this coroutine (see nl_vm.prof_stack); allocated the first time it's needed
+	unsigned long long *prof_stack;
+	unsigned int prof_depth;
+	
+	//the calls being counted in this coroutine (see nl_vm.prof_calls), and when it last stopped running (the time, and the allocation count)
+	nl_prof_call *prof_calls;
+	unsigned int prof_call_depth;
+	unsigned int prof_call_size;
+	unsigned long long prof_paused_ns;
+	unsigned long long prof_paused_allocs;
+	
+	//the next coroutine in whatever queue this one is in (ready, sleeping, waiting for input, or waiting on a channel)
+	nl_co *next;
+	
+	//neighbours in the interpreter's list of unfinished coroutines
+	nl_co *all_next;
+	nl_co *all_prev;
+};
+
+//a channel (the data behind a CHANNEL value); a bounded queue that coroutines send values to and receive them from
+//a send waits while the queue is full, so with a capacity of 0 every send waits for a receive to take its value
+struct nl_chan {
+	//the values in the queue (a ring of cap entries; cnt of them starting at head)
+	nl_val **buf;
+	unsigned int cap;
+	unsigned int head;
+	unsigned int cnt;
+	
+	//TRUE once the channel is closed; nothing more can be sent, and receives get NULL once the queue is empty
+	char closed;
+	
+	//coroutines waiting to send (each with the value it's sending) and to receive, oldest first
+	nl_co *senders;
+	nl_co *receivers;
+};
+
+//samples taken by the profiler's signal handler on one interpreter's thread, waiting to be added to the profile (see nl_prof_drain)
+//only the signal handler moves head, and only a drain (with nl_prof_lock held) moves tail, so neither ever waits for the other
+struct nl_prof_ring {
+	//NL_PROF_RING_SIZE samples of NL_PROF_SAMPLE_LEN entries each
+	unsigned long long *samples;
+	unsigned int head;
+	unsigned int tail;
+	
+	//samples that were lost because the ring was full
+	unsigned long long dropped;
+	
+	//the next ring in the list of every interpreter's rings
+	nl_prof_ring *next;
+};
+
+//the counts for one subroutine or primitive (see --prof-count)
+//every interpreter keeps its own, so counting never waits on other threads; reports add them all up
+typedef struct nl_prof_cnt nl_prof_cnt;
+struct nl_prof_cnt {
+	unsigned long long calls;
+	
+	//time (in nanoseconds) and values allocated, both including and excluding what was done by the calls that were made from it
+	unsigned long long incl_ns;
+	unsigned long long excl_ns;
+	unsigned long long incl_allocs;
+	unsigned long long excl_allocs;
+	
+	//calls that haven't returned yet; only the outermost one adds to the inclusive counts, so recursion isn't counted twice
+	unsigned int active;
+};
+
+#ifdef _LEAKCHECK
+//live values that were allocated at the same place (the same C and neulang lines) and have the same type (see nl_leak_report)
+typedef struct nl_leak_group nl_leak_group;
+struct nl_leak_group {
+	const char *file;
+	unsigned int c_line;
+	unsigned int line;
+	unsigned char t;
+	
+	unsigned long long cnt;
+	
+	//the first value found in the group
+	nl_val *sample;
+};
+#endif
+
+//a call that's being counted
+struct nl_prof_call {
+	//the key of what was called (see nl_prof_key)
+	unsigned int id;
+	
+	//TRUE for the start of a future or coroutine, which tailcalls in its body go on top of rather than replace
+	char keep;
+	
+	//what kind of call this is, for tracing (an NL_TRACE_* kind)
+	unsigned char trace;
+	
+	//when it was called, the allocation count then, and how much of each the calls it's made since have used
+	unsigned long long start_ns;
+	unsigned long long child_ns;
+	unsigned long long start_allocs;
+	unsigned long long child_allocs;
+};
+
+//a finished call, for the trace (see --trace)
+struct nl_trace_span {
+	//the key of what was called (see nl_prof_key), and what kind of call it was (an NL_TRACE_* kind)
+	unsigned int id;
+	unsigned char kind;
+	
+	//the thread it was on
+	int tid;
+	
+	//when it was called and how long it took, in nanoseconds
+	unsigned long long start_ns;
+	unsigned long long ns;
+};
+
+//the spans an interpreter has traced that haven't been written yet
+struct nl_trace_buf {
+	nl_trace_span spans[NL_TRACE_BUF_SIZE];
+	unsigned int cnt;
+	
+	//the next interpreter's buffer
+	nl_trace_buf *next;
+};
+
+//an interpreter's counts (indexed by key, with room for size of them); these are kept for reports after the interpreter is free'd
+struct nl_prof_tally {
+	nl_prof_cnt *cnts;
+	unsigned int size;
+	
+	//the next interpreter's counts
+	nl_prof_tally *next;
+};
+
+//a message waiting in an isolate's mailbox
+struct nl_msg {
+	//the value that was posted; the receiving isolate owns it (see nl_val_share)
+	nl_val *v;
+	
+	nl_msg *next;
+};
+
+//an isolate; a program running in its own interpreter on its own thread, which shares nothing with other isolates
+//isolates only communicate by posting messages (plain data) to each other's mailboxes
+struct nl_isolate {
+	//the isolate's number (the program started from the command line is isolate 0) and the number of the one that started it
+	unsigned int id;
+	unsigned int parent;
+	
+	//the program this isolate runs (NULL for the program started from the command line), and its arguments until it starts
+	char *fname;
+	nl_val *argv;
+	FILE *fp;
+	
+	//lock protects the mailbox (and done); messages are received oldest first
+	pthread_mutex_t lock;
+	nl_msg *msgs;
+	nl_msg *msgs_last;
+	
+	//an event counter with one count for every message in the mailbox; receivers wait for it to be readable
+	int wake_fd;
+	
+	//TRUE once the isolate's program has ended (this is also protected by nl_isolate_lock), and the status it ended with
+	char done;
+	int exit_status;
 };
 
 //END DATA STRUCTURES ---------------------------------------------------------------------------------------------
 
 //BEGIN GLOBAL DATA -----------------------------------------------------------------------------------------------
 
-//bookkeeping
-char end_program;
-int exit_status;
-unsigned int line_number;
+//the interpreter this thread is running
+extern __thread nl_vm *nl_vm_cur;
+
+//FALSE to parse every source file from scratch rather than using (and writing) cached parses
+extern char nl_source_cache;
+
+//global null (shared by every interpreter; it's never reference counted or changed)
+extern nl_val *nl_null;
+
+//number of threads to use for parallel work, including the one that starts it (0 until set, which means one per processor)
+extern unsigned int nl_par_threads;
+
+//nonzero while any parallel work is running; reference counting is atomic and shared environments aren't reordered while it is
+extern int nl_par_active;
+
+//the isolate this thread is running (NULL until the program uses isolates)
+extern __thread nl_isolate *nl_isolate_cur;
+
+//the file the profile is written to (NULL when not profiling, see --profile)
+extern const char *nl_prof_fname;
+
+//TRUE when counting calls (see --prof-count)
+extern char nl_prof_counting;
 
-//global null
-nl_val *nl_null;
+//TRUE when statistics are written at exit (see --stats)
+extern char nl_stats_exit;
+
+//statistics for what's allocated and free'd outside of any interpreter
+//(the command-line arguments, and an interpreter's keywords while it's being allocated or free'd)
+extern nl_stats nl_stats_outside;
+
+//TRUE when a memory report is written at exit (see --mem-report)
+extern char nl_mem_report_exit;
+
+//TRUE when either profiler is on (subroutines are only named for the profiler when it is, see nl_prof_name_sub)
+extern char nl_prof_on;
 
 //END GLOBAL DATA -------------------------------------------------------------------------------------------------
 
@@ -214,9 +1150,31 @@ void nl_err(const nl_val *v, const char *msg, char output);
 //returns a C string consisting of the name of the given type
 const char *nl_type_name(nl_type t);
 
+//get the line side table slot for the given source line (allocating a new slot if needed)
+//returns 0 (no line) if the table is full
+unsigned short nl_line_slot(unsigned int line);
+
+//add the given slot to the line table's hash index
+void nl_line_index_add(nl_vm *vm, unsigned short slot);
+
+//record the current line_number on a value the reader just created
+void nl_line_set(nl_val *v);
+
+//returns the source line a value was read on, or the current line_number for values that weren't created by the reader
+unsigned int nl_val_line(const nl_val *v);
+
 //allocate a value, and initialize it so that we're not doing anything too crazy
 nl_val *nl_val_malloc(nl_type t);
 
+#ifdef _LEAKCHECK
+//record the C source location a value was allocated at, and return it
+nl_val *nl_leak_track(nl_val *v, const char *file, unsigned int c_line);
+
+//in leak checking builds every nl_val_malloc call records where it was made
+//(the definition is written as (nl_val_malloc) so this doesn't apply to it)
+#define nl_val_malloc(t) nl_leak_track((nl_val_malloc)(t),__FILE__,__LINE__)
+#endif
+
 //NOTE: reference decrementing is handled here as well
 //free a value; this recursively frees complex data types
 //returns TRUE if successful, FALSE if there are still references
@@ -244,6 +1202,9 @@ nl_val *nl_lookup(nl_val *symbol, nl_env_frame *env);
 //make a neulang string from a c string
 nl_val *nl_str_from_c_str(const char *c_str);
 
+//make a neulang string from a buffer of the given length
+nl_val *nl_str_from_buf(const char *buf, unsigned int length);
+
 //make a neulang symbol from a c string
 nl_val *nl_sym_from_c_str(const char *c_str);
 
@@ -252,6 +1213,7 @@ nl_val *nl_sym_from_c_str(const char *c_str);
 char *c_str_from_nl_str(nl_val *nl_str);
 
 //make a neulang value out of a primitve function so we can bind it
+//(the value is pinned to the current interpreter; see NL_VAL_PINNED)
 nl_val *nl_primitive_wrap(nl_val *(*function)(nl_val *arglist));
 
 //is this neulang value TRUE? (true values are nonzero numbers and nonzero bytes)
@@ -267,6 +1229,13 @@ char nl_substitute_elements_skipsub(nl_val *list, nl_val *old_val, nl_val *new_v
 //(value CANNOT be a list itself, and also cannot be NULL)
 int nl_list_occur(nl_val *list, nl_val *value);
 
+//returns TRUE if the value is or contains a closure (structs are assumed to, rather than searched)
+char nl_val_has_sub(const nl_val *v);
+
+//returns TRUE if the value is or contains a closure made in the given frame (or in one below it), which would link up to that frame
+//(like nl_val_has_sub, structs, futures, and channels are assumed to, rather than searched)
+char nl_val_links_env(const nl_val *v, const nl_env_frame *env);
+
 //evaluate all the elements in a list, replacing them with their evaluations
 void nl_eval_elements(nl_val *list, nl_env_frame *env);
 
@@ -302,17 +1271,55 @@ nl_val *nl_eval(nl_val *exp, nl_env_frame *env, char last_exp, char *early_ret);
 //check if a givne character counts as whitespace in neulang
 char nl_is_whitespace(char c);
 
-//read an expression from the given input stream
-nl_val *nl_read_exp(FILE *fp);
+//allocate a source reader for the given file descriptor
+nl_reader *nl_reader_malloc(int fd);
+
+//allocate a source reader for bytes already in memory (these are copied, so nothing needs to outlive the reader)
+nl_reader *nl_reader_from_buf(const char *data, unsigned int length);
+
+//free a source reader (this does not close the file)
+void nl_reader_free(nl_reader *r);
+
+//returns the (shared) reader for stdin, allocating it if needed
+nl_reader *nl_reader_stdin();
+
+//read more data into the reader's buffer, keeping any unread data
+//returns the number of new bytes read (0 at end of file)
+unsigned int nl_reader_fill(nl_reader *r);
+
+//look at the byte the given offset past the read position without consuming anything
+//returns EOF if the file ends first
+int nl_reader_peek(nl_reader *r, unsigned int offset);
+
+//consume and return the next byte, or EOF
+int nl_reader_getc(nl_reader *r);
+
+//read an expression from the given reader
+nl_val *nl_read_exp(nl_reader *r);
+
+//write raw string bytes to the given file, in as few writes as possible
+//(bytes with values less than 2 are written as numbers, the same way nl_out writes them)
+void nl_out_bytes(FILE *fp, const char *data, unsigned int length);
 
 //output a neulang value
 void nl_out(FILE *fp, const nl_val *exp);
 
-//create global symbol data so it's not constantly being re-allocated (which is slow and unnecessary)
-void nl_keyword_malloc();
+//create an interpreter's symbol data so it's not constantly being re-allocated (which is slow and unnecessary)
+void nl_keyword_malloc(nl_vm *vm);
+
+//free an interpreter's symbol data for clean exit
+void nl_keyword_free(nl_vm *vm);
+
+//allocate the state for one interpreter
+//an interpreter only runs on one thread at a time (see nl_vm_enter), but any number of them can run at once on different threads
+nl_vm *nl_vm_malloc();
+
+//free the state for an interpreter (this must not be the current interpreter of any thread that will keep running it)
+void nl_vm_free(nl_vm *vm);
 
-//free global symbol data for clean exit
-void nl_keyword_free();
+//make the given interpreter the one the current thread is running
+//returns the interpreter this thread was running before, so it can be restored (NULL if there wasn't one)
+nl_vm *nl_vm_enter(nl_vm *vm);
 
 //bind a newly alloc'd value (just removes an reference after bind to keep us memory-safe)
 void nl_bind_new(nl_val *symbol, nl_val *value, nl_env_frame *env);
@@ -323,34 +1330,40 @@ void nl_bind_stdlib(nl_env_frame *env);
 //the repl for neulang; this is separated from main for embedding purposes
 //the only thing you have to do outside this is give us an open file and close it when we're done
 //arguments given are interpreted as command-line arguments and are bound to argv in the interpreter (NULL works)
-int nl_repl(FILE *fp, nl_val *argv);
+//if load_image is given the global environment starts from that image, and if save_image is given the global environment is saved there when the program ends (either can be NULL)
+//if fname is given (the name fp was opened from) the file is run through the source cache (see nl_source_read) instead of being read an expression at a time
+int nl_repl(FILE *fp, nl_val *argv, const char *load_image, const char *save_image, const char *fname);
 
 //runtime!
 int main(int argc, char *argv[]);
 
 // forward declarations for string<->expression functions -------------
 
-//gets an entry out of the string at the given position or returns NULL if position is out of bounds
-//NOTE: this does NOT do type checking at the moment, use with care
-char nl_str_char_or_null(nl_val *string, unsigned int pos);
+//gets an entry out of the buffer at the given position or returns NULL if position is out of bounds
+char nl_buf_char_or_null(const char *input, unsigned int length, unsigned int pos);
 
-//skip past any leading whitespaces in the string
-void nl_str_skip_whitespace(nl_val *input_string, unsigned int *persistent_pos);
+//skip past any leading whitespaces in the buffer
+void nl_buf_skip_whitespace(const char *input, unsigned int length, unsigned int *persistent_pos);
 
-//read a number from a string
-nl_val *nl_str_read_num(nl_val *input_string, unsigned int *persistent_pos);
+//read a number from a buffer
+nl_val *nl_buf_read_num(const char *input, unsigned int length, unsigned int *persistent_pos);
 
-//read a string (byte array) from a string (trust me it makes sense)
-nl_val *nl_str_read_string(nl_val *input_string, unsigned int *persistent_pos);
+//read a string (byte array) from a buffer
+nl_val *nl_buf_read_string(const char *input, unsigned int length, unsigned int *persistent_pos);
 
-//read a single character (byte) from a string
-nl_val *nl_str_read_char(nl_val *input_string, unsigned int *persistent_pos);
+//read a single character (byte) from a buffer
+nl_val *nl_buf_read_char(const char *input, unsigned int length, unsigned int *persistent_pos);
 
-//read an expression list from a string
-nl_val *nl_str_read_exp_list(nl_val *input_string, unsigned int *persistent_pos);
+//read an expression list from a buffer
+nl_val *nl_buf_read_exp_list(const char *input, unsigned int length, unsigned int *persistent_pos);
 
-//read a symbol (just a string with a wrapper) (with a rapper? drop them beats man) from a string
-nl_val *nl_str_read_symbol(nl_val *input_string, unsigned int *persistent_pos);
+//read a symbol (just a string with a wrapper) from a buffer
+nl_val *nl_buf_read_symbol(const char *input, unsigned int length, unsigned int *persistent_pos);
+
+//read an expression from a buffer
+//takes a buffer and its length, a position to start at (0 for whole buffer) and returns the new expression
+//persistent_pos is set to the end of the first expression read when a full expression is found
+nl_val *nl_buf_read_exp(const char *input, unsigned int length, unsigned int *persistent_pos);
 
 //read an expression from an existing neulang string
 //takes an input string, a position to start at (0 for whole string) and returns the new expression
@@ -365,6 +1378,10 @@ nl_trie_node *nl_trie_malloc();
 //recursively free a trie and associated values
 void nl_trie_free(nl_trie_node *trie_root);
 
+//empty the frames of the closures bound in a trie (for the end of a program)
+//a closure whose own frame holds onto it (say a variable, or a future's result, set to itself) is never free'd otherwise
+void nl_trie_free_closure_frames(nl_trie_node *trie_root);
+
 //allocate a pointer array for trie children
 nl_trie_node **nl_trie_malloc_children(int count);
 
@@ -372,8 +1389,9 @@ nl_trie_node **nl_trie_malloc_children(int count);
 nl_trie_node *nl_trie_cp(nl_trie_node *from);
 
 //add a node to a trie that maps a c string to a value
+//if retire is TRUE other threads could be reading this trie right now, so anything replaced is retired rather than free'd (see nl_par_retire)
 //returns TRUE on success, FALSE on failure
-char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int start_idx, unsigned int length, nl_val *value, const char chk_type);
+char nl_trie_add_node(nl_trie_node *trie_root, const char *name, unsigned int start_idx, unsigned int length, nl_val *value, const char chk_type, const char retire);
 
 //check if a trie contains a given value; if so, return a pointer to the value
 //returns a pointer to the value if a match was found, else NULL
@@ -449,9 +1467,34 @@ nl_val *nl_sym_to_str(nl_val *sym_list);
 //this uses the same parsing as the underlying interpreter parsing of numeric constants
 nl_val *nl_str_to_num(nl_val *str_list);
 
+//set up the shared BYTE values for packed arrays; this happens when the first interpreter is allocated, before there are other threads
+void nl_packed_byte_vals_init();
+
+//allocate raw storage for a packed array, with room for at least len bytes
+nl_bytes *nl_bytes_malloc(size_t len);
+
+//release a reference to raw packed storage, freeing (or unmapping) it once nothing uses it
+void nl_bytes_release(nl_bytes *b);
+
+//make a packed array that's a view of the given shared storage (this takes a reference to the storage)
+nl_val *nl_array_from_bytes(nl_bytes *b, unsigned int offset, unsigned int size);
+
+//returns a pointer to the raw bytes of a packed array
+char *nl_array_bytes(const nl_val *a);
+
+//returns the element at the given index of an array (packed or not) without copying it
+//NOTE: for packed arrays this is a shared constant BYTE; never free or modify what this returns (copy it if you need to keep it)
+nl_val *nl_array_entry(const nl_val *a, unsigned int idx);
+
+//convert a packed array back into a normal array of BYTE values (the shared storage is left unchanged for other users)
+void nl_array_unpack(nl_val *a);
+
 //push a value onto the end of an array
 void nl_array_push(nl_val *a, nl_val *v);
 
+//push raw bytes onto the end of an array (packing the array if it's empty)
+void nl_array_push_bytes(nl_val *a, const char *buf, unsigned int length);
+
 //returns the entry in the array a (first arg) at index idx (second arg)
 nl_val *nl_array_idx(nl_val *args);
 
@@ -503,6 +1546,20 @@ nl_val *nl_array_range(nl_val *arg_list);
 //i.e. the return value of this is the array of return values of the given subroutine applied to each of the original array arguments
 nl_val *nl_array_map(nl_val *arg_list);
 
+//apply a combining subroutine to an accumulator and a value (both of which are used up), and return the result
+nl_val *nl_fold_step(nl_val *combiner, nl_val *acc, nl_val *v);
+
+//fold the elements of an array from start up to (but not including) end into an accumulator (which is used up), in order
+nl_val *nl_array_fold_range(nl_val *a, unsigned int start, unsigned int end, nl_val *acc, nl_val *combiner);
+
+//fold the elements of an array from start on into a copy of acc with a built-in combiner (+, *, b|, b&), as a native loop
+//the result is exactly what applying the combiner to each element in turn would give
+//returns NULL if the combiner isn't one of those or the values aren't all of the type it takes (so the caller folds normally)
+nl_val *nl_array_fold_native(nl_val *a, unsigned int start, nl_val *acc, nl_val *combiner);
+
+//fold an array into one value, starting from the given initial value and applying (combiner accumulator element) for each element in order
+nl_val *nl_array_fold(nl_val *arg_list);
+
 //output the given list of strings in sequence
 //returns NULL (a void function)
 nl_val *nl_outstr(nl_val *array_list);
@@ -511,6 +1568,10 @@ nl_val *nl_outstr(nl_val *array_list);
 //returns NULL (a void function)
 nl_val *nl_outexp(nl_val *v_list);
 
+//writes out anything still buffered for stdout and stderr, or for the given handles if any are given
+//returns NULL (a void function)
+nl_val *nl_flush(nl_val *arg_list);
+
 //reads input from stdin and returns the resulting expression
 nl_val *nl_inexp(nl_val *arg_list);
 
@@ -603,17 +1664,669 @@ nl_val *nl_byte_or(nl_val *byte_list);
 //bitwise AND operation on the byte type
 nl_val *nl_byte_and(nl_val *byte_list);
 
+//remember a new memory map of a file (see nl_map_slot), setting up nl_map_sigbus the first time
+//returns FALSE if there's no slot free for it, in which case it shouldn't stay mapped
+char nl_map_add(char *addr, size_t len, unsigned long long dev, unsigned long long ino);
+
+//forget a memory map that's about to be unmapped (one that was replaced by nl_map_detach is already forgotten)
+void nl_map_remove(char *addr);
+
+//replace every memory map of the given file with a private copy of it, in place, before this program truncates the file
+//so arrays that were read from it keep what they had
+void nl_map_detach(unsigned long long dev, unsigned long long ino);
+
+//SIGBUS handler for reads past the end of a mapped file that something else made shorter; those read as zeros instead of crashing
+void nl_map_sigbus(int sig, siginfo_t *info, void *context);
+
 //reads the given file and returns its contents as a byte array (aka a string)
 //returns NULL if file wasn't found or couldn't be opened
 nl_val *nl_str_from_file(nl_val *fname_list);
 
+//make a HANDLE value for an already-open file descriptor (the handle owns the descriptor unless is_std is TRUE)
+nl_val *nl_handle_from_fd(int fd, char is_std);
+
+//close the file behind a handle (and free its buffers); closing an already-closed handle does nothing
+void nl_handle_close(nl_handle *h);
+
+//get the handle argument for a handle operation, or NULL (after an error) if it isn't a readable handle
+nl_handle *nl_handle_for_reading(nl_val *arg, const char *op_err);
+
+//get the handle argument for a handle operation, or NULL (after an error) if it isn't a writable handle
+nl_handle *nl_handle_for_writing(nl_val *arg, const char *op_err);
+
+//write the given bytes to a file descriptor, retrying on short writes and interrupts
+//returns TRUE on success, FALSE on error
+char nl_fd_write(int fd, const char *data, size_t length);
+
+//write out a handle's buffered data, then sync it to disk if the handle asks for that
+//returns TRUE on success, FALSE on error
+char nl_handle_flush(nl_handle *h);
+
+//write raw bytes to a handle; small writes are buffered, large ones go straight to the file
+//returns TRUE on success, FALSE on error
+char nl_handle_write_bytes(nl_handle *h, const char *data, unsigned int length);
+
+//write the given string to a handle; small writes are buffered, large packed ones go straight to the file
+//returns TRUE on success, FALSE on error
+char nl_handle_write(nl_handle *h, const nl_val *str);
+
+//get the sync mode named by the given string argument ("fsync" or "fdatasync")
+//returns -1 (after an error) if it isn't a sync mode
+int nl_sync_mode(nl_val *mode, const char *op_err);
+
+//open a file and return a handle to it
+nl_val *nl_file_open(nl_val *arg_list);
+
+//write the given string(s) to the given handle
+//returns TRUE on success, FALSE on error
+nl_val *nl_file_write(nl_val *arg_list);
+
+//write a string to a file, replacing it atomically (the data is written to a temporary file which is then renamed over the original)
+//returns TRUE on success, FALSE on error
+nl_val *nl_str_to_file(nl_val *arg_list);
+
+//append a string to the end of a file, creating the file if it doesn't exist
+//returns TRUE on success, FALSE on error
+nl_val *nl_str_append_file(nl_val *arg_list);
+
+//read a line from the given handle, returned without the trailing newline
+//returns NULL at end of file
+nl_val *nl_file_read_line(nl_val *arg_list);
+
+//read up to the given number of bytes from the given handle
+//returns NULL at end of file
+nl_val *nl_file_read_chunk(nl_val *arg_list);
+
+//returns TRUE if there's nothing left to read from the given handle
+nl_val *nl_file_eof(nl_val *arg_list);
+
+//close the given handle(s)
+nl_val *nl_file_close(nl_val *arg_list);
+
+//create a new empty file whose name is the given prefix, then six random characters, then the optional suffix
+//returns the name of the file (which no other file had)
+nl_val *nl_file_tmp(nl_val *arg_list);
+
+//remove the given file(s)
+//returns TRUE if they were all removed, FALSE if any couldn't be (a file that doesn't exist isn't an error, so caches can be cleaned up)
+nl_val *nl_file_delete(nl_val *arg_list);
+
+//set up a binary writer for writing to memory (or to the given handle, if it isn't NULL)
+void nl_bin_writer_init(nl_bin_writer *w, nl_handle *h);
+
+//free a binary writer's internal tables (the output itself is left alone)
+void nl_bin_writer_cleanup(nl_bin_writer *w);
+
+//set up a binary reader for reading from the given packed array (or from the given file reader, if it isn't NULL)
+void nl_bin_reader_init(nl_bin_reader *rd, nl_val *packed, nl_reader *r);
+
+//add raw bytes to binary output
+void nl_bin_put(nl_bin_writer *w, const char *data, unsigned int length);
+
+//add an unsigned number to binary output as a varint (7 bits per byte, low bits first, high bit set on all but the last byte)
+void nl_bin_put_varint(nl_bin_writer *w, unsigned long long int v);
+
+//add a name to binary output (a varint length plus one, then the bytes; a 0 length marks the end of a list of names)
+void nl_bin_put_name(nl_bin_writer *w, const char *name, unsigned int length);
+
+//look up a key in the writer's table of things already written, adding it (with the next index from the given counter) if it isn't there
+//returns the index plus one if it was already written, 0 if it's new
+unsigned int nl_bin_seen_check(nl_bin_writer *w, const void *p, unsigned int offset, unsigned int size, unsigned int *counter);
+
+//write an environment frame in the binary format (frames are shared, so each is written once and referred back to)
+void nl_bin_write_env(nl_bin_writer *w, nl_env_frame *env);
+
+//write the bindings in a trie as (name, allowed types, value) entries, ending with an empty name
+//bindings that are the same in the skip trie (if given) are left out
+void nl_bin_write_trie(nl_bin_writer *w, nl_trie_node *trie_root, nl_trie_node *skip);
+
+//write the entries of nl_bin_write_trie for the given node and everything under it (name holds the name so far, the path to this node)
+void nl_bin_write_trie_entries(nl_bin_writer *w, nl_trie_node *node, nl_val *name, nl_trie_node *skip);
+
+//write a value in the binary format (without the header)
+void nl_bin_write_val(nl_bin_writer *w, const nl_val *v);
+
+//get the next length bytes of binary input
+//returns NULL (and sets the reader's error flag) if the input ends first
+//NOTE: when reading from a file the returned pointer is only good until the next call
+const char *nl_bin_take(nl_bin_reader *rd, unsigned int length);
+
+//read a varint from binary input
+unsigned long long int nl_bin_take_varint(nl_bin_reader *rd);
+
+//remember a value read from binary input so later back-references can refer to it
+void nl_bin_ref_add(nl_bin_reader *rd, nl_val *v);
+
+//read a name written by nl_bin_put_name into a new c string (which you must free)
+//returns NULL at the end of a list of names, or on error (check the reader's error flag)
+char *nl_bin_take_name(nl_bin_reader *rd, unsigned int *length);
+
+//read an environment frame written by nl_bin_write_env
+nl_env_frame *nl_bin_read_env(nl_bin_reader *rd);
+
+//read bindings written by nl_bin_write_trie into the given environment frame
+void nl_bin_read_trie(nl_bin_reader *rd, nl_env_frame *env);
+
+//read a value in the binary format (without the header)
+//returns NULL (and sets the reader's error flag) if the data is bad; anything partially read is still a valid value
+nl_val *nl_bin_read_val(nl_bin_reader *rd);
+
+//encode a value in the compact binary format
+//returns the encoded bytes, or, if a handle is given as the second argument, writes them to that handle and returns TRUE
+nl_val *nl_val_to_bin(nl_val *arg_list);
+
+//decode a value from the binary format, given either a byte array or a handle to read the next value from
+//returns NULL if the data isn't a valid encoded value
+nl_val *nl_bin_to_val(nl_val *arg_list);
+
+//add the header (magic bytes and version) to the start of binary output
+void nl_bin_put_header(nl_bin_writer *w);
+
+//check the header (magic bytes and version) at the start of binary input
+//returns TRUE if it's fine, otherwise outputs an error about err_val and returns FALSE
+char nl_bin_read_header(nl_bin_reader *rd, nl_val *err_val);
+
+//save an interpreter image; this is every global binding that isn't just what the standard library binds anyway (and isn't argv)
+//returns TRUE on success, FALSE on error
+char nl_image_save(nl_env_frame *global_env, const char *fname);
+
+//evaluate an image-save statement; this saves an image of the global environment (the one the given environment is in) to the named file right away
+//returns TRUE on success, FALSE on error
+nl_val *nl_eval_image_save(nl_val *arguments, nl_env_frame *env);
+
+//load an interpreter image saved with nl_image_save into the given global environment
+//returns TRUE on success, FALSE on error
+char nl_image_load(nl_env_frame *global_env, const char *fname);
+
 //assert that all conditions in the given list are true; if not, exit (if compiled _STRICT) or return false (not strict)
 nl_val *nl_assert(nl_val *cond_list);
 
 //sleep a given number of seconds (if multiple arguments are given they are added)
 nl_val *nl_sleep(nl_val *time_list);
 
-//TODO: write a "source" function that imports a different file and executes it (as our include/import/source equivalent)
+//hash source text for the source cache (64-bit FNV-1a)
+unsigned long long int nl_source_hash(const char *data, unsigned int length);
+
+//parse all of a source file's text into a list of (line . expression) pairs, where line is the line the reader was on after that expression
+//the global line number and end of program flag are left as they were
+nl_val *nl_source_parse(const char *data, unsigned int length);
+
+//load the cached parse of a source file, if the cache is there and was made from exactly this text by this interpreter
+//returns the list of (line . expression) pairs, or NULL if the cache can't be used
+nl_val *nl_source_cache_load(nl_val *cache_fname, unsigned long long int hash);
+
+//write the cached parse of a source file; failure (for instance a read-only directory) just means there's no cache next time
+void nl_source_cache_save(nl_val *cache_fname, unsigned long long int hash, nl_val *exps);
+
+//read a source file into a list of (line . expression) pairs, from the cache when the file hasn't changed since it was cached
+//returns NULL if the file is empty or couldn't be read (in which case an error is output)
+nl_val *nl_source_read(nl_val *fname);
+
+//read and evaluate each expression of a source file in the given environment, stopping early if the program exits
+//returns the result of the last expression
+nl_val *nl_source_eval(nl_val *fname, nl_env_frame *env);
+
+//called before anything a parallel map chunk can't do in parallel and still act exactly like a sequential map would
+//(output, input, file changes, errors, exit); a chunk that gets here is abandoned and its part of the array is mapped in order later
+void nl_par_impure();
+
+//returns the time in nanoseconds (from an arbitrary starting point; for measuring how long things take)
+unsigned long long int nl_par_now_ns();
+
+//make a copy of a mapping subroutine for one thread to use
+//a closure's own reference count is changed on every recursive call, so if threads shared one they'd all be fighting over it
+nl_val *nl_par_sub_clone(nl_val *sub);
+
+//map (or fold) a chunk of a parallel job on the current thread
+void nl_par_run_chunk(nl_par_job *job, unsigned int chunk);
+
+//claim and map chunks of the current job until there are none left; returns FALSE if there was no job with chunks left
+//NOTE: nl_par_lock must be held when this is called, and is held again when it returns
+char nl_par_work();
+
+//keep a value (or other memory) that was taken out of an environment until no parallel work is running
+//other threads could still be reading it, so it's free'd by nl_par_release instead of here; either argument can be NULL
+void nl_par_retire(nl_val *v, void *mem);
+
+//finish with the given number of pieces of parallel work (see nl_par_active)
+//once there's none left nothing else can be reading anything that was retired, so it's all free'd
+void nl_par_release(int cnt);
+
+//mark the given frame and every frame above it as visible to tasks, so changes to them are made safely (see nl_bind)
+void nl_par_expose(nl_env_frame *env);
+
+//push a task onto the bottom of a deque; only the thread that owns the deque does this
+//returns FALSE if the deque is full
+char nl_par_deque_push(nl_par_deque *dq, nl_par_task *task);
+
+//pop the newest task off the bottom of a deque; only the thread that owns the deque does this
+//returns NULL if the deque was empty (or a thief took the last task first)
+nl_par_task *nl_par_deque_pop(nl_par_deque *dq);
+
+//steal the oldest task off the top of a deque; any thread can do this
+//returns NULL if the deque was empty or another thread got there first
+nl_par_task *nl_par_deque_steal(nl_par_deque *dq);
+
+//returns TRUE if any deque has tasks on it
+char nl_par_tasks_ready();
+
+//find a task for this thread to run: its own newest task if it has one, otherwise (if steal is TRUE) the oldest task of another thread
+//returns NULL if there's nothing to do
+nl_par_task *nl_par_find_task(char steal);
+
+//wake up a sleeping worker (if there are any) because there's a new task
+void nl_par_notify();
+
+//give back the deque an interpreter claimed in nl_par_start (if it has one), so another interpreter can use it
+void nl_par_deque_release(nl_vm *vm);
+
+//make a task to evaluate the given statements (which become part of the task) with the variables they use from the given environment
+nl_par_task *nl_par_task_malloc(nl_val *body, nl_env_frame *env);
+
+//drop a reference to a task, freeing it if that was the last one
+void nl_par_task_release(nl_par_task *task);
+
+//offer a task to other threads by pushing it onto this thread's deque
+//returns FALSE if it couldn't be (this interpreter has no deque, or it's full); the task is then only run when it's needed
+char nl_par_task_spawn(nl_par_task *task);
+
+//evaluate a task on this thread, in a fresh frame above its variables
+//futures it makes are finished before it's done, like they are for a subroutine call
+void nl_par_task_eval(nl_par_task *task);
+
+//run a task speculatively; like a parallel map chunk, it's abandoned (and left NL_PAR_TASK_ABORTED) if it does anything with side effects
+void nl_par_task_run(nl_par_task *task);
+
+//do something useful while waiting for a task another thread is running
+//a thread that's in the middle of a task only runs its own newer tasks, since a stolen one could end up waiting on the task it's in
+void nl_par_help();
+
+//get the result of a task, running it here if nothing else has (or if its last run was abandoned)
+//returns NULL if the task is being run by this thread already (it's waiting on itself)
+nl_val *nl_par_force(nl_par_task *task);
+
+//finish every future this interpreter made after the given one (NULL for all of them), oldest first
+//they can see the frames of the call that made them, so this is done before that call returns (see nl_apply)
+void nl_par_sync(nl_par_task *mark);
+
+//wait for (but don't finish) every future this interpreter made after the given one, and let go of them
+//this is for when the frames they can see are about to go away anyway (an abandoned task, or an exit)
+void nl_par_wait(nl_par_task *mark);
+
+//capture the variables the given expression uses from the given environment into the captured frame
+//so a task sees them as they were when it was made, whatever happens to the environment afterward
+void nl_par_capture(nl_val *exp, nl_env_frame *env, nl_env_frame *captured);
+
+//evaluate each argument as a task, and return an array of the results (in order)
+nl_val *nl_eval_par(nl_val *arguments, nl_env_frame *env);
+
+//start evaluating the given statements as a task, and return a future for the result right away (see nl_touch)
+nl_val *nl_eval_future(nl_val *arguments, nl_env_frame *env);
+
+//wait for the result of a future (evaluating it here if no other thread has), and return it
+//anything that isn't a future is already its own result
+nl_val *nl_touch(nl_val *arg_list);
+
+//returns TRUE if the given value is plain data (no closures, primitives, structs, handles, or futures) and so can be frozen
+char nl_val_freezable(nl_val *v);
+
+//mark the given value and everything in it as frozen (see NL_VAL_FROZEN)
+//NOTE: nothing else may have a reference to any part of the value yet (nl_freeze makes a copy first)
+void nl_val_freeze(nl_val *v);
+
+//return a frozen copy of the given value (see NL_VAL_FROZEN); this is for large read-only data that parallel work shares
+//looking up a frozen value only copies its top level (arrays and lists share their elements), and threads never contend over it
+nl_val *nl_freeze(nl_val *arg_list);
+
+//the main loop for a worker thread; runs tasks and helps with parallel jobs, and sleeps when there's nothing to do
+void *nl_par_worker(void *arg);
+
+//start the worker threads, if they aren't already running, and give this interpreter a task deque if one is free
+//returns the total number of threads available for parallel work (1 if there are no workers)
+unsigned int nl_par_start();
+
+//start the worker threads and their task deques (see nl_par_start)
+void nl_par_start_workers();
+
+//split the elements of an array from start on into chunks and map them (or if fold is TRUE, fold each chunk) on all free threads
+//elem_ns is about how long each element takes; if that's not enough work to be worth splitting up, nothing is done here
+//results go in res (see nl_par_job), and for folds the chunk size is put in grain
+//returns the index of the first element without a result; everything from there on has to be done in order by the caller
+unsigned int nl_par_run_job(nl_val *a, nl_val *sub, nl_val **res, unsigned int start, unsigned long long int elem_ns, char fold, unsigned int *grain);
+
+//map a subroutine over an array, using as many threads as is worthwhile
+//the result (and any errors or output) is exactly what ar-map would give, as long as the subroutine doesn't depend on
+//state left over in its closure from earlier calls; chunks that do anything with side effects are redone in order
+nl_val *nl_array_pmap(nl_val *arg_list);
+
+//reduce an array to one value by combining its elements with an associative subroutine, using as many threads as is worthwhile
+//the result is what ar-fold would give starting from the first element (NULL for an empty array)
+nl_val *nl_array_reduce(nl_val *arg_list);
+
+//make a coroutine to evaluate the given statements (which become part of it) with the variables they use from the given environment
+//with a NULL body this makes the coroutine for the program itself, which runs on the thread's own stack
+nl_co *nl_co_malloc(nl_val *body, nl_env_frame *env);
+
+//free a coroutine that isn't running (anything still on its stack is left as it is)
+void nl_co_free(nl_co *co);
+
+//put a coroutine at the end of the queue of coroutines that are ready to run
+void nl_co_ready(nl_co *co);
+
+//put a coroutine at the end of the given channel queue
+void nl_co_queue(nl_co **queue, nl_co *co);
+
+//take a coroutine out of the channel queue it's in
+void nl_co_unqueue(nl_co *co);
+
+//take the coroutine at the front of the given channel queue out of it and return it (NULL if the queue is empty)
+nl_co *nl_co_dequeue(nl_co **queue);
+
+//wait until a sleeping coroutine is due to wake up or one waiting for input can read it, and make those ready
+void nl_co_idle(nl_vm *vm);
+
+//free the coroutine that finished last, if there is one; this is done by whichever coroutine runs next
+void nl_co_resumed(nl_vm *vm);
+
+//pause the running coroutine and run the next one that's ready (the running one has to be put wherever it's waiting first)
+//if nothing is ready this waits for a sleeping coroutine or input; if nothing ever could be ready again, whatever is waiting
+//is marked as deadlocked and carries on instead (see nl_co_wait)
+void nl_co_switch();
+
+//where every spawned coroutine starts; this evaluates the coroutine's body and then runs the next one
+void nl_co_entry();
+
+//make the running coroutine wait in the given channel queue until another one wakes it up
+//returns FALSE if nothing ever could (it's been taken back out of the queue)
+char nl_co_wait(nl_co **queue);
+
+//before a read that could block, let other coroutines run until the given file descriptor has something to read
+void nl_co_wait_fd(int fd);
+
+//let other coroutines run while the running one sleeps for the given number of microseconds
+//returns FALSE if there are no other coroutines (so the caller should just sleep)
+char nl_co_sleep(unsigned long long int usec);
+
+//run the program's coroutines until they've all finished, before the program ends
+//any that are left waiting on something that will never happen are abandoned
+void nl_co_join();
+
+//free every coroutine that hasn't finished, without running any more of them (for the end of the program)
+void nl_co_abandon_all();
+
+//start a coroutine to evaluate the given statements; it runs once the running coroutine waits or yields
+nl_val *nl_eval_spawn(nl_val *arguments, nl_env_frame *env);
+
+//let other coroutines that are ready run before this one carries on
+nl_val *nl_co_yield(nl_val *arg_list);
+
+//make a new channel, which holds at most the given number of values (0 if none is given)
+nl_val *nl_chan_new(nl_val *arg_list);
+
+//free a channel and anything still queued in it
+void nl_chan_free(nl_chan *ch);
+
+//send a value on a channel, waiting until there's room for it (or, with a capacity of 0, until something receives it)
+//returns TRUE once the value is sent
+nl_val *nl_chan_send(nl_val *arg_list);
+
+//receive the next value from a channel, waiting until there is one; returns NULL once the channel is closed and empty
+nl_val *nl_chan_recv(nl_val *arg_list);
+
+//close the given channel(s); waiting receivers get NULL, and waiting senders get an error
+nl_val *nl_chan_close(nl_val *arg_list);
+
+//register a new isolate for the given program (which takes ownership of fname and argv), started by the given isolate
+nl_isolate *nl_isolate_malloc(char *fname, nl_val *argv, unsigned int parent);
+
+//get the isolate with the given number, or NULL if there isn't one
+nl_isolate *nl_isolate_lookup(unsigned int id);
+
+//get this thread's isolate, making the running program an isolate if it isn't one yet
+nl_isolate *nl_isolate_self();
+
+//the main subroutine of an isolate's thread; runs the isolate's program in a new interpreter
+void *nl_isolate_main(void *arg);
+
+//mark an isolate as done with the given exit status, dropping any messages it never received
+void nl_isolate_finish(nl_isolate *iso, int status);
+
+//returns TRUE if this thread is running an isolate that was started by another (rather than the program itself)
+char nl_isolate_started();
+
+//mark packed storage in the given value as shared between isolates, so that a copy of it can be given to another isolate
+//(frozen parts are already marked, see nl_val_freeze)
+void nl_val_share(nl_val *v);
+
+//make the copy of a value that gets given to another isolate; the value must be plain data (see nl_val_freezable)
+nl_val *nl_isolate_msg_cp(nl_val *v);
+
+//start a new isolate running the given program file with the given arguments (plain data); returns its number
+nl_val *nl_isolate_start(nl_val *arg_list);
+
+//get the isolate given by number as the first argument of a primitive, or NULL (after an error) if there isn't one
+nl_isolate *nl_isolate_arg(nl_val *arg_list, const char *err_msg);
+
+//post a message (plain data) to the given isolate; returns TRUE, or FALSE if that isolate has already ended
+nl_val *nl_isolate_post(nl_val *arg_list);
+
+//receive the next message posted to this isolate, waiting until there is one
+nl_val *nl_isolate_recv(nl_val *arg_list);
+
+//the number of the running isolate
+nl_val *nl_isolate_self_num(nl_val *arg_list);
+
+//the number of the isolate that started this one (NULL for the program itself)
+nl_val *nl_isolate_parent(nl_val *arg_list);
+
+//wait for the given isolate to end; returns its exit status
+nl_val *nl_isolate_wait(nl_val *arg_list);
+
+//get the number for a name used in profile frames, adding it if it's new
+unsigned int nl_prof_name(const char *name);
+
+//name a subroutine for the profiler after the symbol it's being bound to, if it doesn't have a name yet
+void nl_prof_name_sub(nl_val *sub, nl_val *sym);
+
+//returns the profile frame for a call to the given subroutine (its name number, and its line)
+unsigned long long nl_prof_frame(nl_val *sub);
+
+//record a call (the given frame) on the profiler's call stack
+void nl_prof_push(nl_vm *vm, unsigned long long frame);
+
+//take the newest call off the profiler's call stack
+void nl_prof_pop(nl_vm *vm);
+
+//the newest call on the profiler's call stack made a tailcall (the given frame), which takes its place
+void nl_prof_tail(nl_vm *vm, unsigned long long frame);
+
+//switch the profiler's call stack from one coroutine to another (see nl_co_switch)
+void nl_prof_co_switch(nl_vm *vm, nl_co *cur, nl_co *next);
+
+//set up profiling for a new interpreter, with the given name for the frame its samples start with
+void nl_prof_vm_init(nl_vm *vm, const char *root);
+
+//add an interpreter's remaining samples to the profile and stop sampling it (before it's free'd)
+void nl_prof_vm_free(nl_vm *vm);
+
+//the SIGPROF handler; records the call stack of whatever interpreter this thread is running
+void nl_prof_sample(int sig);
+
+//find the given stack (its frame count and then its frames) in the profile's table, or the empty entry where it belongs
+unsigned int nl_prof_slot(const unsigned long long *stack);
+
+//count one sample of the given stack (its frame count and then its frames) in the profile (nl_prof_lock must be held)
+void nl_prof_add(const unsigned long long *stack);
+
+//add the samples in the given ring to the profile (nl_prof_lock must be held)
+void nl_prof_drain(nl_prof_ring *ring);
+
+//add the running interpreter's samples to the profile once its ring is half full
+void nl_prof_check(nl_vm *vm);
+
+//start profiling the process, writing the profile to the given file when it exits
+//returns FALSE if the profiler's timer couldn't be started
+char nl_prof_start(const char *fname);
+
+//write one frame of a profile stack
+void nl_prof_out_frame(FILE *fp, unsigned long long frame);
+
+//add the names every profile has (see NL_PROF_NAME_SUB), if they aren't there yet
+void nl_prof_names_init();
+
+//get the key number that calls are counted under for a subroutine frame (see nl_prof_frame) or a primitive's function
+//pri is TRUE for primitives; name is the primitive's name number, or 0 if it isn't known yet
+unsigned int nl_prof_key(char pri, unsigned long long k, unsigned int name);
+
+//get the key a subroutine's calls are counted under
+unsigned int nl_prof_sub_key(nl_val *sub);
+
+//start counting a call under the given key (keep is TRUE for the start of a future or coroutine; see nl_prof_call)
+void nl_prof_count_enter(nl_vm *vm, unsigned int id, char keep);
+
+//finish counting the newest call
+void nl_prof_count_exit(nl_vm *vm);
+
+//the newest call being counted made a tailcall (counted under the given key), which takes its place
+void nl_prof_count_tail(nl_vm *vm, unsigned int id);
+
+//finish counting every call past the given depth (the start of a future or coroutine, and any tailcalls on top of it)
+void nl_prof_count_leave(nl_vm *vm, unsigned int depth);
+
+//stop counting calls past the given depth without adding anything for them (for abandoned parallel work)
+void nl_prof_count_unwind(nl_vm *vm, unsigned int depth);
+
+//call a primitive, counting the call
+nl_val *nl_prof_count_pri(nl_val *pri, nl_val *arguments);
+
+//switch the calls being counted from one coroutine to another (see nl_co_switch); what happens while a coroutine is paused isn't counted for it
+void nl_prof_count_co_switch(nl_vm *vm, nl_co *cur, nl_co *next);
+
+//set up call counting for a new interpreter
+void nl_prof_count_vm_init(nl_vm *vm);
+
+//stop counting calls for an interpreter (before it's free'd); its counts are kept for reports
+void nl_prof_count_vm_free(nl_vm *vm);
+
+//name every primitive bound in the given environment, so reports can say which is which
+void nl_prof_count_names(nl_env_frame *env);
+
+//count calls for the whole process (without writing a report; see nl_prof_count_start)
+void nl_prof_count_enable();
+
+//start counting calls for the whole process, and write a report to stderr when it exits
+void nl_prof_count_start();
+
+//write the counts (added up over every interpreter) to the given file as a table, most exclusive time first
+void nl_prof_count_report(FILE *fp);
+
+//write the counts report at exit (see nl_prof_count_start)
+void nl_prof_count_finish();
+
+//write the counts so far to stdout (see --prof-count)
+nl_val *nl_prof_report(nl_val *arg_list);
+
+//start keeping statistics for a new interpreter
+void nl_stats_vm_init(nl_vm *vm);
+
+//add an interpreter's statistics to the totals of interpreters that are done (before it's free'd)
+void nl_stats_vm_free(nl_vm *vm);
+
+//add one interpreter's statistics to a total (with the lock that protects them held, or with the interpreter stopped)
+void nl_stats_add(nl_stats *total, nl_stats *stats);
+
+//add up the statistics of every interpreter, running or not
+//the peak is the sum of each interpreter's own peak, so with more than one interpreter it's an upper bound
+void nl_stats_total(nl_stats *total);
+
+//write the statistics for the whole run to stderr as JSON (see --stats)
+void nl_stats_finish();
+
+//returns memory statistics for the whole process (see nl_stats) as a struct
+nl_val *nl_mem_stats(nl_val *arg_list);
+
+//write the memory statistics for the whole process to the given file, in a form meant for people to read
+void nl_mem_report(FILE *fp);
+
+//write the memory report at exit (see --mem-report)
+void nl_mem_report_finish();
+
+//returns the processor time the whole process has used, in nanoseconds
+unsigned long long int nl_stats_cpu_ns();
+
+//TRUE when hardware performance counters are being read (see --perf-counters)
+extern char nl_perf_on;
+
+//open the hardware performance counters for the calling thread; if none of them can be opened this writes why to stderr and leaves nl_perf_on FALSE
+void nl_perf_start();
+
+//returns TRUE if the counters are open and count the calling thread (they only count the thread that opened them)
+char nl_perf_here();
+
+//read the counters
+void nl_perf_read(nl_perf_counts *counts);
+
+//write the counts between two readings to the given file, with instructions per cycle and miss rates, labelled with the given line number
+//(a line of 0 labels them as the total)
+void nl_perf_report(FILE *fp, unsigned int line, nl_perf_counts *start, nl_perf_counts *end);
+
+//start counting a top-level expression, if counters are on and this isn't inside another one; returns TRUE if it is being counted
+char nl_perf_form_start(nl_perf_counts *start);
+
+//finish counting a top-level expression that nl_perf_form_start started, and report it
+void nl_perf_form_end(nl_perf_counts *start, unsigned int line);
+
+//report the counts for the whole program, and close the counters (see --perf-counters)
+void nl_perf_finish();
+
+//TRUE when calls are being traced (see --trace), and the shortest primitive call that's traced, in nanoseconds
+extern char nl_trace_on;
+extern unsigned long long nl_trace_min_ns;
+
+//start tracing calls to the given file (which is written as a Chrome trace, a JSON array of trace events); returns FALSE if it can't be written
+char nl_trace_start(const char *fname);
+
+//returns TRUE if the given primitive function reads or writes files (calls to these are always traced)
+char nl_trace_io(nl_val *(*function)(nl_val *arglist));
+
+//add a finished call to an interpreter's trace, if it's a kind that's traced
+void nl_trace_add(nl_vm *vm, nl_prof_call *call, unsigned long long ns);
+
+//write out the spans in a buffer (nl_trace_lock must be held)
+void nl_trace_flush(nl_trace_buf *buf);
+
+//set up tracing for a new interpreter
+void nl_trace_vm_init(nl_vm *vm);
+
+//write out an interpreter's spans and stop tracing it (before it's free'd)
+void nl_trace_vm_free(nl_vm *vm);
+
+//write out every interpreter's spans and finish the trace file (see --trace)
+void nl_trace_finish();
+
+//evaluate a time statement's body (a sequence, like begin), and write how long it took and how many values were allocated and free'd meanwhile to stderr
+//returns the value of the body
+nl_val *nl_eval_time(nl_val *arguments, nl_env_frame *env, char *early_ret);
+
+#ifdef _LEAKCHECK
+//add a new value to the list of live values
+void nl_leak_link(nl_val *v);
+
+//take a value that's about to be free'd out of the list of live values
+void nl_leak_unlink(nl_val *v);
+
+//write the live values to the given file, grouped by where they were allocated and their type, most first, with a sample of each
+//all is TRUE to include every live value, or FALSE for only the ones allocated since the last report
+//returns the number of values reported
+unsigned long long nl_leak_report(FILE *fp, char all);
+#endif
+
+//report the values allocated since the last leak-check that are still live (to stdout), and return how many there were
+//this is only available in interpreters built with _LEAKCHECK (make leakcheck)
+nl_val *nl_leak_check(nl_val *arg_list);
+
+//stop sampling and write the profile, as collapsed stacks (one "frame;frame;... count" line per distinct stack, for flamegraph.pl)
+void nl_prof_finish();
 
 //END NL DECLARATIONS ---------------------------------------------------------------------------------------------
 
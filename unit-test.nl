@@ -646,6 +646,9 @@ else
 (outs "this is " "a test" "..." $newline)
 (outs (, "now with " "explicit concatenation" $newline))
 
+//buffered output can be written out explicitly (flush returns NULL)
+(assert (null? (flush)))
+
 //array operations, via strings
 (let str-len $ar-sz)
 (assert (= 6 ($str-len "a test")))
@@ -688,6 +691,12 @@ else
 //memory string (what this value looks in memory, as a string)
 (assert (= "(a b c)" (val->memstr (lit ('a' 'b' 'c')))))
 
+//binary encoding (round trips through val->bin and bin->val)
+(let bin-test (list 1 -2 (/ 3 4) 'c' "str" (array 1 "two") (lit (a $b)) (struct (x 5) (y "why")) NULL))
+(assert (= (bin->val (val->bin $bin-test)) $bin-test))
+(assert (= (bin->val (val->bin "")) ""))
+(assert (null? (bin->val (val->bin NULL))))
+
 //array omit
 (assert (= (array 1 2 4) (ar-omit (array 1 2 3 4) 2)))
 
@@ -733,6 +742,163 @@ else
 //ensure mapping works properly
 (assert (= (ar-map (array 0 1 2 3 4) (sub (n) (* $n 2))) (array 0 2 4 6 8)))
 (assert (= (ar-map (array 5 4 3 2 1) (sub (elem) (/ $elem 2))) (array 5/2 2 3/2 1 1/2)))
+(assert (= (ar-pmap (array 0 1 2 3 4) (sub (n) (* $n 2))) (array 0 2 4 6 8)))
+(let pmap-fib (sub (n) (if (< $n 2) $n else (+ (recur (- $n 1)) (recur (- $n 2))))))
+(let pmap-input (array 14 2 13 3 12 4 14 2 13 3 12 4 14 2 13 3 12 4 14 2 13 3 12 4))
+(assert (= (ar-pmap $pmap-input $pmap-fib) (ar-map $pmap-input $pmap-fib)))
+(assert (= (ar-idx (ar-pmap $pmap-input (sub (n) (ar-cat "fib " (val->memstr ($pmap-fib $n))))) 0) "fib 377/1"))
+//a subroutine that keeps a running total in its closure gives the same totals as ar-map, however many threads there are
+(let pmap-acc 0)
+(let pmap-total-seq (sub (n) (begin ($pmap-fib 11) (let pmap-acc (+ $pmap-acc $n)) $pmap-acc)))
+(let pmap-total-par (sub (n) (begin ($pmap-fib 11) (let pmap-acc (+ $pmap-acc $n)) $pmap-acc)))
+(let pmap-ones ((sub (k) (if (= $k 0) (array) else (ar-extend (recur (- $k 1)) 1))) 400))
+(let pmap-totals (ar-pmap $pmap-ones $pmap-total-par))
+(assert (= $pmap-totals (ar-map $pmap-ones $pmap-total-seq)))
+(assert (= (ar-idx $pmap-totals 399) 400))
+//closures returned from parallel work can still be called once it's over
+(let pmap-idxs ((sub (k) (if (= $k 0) (array) else (ar-extend (recur (- $k 1)) (- $k 1)))) 64))
+(let pmap-mk (sub (n) (begin (if (< $n 3) (let pmap-z 100) else 0) ($pmap-fib 14) (sub (m) (+ $m $pmap-z)))))
+(let pmap-closures (ar-pmap $pmap-idxs $pmap-mk))
+(assert (= ((ar-idx $pmap-closures 63) 1) 101))
+
+//folds go in order from an initial value; reduces combine with an associative subroutine, maybe on several threads
+(assert (= (ar-fold (array 1 2 3 4) 0 $+) 10))
+(assert (= (ar-fold (array 1/2 1/3 1/6) 1 $*) 1/36))
+(assert (= (ar-fold (array 1 2 3) 10 (sub (acc n) (- $acc $n))) 4))
+(assert (= (ar-fold "abc" (num->byte 0) $b|) 'c'))
+(assert (= (ar-reduce (array 1 2 3 4 5) $+) 15))
+(assert (= (ar-reduce (array "a" "b" "c") $ar-cat) "abc"))
+(assert (null? (ar-reduce (array) $+)))
+(assert (= (ar-reduce (ar-map $pmap-input $pmap-fib) (sub (a b) (begin ($pmap-fib 12) (+ $a $b)))) 3040))
+
+//par and future evaluate on other threads, but give exactly what evaluating in order would
+(let par-fib (sub (n) (if (< $n 10) ($pmap-fib $n) else (begin (let r (par (recur (- $n 1)) (recur (- $n 2)))) (+ (ar-idx $r 0) (ar-idx $r 1))))))
+(assert (= ($par-fib 16) ($pmap-fib 16)))
+(let future-fib (sub (n) (if (< $n 10) ($pmap-fib $n) else (begin (let a (future (recur (- $n 1)))) (+ (touch $a) (recur (- $n 2)))))))
+(assert (= ($future-fib 16) 987))
+(assert (= (par (+ 1 2) (begin "a" "b")) (array 3 "b")))
+(let par-x 5)
+(let par-future (future (* $par-x 10)))
+(let par-x 6)
+(assert (= (touch $par-future) 50))
+(assert (= (touch 42) 42))
+//a future bound in the closure that made it lets go of that closure once it's done (the leak-check build reports them otherwise)
+(assert (= ((sub (n) (if (< $n 2) $n else (begin (let fut-a (future (recur (- $n 1)))) (+ (touch $fut-a) (recur (- $n 2)))))) 10) 55))
+
+//frozen data is shared between copies, but copies can still be changed without changing it
+(let frozen-data (freeze (array 1 2 (array 3 4) "str" (list 5 6))))
+(assert (= $frozen-data (array 1 2 (array 3 4) "str" (list 5 6))))
+(assert (= (ar-extend $frozen-data 7) (array 1 2 (array 3 4) "str" (list 5 6) 7)))
+(assert (= (ar-idx $frozen-data 4) (list 5 6)))
+(assert (= (list-cat (ar-idx $frozen-data 4) (list 7)) (list 5 6 7)))
+(assert (= (ar-pmap (array 0 1 2) (sub (n) (ar-idx $frozen-data $n))) (array 1 2 (array 3 4))))
+(assert (= $frozen-data (array 1 2 (array 3 4) "str" (list 5 6))))
+
+//coroutines take turns on the interpreter's thread, and pass values to each other over channels
+(let co-chan (chan 2))
+(spawn (send $co-chan 1) (send $co-chan 2) (send $co-chan 3) (chan-close $co-chan))
+(assert (= (recv $co-chan) 1))
+(assert (= (recv $co-chan) 2))
+(assert (= (recv $co-chan) 3))
+(assert (null? (recv $co-chan)))
+(let co-nums (chan))
+(let co-squares (chan))
+(let co-pump (sub (in out v) (if (null? $v) (chan-close $out) else (begin (send $out (* $v $v)) (recur $in $out (recv $in))))))
+(let co-sum (sub (in acc v) (if (null? $v) $acc else (recur $in (+ $acc $v) (recv $in)))))
+(spawn (for n 1 (<= $n 10) (+ $n 1) (send $co-nums $n)) (chan-close $co-nums))
+(spawn ($co-pump $co-nums $co-squares (recv $co-nums)))
+(assert (= ($co-sum $co-squares 0 (recv $co-squares)) 385))
+(let co-order (chan 2))
+(spawn (sleep 1/100) (send $co-order "slow"))
+(spawn (send $co-order "fast"))
+(assert (= (recv $co-order) "fast"))
+(assert (= (recv $co-order) "slow"))
+//sending a closure that wasn't made in a coroutine doesn't keep the coroutine's frames (the leak-check build reports them otherwise)
+(assert (= ((sub (n) (if (= $n 0) 0 else (begin (let co-c (chan 1)) (let co-a (spawn (send $co-c recur))) ((recv $co-c) 0)))) 3) 0))
+
+//array find returns the index of the first occurance of the given subarray (or -1 if it isn't there)
+(assert (= (ar-find "asdfasdf" "fa") 3))
+(assert (= (ar-find "asdfasdf" "x") -1))
+(assert (= (ar-find (array 1 2 3 4) (array 3 4)) 2))
+
+//file->ar maps the file, but the result works like any other array
+(let this-file (file->ar (list-idx $argv 0)))
+(assert (= (ar-subar $this-file 0 2) "#!"))
+(assert (= (ar-find $this-file "//END standard library array testing") (ar-find (, $this-file) "//END standard library array testing")))
+(assert (= (ar-sz (ar-extend $this-file 'x')) (+ (ar-sz $this-file) 1)))
+(assert (= (ar-idx (ar-extend $this-file 'x') (ar-sz $this-file)) 'x'))
+
+//file handles read a line at a time (without the newline) or a chunk at a time
+(let this-fh (file-open (list-idx $argv 0)))
+(assert (= (file-read-line $this-fh) "#!/usr/bin/neul"))
+(assert (= (file-read-line $this-fh) ""))
+(assert (= (file-read-chunk $this-fh 5) "//a u"))
+(assert (not (file-eof $this-fh)))
+(file-close $this-fh)
+
+//files can be written whole (atomically), appended to, or written through a handle
+//(file-tmp makes a file with a name no other file has, so runs at the same time don't share files; each block deletes its own)
+(let tmp-file (file-tmp "/tmp/neulang-unit-test-" ".txt"))
+(assert (= (file->ar $tmp-file) ""))
+(assert (ar->file $tmp-file "first"))
+(assert (= (file->ar $tmp-file) "first"))
+(assert (ar->file-append $tmp-file " second"))
+(assert (= (file->ar $tmp-file) "first second"))
+(let tmp-fh (file-open $tmp-file "w"))
+(assert (file-write $tmp-fh "third" $newl "fourth"))
+(flush $tmp-fh)
+(assert (= (file->ar $tmp-file) (, "third" $newl "fourth")))
+(file-close $tmp-fh)
+
+//an array read from a file stays readable when the file is truncated after it was read
+(let repeat-str (sub (s n) (if (= $n 0) $s else ($repeat-str (, $s $s) (- $n 1)))))
+(assert (ar->file $tmp-file ($repeat-str "0123456789" 14)))
+(let big-file (file->ar $tmp-file))
+(let tmp-fh (file-open $tmp-file "w"))
+(assert (file-write $tmp-fh "short"))
+(file-close $tmp-fh)
+(assert (= (ar-idx $big-file 50000) '0'))
+(assert (= (file->ar $tmp-file) "short"))
+
+//a chunk's storage is only as big as what's actually read, whatever count is asked for
+(let tmp-fh (file-open $tmp-file))
+(let packed-before (struct-get (mem-stats) packed-bytes))
+(let tmp-chunk (file-read-chunk $tmp-fh 1000000000))
+(assert (< (- (struct-get (mem-stats) packed-bytes) $packed-before) 1000))
+(assert (= $tmp-chunk "short"))
+(file-close $tmp-fh)
+(assert (file-delete $tmp-file))
+(assert (not (file-delete $tmp-file)))
+
+//an image can be saved with channels (and handles) bound; those bindings are just left out, with a warning
+(let image-chan (chan))
+(let tmp-image (file-tmp "/tmp/neulang-unit-test-" ".img"))
+(assert (image-save $tmp-image))
+(assert (> (ar-sz (file->ar $tmp-image)) 0))
+(assert (file-delete $tmp-image))
+
+//source evaluates another file here; its parse is cached, and the cache is only used while the file is unchanged
+(let tmp-source (file-tmp "/tmp/neulang-unit-test-source-" ".nl"))
+(assert (ar->file $tmp-source (, "(let sourced-value 3)" $newl "(+ $sourced-value 1)")))
+(assert (= 4 (source $tmp-source)))
+(assert (= 3 $sourced-value))
+(assert (ar->file $tmp-source "(let sourced-value 5)"))
+(source $tmp-source)
+(assert (= 5 $sourced-value))
+(assert (file-delete $tmp-source))
+(file-delete (, $tmp-source "c"))
+
+//isolates run another program on their own thread and interpreter, and only share messages (plain data) with each other
+(let tmp-isolate (file-tmp "/tmp/neulang-unit-test-isolate-" ".nl"))
+(assert (ar->file $tmp-isolate "(isolate-post (isolate-parent) (list (list-idx $argv 1) (ar-sz (isolate-recv)))) (exit 4)"))
+(let iso (isolate $tmp-isolate "worker"))
+(assert (isolate-post $iso (freeze (ar-extend $this-file 'x'))))
+(assert (= (isolate-recv) (list "worker" (+ (ar-sz $this-file) 1))))
+(assert (= (isolate-wait $iso) 4))
+(assert (not (isolate-post $iso 1)))
+(assert (file-delete $tmp-isolate))
+(file-delete (, $tmp-isolate "c"))
+(assert (null? (isolate-parent)))
 
 //END standard library array testing ----------------------------------------------------------------------
 
@@ -771,6 +937,11 @@ else
 (let some-data (struct-replace $some-data a-var 20))
 (assert (= 20 (struct-get $some-data a-var)))
 
+//memory statistics are a struct too, and everything counted is still in use while it's bound
+(assert (> (struct-get (mem-stats) live) 0))
+(assert (> (struct-get (struct-get (mem-stats) live-by-type) struct) 0))
+(assert (>= (struct-get (mem-stats) peak-bytes) (struct-get (mem-stats) bytes)))
+
 (assert (= (struct (a 5)) (struct (a 5))))
 (assert (not (= (struct (a 4)) (struct (a 5)))))
 (assert (not (= (struct (a 5)) (struct (b 5)))))